@@ -0,0 +1,373 @@
+/**
+ * \file atecc608a.hpp
+ * \brief Type-safe C++17 interface to the ATECC608A driver and utilities.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_HPP
+#define ATECC608A_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+extern "C" {
+#include "psa/crypto.h"
+#include "atecc608a_se.h"
+#include "atecc608a_utils.h"
+#include "atecc508a_config_dev.h"
+}
+
+/* Everything in this header is inline and the slot types are empty, so a
+ * call compiles down to the same locked driver call that the C code makes. What the
+ * types add is that the slot numbers and roles are known at compile time:
+ * signing with a public key slot, for example, is a compile error rather than
+ * an error returned by the chip after a round trip. */
+namespace atecc608a {
+
+constexpr uint16_t slot_count = 16;
+
+/** What a slot holds, as far as the operations below are concerned. */
+enum class SlotRole {
+    /** P256 private key, usable for signing and public key export. */
+    private_key,
+    /** P256 public key, usable for verification. */
+    public_key,
+    /** Clear text data, such as certificates. */
+    data,
+    /** Secret that is neither an ECC key nor readable, such as an ECDH
+     *  master secret. */
+    secret,
+};
+
+/** Decode the role of `slot` from a 128 byte configuration zone image.
+ *  See atecc508a_config_dev.h for the meaning of the bits. */
+constexpr SlotRole slot_role(const uint8_t *config, uint16_t slot)
+{
+    const uint8_t slot_config = config[20 + 2 * slot];
+    const uint8_t key_config = config[96 + 2 * slot];
+    const bool is_secret = (slot_config & 0x80) != 0;
+    const bool is_private = (key_config & 0x01) != 0;
+    const bool is_p256 = ((key_config >> 2) & 0x07) == 0x04;
+
+    if (is_p256) {
+        return is_private ? SlotRole::private_key : SlotRole::public_key;
+    }
+    return is_secret ? SlotRole::secret : SlotRole::data;
+}
+
+/** Clear text reads are allowed when IsSecret is not set. */
+constexpr bool slot_readable(const uint8_t *config, uint16_t slot)
+{
+    return (config[20 + 2 * slot] & 0x80) == 0;
+}
+
+/** Clear text writes are allowed when WriteConfig is "Always" (0b0000). */
+constexpr bool slot_writable(const uint8_t *config, uint16_t slot)
+{
+    return (config[21 + 2 * slot] & 0xF0) == 0;
+}
+
+/** A slot of a device configured with the `Config` template.
+ *
+ *  \code
+ *  using DeviceKey = atecc608a::DevSlot<0>;
+ *  using PeerKey = atecc608a::DevSlot<9>;
+ *  atecc608a::sign(DeviceKey{}, hash, signature, signature_length);
+ *  atecc608a::sign(PeerKey{}, hash, signature, signature_length); // error
+ *  \endcode */
+template <const uint8_t *Config, uint16_t N>
+struct Slot {
+    static_assert(N < slot_count, "The ATECC608A has 16 slots (0-15)");
+
+    static constexpr psa_key_slot_number_t number = N;
+    static constexpr SlotRole role = slot_role(Config, N);
+    static constexpr bool readable = slot_readable(Config, N);
+    static constexpr bool writable = slot_writable(Config, N);
+};
+
+/** Slots of a device configured with the developer's template, which is the
+ *  one written by `write_lock_config`. */
+template <uint16_t N>
+using DevSlot = Slot<template_config_508a_dev, N>;
+
+/** Non-owning view of a contiguous buffer, standing in for C++20 std::span.
+ *  Buffers are passed to the driver in place, without copies. */
+template <typename T>
+class span {
+public:
+    constexpr span() noexcept : _data(nullptr), _size(0) {}
+    constexpr span(T *data, size_t size) noexcept : _data(data), _size(size) {}
+
+    template <size_t N>
+    constexpr span(T (&array)[N]) noexcept : _data(array), _size(N) {}
+
+    template <typename U, size_t N,
+              typename = std::enable_if_t<std::is_convertible<U (*)[], T (*)[]>::value>>
+    constexpr span(std::array<U, N> &array) noexcept :
+        _data(array.data()), _size(N) {}
+
+    template <typename U, size_t N,
+              typename = std::enable_if_t<std::is_convertible<const U (*)[], T (*)[]>::value>>
+    constexpr span(const std::array<U, N> &array) noexcept :
+        _data(array.data()), _size(N) {}
+
+    /* span<uint8_t> converts to span<const uint8_t>. */
+    template <typename U,
+              typename = std::enable_if_t<std::is_convertible<U (*)[], T (*)[]>::value>>
+    constexpr span(const span<U> &other) noexcept :
+        _data(other.data()), _size(other.size()) {}
+
+    constexpr T *data() const noexcept
+    {
+        return _data;
+    }
+
+    constexpr size_t size() const noexcept
+    {
+        return _size;
+    }
+
+    constexpr span subspan(size_t offset, size_t count) const noexcept
+    {
+        return span(_data + offset, count);
+    }
+
+private:
+    T *_data;
+    size_t _size;
+};
+
+/** P256 ECDSA with SHA-256, the only algorithm the driver supports. */
+constexpr psa_algorithm_t ecdsa_sha256 = PSA_ALG_ECDSA(PSA_ALG_SHA_256);
+constexpr psa_key_type_t p256_keypair =
+    PSA_KEY_TYPE_ECC_KEYPAIR(PSA_ECC_CURVE_SECP256R1);
+constexpr psa_key_type_t p256_public_key =
+    PSA_KEY_TYPE_ECC_PUBLIC_KEY(PSA_ECC_CURVE_SECP256R1);
+constexpr size_t p256_bits = 256;
+
+template <typename S>
+inline psa_status_t generate(S, span<uint8_t> pubkey = {},
+                             size_t *pubkey_length = nullptr)
+{
+    static_assert(S::role == SlotRole::private_key,
+                  "Keys can only be generated in private key slots");
+    return atecc608a_driver()->p_key_management->p_generate(
+               S::number, p256_keypair,
+               PSA_KEY_USAGE_SIGN | PSA_KEY_USAGE_VERIFY, p256_bits,
+               NULL, 0, pubkey.data(), pubkey.size(), pubkey_length);
+}
+
+template <typename S>
+inline psa_status_t export_public_key(S, span<uint8_t> pubkey,
+                                      size_t &pubkey_length)
+{
+    static_assert(S::role == SlotRole::private_key ||
+                  S::role == SlotRole::public_key,
+                  "Public keys can only be exported from key slots");
+    return atecc608a_driver()->p_key_management->p_export(
+               S::number, pubkey.data(), pubkey.size(), &pubkey_length);
+}
+
+template <typename S>
+inline psa_status_t import_public_key(S, span<const uint8_t> pubkey)
+{
+    static_assert(S::role == SlotRole::public_key,
+                  "Public keys can only be imported to public key slots");
+    return atecc608a_driver()->p_key_management->p_import(
+               S::number, atecc608a_drv_info.lifetime, p256_public_key,
+               ecdsa_sha256, PSA_KEY_USAGE_VERIFY, pubkey.data(),
+               pubkey.size());
+}
+
+template <typename S>
+inline psa_status_t sign(S, span<const uint8_t> hash, span<uint8_t> signature,
+                         size_t &signature_length)
+{
+    static_assert(S::role == SlotRole::private_key,
+                  "Signing requires a private key slot");
+    return atecc608a_driver()->p_asym->p_sign(
+               S::number, ecdsa_sha256, hash.data(), hash.size(),
+               signature.data(), signature.size(), &signature_length);
+}
+
+template <typename S>
+inline psa_status_t verify(S, span<const uint8_t> hash,
+                           span<const uint8_t> signature)
+{
+    static_assert(S::role == SlotRole::public_key,
+                  "Verification requires a public key slot");
+    return atecc608a_driver()->p_asym->p_verify(
+               S::number, ecdsa_sha256, hash.data(), hash.size(),
+               signature.data(), signature.size());
+}
+
+template <typename S>
+inline psa_status_t read(S, size_t offset, span<uint8_t> data)
+{
+    static_assert(S::readable, "The slot does not allow clear text reads");
+    return atecc608a_device_read(S::number, offset, data.data(), data.size());
+}
+
+template <typename S>
+inline psa_status_t write(S, size_t offset, span<const uint8_t> data)
+{
+    static_assert(S::writable, "The slot does not allow clear text writes");
+    return atecc608a_device_write(S::number, offset, data.data(), data.size());
+}
+
+inline psa_status_t random_32_bytes(span<uint8_t> out)
+{
+    return atecc608a_random_32_bytes(out.data(), out.size());
+}
+
+inline psa_status_t serial_number(span<uint8_t> out, size_t &length)
+{
+    return atecc608a_get_serial_number(out.data(), out.size(), &length);
+}
+
+/** Holds the device lock and keeps the device initialized, for direct
+ *  cryptoauthlib (atcab_*) calls.
+ *
+ *  The functions above, the driver and the utilities take the device lock
+ *  themselves, so other threads, the request service among them, may call
+ *  them at any time: they wait for the session to close. The thread that
+ *  owns the session should not call them inside it, as they release the
+ *  device when done, which ends the initialization of the session too. */
+class Session {
+public:
+    Session() noexcept
+    {
+        atecc608a_device_lock();
+        _status = atecc608a_init();
+    }
+
+    ~Session()
+    {
+        if (_status == PSA_SUCCESS) {
+            atecc608a_deinit();
+        }
+        atecc608a_device_unlock();
+    }
+
+    Session(const Session &) = delete;
+    Session &operator=(const Session &) = delete;
+
+    /** PSA_SUCCESS if the device was initialized. */
+    psa_status_t status() const noexcept
+    {
+        return _status;
+    }
+
+private:
+    psa_status_t _status;
+};
+
+/** Owns a volatile PSA key and closes it on destruction. Move-only, so a key
+ *  can't be closed twice or used after it has been closed. */
+class KeyHandle {
+public:
+    KeyHandle() noexcept : _handle(0) {}
+    explicit KeyHandle(psa_key_handle_t handle) noexcept : _handle(handle) {}
+
+    ~KeyHandle()
+    {
+        reset();
+    }
+
+    KeyHandle(KeyHandle &&other) noexcept : _handle(other.release()) {}
+
+    KeyHandle &operator=(KeyHandle &&other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            _handle = other.release();
+        }
+        return *this;
+    }
+
+    KeyHandle(const KeyHandle &) = delete;
+    KeyHandle &operator=(const KeyHandle &) = delete;
+
+    psa_key_handle_t get() const noexcept
+    {
+        return _handle;
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return _handle != 0;
+    }
+
+    psa_key_handle_t release() noexcept
+    {
+        psa_key_handle_t handle = _handle;
+        _handle = 0;
+        return handle;
+    }
+
+    void reset() noexcept
+    {
+        if (_handle != 0) {
+            psa_close_key(_handle);
+            _handle = 0;
+        }
+    }
+
+private:
+    psa_key_handle_t _handle;
+};
+
+/** Import a public key exported from the device into a volatile PSA key that
+ *  can only be used for verification. */
+inline psa_status_t import_verify_key(span<const uint8_t> pubkey,
+                                      KeyHandle &key)
+{
+    psa_key_handle_t handle;
+    psa_key_policy_t policy = PSA_KEY_POLICY_INIT;
+    psa_status_t status = psa_allocate_key(&handle);
+
+    if (status != PSA_SUCCESS) {
+        return status;
+    }
+    KeyHandle owned(handle);
+    psa_key_policy_set_usage(&policy, PSA_KEY_USAGE_VERIFY, ecdsa_sha256);
+    status = psa_set_key_policy(handle, &policy);
+    if (status == PSA_SUCCESS) {
+        status = psa_import_key(handle, p256_public_key, pubkey.data(),
+                                pubkey.size());
+    }
+    if (status == PSA_SUCCESS) {
+        key = static_cast<KeyHandle &&>(owned);
+    }
+    return status;
+}
+
+inline psa_status_t verify(const KeyHandle &key, span<const uint8_t> hash,
+                           span<const uint8_t> signature)
+{
+    return psa_asymmetric_verify(key.get(), ecdsa_sha256, hash.data(),
+                                 hash.size(), signature.data(),
+                                 signature.size());
+}
+
+} // namespace atecc608a
+
+#endif /* ATECC608A_HPP */
@@ -0,0 +1,213 @@
+/**
+ * \file atecc608a_app.c
+ * \brief What the console commands and tests of the example share.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include "atecc608a_app.h"
+
+#include "atecc608a_event_log.h"
+#include "atecc608a_key_index.h"
+#include "atecc608a_profile.h"
+#include "atecc608a_verify_cache.h"
+#include "atecc508a_config_dev.h"
+
+bool tests_verbose = true;
+
+/* Data used by tests */
+psa_key_slot_number_t atecc608a_private_key_slot = 0;
+psa_key_slot_number_t atecc608a_public_key_slot = 9;
+
+#ifdef ATECC608A_EMULATOR
+void reload_host_state(void)
+{
+    atecc608a_verify_cache_flush();
+    (void) atecc608a_key_index_load();
+    (void) atecc608a_event_log_open();
+}
+#endif
+
+psa_status_t run_test_step(const test_step_t *step)
+{
+    psa_status_t status;
+
+#ifdef ATECC608A_EMULATOR
+    status = atecc608a_emu_load_fixture(atecc608a_emu_selected(),
+                                        step->fixture);
+
+    reload_host_state();
+    if (status != PSA_SUCCESS) {
+        printf("Failed to restore fixture \'%s\' for %s.\n",
+               atecc608a_emu_fixture_name(step->fixture), step->name);
+        return status;
+    }
+#endif
+    /* The keys a test makes and destroys are not security events. */
+    atecc608a_event_log_suspend();
+    atecc608a_profile_begin(step->name);
+    status = step->run();
+    atecc608a_profile_end();
+    atecc608a_event_log_resume();
+    return status;
+}
+
+typedef struct {
+    const char *name;
+    /* Perform step number `done`. */
+    job_step_result_t (*step)(uint32_t done);
+    /* Optional, called once when the job stops for any reason. */
+    void (*stop)(void);
+    uint32_t done;
+    /* Number of steps, or 0 if the job decides itself when it is finished. */
+    uint32_t total;
+    bool active;
+    bool cancel_requested;
+} job_t;
+
+static job_t job;
+
+bool start_job(const char *name, job_step_result_t (*step)(uint32_t done),
+               void (*stop)(void), uint32_t total)
+{
+    if (job_busy()) {
+        return false;
+    }
+    job.name = name;
+    job.step = step;
+    job.stop = stop;
+    job.done = 0;
+    job.total = total;
+    job.cancel_requested = false;
+    job.active = true;
+    printf("Started job \'%s\'.\n", name);
+    return true;
+}
+
+static void stop_job()
+{
+    job.active = false;
+    if (job.stop != NULL) {
+        job.stop();
+    }
+}
+
+void run_job_step()
+{
+    job_step_result_t result;
+
+    if (job.cancel_requested) {
+        printf("Job \'%s\' cancelled after %lu steps.\n", job.name,
+               (unsigned long) job.done);
+        stop_job();
+        return;
+    }
+    result = job.step(job.done);
+    job.done++;
+    if (result == JOB_STEP_FAILED) {
+        printf("Job \'%s\' failed at step %lu.\n", job.name,
+               (unsigned long) job.done);
+        stop_job();
+    } else if (result == JOB_STEP_FINISHED || job.done == job.total) {
+        printf("Job \'%s\' finished.\n", job.name);
+        stop_job();
+    }
+}
+
+void print_job_status()
+{
+    if (!job.active) {
+        printf("No job is running.\n");
+        return;
+    }
+    if (job.total != 0) {
+        printf("Job \'%s\': %lu/%lu steps done%s.\n", job.name,
+               (unsigned long) job.done, (unsigned long) job.total,
+               job.cancel_requested ? ", cancelling" : "");
+    } else {
+        printf("Job \'%s\': %lu steps done%s.\n", job.name,
+               (unsigned long) job.done,
+               job.cancel_requested ? ", cancelling" : "");
+    }
+}
+
+bool job_active()
+{
+    return job.active;
+}
+
+void cancel_job()
+{
+    if (job.active) {
+        job.cancel_requested = true;
+    }
+}
+
+bool job_busy()
+{
+    if (job.active) {
+        printf("Job \'%s\' is already running, cancel it or wait for it to "
+               "finish.\n", job.name);
+    }
+    return job.active;
+}
+
+void print_ms(uint64_t us)
+{
+    printf("%lu.%01lu ms", (unsigned long)(us / 1000),
+           (unsigned long)(us % 1000 / 100));
+}
+
+uint64_t print_estimate(const char *name, const atecc608a_cost_step_t *steps,
+                        size_t step_count, uint32_t repeat)
+{
+    uint64_t us = atecc608a_cost_model_estimate_us(steps, step_count) * repeat;
+
+    printf("  - %-26s ", name);
+    print_ms(us);
+    for (size_t i = 0; i < step_count; i++) {
+        printf("%s %s x%lu", i == 0 ? " :" : ",",
+               atecc608a_cost_model_op_name(steps[i].op),
+               (unsigned long)(steps[i].count * repeat));
+    }
+    printf("\n");
+    return us;
+}
+
+static void (*pending_confirmation)(void);
+
+void prompt_confirmation(const char *message, void (*on_confirmed)(void))
+{
+    printf("%s", message);
+    pending_confirmation = on_confirmed;
+}
+
+bool confirmation_pending()
+{
+    return pending_confirmation != NULL;
+}
+
+void answer_confirmation(const char *answer)
+{
+    void (*on_confirmed)(void) = pending_confirmation;
+
+    pending_confirmation = NULL;
+    printf("\n");
+    if (answer[0] == 'y' || answer[0] == 'Y') {
+        on_confirmed();
+    }
+}
@@ -0,0 +1,185 @@
+/**
+ * \file atecc608a_app.h
+ * \brief What the console commands and tests of the example share: the key
+ *        slots and types of the tests, test steps, background jobs, cost
+ *        estimates and console command modules.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_APP_H
+#define ATECC608A_APP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "psa/crypto.h"
+#include "atecc608a_se.h"
+#include "atecc608a_cost_model.h"
+#ifdef ATECC608A_EMULATOR
+#include "atecc608a_emulator.h"
+#endif
+
+/** This macro checks if the result of an `expression` is equal to an
+ *  `expected` value and sets a `status` variable of type `psa_status_t` to
+ *  `PSA_SUCCESS`. If they are not equal, the `status` is set to
+ *  `psa_error instead`, the error details are printed, and the code jumps
+ *  to the `exit` label. */
+#define ASSERT_STATUS_PSA(expression, expected, psa_error)            \
+    do                                                                \
+    {                                                                 \
+        psa_status_t ASSERT_result = (expression);                    \
+        psa_status_t ASSERT_expected = (expected);                    \
+        if ((ASSERT_result) != (ASSERT_expected))                     \
+        {                                                             \
+            printf("assertion failed at %s:%d "                       \
+                   "(actual=%ld expected=%ld)\n", __FILE__, __LINE__, \
+                   (long) ASSERT_result, (long) ASSERT_expected);     \
+            status = (psa_error);                                     \
+            goto exit;                                                \
+        }                                                             \
+        status = PSA_SUCCESS;                                         \
+    } while(0)
+
+/** Print the success message of a test. Soak runs repeat the tests many
+ *  times, so they turn the messages off. */
+#define TEST_PASSED(name)                         \
+    do                                            \
+    {                                             \
+        if (tests_verbose)                        \
+        {                                         \
+            printf(name " succesful!\n");         \
+        }                                         \
+    } while(0)
+
+extern bool tests_verbose;
+
+/** The hardcoded configuration of atecc508a_config_dev.h. The header
+ *  defines it, so only atecc608a_app.c includes it. */
+extern const uint8_t template_config_508a_dev[ATCA_ECC_CONFIG_SIZE];
+
+/** Slots the tests and commands use by default. */
+extern psa_key_slot_number_t atecc608a_private_key_slot;
+extern psa_key_slot_number_t atecc608a_public_key_slot;
+
+enum {
+    key_type = PSA_KEY_TYPE_ECC_PUBLIC_KEY(PSA_ECC_CURVE_SECP256R1),
+    keypair_type = PSA_KEY_TYPE_ECC_KEYPAIR(PSA_ECC_CURVE_SECP256R1),
+    key_bits = 256,
+    hash_alg = PSA_ALG_SHA_256,
+    alg = PSA_ALG_ECDSA(hash_alg),
+    sig_size = PSA_ASYMMETRIC_SIGN_OUTPUT_SIZE(key_type, key_bits, alg),
+    pubkey_size = PSA_KEY_EXPORT_ECC_PUBLIC_KEY_MAX_SIZE(key_bits),
+    hash_size = PSA_HASH_SIZE(hash_alg),
+};
+
+#define COST_STEPS(steps) steps, (sizeof(steps) / sizeof(steps[0]))
+
+/* On the emulator, every test starts from a fixture state of the device
+ * instead of whatever the tests before it left behind. */
+#ifdef ATECC608A_EMULATOR
+#define FIXTURE(fixture) , ATECC608A_EMU_##fixture
+#else
+#define FIXTURE(fixture)
+#endif
+
+typedef struct {
+    const char *name;
+    psa_status_t (*run)(void);
+    /* Device operations the test makes, used to estimate a test run without
+     * touching the device. Calls that the driver rejects before reaching
+     * the device are not counted. */
+    const atecc608a_cost_step_t *cost;
+    size_t cost_steps;
+#ifdef ATECC608A_EMULATOR
+    atecc608a_emu_fixture_t fixture;
+#endif
+    /* The test leaves records on the device that outlive it and wears its
+     * EEPROM, or uses a device key for more than signing: it only runs when
+     * asked for, with `test` or in a soak mix naming it, and at boot on the
+     * emulator, whose fixtures undo it. */
+    bool persistent;
+} test_step_t;
+
+#define PERSISTENT , .persistent = true
+
+/** Run one test step, from its fixture on the emulator. */
+psa_status_t run_test_step(const test_step_t *step);
+
+#ifdef ATECC608A_EMULATOR
+/** After the emulated device state was replaced, drop what the host kept
+ *  about the device before and load it again where there is something. */
+void reload_host_state(void);
+#endif
+
+/* Long operations run as a background job: the main loop performs one step
+ * at a time and handles console commands in between, so the shell stays
+ * responsive and a job can be cancelled at a step boundary. Only one job runs
+ * at a time, since they all share the device. */
+typedef enum {
+    JOB_STEP_CONTINUE,
+    JOB_STEP_FINISHED,
+    JOB_STEP_FAILED,
+} job_step_result_t;
+
+/** Start a job of `total` steps, or of as many as `step` decides if 0.
+ *  `stop` is optional, and called once when the job stops for any reason.
+ *  Returns false, and says why, if a job is running already. */
+bool start_job(const char *name, job_step_result_t (*step)(uint32_t done),
+               void (*stop)(void), uint32_t total);
+void run_job_step(void);
+void print_job_status(void);
+bool job_active(void);
+/** Cancel the job after its current step. */
+void cancel_job(void);
+/** For commands that use the device in the foreground: returns true, and
+ *  says so, if a job is running. */
+bool job_busy(void);
+
+void print_ms(uint64_t us);
+/** Print one line of an estimate breakdown and return its duration. */
+uint64_t print_estimate(const char *name, const atecc608a_cost_step_t *steps,
+                        size_t step_count, uint32_t repeat);
+
+/* Irreversible operations are only run once the operator answers the
+ * confirmation prompt. The answer arrives as the next console command, so the
+ * main loop keeps running background jobs in the meantime. */
+void prompt_confirmation(const char *message, void (*on_confirmed)(void));
+bool confirmation_pending(void);
+void answer_confirmation(const char *answer);
+
+/** Console commands of one feature of the example. */
+typedef struct {
+    /** Its lines of the `help` text. */
+    const char *usage;
+    /** Commands that do not talk to the device and run normally in a dry
+     *  run, NULL terminated. A trailing '=' matches any argument. */
+    const char *const *host_commands;
+    /** Run `command`, whose argument, if there is one, follows the '=' that
+     *  `arg` points to. Returns false if the command is not one of the
+     *  module's. */
+    bool (*run)(char *command, char *arg);
+    /** Print the estimate of `command` with the cost model, and return its
+     *  duration in `us`. Returns false if the module has no estimate for
+     *  it. */
+    bool (*estimate)(const char *command, const char *arg, uint64_t *us);
+} command_module_t;
+
+#endif /* ATECC608A_APP_H */
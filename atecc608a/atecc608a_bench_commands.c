@@ -0,0 +1,454 @@
+/**
+ * \file atecc608a_bench_commands.c
+ * \brief Benchmarks of the device operations that calibrate the cost model, and
+ *        the profile.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include "atecc608a_bench_commands.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "atecc608a_crc16.h"
+#include "atecc608a_csr.h"
+#include "atecc608a_event_log.h"
+#include "atecc608a_profile.h"
+#include "atecc608a_stats.h"
+#include "atecc608a_utils.h"
+#include "atecc608a_verify_cache.h"
+
+/* Print a throughput as bytes per cycle, with three decimals. */
+static void print_bytes_per_cycle(const char *name, uint32_t bytes, uint32_t cycles)
+{
+    uint32_t milli = cycles == 0 ? 0 : (uint32_t)(bytes * 1000ULL / cycles);
+
+    printf("  - %s: %lu bytes in %lu cycles, %lu.%03lu bytes/cycle\n", name,
+           (unsigned long) bytes, (unsigned long) cycles,
+           (unsigned long)(milli / 1000), (unsigned long)(milli % 1000));
+}
+
+/* CRC-16 over config-zone sized buffers, which is what every command packet
+ * and the config lock compute, with cryptoauthlib's atCRC for reference. */
+static psa_status_t bench_crc16()
+{
+    static uint8_t data[ATCA_ECC_CONFIG_SIZE];
+    const uint32_t rounds = 64;
+    uint8_t crc[2];
+    uint32_t start;
+    uint32_t cycles;
+
+    memset(data, 0xA5, sizeof(data));
+    printf("CRC-16 benchmark:\n");
+
+    start = atecc608a_cycles();
+    for (uint32_t i = 0; i < rounds; i++) {
+        atCRC(sizeof(data), data, crc);
+    }
+    cycles = atecc608a_cycles() - start;
+    print_bytes_per_cycle("atCRC", rounds * sizeof(data), cycles);
+
+    start = atecc608a_cycles();
+    for (uint32_t i = 0; i < rounds; i++) {
+        atecc608a_crc16(sizeof(data), data, crc);
+    }
+    cycles = atecc608a_cycles() - start;
+    print_bytes_per_cycle("atecc608a_crc16", rounds * sizeof(data), cycles);
+    return PSA_SUCCESS;
+}
+
+/* Device operations are repeated this many times and averaged. */
+#define BENCH_ROUNDS 5
+
+/* Device operation benchmarks. They run in table order, so the key pair and
+ * the signature used by the later ones are made by the earlier ones. */
+static uint8_t bench_pubkey[pubkey_size];
+static size_t bench_pubkey_length;
+static uint8_t bench_hash[hash_size];
+static uint8_t bench_signature[sig_size];
+static size_t bench_signature_length;
+static uint8_t bench_data[64];
+
+static psa_status_t bench_generate()
+{
+    return atecc608a_driver()->p_key_management->p_generate(
+               atecc608a_private_key_slot, keypair_type,
+               PSA_KEY_USAGE_SIGN | PSA_KEY_USAGE_VERIFY, key_bits, NULL, 0,
+               NULL, 0, NULL);
+}
+
+static psa_status_t bench_export()
+{
+    return atecc608a_driver()->p_key_management->p_export(
+               atecc608a_private_key_slot, bench_pubkey, sizeof(bench_pubkey),
+               &bench_pubkey_length);
+}
+
+/* Mirrored export of the same key, from the public key slot. */
+static psa_status_t bench_generate_mirrored()
+{
+    return atecc608a_generate_mirrored(atecc608a_private_key_slot,
+                                       atecc608a_public_key_slot, NULL, 0,
+                                       NULL);
+}
+
+static psa_status_t bench_export_mirrored()
+{
+    return atecc608a_export_mirrored(atecc608a_private_key_slot,
+                                     atecc608a_public_key_slot, bench_pubkey,
+                                     sizeof(bench_pubkey), &bench_pubkey_length);
+}
+
+static psa_status_t bench_import()
+{
+    return atecc608a_driver()->p_key_management->p_import(
+               atecc608a_public_key_slot, atecc608a_drv_info.lifetime,
+               key_type, alg, PSA_KEY_USAGE_VERIFY, bench_pubkey,
+               bench_pubkey_length);
+}
+
+static psa_status_t bench_sign()
+{
+    return atecc608a_driver()->p_asym->p_sign(
+               atecc608a_private_key_slot, alg, bench_hash, sizeof(bench_hash),
+               bench_signature, sizeof(bench_signature),
+               &bench_signature_length);
+}
+
+static psa_status_t bench_verify()
+{
+    return atecc608a_driver()->p_asym->p_verify(
+               atecc608a_public_key_slot, alg, bench_hash, sizeof(bench_hash),
+               bench_signature, bench_signature_length);
+}
+
+/* The device verifications of bench_dispatch() and the export that fills
+ * the verify key cache. */
+static const atecc608a_cost_step_t cost_bench_dispatch[] = {
+    { ATECC608A_COST_VERIFY, BENCH_ROUNDS }, { ATECC608A_COST_EXPORT, 1 },
+};
+
+/* Rounds of the calls that fail before any cryptography is done. */
+#define DISPATCH_ROUNDS 100
+
+static void print_dispatch_row(const char *path, uint64_t total_us,
+                               uint32_t rounds)
+{
+    uint64_t mean_ns = total_us * 1000 / rounds;
+
+    printf("  - %-28s %6lu.%03lu us\n", path,
+           (unsigned long)(mean_ns / 1000), (unsigned long)(mean_ns % 1000));
+}
+
+/* The same verification through the PSA API and through the driver table.
+ * PSA verifies on the host and the driver on the device, so the calls with
+ * a signature of the wrong length, rejected before any cryptography, show
+ * what each layer costs by itself. Uses the key pair and the signature of
+ * the earlier steps, and the public key imported to the public key slot. */
+static psa_status_t bench_dispatch()
+{
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+    psa_key_handle_t handle = 0;
+    psa_key_policy_t policy = PSA_KEY_POLICY_INIT;
+    uint64_t start;
+
+    printf("Verification paths (mean):\n");
+
+    start = atecc608a_time_us();
+    for (int i = 0; i < BENCH_ROUNDS; i++) {
+        ASSERT_SUCCESS_PSA(psa_allocate_key(&handle));
+        psa_key_policy_set_usage(&policy, PSA_KEY_USAGE_VERIFY, alg);
+        ASSERT_SUCCESS_PSA(psa_set_key_policy(handle, &policy));
+        ASSERT_SUCCESS_PSA(psa_import_key(handle, key_type, bench_pubkey,
+                                          bench_pubkey_length));
+        ASSERT_SUCCESS_PSA(psa_asymmetric_verify(handle, alg, bench_hash,
+                                                 sizeof(bench_hash),
+                                                 bench_signature,
+                                                 bench_signature_length));
+        psa_destroy_key(handle);
+        handle = 0;
+    }
+    print_dispatch_row("psa, import per call",
+                       atecc608a_time_us() - start, BENCH_ROUNDS);
+
+    /* The first call fills the cache. */
+    ASSERT_SUCCESS_PSA(atecc608a_verify_cache_verify(
+                           atecc608a_private_key_slot, bench_hash,
+                           sizeof(bench_hash), bench_signature,
+                           bench_signature_length));
+    start = atecc608a_time_us();
+    for (int i = 0; i < BENCH_ROUNDS; i++) {
+        ASSERT_SUCCESS_PSA(atecc608a_verify_cache_verify(
+                               atecc608a_private_key_slot, bench_hash,
+                               sizeof(bench_hash), bench_signature,
+                               bench_signature_length));
+    }
+    print_dispatch_row("psa, cached key", atecc608a_time_us() - start,
+                       BENCH_ROUNDS);
+
+    start = atecc608a_time_us();
+    for (int i = 0; i < BENCH_ROUNDS; i++) {
+        ASSERT_SUCCESS_PSA(atecc608a_driver()->p_asym->p_verify(
+                               atecc608a_public_key_slot, alg, bench_hash,
+                               sizeof(bench_hash), bench_signature,
+                               bench_signature_length));
+    }
+    print_dispatch_row("driver, device verify", atecc608a_time_us() - start,
+                       BENCH_ROUNDS);
+
+    /* Handle lookup and policy check only. */
+    ASSERT_SUCCESS_PSA(atecc608a_verify_cache_acquire(
+                           atecc608a_private_key_slot, &handle));
+    start = atecc608a_time_us();
+    for (int i = 0; i < DISPATCH_ROUNDS; i++) {
+        psa_asymmetric_verify(handle, alg, bench_hash, sizeof(bench_hash),
+                              bench_signature, 1);
+    }
+    print_dispatch_row("psa dispatch, rejected call",
+                       atecc608a_time_us() - start, DISPATCH_ROUNDS);
+    atecc608a_verify_cache_release(handle);
+    handle = 0;
+
+    start = atecc608a_time_us();
+    for (int i = 0; i < DISPATCH_ROUNDS; i++) {
+        atecc608a_driver()->p_asym->p_verify(
+            atecc608a_public_key_slot, alg, bench_hash, sizeof(bench_hash),
+            bench_signature, 1);
+    }
+    print_dispatch_row("driver dispatch, rejected call",
+                       atecc608a_time_us() - start, DISPATCH_ROUNDS);
+
+exit:
+    if (handle != 0) {
+        psa_destroy_key(handle);
+    }
+    return status;
+}
+
+static psa_status_t bench_random()
+{
+    return atecc608a_random_32_bytes(bench_data, sizeof(bench_data));
+}
+
+static psa_status_t bench_sha(size_t length)
+{
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+    uint8_t digest[ATCA_SHA_DIGEST_SIZE];
+
+    atecc608a_device_lock();
+    ASSERT_SUCCESS_PSA(atecc608a_init());
+    ASSERT_SUCCESS(atcab_hw_sha2_256(bench_data, length, digest));
+
+exit:
+    atecc608a_deinit();
+    atecc608a_device_unlock();
+    return status;
+}
+
+static psa_status_t bench_sha_short()
+{
+    return bench_sha(32);
+}
+
+static psa_status_t bench_sha_64()
+{
+    return bench_sha(64);
+}
+
+/* A lock status check, which is a single word read. */
+static psa_status_t bench_read_word()
+{
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+    bool zone_locked;
+
+    atecc608a_device_lock();
+    ASSERT_SUCCESS_PSA(atecc608a_init());
+    ASSERT_SUCCESS(atcab_is_locked(LOCK_ZONE_CONFIG, &zone_locked));
+
+exit:
+    atecc608a_deinit();
+    atecc608a_device_unlock();
+    return status;
+}
+
+static psa_status_t bench_read_block()
+{
+    return atecc608a_device_read(8, 0, bench_data, 32);
+}
+
+static psa_status_t bench_write_block()
+{
+    return atecc608a_device_write(8, 0, bench_data, 32);
+}
+
+static psa_status_t bench_read_config()
+{
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+    uint8_t config[ATCA_ECC_CONFIG_SIZE];
+
+    atecc608a_device_lock();
+    ASSERT_SUCCESS_PSA(atecc608a_init());
+    ASSERT_SUCCESS(atcab_read_config_zone(config));
+
+exit:
+    atecc608a_deinit();
+    atecc608a_device_unlock();
+    return status;
+}
+
+static psa_status_t bench_csr()
+{
+    static uint8_t csr[ATECC608A_CSR_MAX_SIZE];
+    size_t csr_len;
+
+    return atecc608a_csr_generate(atecc608a_private_key_slot, csr, sizeof(csr),
+                                  &csr_len);
+}
+
+/* The config write and the locks are irreversible and are not benchmarked. */
+const bench_step_t bench_steps[] = {
+    { "crc16", bench_crc16, ATECC608A_COST_OP_COUNT },
+    { "generate", bench_generate, ATECC608A_COST_GENERATE },
+    { "export", bench_export, ATECC608A_COST_EXPORT },
+    { "generate_mirrored", bench_generate_mirrored, ATECC608A_COST_GENERATE_MIRRORED },
+    { "export_mirrored", bench_export_mirrored, ATECC608A_COST_EXPORT_MIRRORED },
+    { "import", bench_import, ATECC608A_COST_IMPORT },
+    { "sign", bench_sign, ATECC608A_COST_SIGN },
+    { "verify", bench_verify, ATECC608A_COST_VERIFY },
+    { "dispatch", bench_dispatch, ATECC608A_COST_OP_COUNT },
+    { "random", bench_random, ATECC608A_COST_RANDOM },
+    { "sha_short", bench_sha_short, ATECC608A_COST_SHA_SHORT },
+    { "sha_64", bench_sha_64, ATECC608A_COST_SHA_64 },
+    { "read_word", bench_read_word, ATECC608A_COST_READ_WORD },
+    { "read_config", bench_read_config, ATECC608A_COST_READ_CONFIG },
+    { "write_block", bench_write_block, ATECC608A_COST_WRITE_BLOCK },
+    { "read_block", bench_read_block, ATECC608A_COST_READ_BLOCK },
+    { "csr", bench_csr, ATECC608A_COST_CSR },
+};
+
+#define BENCH_STEP_COUNT (sizeof(bench_steps) / sizeof(bench_steps[0]))
+
+const size_t bench_step_count = BENCH_STEP_COUNT;
+
+/* The benchmarks run with the event log suspended, so that the key
+ * operations are timed, and the cost model calibrated, without the
+ * appends and signatures of their events. */
+static void bench_job_stop()
+{
+    atecc608a_event_log_resume();
+}
+
+static job_step_result_t bench_job_step(uint32_t done)
+{
+    const bench_step_t *step = &bench_steps[done];
+    psa_status_t status = PSA_SUCCESS;
+    uint64_t start;
+    uint32_t mean;
+
+    if (step->op == ATECC608A_COST_OP_COUNT) {
+        atecc608a_profile_begin(step->name);
+        step->run();
+        atecc608a_profile_end();
+        return JOB_STEP_CONTINUE;
+    }
+
+    if (done == 1) {
+        printf("Device operations (mean of %d, model estimate):\n",
+               BENCH_ROUNDS);
+    }
+    start = atecc608a_time_us();
+    for (int i = 0; i < BENCH_ROUNDS && status == PSA_SUCCESS; i++) {
+        atecc608a_profile_begin(step->name);
+        status = step->run();
+        atecc608a_profile_end();
+    }
+    if (status != PSA_SUCCESS) {
+        /* E.g. clear reads need a locked data zone - skip, but go on. */
+        printf("  - %-17s failed with %ld, skipped\n", step->name,
+               (long) status);
+        return JOB_STEP_CONTINUE;
+    }
+    mean = (uint32_t)((atecc608a_time_us() - start) / BENCH_ROUNDS);
+    printf("  - %-17s %6lu us (%lu us)\n", step->name, (unsigned long) mean,
+           (unsigned long) atecc608a_cost_model_op_us(step->op));
+    atecc608a_cost_model_calibrate(step->op, mean);
+    return JOB_STEP_CONTINUE;
+}
+
+static bool run_bench_command(char *command, char *arg)
+{
+    if (strcmp(command, "cost_model") == 0) {
+        atecc608a_cost_model_print();
+    } else if (strncmp(command, "profile=", strlen("profile=")) == 0) {
+        atecc608a_profile_enable(atoi(arg + 1) != 0);
+        if (atecc608a_profile_enabled()) {
+            printf("Profiling the steps of tests and benchmarks.\n");
+        } else {
+            atecc608a_profile_print();
+        }
+    } else if (strcmp(command, "profile") == 0) {
+        atecc608a_profile_print();
+    } else if (strcmp(command, "bench") == 0) {
+        if (start_job("bench", bench_job_step, bench_job_stop,
+                      BENCH_STEP_COUNT)) {
+            atecc608a_event_log_suspend();
+        }
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool estimate_bench_command(const char *command, const char *arg,
+                                   uint64_t *estimate_us)
+{
+    uint64_t us = 0;
+
+    (void) arg;
+    if (strcmp(command, "bench") == 0) {
+        printf("[dry run] %s\n", command);
+        for (size_t i = 0; i < BENCH_STEP_COUNT; i++) {
+            if (bench_steps[i].op != ATECC608A_COST_OP_COUNT) {
+                atecc608a_cost_step_t step = { bench_steps[i].op, 1 };
+                us += print_estimate(bench_steps[i].name, &step, 1,
+                                     BENCH_ROUNDS);
+            }
+        }
+        us += print_estimate("dispatch", COST_STEPS(cost_bench_dispatch), 1);
+    } else {
+        return false;
+    }
+    *estimate_us = us;
+    return true;
+}
+
+static const char *const bench_host_commands[] = {
+    "cost_model", "profile", "profile=", NULL,
+};
+
+const command_module_t bench_commands = {
+    " - bench - run benchmarks in the background and calibrate the cost\n"
+    "           model with the measured device operations;\n"
+    " - cost_model - print the estimated duration of device operations;\n"
+    " - profile=%d - 1 - profile the host CPU time of each layer (utils,\n"
+    "                 driver, cryptoauthlib, HAL) and the time waiting\n"
+    "                 for the device in the steps of tests and\n"
+    "                 benchmarks, 0 - stop and print the profile;\n"
+    " - profile - print the profile;\n",
+    bench_host_commands, run_bench_command, estimate_bench_command,
+};
@@ -0,0 +1,46 @@
+/**
+ * \file atecc608a_bench_commands.h
+ * \brief Benchmarks of the device operations that calibrate the cost model, and
+ *        the profile.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_BENCH_COMMANDS_H
+#define ATECC608A_BENCH_COMMANDS_H
+
+#include "atecc608a_app.h"
+
+typedef struct {
+    const char *name;
+    psa_status_t (*run)(void);
+    /* Cost model entry calibrated by the benchmark, or
+     * ATECC608A_COST_OP_COUNT for benchmarks that run once and print their
+     * own results. */
+    atecc608a_cost_op_t op;
+} bench_step_t;
+
+/** bench, cost_model and profile. */
+extern const command_module_t bench_commands;
+
+/** The benchmarks, in the order they run: the key pair and the signature
+ *  used by the later ones are made by the earlier ones. */
+extern const bench_step_t bench_steps[];
+extern const size_t bench_step_count;
+
+#endif /* ATECC608A_BENCH_COMMANDS_H */
@@ -0,0 +1,408 @@
+/**
+ * \file atecc608a_bridge.c
+ * \brief Framing of the serial bridge between a host running cryptoauthlib
+ *        and a relay board that owns the device.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include "atecc608a_bridge.h"
+
+#include <string.h>
+
+#include "atecc608a_crc16.h"
+
+void atecc608a_bridge_reader_init(atecc608a_bridge_reader_t *reader)
+{
+    reader->start = 0;
+    reader->end = 0;
+}
+
+size_t atecc608a_bridge_encode(uint8_t sync,
+                               const atecc608a_bridge_frame_t *frame,
+                               uint8_t *out)
+{
+    size_t size = ATECC608A_BRIDGE_OVERHEAD + frame->length;
+
+    out[0] = sync;
+    out[1] = frame->seq;
+    out[2] = frame->code;
+    out[3] = frame->length;
+    memcpy(out + 4, frame->payload, frame->length);
+    atecc608a_crc16(3 + (size_t) frame->length, out + 1, out + size - 2);
+    return size;
+}
+
+ATCA_STATUS atecc608a_bridge_write(const atecc608a_bridge_link_t *link,
+                                   uint8_t sync,
+                                   const atecc608a_bridge_frame_t *frame)
+{
+    uint8_t out[ATECC608A_BRIDGE_MAX_FRAME];
+    size_t size = atecc608a_bridge_encode(sync, frame, out);
+
+    return link->write(link->context, out, size) ? ATCA_SUCCESS :
+           ATCA_COMM_FAIL;
+}
+
+/* The buffer holds two frames, so there is always room for the rest of a
+ * frame once the bytes before it are dropped. */
+ATCA_STATUS atecc608a_bridge_read(const atecc608a_bridge_link_t *link,
+                                  atecc608a_bridge_reader_t *reader,
+                                  uint8_t sync,
+                                  atecc608a_bridge_frame_t *frame)
+{
+    for (;;) {
+        uint8_t *data = reader->data + reader->start;
+        size_t available = reader->end - reader->start;
+        uint8_t *found = memchr(data, sync, available);
+        int count;
+
+        if (found == NULL) {
+            reader->start = reader->end;
+            available = 0;
+        } else if (found != data) {
+            reader->start += (size_t)(found - data);
+            continue;
+        } else if (available >= 4 &&
+                   available >= ATECC608A_BRIDGE_OVERHEAD + (size_t) data[3]) {
+            size_t size = ATECC608A_BRIDGE_OVERHEAD + data[3];
+            uint8_t crc[2];
+
+            atecc608a_crc16(size - 3, data + 1, crc);
+            if (crc[0] != data[size - 2] || crc[1] != data[size - 1]) {
+                /* A sync byte in noise, or a damaged frame. */
+                reader->start++;
+                continue;
+            }
+            frame->seq = data[1];
+            frame->code = data[2];
+            frame->length = data[3];
+            memcpy(frame->payload, data + 4, frame->length);
+            reader->start += size;
+            return ATCA_SUCCESS;
+        }
+
+        if (reader->start > 0) {
+            memmove(reader->data, reader->data + reader->start, available);
+            reader->start = 0;
+            reader->end = available;
+        }
+        count = link->read(link->context, reader->data + reader->end,
+                           sizeof(reader->data) - reader->end);
+        if (count == 0) {
+            return ATCA_RX_TIMEOUT;
+        }
+        if (count < 0) {
+            return ATCA_COMM_FAIL;
+        }
+        reader->end += (size_t) count;
+    }
+}
+
+/* The device does not answer while it executes a command. HALs report that
+ * as no response, or as a failed transfer when the address is not
+ * acknowledged. */
+static bool device_busy(ATCA_STATUS status)
+{
+    return status == ATCA_RX_NO_RESPONSE || status == ATCA_COMM_FAIL;
+}
+
+static ATCA_STATUS relay_receive(const atecc608a_bridge_device_t *device,
+                                 const atecc608a_bridge_frame_t *request,
+                                 atecc608a_bridge_frame_t *response)
+{
+    uint32_t waited = 0;
+    ATCA_STATUS status;
+
+    for (;;) {
+        uint16_t length = request->length > 0 ? request->payload[0] :
+                          ATECC608A_BRIDGE_MAX_PAYLOAD;
+
+        status = device->receive(device->context, response->payload, &length);
+        if (status == ATCA_SUCCESS) {
+            response->length = (uint8_t) length;
+            return status;
+        }
+        if (!device_busy(status) || waited >= ATECC608A_RELAY_POLL_TIMEOUT_US) {
+            return status;
+        }
+        device->delay_us(device->context, ATECC608A_RELAY_POLL_US);
+        waited += ATECC608A_RELAY_POLL_US;
+    }
+}
+
+static ATCA_STATUS relay_request(const atecc608a_bridge_device_t *device,
+                                 const atecc608a_bridge_frame_t *request,
+                                 atecc608a_bridge_frame_t *response)
+{
+    switch (request->code) {
+        case ATECC608A_BRIDGE_WAKE:
+            return device->wake(device->context);
+        case ATECC608A_BRIDGE_IDLE:
+            return device->idle(device->context);
+        case ATECC608A_BRIDGE_SLEEP:
+            return device->sleep(device->context);
+        case ATECC608A_BRIDGE_SEND:
+            return device->send(device->context, request->payload,
+                                request->length);
+        case ATECC608A_BRIDGE_RECEIVE:
+            return relay_receive(device, request, response);
+        default:
+            return ATCA_BAD_OPCODE;
+    }
+}
+
+typedef struct {
+    const atecc608a_bridge_link_t *link;
+    /* Posted requests done and not acknowledged yet, and the last one. */
+    uint32_t unacked;
+    uint8_t last_seq;
+} relay_t;
+
+static bool relay_acknowledge(relay_t *relay)
+{
+    atecc608a_bridge_frame_t ack;
+
+    if (relay->unacked == 0) {
+        return true;
+    }
+    relay->unacked = 0;
+    ack.seq = relay->last_seq;
+    ack.code = ATCA_SUCCESS;
+    ack.length = 0;
+    return atecc608a_bridge_write(relay->link, ATECC608A_BRIDGE_RESPONSE_SYNC,
+                                  &ack) == ATCA_SUCCESS;
+}
+
+/* Acknowledge before waiting for more requests: a host with a full window
+ * sends no more until it gets the acknowledgement. */
+static int relay_read(void *context, uint8_t *data, size_t length)
+{
+    relay_t *relay = context;
+
+    if (!relay_acknowledge(relay)) {
+        return -1;
+    }
+    return relay->link->read(relay->link->context, data, length);
+}
+
+void atecc608a_relay_serve(const atecc608a_bridge_link_t *link,
+                           const atecc608a_bridge_device_t *device)
+{
+    static atecc608a_bridge_reader_t reader;
+    static atecc608a_bridge_frame_t request;
+    static atecc608a_bridge_frame_t response;
+    relay_t relay = { link, 0, 0 };
+    const atecc608a_bridge_link_t requests = { relay_read, NULL, &relay };
+
+    atecc608a_bridge_reader_init(&reader);
+    for (;;) {
+        ATCA_STATUS status;
+
+        status = atecc608a_bridge_read(&requests, &reader,
+                                       ATECC608A_BRIDGE_REQUEST_SYNC, &request);
+        if (status == ATCA_RX_TIMEOUT) {
+            continue;
+        }
+        if (status != ATCA_SUCCESS) {
+            return;
+        }
+        response.seq = request.seq;
+        response.length = 0;
+        status = relay_request(device, &request, &response);
+        if (status == ATCA_SUCCESS &&
+                request.code != ATECC608A_BRIDGE_RECEIVE) {
+            relay.unacked++;
+            relay.last_seq = request.seq;
+            if (relay.unacked < ATECC608A_BRIDGE_ACK_BATCH ||
+                    relay_acknowledge(&relay)) {
+                continue;
+            }
+            return;
+        }
+        /* Receives and failures are answered at once, which acknowledges
+         * the requests before them too. */
+        relay.unacked = 0;
+        response.code = (uint8_t) status;
+        if (atecc608a_bridge_write(link, ATECC608A_BRIDGE_RESPONSE_SYNC,
+                                   &response) != ATCA_SUCCESS) {
+            return;
+        }
+    }
+}
+
+#if defined(ATECC608A_RELAY)
+
+#include "atca_basic.h"
+#include "atca_hal.h"
+#include "atecc608a_se.h"
+
+#if defined(__MBED__)
+
+#include "hal/serial_api.h"
+
+/* The relay owns the UART of the console: it never prints. */
+static serial_t relay_serial;
+
+static int link_read(void *context, uint8_t *data, size_t length)
+{
+    size_t count = 0;
+
+    (void) context;
+    data[count++] = (uint8_t) serial_getc(&relay_serial);
+    while (count < length && serial_readable(&relay_serial)) {
+        data[count++] = (uint8_t) serial_getc(&relay_serial);
+    }
+    return (int) count;
+}
+
+static bool link_write(void *context, const uint8_t *data, size_t length)
+{
+    (void) context;
+    for (size_t i = 0; i < length; i++) {
+        serial_putc(&relay_serial, data[i]);
+    }
+    return true;
+}
+
+static bool link_open(void)
+{
+    serial_init(&relay_serial, USBTX, USBRX);
+    serial_baud(&relay_serial, ATECC608A_RELAY_BAUD);
+    return true;
+}
+
+#else /* __MBED__ */
+
+#include <errno.h>
+#include <pty.h>
+#include <stdio.h>
+#include <termios.h>
+#include <unistd.h>
+
+/* Host builds relay their backend on a pseudo terminal, in place of a
+ * board: host builds with the serial backend run against it. */
+static int relay_fd = -1;
+
+static int link_read(void *context, uint8_t *data, size_t length)
+{
+    ssize_t count;
+
+    (void) context;
+    do {
+        count = read(relay_fd, data, length);
+    } while (count < 0 && errno == EINTR);
+    return count > 0 ? (int) count : -1;
+}
+
+static bool link_write(void *context, const uint8_t *data, size_t length)
+{
+    (void) context;
+    while (length > 0) {
+        ssize_t count = write(relay_fd, data, length);
+
+        if (count < 0) {
+            if (errno != EINTR) {
+                return false;
+            }
+            continue;
+        }
+        data += count;
+        length -= (size_t) count;
+    }
+    return true;
+}
+
+/* The relay keeps the other end open too, so that hosts can come and go
+ * without the pseudo terminal hanging up. */
+static bool link_open(void)
+{
+    struct termios tio;
+    char path[64];
+    int other;
+
+    memset(&tio, 0, sizeof(tio));
+    cfmakeraw(&tio);
+    if (openpty(&relay_fd, &other, path, &tio, NULL) != 0) {
+        printf("Relay: failed to open a pseudo terminal: %s.\n",
+               strerror(errno));
+        return false;
+    }
+    printf("Relay on %s.\n", path);
+    return true;
+}
+
+#endif /* __MBED__ */
+
+static ATCA_STATUS device_wake(void *context)
+{
+    return atwake((ATCAIface) context);
+}
+
+static ATCA_STATUS device_idle(void *context)
+{
+    return atidle((ATCAIface) context);
+}
+
+static ATCA_STATUS device_sleep(void *context)
+{
+    return atsleep((ATCAIface) context);
+}
+
+/* The HAL takes the word address in the byte before the packet. */
+static ATCA_STATUS device_send(void *context, const uint8_t *packet,
+                               size_t length)
+{
+    uint8_t txdata[1 + ATECC608A_BRIDGE_MAX_PAYLOAD];
+
+    memcpy(txdata + 1, packet, length);
+    return atsend((ATCAIface) context, txdata, (int) length);
+}
+
+static ATCA_STATUS device_receive(void *context, uint8_t *data,
+                                  uint16_t *length)
+{
+    return atreceive((ATCAIface) context, data, length);
+}
+
+static void device_delay_us(void *context, uint32_t us)
+{
+    (void) context;
+    atca_delay_us(us);
+}
+
+ATCA_STATUS atecc608a_relay_main(void)
+{
+    atecc608a_bridge_link_t link = { link_read, link_write, NULL };
+    atecc608a_bridge_device_t device = {
+        device_wake, device_idle, device_sleep, device_send, device_receive,
+        device_delay_us, NULL,
+    };
+
+    if (atecc608a_init() != PSA_SUCCESS) {
+        return ATCA_COMM_FAIL;
+    }
+    device.context = atGetIFace(atcab_get_device());
+    if (!link_open()) {
+        return ATCA_COMM_FAIL;
+    }
+    for (;;) {
+        atecc608a_relay_serve(&link, &device);
+    }
+}
+
+#endif /* ATECC608A_RELAY */
@@ -0,0 +1,162 @@
+/**
+ * \file atecc608a_bridge.h
+ * \brief Framing of the serial bridge between a host running cryptoauthlib
+ *        and a relay board that owns the device.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_BRIDGE_H
+#define ATECC608A_BRIDGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "atca_status.h"
+
+/** The host calls the I2C HAL of cryptoauthlib as usual, and each call is
+ *  a request frame to the relay, which makes the same call on its own HAL
+ *  and answers with a response frame:
+ *
+ *      sync | seq | code   | length | payload | CRC-16 (little endian)
+ *
+ *  The sync byte tells requests from responses. `code` is the HAL call in a
+ *  request and its ATCA_STATUS in a response, and `seq` is copied from the
+ *  request to its response. The CRC is the one of the device, over `seq` to
+ *  the end of the payload. A send carries the command packet, a receive the
+ *  most bytes the host takes, and its response the bytes read.
+ *
+ *  Serial links take a millisecond or more per round trip, more than the
+ *  I2C transfers, so only receives wait for their response. Wakes, idles,
+ *  sleeps and sends are posted: the host keeps up to a window of them in
+ *  flight, and the relay only answers them at once when they fail. It
+ *  acknowledges the others in batches, with a response of status
+ *  ATCA_SUCCESS and no payload, which acknowledges every request up to its
+ *  `seq`. Requests are handled in order, so the response to a receive also
+ *  acknowledges the requests before it. The failure of a posted request
+ *  is returned by the next receive between the same wake and idle or
+ *  sleep, so that it fails the command it belongs to; a failure found
+ *  after that, e.g. of the idle, fails the next wake instead, before any
+ *  of the next command is sent.
+ *
+ *  On a receive, the relay polls the device until it is done with the
+ *  command, instead of the host waiting out the longest execution time. */
+#define ATECC608A_BRIDGE_REQUEST_SYNC 0xA5
+#define ATECC608A_BRIDGE_RESPONSE_SYNC 0x5A
+
+#define ATECC608A_BRIDGE_WAKE 0x01
+#define ATECC608A_BRIDGE_IDLE 0x02
+#define ATECC608A_BRIDGE_SLEEP 0x03
+#define ATECC608A_BRIDGE_SEND 0x04
+#define ATECC608A_BRIDGE_RECEIVE 0x05
+
+#define ATECC608A_BRIDGE_MAX_PAYLOAD 255
+/** Sync, seq, code, length and CRC. */
+#define ATECC608A_BRIDGE_OVERHEAD 6
+#define ATECC608A_BRIDGE_MAX_FRAME \
+    (ATECC608A_BRIDGE_OVERHEAD + ATECC608A_BRIDGE_MAX_PAYLOAD)
+
+/** Requests in flight by default, and at most, so that `seq` cannot wrap
+ *  around within a window. A window of 1 waits for each request. */
+#define ATECC608A_BRIDGE_WINDOW 8
+#define ATECC608A_BRIDGE_WINDOW_MAX 64
+
+/** The relay acknowledges posted requests after this many, and whenever it
+ *  runs out of requests to handle. */
+#define ATECC608A_BRIDGE_ACK_BATCH 4
+
+/** Polling of a busy device by the relay. The longest command, GenKey,
+ *  takes 115 ms at most. */
+#define ATECC608A_RELAY_POLL_US 100
+#define ATECC608A_RELAY_POLL_TIMEOUT_US 250000
+
+typedef struct {
+    uint8_t seq;
+    /** HAL call of a request, ATCA_STATUS of a response. */
+    uint8_t code;
+    uint8_t length;
+    uint8_t payload[ATECC608A_BRIDGE_MAX_PAYLOAD];
+} atecc608a_bridge_frame_t;
+
+/** A byte stream to the other end: a UART on the relay, a tty on hosts. */
+typedef struct {
+    /** Read at least one and up to `length` bytes. Returns the number of
+     *  bytes read, 0 on timeout, or a negative value once the link is
+     *  gone. */
+    int (*read)(void *context, uint8_t *data, size_t length);
+    /** Write all of `data`, false once the link is gone. */
+    bool (*write)(void *context, const uint8_t *data, size_t length);
+    void *context;
+} atecc608a_bridge_link_t;
+
+/** Incoming bytes not yet taken by a frame. */
+typedef struct {
+    uint8_t data[2 * ATECC608A_BRIDGE_MAX_FRAME];
+    size_t start;
+    size_t end;
+} atecc608a_bridge_reader_t;
+
+void atecc608a_bridge_reader_init(atecc608a_bridge_reader_t *reader);
+
+/** Write `frame` behind `sync` into `out`, which holds at least
+ *  ATECC608A_BRIDGE_MAX_FRAME bytes. Returns the encoded size. */
+size_t atecc608a_bridge_encode(uint8_t sync,
+                               const atecc608a_bridge_frame_t *frame,
+                               uint8_t *out);
+
+ATCA_STATUS atecc608a_bridge_write(const atecc608a_bridge_link_t *link,
+                                   uint8_t sync,
+                                   const atecc608a_bridge_frame_t *frame);
+
+/** Read the next frame behind `sync`. Bytes before a sync byte, and frames
+ *  with a bad CRC, are skipped. Returns ATCA_RX_TIMEOUT if the link timed
+ *  out before a whole frame arrived, and ATCA_COMM_FAIL once it is gone. */
+ATCA_STATUS atecc608a_bridge_read(const atecc608a_bridge_link_t *link,
+                                  atecc608a_bridge_reader_t *reader,
+                                  uint8_t sync,
+                                  atecc608a_bridge_frame_t *frame);
+
+/** The device as the relay reaches it, the cryptoauthlib interface on the
+ *  relay firmware. */
+typedef struct {
+    ATCA_STATUS (*wake)(void *context);
+    ATCA_STATUS (*idle)(void *context);
+    ATCA_STATUS (*sleep)(void *context);
+    ATCA_STATUS (*send)(void *context, const uint8_t *packet, size_t length);
+    ATCA_STATUS (*receive)(void *context, uint8_t *data, uint16_t *length);
+    void (*delay_us)(void *context, uint32_t us);
+    void *context;
+} atecc608a_bridge_device_t;
+
+/** Handle the requests arriving on `link` with `device`, until the link is
+ *  gone. */
+void atecc608a_relay_serve(const atecc608a_bridge_link_t *link,
+                           const atecc608a_bridge_device_t *device);
+
+/** Relay firmware: serve the device of this board over its USB serial port,
+ *  at ATECC608A_RELAY_BAUD. Host builds serve their backend on a pseudo
+ *  terminal instead. Only returns if the device or the link fails to
+ *  start. */
+ATCA_STATUS atecc608a_relay_main(void);
+
+#ifndef ATECC608A_RELAY_BAUD
+#define ATECC608A_RELAY_BAUD 115200
+#endif
+
+#endif /* ATECC608A_BRIDGE_H */
@@ -0,0 +1,123 @@
+/**
+ * \file atecc608a_console.c
+ * \brief Non-blocking command reader for the example's serial console.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include "atecc608a_console.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cmsis_os2.h"
+
+typedef struct {
+    char text[ATECC608A_CONSOLE_COMMAND_SIZE];
+} console_command_t;
+
+static osMessageQueueId_t console_queue;
+
+/* Commands dropped on a full queue. The reader only counts them: they are
+ * reported by the application thread, which has the stack for printf. */
+static volatile uint32_t console_dropped;
+static uint32_t console_reported;
+
+/* Input of host builds may be a script, which comes faster than commands
+ * run: the reader waits for room in the queue instead of dropping them. */
+#if defined(__MBED__)
+#define CONSOLE_PUT_TIMEOUT 0
+#else
+#define CONSOLE_PUT_TIMEOUT osWaitForever
+#endif
+
+/* The reader only calls getchar(), so a small stack is enough. */
+static const osThreadAttr_t console_thread_attr = {
+    .name = "console",
+    .stack_size = 1024,
+    .priority = osPriorityBelowNormal,
+};
+
+static void console_thread(void *argument)
+{
+    console_command_t command;
+    size_t len = 0;
+    int c;
+    (void) argument;
+
+    /* With "platform.stdio-buffered-serial" enabled, getchar() blocks on a
+     * semaphore released from the UART receive interrupt, so this thread only
+     * wakes up when there is input to process. */
+    while ((c = getchar()) != EOF) {
+        if (!isspace(c)) {
+            /* Overlong commands are truncated, as with scanf("%79s"). */
+            if (len < sizeof(command.text) - 1) {
+                command.text[len++] = (char) c;
+            }
+            continue;
+        }
+        if (len == 0) {
+            continue;
+        }
+        command.text[len] = '\0';
+        len = 0;
+        if (osMessageQueuePut(console_queue, &command, 0,
+                              CONSOLE_PUT_TIMEOUT) != osOK) {
+            console_dropped++;
+        }
+    }
+    /* The end of a script: its last command, then nothing more. */
+    if (len > 0) {
+        command.text[len] = '\0';
+        osMessageQueuePut(console_queue, &command, 0, osWaitForever);
+    }
+    strcpy(command.text, "exit");
+    osMessageQueuePut(console_queue, &command, 0, osWaitForever);
+}
+
+bool atecc608a_console_start(void)
+{
+    console_queue = osMessageQueueNew(ATECC608A_CONSOLE_QUEUE_DEPTH,
+                                      sizeof(console_command_t), NULL);
+    if (console_queue == NULL) {
+        return false;
+    }
+    return osThreadNew(console_thread, NULL, &console_thread_attr) != NULL;
+}
+
+bool atecc608a_console_get_command(char *command, size_t command_size,
+                                   uint32_t timeout_ms)
+{
+    console_command_t queued;
+    uint32_t dropped = console_dropped;
+
+    if (command == NULL || command_size == 0) {
+        return false;
+    }
+    if (dropped != console_reported) {
+        printf("Console queue full - dropped %lu commands.\n",
+               (unsigned long)(dropped - console_reported));
+        console_reported = dropped;
+    }
+    if (osMessageQueueGet(console_queue, &queued, NULL, timeout_ms) != osOK) {
+        return false;
+    }
+    strncpy(command, queued.text, command_size - 1);
+    command[command_size - 1] = '\0';
+    return true;
+}
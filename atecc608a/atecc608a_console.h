@@ -0,0 +1,56 @@
+/**
+ * \file atecc608a_console.h
+ * \brief Non-blocking command reader for the example's serial console.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_CONSOLE_H
+#define ATECC608A_CONSOLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Maximum size of a single command, including the null terminator. */
+#define ATECC608A_CONSOLE_COMMAND_SIZE 80
+
+/** Timeout for atecc608a_console_get_command() that never expires. */
+#define ATECC608A_CONSOLE_WAIT_FOREVER 0xFFFFFFFFu
+
+/** Number of complete commands that can be queued before input is dropped,
+ *  or on hosts, before the reader waits. */
+#define ATECC608A_CONSOLE_QUEUE_DEPTH 4
+
+/** Start the console reader thread.
+ *
+ *  The reader sleeps until the serial driver signals received characters,
+ *  splits the input on whitespace (the same way `scanf("%s")` did) and queues
+ *  each complete command for the application. The end of the input, of a
+ *  script piped in on hosts, queues an `exit` command. */
+bool atecc608a_console_start(void);
+
+/** Take the next queued command, waiting at most `timeout_ms` milliseconds.
+ *  A timeout of 0 polls without blocking. Commands dropped since the last
+ *  call are reported first.
+ *
+ *  \return true if a command was copied to `command`, false on timeout. */
+bool atecc608a_console_get_command(char *command, size_t command_size,
+                                   uint32_t timeout_ms);
+
+#endif /* ATECC608A_CONSOLE_H */
@@ -0,0 +1,432 @@
+/**
+ * \file atecc608a_contention.c
+ * \brief Submission latency of concurrent requests, through the service ring
+ *        and through the device lock, and a stress test of the locking.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include "atecc608a_contention.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cmsis_os2.h"
+#include "atca_basic.h"
+#include "atecc608a_key_index.h"
+#include "atecc608a_lock.h"
+#include "atecc608a_service.h"
+#include "atecc608a_stats.h"
+#include "atecc608a_utils.h"
+
+typedef struct {
+    bool use_mutex;
+    uint32_t requests;
+    uint32_t failures;
+    /* Per producer, so that recording needs no lock. Merged at the end. */
+    atecc608a_histogram_t submit_cycles;
+    atecc608a_histogram_t complete_us;
+} producer_t;
+
+static producer_t producers[ATECC608A_CONTENTION_MAX_PRODUCERS];
+static osSemaphoreId_t producers_done;
+
+/* Each producer calls the driver in mutex mode, hence the same stack as the
+ * service thread. */
+static const osThreadAttr_t producer_thread_attr = {
+    .name = "producer",
+    .stack_size = 2048,
+    .priority = osPriorityNormal,
+};
+
+static void producer_thread(void *argument)
+{
+    producer_t *producer = argument;
+    uint8_t random[32];
+    atecc608a_request_t request = {
+        .op = ATECC608A_REQUEST_RANDOM,
+        .priority = ATECC608A_PRIORITY_NORMAL,
+        .data = random,
+        .data_size = sizeof(random),
+    };
+
+    for (uint32_t i = 0; i < producer->requests; i++) {
+        uint64_t start_us = atecc608a_time_us();
+        uint32_t start = atecc608a_cycles();
+        uint32_t submitted;
+        psa_status_t status;
+
+        if (producer->use_mutex) {
+            /* Taken again, recursively, by the call. */
+            atecc608a_device_lock();
+            submitted = atecc608a_cycles();
+            status = atecc608a_random_32_bytes(random, sizeof(random));
+            atecc608a_device_unlock();
+        } else {
+            status = atecc608a_service_submit(&request);
+            submitted = atecc608a_cycles();
+            if (status == PSA_SUCCESS) {
+                status = atecc608a_service_wait(&request, osWaitForever);
+            }
+        }
+        atecc608a_histogram_record(&producer->submit_cycles, submitted - start);
+        atecc608a_histogram_record(&producer->complete_us,
+                                   (uint32_t)(atecc608a_time_us() - start_us));
+        if (status != PSA_SUCCESS) {
+            producer->failures++;
+        }
+    }
+    osSemaphoreRelease(producers_done);
+}
+
+static void print_row(const char *mode, const atecc608a_histogram_t *submit,
+                      const atecc608a_histogram_t *complete, uint32_t failures)
+{
+    printf("  %-5s %10lu %10lu %10lu %10lu | %7lu %7lu %7lu | %lu\n", mode,
+           (unsigned long) atecc608a_histogram_percentile(submit, 50),
+           (unsigned long) atecc608a_histogram_percentile(submit, 99),
+           (unsigned long) atecc608a_histogram_percentile(submit, 99.9),
+           (unsigned long) submit->max,
+           (unsigned long) atecc608a_histogram_percentile(complete, 50),
+           (unsigned long) atecc608a_histogram_percentile(complete, 99),
+           (unsigned long) complete->max,
+           (unsigned long) failures);
+}
+
+static psa_status_t run(bool use_mutex, uint32_t producer_count,
+                        uint32_t requests)
+{
+    static atecc608a_histogram_t submit;
+    static atecc608a_histogram_t complete;
+    uint32_t failures = 0;
+    uint32_t started = 0;
+
+    for (uint32_t i = 0; i < producer_count; i++) {
+        producers[i].use_mutex = use_mutex;
+        producers[i].requests = requests;
+        producers[i].failures = 0;
+        atecc608a_histogram_reset(&producers[i].submit_cycles);
+        atecc608a_histogram_reset(&producers[i].complete_us);
+    }
+    /* Threads only start running once the main thread waits. The ones
+     * started use `producers` until they are done, even if a later one
+     * fails to start. */
+    for (uint32_t i = 0; i < producer_count; i++) {
+        if (osThreadNew(producer_thread, &producers[i],
+                        &producer_thread_attr) == NULL) {
+            break;
+        }
+        started++;
+    }
+    for (uint32_t i = 0; i < started; i++) {
+        osSemaphoreAcquire(producers_done, osWaitForever);
+    }
+    if (started < producer_count) {
+        return PSA_ERROR_INSUFFICIENT_MEMORY;
+    }
+
+    atecc608a_histogram_reset(&submit);
+    atecc608a_histogram_reset(&complete);
+    for (uint32_t i = 0; i < producer_count; i++) {
+        atecc608a_histogram_merge(&submit, &producers[i].submit_cycles);
+        atecc608a_histogram_merge(&complete, &producers[i].complete_us);
+        failures += producers[i].failures;
+    }
+    print_row(use_mutex ? "mutex" : "ring", &submit, &complete, failures);
+    return PSA_SUCCESS;
+}
+
+static psa_status_t setup(void)
+{
+    if (producers_done == NULL) {
+        producers_done = osSemaphoreNew(ATECC608A_CONTENTION_MAX_PRODUCERS, 0,
+                                        NULL);
+        if (producers_done == NULL) {
+            return PSA_ERROR_INSUFFICIENT_MEMORY;
+        }
+    }
+    if (!atecc608a_service_start()) {
+        return PSA_ERROR_INSUFFICIENT_MEMORY;
+    }
+    return PSA_SUCCESS;
+}
+
+psa_status_t atecc608a_contention_run(uint32_t producer_count,
+                                      uint32_t requests)
+{
+    psa_status_t status;
+
+    if (producer_count == 0 || producer_count > ATECC608A_CONTENTION_MAX_PRODUCERS) {
+        return PSA_ERROR_INVALID_ARGUMENT;
+    }
+    status = setup();
+    if (status != PSA_SUCCESS) {
+        return status;
+    }
+
+    printf("%lu producers x %lu random requests:\n",
+           (unsigned long) producer_count, (unsigned long) requests);
+    printf("        submit (cycles)                             | "
+           "complete (us)           |\n");
+    printf("  mode         p50        p99      p99.9        max | "
+           "    p50     p99     max | failures\n");
+    status = run(false, producer_count, requests);
+    if (status == PSA_SUCCESS) {
+        status = run(true, producer_count, requests);
+    }
+    return status;
+}
+
+/* One kind of request of the mixed load, sent in a loop by its own thread
+ * until the run is over. */
+typedef struct {
+    atecc608a_request_t request;
+    uint32_t period_ms;
+    /** Deadline of each request from its submission, 0 for none. */
+    uint32_t deadline_ms;
+    /** Time after which the sender gives up and cancels, 0 to wait. */
+    uint32_t timeout_ms;
+    uint32_t failures;
+} mixed_load_t;
+
+static volatile bool mixed_load_running;
+
+static void mixed_load_thread(void *argument)
+{
+    mixed_load_t *load = argument;
+
+    while (mixed_load_running) {
+        uint32_t start = osKernelGetTickCount();
+        psa_status_t status;
+
+        load->request.deadline_us = load->deadline_ms == 0 ?
+                                    ATECC608A_NO_DEADLINE :
+                                    atecc608a_service_deadline_in(load->deadline_ms);
+        status = atecc608a_service_submit(&load->request);
+        if (status == PSA_SUCCESS) {
+            status = atecc608a_service_wait(&load->request,
+                                            load->timeout_ms == 0 ?
+                                            osWaitForever : load->timeout_ms);
+            if (!load->request.done) {
+                atecc608a_service_cancel(&load->request);
+                /* Cancelled or not, the request is in use until done. */
+                status = atecc608a_service_wait(&load->request, osWaitForever);
+            }
+        }
+        /* Expired and cancelled requests are counted by the service. */
+        if (status != PSA_SUCCESS &&
+                load->request.state != ATECC608A_REQUEST_CANCELLED &&
+                load->request.state != ATECC608A_REQUEST_EXPIRED) {
+            load->failures++;
+        }
+        if (load->period_ms != 0 &&
+                osKernelGetTickCount() - start < load->period_ms) {
+            osDelay(load->period_ms - (osKernelGetTickCount() - start));
+        }
+    }
+    osSemaphoreRelease(producers_done);
+}
+
+psa_status_t atecc608a_contention_priorities(psa_key_slot_number_t slot,
+                                             uint32_t seconds)
+{
+    static uint8_t hash[32];
+    static uint8_t signature[64];
+    static uint8_t random[32];
+    static uint8_t fill[ATECC608A_PRIORITIES_FILL_SIZE];
+    static mixed_load_t loads[3];
+    psa_status_t status = setup();
+
+    if (status != PSA_SUCCESS) {
+        return status;
+    }
+
+    memset(loads, 0, sizeof(loads));
+    loads[0].request.op = ATECC608A_REQUEST_SIGN;
+    loads[0].request.priority = ATECC608A_PRIORITY_HIGH;
+    loads[0].request.slot = slot;
+    loads[0].request.hash = hash;
+    loads[0].request.hash_length = sizeof(hash);
+    loads[0].request.data = signature;
+    loads[0].request.data_size = sizeof(signature);
+    loads[0].period_ms = ATECC608A_PRIORITIES_SIGN_PERIOD_MS;
+    loads[0].deadline_ms = 100;
+    loads[1].request.op = ATECC608A_REQUEST_RANDOM;
+    loads[1].request.priority = ATECC608A_PRIORITY_NORMAL;
+    loads[1].request.data = random;
+    loads[1].request.data_size = sizeof(random);
+    loads[1].period_ms = ATECC608A_PRIORITIES_RANDOM_PERIOD_MS;
+    loads[1].timeout_ms = 30;
+    loads[2].request.op = ATECC608A_REQUEST_RANDOM_FILL;
+    loads[2].request.priority = ATECC608A_PRIORITY_BULK;
+    loads[2].request.data = fill;
+    loads[2].request.data_size = sizeof(fill);
+
+    for (int scheduling = 1; scheduling >= 0; scheduling--) {
+        uint32_t failures = 0;
+
+        atecc608a_service_set_scheduling(scheduling);
+        atecc608a_service_reset_stats();
+        mixed_load_running = true;
+        for (int i = 0; i < 3; i++) {
+            loads[i].failures = 0;
+            if (osThreadNew(mixed_load_thread, &loads[i],
+                            &producer_thread_attr) == NULL) {
+                /* The started ones are stopped below. */
+                status = PSA_ERROR_INSUFFICIENT_MEMORY;
+                mixed_load_running = false;
+                for (int j = 0; j < i; j++) {
+                    osSemaphoreAcquire(producers_done, osWaitForever);
+                }
+                atecc608a_service_set_scheduling(true);
+                return status;
+            }
+        }
+        osDelay(seconds * 1000);
+        mixed_load_running = false;
+        for (int i = 0; i < 3; i++) {
+            osSemaphoreAcquire(producers_done, osWaitForever);
+            failures += loads[i].failures;
+        }
+
+        printf("Scheduling %s, %lu s (%lu failures):\n",
+               scheduling ? "on" : "off (FIFO, bulk runs to completion)",
+               (unsigned long) seconds, (unsigned long) failures);
+        atecc608a_service_print_stats();
+    }
+    atecc608a_service_set_scheduling(true);
+    return PSA_SUCCESS;
+}
+
+/* Results every stress thread must reproduce. */
+typedef struct {
+    uint8_t serial[ATCA_SERIAL_NUM_SIZE];
+    psa_status_t config_locked;
+    int key_slot;
+} stress_reference_t;
+
+typedef struct {
+    const stress_reference_t *reference;
+    uint32_t index;
+    uint32_t iterations;
+    uint32_t errors;
+    uint32_t mismatches;
+} stress_thread_t;
+
+/* Key ID looked up by the stress threads, whichever slot holds it. */
+#define STRESS_KEY_ID 1
+
+static void stress_thread(void *argument)
+{
+    stress_thread_t *thread = argument;
+    const stress_reference_t *reference = thread->reference;
+
+    for (uint32_t i = 0; i < thread->iterations; i++) {
+        uint8_t buffer[32];
+        size_t length;
+        psa_status_t status = PSA_SUCCESS;
+
+        /* Threads start at different steps, so that all kinds overlap. */
+        switch ((i + thread->index) % 4) {
+            case 0:
+                status = atecc608a_get_serial_number(buffer, sizeof(buffer),
+                                                     &length);
+                if (status == PSA_SUCCESS &&
+                        memcmp(buffer, reference->serial,
+                               sizeof(reference->serial)) != 0) {
+                    thread->mismatches++;
+                }
+                break;
+            case 1:
+                status = atecc608a_random_32_bytes(buffer, sizeof(buffer));
+                break;
+            case 2:
+                if (atecc608a_check_zone_locked(LOCK_ZONE_CONFIG) !=
+                        reference->config_locked) {
+                    thread->mismatches++;
+                }
+                break;
+            default:
+                if (atecc608a_key_index_find(STRESS_KEY_ID) !=
+                        reference->key_slot) {
+                    thread->mismatches++;
+                }
+                break;
+        }
+        if (status != PSA_SUCCESS) {
+            thread->errors++;
+        }
+    }
+    osSemaphoreRelease(producers_done);
+}
+
+psa_status_t atecc608a_contention_stress(uint32_t threads,
+                                         uint32_t iterations)
+{
+    static stress_reference_t reference;
+    static stress_thread_t stress[ATECC608A_CONTENTION_MAX_PRODUCERS];
+    uint32_t started = 0;
+    uint32_t errors = 0;
+    uint32_t mismatches = 0;
+    size_t length;
+    psa_status_t status = setup();
+
+    if (status != PSA_SUCCESS) {
+        return status;
+    }
+    if (threads == 0 || threads > ATECC608A_CONTENTION_MAX_PRODUCERS) {
+        return PSA_ERROR_INVALID_ARGUMENT;
+    }
+
+    status = atecc608a_get_serial_number(reference.serial,
+                                         sizeof(reference.serial), &length);
+    if (status != PSA_SUCCESS) {
+        return status;
+    }
+    reference.config_locked = atecc608a_check_zone_locked(LOCK_ZONE_CONFIG);
+    reference.key_slot = atecc608a_key_index_find(STRESS_KEY_ID);
+
+    atecc608a_locks_reset_stats();
+    for (uint32_t i = 0; i < threads; i++) {
+        stress[i].reference = &reference;
+        stress[i].index = i;
+        stress[i].iterations = iterations;
+        stress[i].errors = 0;
+        stress[i].mismatches = 0;
+        if (osThreadNew(stress_thread, &stress[i],
+                        &producer_thread_attr) == NULL) {
+            status = PSA_ERROR_INSUFFICIENT_MEMORY;
+            break;
+        }
+        started++;
+    }
+    for (uint32_t i = 0; i < started; i++) {
+        osSemaphoreAcquire(producers_done, osWaitForever);
+        errors += stress[i].errors;
+        mismatches += stress[i].mismatches;
+    }
+
+    printf("Stress: %lu threads, %lu calls each, %lu errors, %lu mismatches\n",
+           (unsigned long) started, (unsigned long) iterations,
+           (unsigned long) errors, (unsigned long) mismatches);
+    atecc608a_locks_print();
+    if (status == PSA_SUCCESS && (errors != 0 || mismatches != 0)) {
+        status = PSA_ERROR_HARDWARE_FAILURE;
+    }
+    return status;
+}
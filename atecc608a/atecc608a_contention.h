@@ -0,0 +1,63 @@
+/**
+ * \file atecc608a_contention.h
+ * \brief Submission latency of concurrent requests, through the service ring
+ *        and through the device lock, and a stress test of the locking.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_CONTENTION_H
+#define ATECC608A_CONTENTION_H
+
+#include <stdint.h>
+
+#include "psa/crypto.h"
+
+#define ATECC608A_CONTENTION_MAX_PRODUCERS 4
+
+/* The mixed load of atecc608a_contention_priorities(). */
+#define ATECC608A_PRIORITIES_SIGN_PERIOD_MS 50
+#define ATECC608A_PRIORITIES_RANDOM_PERIOD_MS 20
+#define ATECC608A_PRIORITIES_FILL_SIZE 256
+
+/** Run `requests` random number requests from each of `producers` threads,
+ *  first through atecc608a_service_submit(), then with each thread calling
+ *  the driver under the device lock. Prints the submission latency in cycles
+ *  (the submit call, or acquiring the lock) and the completion latency in
+ *  microseconds of both. Blocks until both runs are over. Starts the service
+ *  if needed. */
+psa_status_t atecc608a_contention_run(uint32_t producers, uint32_t requests);
+
+/** For `seconds` each with the service's scheduling on and off, run a mixed
+ *  load: a high priority signature with the key in `slot` and a 100 ms
+ *  deadline every 50 ms, a normal priority random request every 20 ms that
+ *  its sender cancels after 30 ms, and back to back 256 byte bulk random
+ *  fills. Prints the latency percentiles of each priority and the requests
+ *  that expired or were cancelled. */
+psa_status_t atecc608a_contention_priorities(psa_key_slot_number_t slot,
+                                             uint32_t seconds);
+
+/** Call the utilities from `threads` threads at once, `iterations` times
+ *  each, cycling through a serial number read, a random number, a config
+ *  zone lock check and a key index lookup, and check every result against
+ *  one obtained before the threads start. Prints the number of mismatches
+ *  and errors, and the wait and hold times of each lock. */
+psa_status_t atecc608a_contention_stress(uint32_t threads,
+                                         uint32_t iterations);
+
+#endif /* ATECC608A_CONTENTION_H */
@@ -0,0 +1,636 @@
+/**
+ * \file atecc608a_coro.hpp
+ * \brief C++20 coroutine interface to the ATECC608A, over the request
+ *        service.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_CORO_HPP
+#define ATECC608A_CORO_HPP
+
+#if __cplusplus < 202002L || !defined(__cpp_impl_coroutine)
+#error "atecc608a_coro.hpp needs C++20 coroutines"
+#endif
+
+#include <coroutine>
+#include <exception>
+
+#include "atecc608a.hpp"
+
+extern "C" {
+#include "cmsis_os2.h"
+#include "atecc608a_service.h"
+#include "atecc608a_stats.h"
+}
+
+/* Each awaitable operation is a service request living in the coroutine
+ * frame. Awaiting it submits the request and suspends the coroutine; the
+ * service thread runs it on the device and marks it done, and the executor
+ * of the awaiting thread resumes the coroutine on its next poll. Any number
+ * of coroutines can wait on one thread, with no stack of their own: the
+ * device works through their requests while the thread only wakes up to
+ * resume the ones that are done.
+ *
+ * The slot types and their role checks are those of atecc608a.hpp.
+ *
+ * \code
+ * atecc608a::coro::Task<psa_status_t> attest(atecc608a::coro::Executor &ex)
+ * {
+ *     uint8_t nonce[32], digest[32], signature[64];
+ *     size_t length;
+ *     psa_status_t status = co_await atecc608a::coro::random_32_bytes(ex, nonce);
+ *     if (status == PSA_SUCCESS) {
+ *         status = co_await atecc608a::coro::sha256(ex, nonce, digest);
+ *     }
+ *     if (status == PSA_SUCCESS) {
+ *         status = co_await atecc608a::coro::sign(ex, DeviceKey{}, digest,
+ *                                                 signature, length);
+ *     }
+ *     co_return status;
+ * }
+ * \endcode */
+namespace atecc608a {
+namespace coro {
+
+class Executor;
+
+template <typename T = void>
+class Task;
+
+namespace detail {
+
+struct PromiseBase {
+    /** Resumed when the task is over: the awaiting task, if any. */
+    std::coroutine_handle<> continuation;
+    /** Next task spawned on the same executor. */
+    PromiseBase *next_spawned = nullptr;
+
+    struct FinalAwaiter {
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        template <typename P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> handle) noexcept
+        {
+            std::coroutine_handle<> continuation = handle.promise().continuation;
+
+            return continuation ? continuation : std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    /* Tasks start when awaited or spawned. */
+    std::suspend_always initial_suspend() const noexcept
+    {
+        return {};
+    }
+
+    FinalAwaiter final_suspend() const noexcept
+    {
+        return {};
+    }
+
+    /* Builds run without exceptions. */
+    void unhandled_exception() const noexcept
+    {
+        std::terminate();
+    }
+};
+
+template <typename T>
+struct Promise : PromiseBase {
+    T value{};
+
+    Task<T> get_return_object() noexcept;
+
+    void return_value(T result) noexcept
+    {
+        value = result;
+    }
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+    Task<void> get_return_object() noexcept;
+
+    void return_void() const noexcept {}
+};
+
+} // namespace detail
+
+/** A coroutine that returns a T. It starts when it is awaited, or when it
+ *  is spawned on an executor. Without exceptions, a frame that cannot be
+ *  allocated gives an empty task, which awaits to a default T. Move-only;
+ *  the frame is destroyed with the task. */
+template <typename T>
+class Task {
+public:
+    using promise_type = detail::Promise<T>;
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    Task() noexcept : _handle(nullptr) {}
+    explicit Task(handle_type handle) noexcept : _handle(handle) {}
+
+    Task(Task &&other) noexcept : _handle(other._handle)
+    {
+        other._handle = nullptr;
+    }
+
+    Task &operator=(Task &&other) noexcept
+    {
+        if (this != &other) {
+            if (_handle) {
+                _handle.destroy();
+            }
+            _handle = other._handle;
+            other._handle = nullptr;
+        }
+        return *this;
+    }
+
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+    ~Task()
+    {
+        if (_handle) {
+            _handle.destroy();
+        }
+    }
+
+    static Task get_return_object_on_allocation_failure() noexcept
+    {
+        return Task();
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return static_cast<bool>(_handle);
+    }
+
+    bool await_ready() const noexcept
+    {
+        return !_handle || _handle.done();
+    }
+
+    /* Symmetric transfer: the task runs right away on this thread and
+     * resumes the awaiting coroutine when it is over. */
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+    {
+        _handle.promise().continuation = awaiting;
+        return _handle;
+    }
+
+    T await_resume() const noexcept
+    {
+        if constexpr (!std::is_void<T>::value) {
+            return _handle ? _handle.promise().value : T{};
+        }
+    }
+
+private:
+    friend class Executor;
+
+    handle_type release() noexcept
+    {
+        handle_type handle = _handle;
+        _handle = nullptr;
+        return handle;
+    }
+
+    handle_type _handle;
+};
+
+namespace detail {
+
+template <typename T>
+inline Task<T> Promise<T>::get_return_object() noexcept
+{
+    return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline Task<void> Promise<void>::get_return_object() noexcept
+{
+    return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+} // namespace detail
+
+/** Scheduling overhead of the awaits of an executor. */
+struct ExecutorStats {
+    /** Awaits that suspended. */
+    uint32_t awaits;
+    /** Awaits that found the service ring full and were submitted later. */
+    uint32_t deferred;
+    /** From the await to the request being in the ring, in cycles. */
+    atecc608a_histogram_t submit_cycles;
+    /** From the service completing the request to the coroutine being
+     *  resumed, in microseconds. */
+    atecc608a_histogram_t resume_us;
+};
+
+class Operation;
+
+/** Resumes the coroutines of one thread once their requests are done. Every
+ *  coroutine that awaits through an executor must run on the thread that
+ *  polls it. */
+class Executor {
+public:
+    explicit Executor(atecc608a_priority_t priority = ATECC608A_PRIORITY_NORMAL) noexcept :
+        _priority(priority), _waiting(nullptr), _deferred(nullptr),
+        _deferred_tail(nullptr), _spawned(nullptr)
+    {
+        reset_stats();
+    }
+
+    Executor(const Executor &) = delete;
+    Executor &operator=(const Executor &) = delete;
+
+    /** Destroys the spawned tasks, over or not. Their requests still in the
+     *  service are cancelled if they have not started, and waited for if
+     *  they have, so the executor must be destroyed on its thread. */
+    ~Executor();
+
+    atecc608a_priority_t priority() const noexcept
+    {
+        return _priority;
+    }
+
+    /** Start `task`, which the executor then owns and destroys when it is
+     *  over. Returns false for an empty task. */
+    bool spawn(Task<void> &&task) noexcept
+    {
+        typename Task<void>::handle_type handle = task.release();
+
+        if (!handle) {
+            return false;
+        }
+        handle.promise().next_spawned = _spawned;
+        _spawned = &handle.promise();
+        handle.resume();
+        return true;
+    }
+
+    /** Submit the requests that found the ring full, resume the coroutines
+     *  whose requests are done and destroy the spawned tasks that are over.
+     *  Returns the number of coroutines resumed. */
+    uint32_t poll() noexcept;
+
+    /** Poll until every spawned task is over, sleeping on the completion
+     *  flag of the service in between. Starts the service if needed. */
+    psa_status_t run() noexcept;
+
+    /** Whether a spawned task is not over yet. */
+    bool busy() const noexcept
+    {
+        return _spawned != nullptr;
+    }
+
+    const ExecutorStats &stats() const noexcept
+    {
+        return _stats;
+    }
+
+    void reset_stats() noexcept
+    {
+        _stats.awaits = 0;
+        _stats.deferred = 0;
+        atecc608a_histogram_reset(&_stats.submit_cycles);
+        atecc608a_histogram_reset(&_stats.resume_us);
+    }
+
+private:
+    friend class Operation;
+
+    void suspend(Operation &operation) noexcept;
+    void destroy_spawned(bool all) noexcept;
+
+    atecc608a_priority_t _priority;
+    /** Submitted, in no particular order. */
+    Operation *_waiting;
+    /** Refused by a full ring, in await order. */
+    Operation *_deferred;
+    Operation *_deferred_tail;
+    detail::PromiseBase *_spawned;
+    ExecutorStats _stats;
+};
+
+/** One service request, awaited. Created by the functions below; awaiting
+ *  it gives the status of the request. */
+class Operation {
+public:
+    Operation(Executor &executor, atecc608a_request_op_t op,
+              size_t *length = nullptr) noexcept :
+        _executor(executor), _request{}, _length(length), _next(nullptr),
+        _awaited(0), _completed_us(0)
+    {
+        _request.op = op;
+        _request.priority = executor.priority();
+        _request.deadline_us = ATECC608A_NO_DEADLINE;
+        _request.callback = &Operation::completed;
+    }
+
+    /* Operations are returned by value until awaited. Once submitted the
+     * service points to the request, which stays in the frame of the
+     * awaiting coroutine. */
+    Operation(Operation &&other) noexcept :
+        _executor(other._executor), _request(other._request),
+        _length(other._length), _next(nullptr), _awaited(0),
+        _completed_us(0) {}
+
+    Operation(const Operation &) = delete;
+    Operation &operator=(const Operation &) = delete;
+
+    atecc608a_request_t &request() noexcept
+    {
+        return _request;
+    }
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) noexcept
+    {
+        _handle = handle;
+        _request.context = this;
+        _executor.suspend(*this);
+    }
+
+    psa_status_t await_resume() const noexcept
+    {
+        if (_length != nullptr) {
+            *_length = _request.data_length;
+        }
+        return _request.status;
+    }
+
+private:
+    friend class Executor;
+
+    /* On the service thread. The executor reads the time once it sees the
+     * request done, which is set after this returns. */
+    static void completed(atecc608a_request_t *request)
+    {
+        static_cast<Operation *>(request->context)->_completed_us =
+            atecc608a_time_us();
+    }
+
+    Executor &_executor;
+    atecc608a_request_t _request;
+    size_t *_length;
+    std::coroutine_handle<> _handle;
+    Operation *_next;
+    /** When awaited, in cycles. */
+    uint32_t _awaited;
+    volatile uint64_t _completed_us;
+};
+
+inline void Executor::suspend(Operation &operation) noexcept
+{
+    operation._awaited = atecc608a_cycles();
+    _stats.awaits++;
+    if (_deferred == nullptr &&
+            atecc608a_service_submit(&operation._request) == PSA_SUCCESS) {
+        atecc608a_histogram_record(&_stats.submit_cycles,
+                                   atecc608a_cycles() - operation._awaited);
+        operation._next = _waiting;
+        _waiting = &operation;
+        return;
+    }
+    /* Behind the ones already deferred, to keep their order. */
+    _stats.deferred++;
+    operation._next = nullptr;
+    if (_deferred_tail != nullptr) {
+        _deferred_tail->_next = &operation;
+    } else {
+        _deferred = &operation;
+    }
+    _deferred_tail = &operation;
+}
+
+inline uint32_t Executor::poll() noexcept
+{
+    Operation *done = nullptr;
+    uint32_t resumed = 0;
+
+    while (_deferred != nullptr) {
+        Operation *operation = _deferred;
+
+        if (atecc608a_service_submit(&operation->_request) != PSA_SUCCESS) {
+            break;
+        }
+        _deferred = operation->_next;
+        if (_deferred == nullptr) {
+            _deferred_tail = nullptr;
+        }
+        atecc608a_histogram_record(&_stats.submit_cycles,
+                                   atecc608a_cycles() - operation->_awaited);
+        operation->_next = _waiting;
+        _waiting = operation;
+    }
+
+    /* Done operations are taken off the list first: resuming a coroutine
+     * may add to it. */
+    for (Operation **link = &_waiting; *link != nullptr;) {
+        Operation *operation = *link;
+
+        if (!atecc608a_service_is_done(&operation->_request)) {
+            link = &operation->_next;
+            continue;
+        }
+        *link = operation->_next;
+        operation->_next = done;
+        done = operation;
+    }
+    while (done != nullptr) {
+        Operation *operation = done;
+        std::coroutine_handle<> handle = operation->_handle;
+        uint64_t now = atecc608a_time_us();
+
+        done = operation->_next;
+        atecc608a_histogram_record(&_stats.resume_us,
+                                   (uint32_t)(now - operation->_completed_us));
+        /* The operation is gone once the coroutine goes on. */
+        handle.resume();
+        resumed++;
+    }
+
+    destroy_spawned(false);
+    return resumed;
+}
+
+inline psa_status_t Executor::run() noexcept
+{
+    if (!atecc608a_service_start()) {
+        return PSA_ERROR_INSUFFICIENT_MEMORY;
+    }
+    while (busy()) {
+        if (poll() != 0) {
+            continue;
+        }
+        if (_waiting != nullptr) {
+            /* A flag left over from a request resumed by an earlier poll
+             * only costs one more poll. */
+            osThreadFlagsWait(ATECC608A_SERVICE_DONE_FLAG, osFlagsWaitAny,
+                              osWaitForever);
+        } else {
+            /* The ring is full of requests of other threads, or a task
+             * waits on something other than the device. */
+            osThreadYield();
+        }
+    }
+    return PSA_SUCCESS;
+}
+
+inline Executor::~Executor()
+{
+    /* The service writes the result into the request, in the frame of the
+     * awaiting coroutine: it must be done with it before the frame goes.
+     * Deferred requests were never submitted. */
+    for (Operation *operation = _waiting; operation != nullptr;
+            operation = operation->_next) {
+        atecc608a_service_cancel(&operation->_request);
+        atecc608a_service_wait(&operation->_request, osWaitForever);
+    }
+    destroy_spawned(true);
+}
+
+inline void Executor::destroy_spawned(bool all) noexcept
+{
+    for (detail::PromiseBase **link = &_spawned; *link != nullptr;) {
+        detail::PromiseBase *promise = *link;
+        auto handle = std::coroutine_handle<detail::Promise<void>>::from_promise(
+                          *static_cast<detail::Promise<void> *>(promise));
+
+        if (!all && !handle.done()) {
+            link = &promise->next_spawned;
+            continue;
+        }
+        *link = promise->next_spawned;
+        handle.destroy();
+    }
+}
+
+template <typename S>
+inline Operation sign(Executor &executor, S, span<const uint8_t> hash,
+                      span<uint8_t> signature, size_t &signature_length)
+{
+    static_assert(S::role == SlotRole::private_key,
+                  "Signing requires a private key slot");
+    Operation operation(executor, ATECC608A_REQUEST_SIGN, &signature_length);
+
+    operation.request().slot = S::number;
+    operation.request().hash = hash.data();
+    operation.request().hash_length = hash.size();
+    operation.request().data = signature.data();
+    operation.request().data_size = signature.size();
+    return operation;
+}
+
+template <typename S>
+inline Operation verify(Executor &executor, S, span<const uint8_t> hash,
+                        span<const uint8_t> signature)
+{
+    static_assert(S::role == SlotRole::public_key,
+                  "Verification requires a public key slot");
+    Operation operation(executor, ATECC608A_REQUEST_VERIFY);
+
+    operation.request().slot = S::number;
+    operation.request().hash = hash.data();
+    operation.request().hash_length = hash.size();
+    /* Only read by the service. */
+    operation.request().data = const_cast<uint8_t *>(signature.data());
+    operation.request().data_length = signature.size();
+    return operation;
+}
+
+template <typename S>
+inline Operation export_public_key(Executor &executor, S,
+                                   span<uint8_t> pubkey, size_t &pubkey_length)
+{
+    static_assert(S::role == SlotRole::private_key ||
+                  S::role == SlotRole::public_key,
+                  "Public keys can only be exported from key slots");
+    Operation operation(executor, ATECC608A_REQUEST_EXPORT, &pubkey_length);
+
+    operation.request().slot = S::number;
+    operation.request().data = pubkey.data();
+    operation.request().data_size = pubkey.size();
+    return operation;
+}
+
+inline Operation random_32_bytes(Executor &executor, span<uint8_t> out)
+{
+    Operation operation(executor, ATECC608A_REQUEST_RANDOM);
+
+    operation.request().data = out.data();
+    operation.request().data_size = out.size();
+    return operation;
+}
+
+/** SHA-256 on the device, into a 32 byte `digest`. */
+inline Operation sha256(Executor &executor, span<const uint8_t> input,
+                        span<uint8_t> digest)
+{
+    Operation operation(executor, ATECC608A_REQUEST_SHA256);
+
+    operation.request().hash = input.data();
+    operation.request().hash_length = input.size();
+    operation.request().data = digest.data();
+    operation.request().data_size = digest.size();
+    return operation;
+}
+
+template <typename S>
+inline Operation read(Executor &executor, S, size_t offset, span<uint8_t> data)
+{
+    static_assert(S::readable, "The slot does not allow clear text reads");
+    Operation operation(executor, ATECC608A_REQUEST_READ_DATA);
+
+    operation.request().slot = S::number;
+    operation.request().offset = static_cast<uint16_t>(offset);
+    operation.request().data = data.data();
+    operation.request().data_size = data.size();
+    return operation;
+}
+
+template <typename S>
+inline Operation write(Executor &executor, S, size_t offset,
+                       span<const uint8_t> data)
+{
+    static_assert(S::writable, "The slot does not allow clear text writes");
+    Operation operation(executor, ATECC608A_REQUEST_WRITE_DATA);
+
+    operation.request().slot = S::number;
+    operation.request().offset = static_cast<uint16_t>(offset);
+    /* Only read by the service. */
+    operation.request().data = const_cast<uint8_t *>(data.data());
+    operation.request().data_length = data.size();
+    return operation;
+}
+
+} // namespace coro
+} // namespace atecc608a
+
+#endif /* ATECC608A_CORO_HPP */
@@ -0,0 +1,171 @@
+/**
+ * \file atecc608a_coro_pipeline.cpp
+ * \brief Example of the coroutine interface: many signatures in flight on
+ *        one thread.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "atecc608a_coro_pipeline.h"
+
+/* The default Mbed OS profiles build C++14; the example needs
+ * -std=gnu++20 in the cxx flags of the build profile. */
+#if __cplusplus >= 202002L && defined(__cpp_impl_coroutine)
+
+#include <stdio.h>
+
+#include "atecc608a_coro.hpp"
+
+namespace {
+
+using DeviceKey = atecc608a::DevSlot<0>;
+namespace coro = atecc608a::coro;
+
+struct Pipeline {
+    uint32_t requests;
+    /** Attestations started so far. */
+    uint32_t started;
+    uint32_t failures;
+};
+
+psa_status_t attest_blocking()
+{
+    uint8_t nonce[32];
+    uint8_t digest[32];
+    uint8_t signature[64];
+    size_t signature_length;
+    psa_status_t status = atecc608a::random_32_bytes(nonce);
+
+    if (status == PSA_SUCCESS) {
+        status = atecc608a_sha256(nonce, sizeof(nonce), digest);
+    }
+    if (status == PSA_SUCCESS) {
+        status = atecc608a::sign(DeviceKey{}, digest, signature,
+                                 signature_length);
+    }
+    return status;
+}
+
+/* Takes attestations until all are started. The buffers are in the frame,
+ * each worker has one attestation in flight. */
+coro::Task<void> attest_worker(coro::Executor &executor, Pipeline &pipeline)
+{
+    uint8_t nonce[32];
+    uint8_t digest[32];
+    uint8_t signature[64];
+    size_t signature_length;
+
+    while (pipeline.started < pipeline.requests) {
+        psa_status_t status;
+
+        pipeline.started++;
+        status = co_await coro::random_32_bytes(executor, nonce);
+        if (status == PSA_SUCCESS) {
+            status = co_await coro::sha256(executor, nonce, digest);
+        }
+        if (status == PSA_SUCCESS) {
+            status = co_await coro::sign(executor, DeviceKey{}, digest,
+                                         signature, signature_length);
+        }
+        if (status != PSA_SUCCESS) {
+            pipeline.failures++;
+        }
+    }
+}
+
+void print_run(const char *mode, uint32_t requests, uint64_t elapsed_us,
+               uint32_t failures)
+{
+    printf("  %-10s %8lu ms %8lu ops/s %6lu failures\n", mode,
+           (unsigned long)(elapsed_us / 1000),
+           (unsigned long)(elapsed_us > 0 ?
+                           3ull * requests * 1000000 / elapsed_us : 0),
+           (unsigned long) failures);
+}
+
+} // namespace
+
+extern "C" psa_status_t atecc608a_coro_pipeline(uint32_t requests,
+                                                uint32_t concurrency)
+{
+    static coro::Executor executor;
+    Pipeline pipeline = { requests, 0, 0 };
+    uint32_t failures = 0;
+    uint64_t start;
+    psa_status_t status;
+
+    if (concurrency == 0 ||
+            concurrency > ATECC608A_CORO_PIPELINE_MAX_CONCURRENCY) {
+        return PSA_ERROR_INVALID_ARGUMENT;
+    }
+    if (!atecc608a_service_start()) {
+        return PSA_ERROR_INSUFFICIENT_MEMORY;
+    }
+
+    printf("%lu attestations (random, SHA-256, sign), %lu in flight:\n",
+           (unsigned long) requests, (unsigned long) concurrency);
+    start = atecc608a_time_us();
+    for (uint32_t i = 0; i < requests; i++) {
+        if (attest_blocking() != PSA_SUCCESS) {
+            failures++;
+        }
+    }
+    print_run("blocking", requests, atecc608a_time_us() - start, failures);
+
+    executor.reset_stats();
+    start = atecc608a_time_us();
+    for (uint32_t i = 0; i < concurrency; i++) {
+        /* Workers that could not be allocated leave their share to the
+         * others. */
+        if (!executor.spawn(attest_worker(executor, pipeline)) && i == 0) {
+            return PSA_ERROR_INSUFFICIENT_MEMORY;
+        }
+    }
+    status = executor.run();
+    if (status != PSA_SUCCESS) {
+        return status;
+    }
+    print_run("coroutines", requests, atecc608a_time_us() - start,
+              pipeline.failures);
+
+    const coro::ExecutorStats &stats = executor.stats();
+
+    printf("  %lu awaits, %lu deferred on a full ring\n",
+           (unsigned long) stats.awaits, (unsigned long) stats.deferred);
+    printf("  submit (cycles): mean %lu, p99 %lu, max %lu\n",
+           (unsigned long) atecc608a_histogram_mean(&stats.submit_cycles),
+           (unsigned long) atecc608a_histogram_percentile(&stats.submit_cycles, 99),
+           (unsigned long) stats.submit_cycles.max);
+    printf("  resume (us):     mean %lu, p99 %lu, max %lu\n",
+           (unsigned long) atecc608a_histogram_mean(&stats.resume_us),
+           (unsigned long) atecc608a_histogram_percentile(&stats.resume_us, 99),
+           (unsigned long) stats.resume_us.max);
+    return PSA_SUCCESS;
+}
+
+#else
+
+extern "C" psa_status_t atecc608a_coro_pipeline(uint32_t requests,
+                                                uint32_t concurrency)
+{
+    (void) requests;
+    (void) concurrency;
+    return PSA_ERROR_NOT_SUPPORTED;
+}
+
+#endif
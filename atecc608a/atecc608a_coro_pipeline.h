@@ -0,0 +1,51 @@
+/**
+ * \file atecc608a_coro_pipeline.h
+ * \brief Example of the coroutine interface: many signatures in flight on
+ *        one thread.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_CORO_PIPELINE_H
+#define ATECC608A_CORO_PIPELINE_H
+
+#include <stdint.h>
+
+#include "psa/crypto.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ATECC608A_CORO_PIPELINE_MAX_CONCURRENCY 32
+
+/** Make `requests` attestations, each a random nonce, its device SHA-256
+ *  and a signature of the digest with the key in slot 0: first one after
+ *  the other with the blocking utilities, then from `concurrency`
+ *  coroutines on the calling thread, through the request service. Prints
+ *  the time and operations per second of both, and the submit and resume
+ *  overhead of each await. Starts the service if needed.
+ *
+ *  Fails with PSA_ERROR_NOT_SUPPORTED unless built as C++20. */
+psa_status_t atecc608a_coro_pipeline(uint32_t requests, uint32_t concurrency);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ATECC608A_CORO_PIPELINE_H */
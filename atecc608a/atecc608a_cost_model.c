@@ -0,0 +1,228 @@
+/**
+ * \file atecc608a_cost_model.c
+ * \brief Latency model of ATECC508A and ATECC608A operations.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include "atecc608a_cost_model.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/* Device commands as seen on the bus. Execution times are the maximums from
+ * the ATECC508A datasheet (DS20005927A, table 9-4), the same values
+ * cryptoauthlib waits for before reading a response. */
+typedef enum {
+    CMD_READ_WORD,
+    CMD_READ_BLOCK,
+    CMD_WRITE_WORD,
+    CMD_WRITE_BLOCK,
+    CMD_NONCE_LOAD,
+    CMD_RANDOM,
+    CMD_SIGN,
+    CMD_VERIFY,
+    CMD_GENKEY,
+    CMD_SHA_START,
+    CMD_SHA_UPDATE,
+    CMD_SHA_END,
+    CMD_UPDATE_EXTRA,
+    CMD_LOCK,
+    CMD_ECDH,
+    CMD_COUNT,
+} command_t;
+
+typedef struct {
+    uint8_t exec_ms;
+    /* Bytes of command data and of response data, without framing. */
+    uint8_t tx_data;
+    uint8_t rx_data;
+} command_cost_t;
+
+static const command_cost_t command_costs[CMD_COUNT] = {
+    [CMD_READ_WORD]    = {   1,  0,  4 },
+    [CMD_READ_BLOCK]   = {   1,  0, 32 },
+    [CMD_WRITE_WORD]   = {  26,  4,  1 },
+    [CMD_WRITE_BLOCK]  = {  26, 32,  1 },
+    [CMD_NONCE_LOAD]   = {   7, 32,  1 },
+    [CMD_RANDOM]       = {  23,  0, 32 },
+    [CMD_SIGN]         = {  50,  0, 64 },
+    [CMD_VERIFY]       = {  58, 64,  1 },
+    [CMD_GENKEY]       = { 115,  0, 64 },
+    [CMD_SHA_START]    = {   9,  0,  1 },
+    [CMD_SHA_UPDATE]   = {   9, 64,  1 },
+    [CMD_SHA_END]      = {   9,  0, 32 },
+    [CMD_UPDATE_EXTRA] = {  10,  0,  1 },
+    [CMD_LOCK]         = {  32,  0,  1 },
+    [CMD_ECDH]         = {  58, 64,  1 },
+};
+
+typedef struct {
+    command_t command;
+    uint8_t count;
+} command_step_t;
+
+#define MAX_COMMAND_STEPS 5
+
+typedef struct {
+    const char *name;
+    command_step_t commands[MAX_COMMAND_STEPS];
+} op_definition_t;
+
+/* How cryptoauthlib breaks each operation down into commands. */
+static const op_definition_t op_definitions[ATECC608A_COST_OP_COUNT] = {
+    [ATECC608A_COST_SIGN] = {
+        "sign", { { CMD_RANDOM, 1 }, { CMD_NONCE_LOAD, 1 }, { CMD_SIGN, 1 } }
+    },
+    [ATECC608A_COST_VERIFY] = {
+        "verify", { { CMD_NONCE_LOAD, 1 }, { CMD_VERIFY, 1 } }
+    },
+    [ATECC608A_COST_GENERATE] = { "generate", { { CMD_GENKEY, 1 } } },
+    [ATECC608A_COST_EXPORT] = { "export", { { CMD_GENKEY, 1 } } },
+    [ATECC608A_COST_IMPORT] = {
+        "import", { { CMD_WRITE_BLOCK, 2 }, { CMD_WRITE_WORD, 2 } }
+    },
+    [ATECC608A_COST_GENERATE_MIRRORED] = {
+        "generate_mirrored", {
+            { CMD_GENKEY, 1 }, { CMD_WRITE_BLOCK, 2 }, { CMD_WRITE_WORD, 2 }
+        }
+    },
+    [ATECC608A_COST_EXPORT_MIRRORED] = {
+        "export_mirrored", { { CMD_READ_BLOCK, 2 }, { CMD_READ_WORD, 2 } }
+    },
+    [ATECC608A_COST_RANDOM] = { "random", { { CMD_RANDOM, 1 } } },
+    [ATECC608A_COST_SHA_SHORT] = {
+        "sha_short", { { CMD_SHA_START, 1 }, { CMD_SHA_END, 1 } }
+    },
+    [ATECC608A_COST_SHA_64] = {
+        "sha_64", {
+            { CMD_SHA_START, 1 }, { CMD_SHA_UPDATE, 1 }, { CMD_SHA_END, 1 }
+        }
+    },
+    [ATECC608A_COST_READ_WORD] = { "read_word", { { CMD_READ_WORD, 1 } } },
+    [ATECC608A_COST_READ_BLOCK] = { "read_block", { { CMD_READ_BLOCK, 1 } } },
+    [ATECC608A_COST_WRITE_BLOCK] = { "write_block", { { CMD_WRITE_BLOCK, 1 } } },
+    [ATECC608A_COST_WRITE_WORD] = { "write_word", { { CMD_WRITE_WORD, 1 } } },
+    [ATECC608A_COST_READ_CONFIG] = { "read_config", { { CMD_READ_BLOCK, 4 } } },
+    [ATECC608A_COST_WRITE_CONFIG] = {
+        "write_config", {
+            { CMD_WRITE_WORD, 4 }, { CMD_WRITE_BLOCK, 3 }, { CMD_UPDATE_EXTRA, 2 }
+        }
+    },
+    [ATECC608A_COST_LOCK] = { "lock", { { CMD_LOCK, 1 } } },
+    [ATECC608A_COST_CSR] = {
+        "csr", {
+            { CMD_GENKEY, 1 }, { CMD_READ_BLOCK, 1 }, { CMD_RANDOM, 1 },
+            { CMD_NONCE_LOAD, 1 }, { CMD_SIGN, 1 }
+        }
+    },
+    [ATECC608A_COST_ECDH_HMAC] = {
+        "ecdh_hmac", {
+            { CMD_ECDH, 1 }, { CMD_SHA_START, 1 }, { CMD_SHA_END, 1 }
+        }
+    },
+};
+
+static uint32_t op_us[ATECC608A_COST_OP_COUNT];
+static bool op_measured[ATECC608A_COST_OP_COUNT];
+static bool model_initialized;
+
+/* Time to clock `bytes` bytes over I2C, 9 bits each with the acknowledge,
+ * plus the address byte of the transaction. */
+static uint32_t i2c_transfer_us(uint32_t bytes)
+{
+    return (uint32_t)((bytes + 1) * 9 * 1000000ULL / ATECC608A_COST_MODEL_I2C_HZ);
+}
+
+/* cryptoauthlib wakes the device before every command and sends it to idle
+ * afterwards. A command frame carries a word address, count, opcode, two
+ * parameters (3 bytes) and a CRC around the data; a response frame carries a
+ * count and a CRC around the data. */
+static uint32_t command_us(command_t command)
+{
+    const command_cost_t *cost = &command_costs[command];
+    uint32_t wake = i2c_transfer_us(0) + ATECC608A_COST_MODEL_WAKE_DELAY_US +
+                    i2c_transfer_us(4);
+    uint32_t send = i2c_transfer_us(1 + 1 + 1 + 3 + cost->tx_data + 2);
+    uint32_t receive = i2c_transfer_us(1 + cost->rx_data + 2);
+    uint32_t idle = i2c_transfer_us(1);
+
+    return wake + send + cost->exec_ms * 1000 + receive + idle;
+}
+
+const char *atecc608a_cost_model_op_name(atecc608a_cost_op_t op)
+{
+    return op < ATECC608A_COST_OP_COUNT ? op_definitions[op].name : "unknown";
+}
+
+void atecc608a_cost_model_reset(void)
+{
+    for (size_t op = 0; op < ATECC608A_COST_OP_COUNT; op++) {
+        const op_definition_t *definition = &op_definitions[op];
+
+        op_us[op] = 0;
+        for (size_t i = 0; i < MAX_COMMAND_STEPS; i++) {
+            op_us[op] += definition->commands[i].count *
+                         command_us(definition->commands[i].command);
+        }
+        op_measured[op] = false;
+    }
+    model_initialized = true;
+}
+
+void atecc608a_cost_model_calibrate(atecc608a_cost_op_t op, uint32_t us)
+{
+    if (!model_initialized) {
+        atecc608a_cost_model_reset();
+    }
+    if (op < ATECC608A_COST_OP_COUNT) {
+        op_us[op] = us;
+        op_measured[op] = true;
+    }
+}
+
+uint32_t atecc608a_cost_model_op_us(atecc608a_cost_op_t op)
+{
+    if (!model_initialized) {
+        atecc608a_cost_model_reset();
+    }
+    return op < ATECC608A_COST_OP_COUNT ? op_us[op] : 0;
+}
+
+uint64_t atecc608a_cost_model_estimate_us(const atecc608a_cost_step_t *steps,
+                                          size_t step_count)
+{
+    uint64_t total = 0;
+
+    for (size_t i = 0; i < step_count; i++) {
+        total += steps[i].count * atecc608a_cost_model_op_us(steps[i].op);
+    }
+    return total;
+}
+
+void atecc608a_cost_model_print(void)
+{
+    printf("--- Operation cost model (I2C %lu Hz) ---\n",
+           (unsigned long) ATECC608A_COST_MODEL_I2C_HZ);
+    for (size_t op = 0; op < ATECC608A_COST_OP_COUNT; op++) {
+        uint32_t us = atecc608a_cost_model_op_us((atecc608a_cost_op_t) op);
+
+        printf("  - %-17s %6lu us (%s)\n", op_definitions[op].name,
+               (unsigned long) us, op_measured[op] ? "measured" : "datasheet");
+    }
+    printf("-----------------------------------------\n");
+}
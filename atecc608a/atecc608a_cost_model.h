@@ -0,0 +1,109 @@
+/**
+ * \file atecc608a_cost_model.h
+ * \brief Latency model of ATECC508A and ATECC608A operations.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_COST_MODEL_H
+#define ATECC608A_COST_MODEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** I2C clock assumed by the datasheet-based estimates. */
+#ifndef ATECC608A_COST_MODEL_I2C_HZ
+#define ATECC608A_COST_MODEL_I2C_HZ 100000
+#endif
+
+/** Time the device needs after the wake pulse (tWHI), in microseconds. */
+#ifndef ATECC608A_COST_MODEL_WAKE_DELAY_US
+#define ATECC608A_COST_MODEL_WAKE_DELAY_US 1500
+#endif
+
+/** Driver and utility level operations, each a fixed sequence of device
+ *  commands. */
+typedef enum {
+    /** p_sign: Random, Nonce (pass-through), Sign. */
+    ATECC608A_COST_SIGN,
+    /** p_verify with a stored key: Nonce, Verify. */
+    ATECC608A_COST_VERIFY,
+    /** p_generate: GenKey (private). */
+    ATECC608A_COST_GENERATE,
+    /** p_export: GenKey (public). */
+    ATECC608A_COST_EXPORT,
+    /** p_import: a 72 byte public key, two block and two word writes. */
+    ATECC608A_COST_IMPORT,
+    /** atecc608a_generate_mirrored: GenKey (private) and a 72 byte write. */
+    ATECC608A_COST_GENERATE_MIRRORED,
+    /** atecc608a_export_mirrored: a 72 byte read, two block and two word
+     *  reads. */
+    ATECC608A_COST_EXPORT_MIRRORED,
+    ATECC608A_COST_RANDOM,
+    /** SHA-256 of less than 64 bytes: SHA start and end. */
+    ATECC608A_COST_SHA_SHORT,
+    /** SHA-256 of 64 bytes: SHA start, update and end. */
+    ATECC608A_COST_SHA_64,
+    /** One 4 byte read, e.g. a lock status check. */
+    ATECC608A_COST_READ_WORD,
+    /** One 32 byte read, e.g. a data block or the serial number. */
+    ATECC608A_COST_READ_BLOCK,
+    /** One 32 byte write. */
+    ATECC608A_COST_WRITE_BLOCK,
+    /** One 4 byte write, e.g. the event log tail pointer. */
+    ATECC608A_COST_WRITE_WORD,
+    /** Whole config zone read: four block reads. */
+    ATECC608A_COST_READ_CONFIG,
+    /** Config zone write: four word writes, three block writes and two
+     *  UpdateExtra commands. */
+    ATECC608A_COST_WRITE_CONFIG,
+    ATECC608A_COST_LOCK,
+    /** atecc608a_csr_generate: an export, a serial number read and a sign. */
+    ATECC608A_COST_CSR,
+    /** atecc608a_ecdh_hmac: ECDH into TempKey, then an HMAC keyed with it
+     *  over a message shorter than a block. */
+    ATECC608A_COST_ECDH_HMAC,
+    ATECC608A_COST_OP_COUNT,
+} atecc608a_cost_op_t;
+
+/** `count` repetitions of an operation. */
+typedef struct {
+    atecc608a_cost_op_t op;
+    uint16_t count;
+} atecc608a_cost_step_t;
+
+const char *atecc608a_cost_model_op_name(atecc608a_cost_op_t op);
+
+/** Set every operation back to its datasheet-based estimate. This is done
+ *  automatically on first use. */
+void atecc608a_cost_model_reset(void);
+
+/** Replace the estimate for `op` with a measured duration. */
+void atecc608a_cost_model_calibrate(atecc608a_cost_op_t op, uint32_t us);
+
+/** Predicted duration of one `op`, in microseconds. */
+uint32_t atecc608a_cost_model_op_us(atecc608a_cost_op_t op);
+
+/** Predicted duration of a sequence of steps, in microseconds. */
+uint64_t atecc608a_cost_model_estimate_us(const atecc608a_cost_step_t *steps,
+                                          size_t step_count);
+
+/** Print the per-operation estimates and where they come from. */
+void atecc608a_cost_model_print(void);
+
+#endif /* ATECC608A_COST_MODEL_H */
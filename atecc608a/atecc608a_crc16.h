@@ -0,0 +1,38 @@
+/**
+ * \file atecc608a_crc16.h
+ * \brief Table-driven CRC-16 used by the ATECC508A and ATECC608A.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_CRC16_H
+#define ATECC608A_CRC16_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Compute the CRC-16 of `data` the way the device does (polynomial 0x8005,
+ *  initial value 0, data bits fed least significant bit first).
+ *
+ *  This is a drop-in replacement for cryptoauthlib's bit-by-bit atCRC(): the
+ *  arguments are the same and the result is written to `crc_le` in little
+ *  endian order. Eight bytes are processed per iteration, using 4 KiB of
+ *  constant tables. */
+void atecc608a_crc16(size_t length, const uint8_t *data, uint8_t *crc_le);
+
+#endif /* ATECC608A_CRC16_H */
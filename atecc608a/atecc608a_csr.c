@@ -0,0 +1,182 @@
+/**
+ * \file atecc608a_csr.c
+ * \brief PKCS#10 certificate signing requests from a DER template.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include "atecc608a_csr.h"
+
+#include <string.h>
+
+#include "atecc608a_se.h"
+#include "atecc608a_utils.h"
+
+#define SERIAL_SIZE 9
+#define COORDINATE_SIZE 32
+#define PUBKEY_SIZE (1 + 2 * COORDINATE_SIZE)
+
+/* Everything up to the signature value. All lengths but the outer one at
+ * offset 2 are fixed, as the subject and the key have a fixed size. */
+#define OUTER_LENGTH_OFFSET 2
+#define SERIAL_OFFSET 42
+#define SIGNATURE_OFFSET 165
+
+static const uint8_t csr_template[SIGNATURE_OFFSET] = {
+    /* CertificationRequest, length patched */
+    0x30, 0x81, 0x00,
+    /* CertificationRequestInfo */
+    0x30, 0x81, 0x93,
+    /* version 0 */
+    0x02, 0x01, 0x00,
+    /* subject: CN=ATECC608A, serialNumber=<18 hex digits> */
+    0x30, 0x31,
+    0x31, 0x12, 0x30, 0x10, 0x06, 0x03, 0x55, 0x04, 0x03,
+    0x0C, 0x09, 'A', 'T', 'E', 'C', 'C', '6', '0', '8', 'A',
+    0x31, 0x1B, 0x30, 0x19, 0x06, 0x03, 0x55, 0x04, 0x05,
+    0x13, 0x12,
+    '0', '0', '0', '0', '0', '0', '0', '0', '0',
+    '0', '0', '0', '0', '0', '0', '0', '0', '0',
+    /* subjectPKInfo: id-ecPublicKey, prime256v1 */
+    0x30, 0x59,
+    0x30, 0x13,
+    0x06, 0x07, 0x2A, 0x86, 0x48, 0xCE, 0x3D, 0x02, 0x01,
+    0x06, 0x08, 0x2A, 0x86, 0x48, 0xCE, 0x3D, 0x03, 0x01, 0x07,
+    0x03, 0x42, 0x00,
+    /* uncompressed point: 0x04, X, Y */
+    0x04,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    /* no attributes */
+    0xA0, 0x00,
+    /* signatureAlgorithm: ecdsa-with-SHA256 */
+    0x30, 0x0A, 0x06, 0x08, 0x2A, 0x86, 0x48, 0xCE, 0x3D, 0x04, 0x03, 0x02,
+};
+
+/* Buffers used while a CSR is made, in one place so that their size can be
+ * reported. */
+typedef struct {
+    uint8_t serial[SERIAL_SIZE];
+    uint8_t hash[PSA_HASH_SIZE(PSA_ALG_SHA_256)];
+    uint8_t signature[2 * COORDINATE_SIZE];
+    psa_hash_operation_t hash_operation;
+} csr_work_t;
+
+size_t atecc608a_csr_work_size(void)
+{
+    return sizeof(csr_work_t);
+}
+
+/* Write a 32 byte big-endian unsigned value as a DER INTEGER: without
+ * leading zeros, but with a zero before a set top bit. */
+static size_t write_integer(uint8_t *to, const uint8_t *value)
+{
+    size_t skip = 0;
+    size_t length;
+    size_t pad;
+
+    while (skip < COORDINATE_SIZE - 1 && value[skip] == 0) {
+        skip++;
+    }
+    pad = (value[skip] & 0x80) ? 1 : 0;
+    length = COORDINATE_SIZE - skip + pad;
+
+    to[0] = 0x02;
+    to[1] = (uint8_t) length;
+    to[2] = 0x00;
+    memcpy(to + 2 + pad, value + skip, COORDINATE_SIZE - skip);
+    return 2 + length;
+}
+
+/* Write the signature as a BIT STRING holding SEQUENCE { r, s }. */
+static size_t write_signature(uint8_t *to, const uint8_t *signature)
+{
+    size_t length = 5;
+
+    to[0] = 0x03;
+    to[2] = 0x00;
+    to[3] = 0x30;
+    length += write_integer(to + length, signature);
+    length += write_integer(to + length, signature + COORDINATE_SIZE);
+    to[4] = (uint8_t)(length - 5);
+    to[1] = (uint8_t)(length - 2);
+    return length;
+}
+
+static void write_hex(uint8_t *to, const uint8_t *data, size_t size)
+{
+    static const char digits[] = "0123456789ABCDEF";
+
+    for (size_t i = 0; i < size; i++) {
+        to[2 * i] = digits[data[i] >> 4];
+        to[2 * i + 1] = digits[data[i] & 0x0F];
+    }
+}
+
+psa_status_t atecc608a_csr_generate(psa_key_slot_number_t slot,
+                                    uint8_t *csr, size_t csr_size,
+                                    size_t *csr_length)
+{
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+    csr_work_t work = { .hash_operation = PSA_HASH_OPERATION_INIT };
+    size_t length;
+    size_t total;
+
+    if (csr_size < ATECC608A_CSR_MAX_SIZE) {
+        return PSA_ERROR_BUFFER_TOO_SMALL;
+    }
+
+    memcpy(csr, csr_template, sizeof(csr_template));
+
+    /* The public key is exported straight into place. */
+    ASSERT_SUCCESS_PSA(atecc608a_driver()->p_key_management->p_export(
+                           slot, csr + ATECC608A_CSR_PUBKEY_OFFSET, PUBKEY_SIZE,
+                           &length));
+    ASSERT_STATUS(length, PUBKEY_SIZE, PSA_ERROR_HARDWARE_FAILURE);
+
+    ASSERT_SUCCESS_PSA(atecc608a_get_serial_number(work.serial,
+                                                   sizeof(work.serial),
+                                                   &length));
+    write_hex(csr + SERIAL_OFFSET, work.serial, sizeof(work.serial));
+
+    /* Hash the signed part in place, no copy of it is needed. */
+    ASSERT_SUCCESS_PSA(psa_hash_setup(&work.hash_operation, PSA_ALG_SHA_256));
+    ASSERT_SUCCESS_PSA(psa_hash_update(&work.hash_operation,
+                                       csr + ATECC608A_CSR_TBS_OFFSET,
+                                       ATECC608A_CSR_TBS_SIZE));
+    ASSERT_SUCCESS_PSA(psa_hash_finish(&work.hash_operation, work.hash,
+                                       sizeof(work.hash), &length));
+
+    ASSERT_SUCCESS_PSA(atecc608a_driver()->p_asym->p_sign(
+                           slot, PSA_ALG_ECDSA(PSA_ALG_SHA_256), work.hash,
+                           sizeof(work.hash), work.signature,
+                           sizeof(work.signature), &length));
+    ASSERT_STATUS(length, sizeof(work.signature), PSA_ERROR_HARDWARE_FAILURE);
+
+    total = SIGNATURE_OFFSET + write_signature(csr + SIGNATURE_OFFSET,
+                                               work.signature);
+    csr[OUTER_LENGTH_OFFSET] = (uint8_t)(total - 3);
+    *csr_length = total;
+
+exit:
+    if (status != PSA_SUCCESS) {
+        psa_hash_abort(&work.hash_operation);
+    }
+    return status;
+}
@@ -0,0 +1,58 @@
+/**
+ * \file atecc608a_csr.h
+ * \brief PKCS#10 certificate signing requests from a DER template.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_CSR_H
+#define ATECC608A_CSR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "psa/crypto.h"
+
+/** Largest CSR, with both signature integers at their longest. */
+#define ATECC608A_CSR_MAX_SIZE 240
+
+/** Common name of the subject. Its length is fixed by the template. */
+#define ATECC608A_CSR_COMMON_NAME "ATECC608A"
+
+/** Build a CSR for the P-256 key in `slot`, with the subject
+ *  CN=ATECC608A_CSR_COMMON_NAME, serialNumber=<device serial in hex>, signed
+ *  by the key with ECDSA-SHA256. Only the public key, the serial number and
+ *  the signature are computed, the rest is copied from a template. No heap
+ *  is used: see atecc608a_csr_work_size() for the stack needed besides
+ *  `csr`. */
+psa_status_t atecc608a_csr_generate(psa_key_slot_number_t slot,
+                                    uint8_t *csr, size_t csr_size,
+                                    size_t *csr_length);
+
+/** Bytes of working buffers atecc608a_csr_generate() keeps on the stack. */
+size_t atecc608a_csr_work_size(void);
+
+/** Offset and length of the signed part of a CSR made by
+ *  atecc608a_csr_generate(), for verifying it. */
+#define ATECC608A_CSR_TBS_OFFSET 3
+#define ATECC608A_CSR_TBS_SIZE 150
+
+/** Offset of the public key, in the export format, in a CSR. */
+#define ATECC608A_CSR_PUBKEY_OFFSET 86
+
+#endif /* ATECC608A_CSR_H */
@@ -0,0 +1,324 @@
+/**
+ * \file atecc608a_device_commands.c
+ * \brief Console commands that read, configure and lock the device.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include "atecc608a_device_commands.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "atecc608a_csr.h"
+#include "atecc608a_stats.h"
+#include "atecc608a_utils.h"
+#include "atecc608a_verify_cache.h"
+#include "atca_helpers.h"
+
+#define WARNING_CONFIG \
+    "\n\nWarning! Locking a configuration zone is irreversible.\n"\
+    "Please make sure that a desired configuration is used in the process.\n"\
+    "Are you sure you want to proceed? [y/n]: "
+
+#define WARNING_DATA \
+    "\n\nWarning! Locking the data/OTP zone is irreversible.\n"\
+    "Please note that locking the data/OTP zone does not mean that\n"\
+    "the values in these zones cannot be modified; locking indicates that\n"\
+    "the slot now behaves according to the policies set by the associated\n"\
+    "configuration zone’s values. [y/n]: "
+
+static psa_status_t atecc608a_print_locked_zones()
+{
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+    bool locked;
+    printf("--- Device locks information ---\n");
+    atecc608a_device_lock();
+    ASSERT_SUCCESS_PSA(atecc608a_init());
+    ASSERT_SUCCESS(atcab_is_locked(LOCK_ZONE_CONFIG, &locked));
+    printf("  - Config locked: %d\n", locked);
+    ASSERT_SUCCESS(atcab_is_locked(LOCK_ZONE_DATA, &locked));
+    printf("  - Data locked: %d\n", locked);
+    for (uint8_t i = 0; i < 16; i++) {
+        ASSERT_SUCCESS(atcab_is_slot_locked(i, &locked));
+        printf("  - Slot %d locked: %d\n", i, locked);
+    }
+    printf("--------------------------------\n");
+
+exit:
+    atecc608a_deinit();
+    atecc608a_device_unlock();
+    return status;
+}
+
+static psa_status_t atecc608a_print_serial_number()
+{
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+    uint8_t serial[ATCA_SERIAL_NUM_SIZE];
+    size_t buffer_length;
+
+    ASSERT_SUCCESS_PSA(atecc608a_get_serial_number(serial,
+                                                   ATCA_SERIAL_NUM_SIZE,
+                                                   &buffer_length));
+    printf("Serial Number:\n");
+    atcab_printbin_sp(serial, buffer_length);
+    printf("\n");
+exit:
+    return status;
+}
+
+static psa_status_t atecc608a_print_config_zone()
+{
+    uint8_t config_buffer[ATCA_ECC_CONFIG_SIZE] = {0};
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+    atecc608a_device_lock();
+    ASSERT_SUCCESS_PSA(atecc608a_init());
+    ASSERT_SUCCESS(atcab_read_config_zone(config_buffer));
+    atcab_printbin_label("Config zone: ", config_buffer, ATCA_ECC_CONFIG_SIZE);
+exit:
+    atecc608a_deinit();
+    atecc608a_device_unlock();
+    return status;
+}
+
+/* Read a DER INTEGER of at most 32 bytes into a 32 byte big-endian value. */
+static const uint8_t *parse_csr_integer(const uint8_t *from, uint8_t *value)
+{
+    size_t length = from[1];
+    const uint8_t *data = from + 2;
+
+    if (length == 33) {
+        data++;
+        length--;
+    }
+    memset(value, 0, 32 - length);
+    memcpy(value + 32 - length, data, length);
+    return from + 2 + from[1];
+}
+
+/* Test that a CSR holds the key of the private key slot, and that its
+ * signature verifies with that key over the signed part of the CSR. */
+static psa_status_t test_csr()
+{
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+    static uint8_t csr[ATECC608A_CSR_MAX_SIZE];
+    static uint8_t pubkey[pubkey_size];
+    uint8_t hash[hash_size];
+    uint8_t signature[sig_size];
+    size_t csr_len = 0;
+    size_t pubkey_len = 0;
+    size_t hash_len = 0;
+    const uint8_t *integer;
+    psa_hash_operation_t operation = PSA_HASH_OPERATION_INIT;
+    psa_key_handle_t verify_handle = 0;
+    psa_key_policy_t policy = PSA_KEY_POLICY_INIT;
+
+    ASSERT_SUCCESS_PSA(atecc608a_csr_generate(atecc608a_private_key_slot, csr,
+                                              sizeof(csr), &csr_len));
+    ASSERT_STATUS(csr[2], csr_len - 3, PSA_ERROR_GENERIC_ERROR);
+
+    ASSERT_SUCCESS_PSA(atecc608a_driver()->p_key_management->p_export(
+                           atecc608a_private_key_slot, pubkey, sizeof(pubkey),
+                           &pubkey_len));
+    ASSERT_STATUS(memcmp(csr + ATECC608A_CSR_PUBKEY_OFFSET, pubkey, pubkey_len),
+                  0, PSA_ERROR_GENERIC_ERROR);
+
+    /* BIT STRING, unused bits, SEQUENCE, then r and s. */
+    integer = csr + ATECC608A_CSR_TBS_OFFSET + ATECC608A_CSR_TBS_SIZE + 12 + 5;
+    integer = parse_csr_integer(integer, signature);
+    parse_csr_integer(integer, signature + 32);
+
+    ASSERT_SUCCESS_PSA(psa_hash_setup(&operation, hash_alg));
+    ASSERT_SUCCESS_PSA(psa_hash_update(&operation,
+                                       csr + ATECC608A_CSR_TBS_OFFSET,
+                                       ATECC608A_CSR_TBS_SIZE));
+    ASSERT_SUCCESS_PSA(psa_hash_finish(&operation, hash, sizeof(hash),
+                                       &hash_len));
+
+    ASSERT_SUCCESS_PSA(psa_allocate_key(&verify_handle));
+    psa_key_policy_set_usage(&policy, PSA_KEY_USAGE_VERIFY, alg);
+    ASSERT_SUCCESS_PSA(psa_set_key_policy(verify_handle, &policy));
+    ASSERT_SUCCESS_PSA(psa_import_key(verify_handle, key_type, pubkey,
+                                      pubkey_len));
+    ASSERT_SUCCESS_PSA(psa_asymmetric_verify(verify_handle, alg, hash,
+                                             sizeof(hash), signature,
+                                             sizeof(signature)));
+
+    TEST_PASSED("test_csr");
+exit:
+    if (verify_handle != 0) {
+        psa_close_key(verify_handle);
+    }
+    return status;
+}
+
+static const atecc608a_cost_step_t cost_csr[] = {
+    { ATECC608A_COST_CSR, 1 }, { ATECC608A_COST_EXPORT, 1 },
+};
+
+const test_step_t test_step_csr = {
+    "test_csr", test_csr, COST_STEPS(cost_csr) FIXTURE(LOCKED)
+};
+
+/* Generate a CSR for `slot` and print it as PEM, with what it cost. */
+static void print_csr(uint16_t slot)
+{
+    static uint8_t csr[ATECC608A_CSR_MAX_SIZE];
+    /* Base64 of the CSR with a line break every 64 characters. */
+    static char pem[ATECC608A_CSR_MAX_SIZE * 4 / 3 + 16];
+    size_t csr_len = 0;
+    size_t pem_len = sizeof(pem);
+    uint64_t start;
+    uint32_t us;
+    psa_status_t status;
+
+    start = atecc608a_time_us();
+    status = atecc608a_csr_generate(slot, csr, sizeof(csr), &csr_len);
+    us = (uint32_t)(atecc608a_time_us() - start);
+    if (status != PSA_SUCCESS) {
+        printf("Failed to generate a CSR. Error %ld.\n", (long) status);
+        return;
+    }
+    if (atcab_base64encode(csr, csr_len, pem, &pem_len) != ATCA_SUCCESS) {
+        printf("Failed to encode the CSR.\n");
+        return;
+    }
+    printf("-----BEGIN CERTIFICATE REQUEST-----\n%s\n"
+           "-----END CERTIFICATE REQUEST-----\n", pem);
+    printf("CSR of %lu bytes in %lu.%01lu ms, RAM: %lu bytes of output and "
+           "%lu bytes of working buffers, no heap.\n",
+           (unsigned long) csr_len, (unsigned long)(us / 1000),
+           (unsigned long)(us % 1000 / 100),
+           (unsigned long) ATECC608A_CSR_MAX_SIZE,
+           (unsigned long) atecc608a_csr_work_size());
+}
+
+void print_device_info()
+{
+    atecc608a_print_serial_number();
+    atecc608a_print_config_zone();
+    atecc608a_print_locked_zones();
+    printf("\nPrivate key slot in use: %lu, public: %lu\n",
+           (unsigned long) atecc608a_private_key_slot,
+           (unsigned long) atecc608a_public_key_slot);
+}
+
+static void write_lock_config_confirmed()
+{
+    psa_status_t status;
+
+    printf("Writing configuration and locking the config zone... ");
+    status = atecc608a_write_lock_config(template_config_508a_dev,
+                                         sizeof(template_config_508a_dev));
+    if (status != PSA_SUCCESS) {
+        printf("Failed! Error %ld.\n", (long) status);
+        return;
+    }
+    printf("Done.\n");
+}
+
+static void lock_data_confirmed()
+{
+    psa_status_t status;
+
+    printf("Locking the data/OTP zone... ");
+    status = atecc608a_lock_data_zone();
+    if (status != PSA_SUCCESS) {
+        printf("Failed! Error %ld.\n", (long) status);
+        return;
+    }
+    printf("Done.\n");
+}
+
+static bool run_device_command(char *command, char *arg)
+{
+    if (strcmp(command, "info") == 0) {
+        print_device_info();
+    } else if (strncmp(command, "csr", strlen("csr")) == 0) {
+        uint16_t slot = arg != NULL ? (uint16_t) atoi(arg + 1) : 0;
+
+        if (slot > 15) {
+            printf("Invalid slot %u provided for csr command.\n", slot);
+            return true;
+        }
+        print_csr(slot);
+    } else if (strcmp(command, "verify_cache") == 0) {
+        atecc608a_verify_cache_print();
+    } else if (strcmp(command, "write_lock_config") == 0) {
+        prompt_confirmation(WARNING_CONFIG, write_lock_config_confirmed);
+    } else if (strcmp(command, "lock_data") == 0) {
+        prompt_confirmation(WARNING_DATA, lock_data_confirmed);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool estimate_device_command(const char *command, const char *arg,
+                                    uint64_t *estimate_us)
+{
+    static const atecc608a_cost_step_t cost_info[] = {
+        { ATECC608A_COST_READ_BLOCK, 1 }, { ATECC608A_COST_READ_CONFIG, 1 },
+        { ATECC608A_COST_READ_WORD, 18 },
+    };
+    static const atecc608a_cost_step_t cost_write_lock_config[] = {
+        { ATECC608A_COST_READ_WORD, 5 }, { ATECC608A_COST_WRITE_CONFIG, 1 },
+        { ATECC608A_COST_LOCK, 1 },
+    };
+    static const atecc608a_cost_step_t cost_csr_command[] = {
+        { ATECC608A_COST_CSR, 1 },
+    };
+    static const atecc608a_cost_step_t cost_lock_data[] = {
+        { ATECC608A_COST_READ_WORD, 1 }, { ATECC608A_COST_LOCK, 1 },
+    };
+    uint64_t us = 0;
+
+    (void) arg;
+    if (strcmp(command, "info") == 0) {
+        printf("[dry run] %s\n", command);
+        us = print_estimate("info", COST_STEPS(cost_info), 1);
+    } else if (strcmp(command, "write_lock_config") == 0) {
+        printf("[dry run] %s\n", command);
+        us = print_estimate("write_lock_config",
+                            COST_STEPS(cost_write_lock_config), 1);
+    } else if (strncmp(command, "csr", strlen("csr")) == 0) {
+        printf("[dry run] %s\n", command);
+        us = print_estimate("csr", COST_STEPS(cost_csr_command), 1);
+    } else if (strcmp(command, "lock_data") == 0) {
+        printf("[dry run] %s\n", command);
+        us = print_estimate("lock_data", COST_STEPS(cost_lock_data), 1);
+    } else {
+        return false;
+    }
+    *estimate_us = us;
+    return true;
+}
+
+static const char *const device_host_commands[] = {
+    "verify_cache", NULL,
+};
+
+const command_module_t device_commands = {
+    " - info - print configuration information;\n"
+    " - csr[=%d] - print a certificate signing request for the key in a\n"
+    "             given slot (0-15), default slot - 0;\n"
+    " - verify_cache - print the PSA verification keys kept imported;\n"
+    " - write_lock_config - write a hardcoded configuration to the device,\n"
+    "                       lock it;\n"
+    " - lock_data - lock the data zone;\n",
+    device_host_commands, run_device_command, estimate_device_command,
+};
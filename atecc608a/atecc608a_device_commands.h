@@ -0,0 +1,39 @@
+/**
+ * \file atecc608a_device_commands.h
+ * \brief Console commands that read, configure and lock the device.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_DEVICE_COMMANDS_H
+#define ATECC608A_DEVICE_COMMANDS_H
+
+#include "atecc608a_app.h"
+
+/** info, csr, verify_cache, write_lock_config and lock_data. */
+extern const command_module_t device_commands;
+
+/** Test that a CSR holds the key of the private key slot, and that its
+ *  signature verifies with that key. */
+extern const test_step_t test_step_csr;
+
+/** Print the serial number, the config zone, the zone and slot locks and
+ *  the key slots of the tests. */
+void print_device_info(void);
+
+#endif /* ATECC608A_DEVICE_COMMANDS_H */
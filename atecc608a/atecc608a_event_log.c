@@ -0,0 +1,661 @@
+/**
+ * \file atecc608a_event_log.c
+ * \brief Append-only, hash-chained log of security events kept in a data
+ *        slot of the device.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include "atecc608a_event_log.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "atecc608a_stats.h"
+#include "atecc608a_utils.h"
+#include "atecc608a_verify_cache.h"
+#include "psa/internal_trusted_storage.h"
+
+/* Log layout, all fields little-endian:
+ *   block 0: tail pointer - the sequence number of the first record of the
+ *            block holding the last record (4), unused (28)
+ *   blocks 1-7: two records each
+ *   record: sequence number (4), type (1), slot (1), detail (2), link (8)
+ * Record n (from 1) always lives at position (n - 1) % 14, so the position
+ * of a record follows from its number. Its link is the first 8 bytes of the
+ * SHA-256 of the link of record n - 1 (zeros for record 1) and of its first
+ * 8 bytes. Unused records are all ones. */
+#define BLOCK_SIZE 32
+#define RECORDS_PER_BLOCK (BLOCK_SIZE / ATECC608A_EVENT_LOG_RECORD_SIZE)
+#define LINK_OFFSET 8
+#define LINK_SIZE 8
+#define TAIL_SIZE 4
+
+/* Last signed head, in trusted storage: sequence number (4), link (8),
+ * signing slot (2), signature (64). The signed hash is the SHA-256 of
+ * CHECKPOINT_MAGIC, the sequence number and the link. */
+#define CHECKPOINT_MAGIC "ELOG"
+#define SIGNATURE_SIZE 64
+#define CHECKPOINT_SIZE (4 + LINK_SIZE + 2 + SIGNATURE_SIZE)
+
+typedef struct {
+    uint32_t seq;
+    uint8_t link[LINK_SIZE];
+    uint16_t sign_slot;
+    uint8_t signature[SIGNATURE_SIZE];
+} checkpoint_t;
+
+/* All state is guarded by the device lock, which appends from the driver
+ * wrappers already hold. */
+static bool log_open;
+/* Number and link of the last record, and the block that holds it. */
+static uint32_t log_seq;
+static uint8_t log_link[LINK_SIZE];
+static uint8_t current_block[BLOCK_SIZE];
+/* The tail pointer on the device lags behind, a write of it failed or it
+ * was not yet written after a block was filled before a reset. */
+static bool tail_stale;
+static checkpoint_t checkpoint;
+static atecc608a_event_log_stats_t stats;
+/* Nesting depth of atecc608a_event_log_suspend(). */
+static uint32_t suspended;
+
+static void put_u16(uint8_t *to, uint16_t value)
+{
+    to[0] = (uint8_t) value;
+    to[1] = (uint8_t)(value >> 8);
+}
+
+static uint16_t get_u16(const uint8_t *from)
+{
+    return (uint16_t)(from[0] | (from[1] << 8));
+}
+
+static void put_u32(uint8_t *to, uint32_t value)
+{
+    put_u16(to, (uint16_t) value);
+    put_u16(to + 2, (uint16_t)(value >> 16));
+}
+
+static uint32_t get_u32(const uint8_t *from)
+{
+    return get_u16(from) | ((uint32_t) get_u16(from + 2) << 16);
+}
+
+static uint32_t position_of(uint32_t seq)
+{
+    return (seq - 1) % ATECC608A_EVENT_LOG_RECORDS;
+}
+
+static bool starts_block(uint32_t seq)
+{
+    return position_of(seq) % RECORDS_PER_BLOCK == 0;
+}
+
+/* Offset of the block of a record from the start of the log. */
+static size_t block_of(uint32_t seq)
+{
+    return BLOCK_SIZE * (1 + position_of(seq) / RECORDS_PER_BLOCK);
+}
+
+static size_t record_in_block(uint32_t seq)
+{
+    return ATECC608A_EVENT_LOG_RECORD_SIZE *
+           (position_of(seq) % RECORDS_PER_BLOCK);
+}
+
+/* Record `seq` in a copy of the whole log, or NULL if it was overwritten. */
+static const uint8_t *find_record(const uint8_t *log, uint32_t seq)
+{
+    const uint8_t *record = log + block_of(seq) + record_in_block(seq);
+
+    return seq != 0 && get_u32(record) == seq ? record : NULL;
+}
+
+static psa_status_t sha256(const uint8_t *first, size_t first_length,
+                           const uint8_t *second, size_t second_length,
+                           const uint8_t *third, size_t third_length,
+                           uint8_t *digest)
+{
+    psa_status_t status;
+    psa_hash_operation_t operation = PSA_HASH_OPERATION_INIT;
+    size_t digest_length;
+
+    status = psa_hash_setup(&operation, PSA_ALG_SHA_256);
+    if (status == PSA_SUCCESS) {
+        status = psa_hash_update(&operation, first, first_length);
+    }
+    if (status == PSA_SUCCESS) {
+        status = psa_hash_update(&operation, second, second_length);
+    }
+    if (status == PSA_SUCCESS && third != NULL) {
+        status = psa_hash_update(&operation, third, third_length);
+    }
+    if (status == PSA_SUCCESS) {
+        status = psa_hash_finish(&operation, digest,
+                                 PSA_HASH_SIZE(PSA_ALG_SHA_256),
+                                 &digest_length);
+    }
+    if (status != PSA_SUCCESS) {
+        psa_hash_abort(&operation);
+    }
+    return status;
+}
+
+/* Link of `record` following a record with the link `previous`. */
+static psa_status_t chain(const uint8_t *previous, const uint8_t *record,
+                          uint8_t *link)
+{
+    uint8_t digest[PSA_HASH_SIZE(PSA_ALG_SHA_256)];
+    psa_status_t status = sha256(previous, LINK_SIZE, record, LINK_OFFSET,
+                                 NULL, 0, digest);
+
+    if (status == PSA_SUCCESS) {
+        memcpy(link, digest, LINK_SIZE);
+    }
+    return status;
+}
+
+static psa_status_t checkpoint_hash(const checkpoint_t *from, uint8_t *digest)
+{
+    uint8_t seq[4];
+
+    put_u32(seq, from->seq);
+    return sha256((const uint8_t *) CHECKPOINT_MAGIC, 4, seq, sizeof(seq),
+                  from->link, LINK_SIZE, digest);
+}
+
+static psa_status_t load_checkpoint(void)
+{
+    struct psa_storage_info_t info;
+    uint8_t data[CHECKPOINT_SIZE];
+    size_t length = 0;
+    psa_status_t status;
+
+    status = psa_its_get_info(ATECC608A_EVENT_LOG_CHECKPOINT_UID, &info);
+    if (status == PSA_SUCCESS) {
+        status = psa_its_get(ATECC608A_EVENT_LOG_CHECKPOINT_UID, 0,
+                             sizeof(data), data, &length);
+    }
+    if (status != PSA_SUCCESS) {
+        return status;
+    }
+    if (length != sizeof(data)) {
+        return PSA_ERROR_DOES_NOT_EXIST;
+    }
+    checkpoint.seq = get_u32(data);
+    memcpy(checkpoint.link, data + 4, LINK_SIZE);
+    checkpoint.sign_slot = get_u16(data + 4 + LINK_SIZE);
+    memcpy(checkpoint.signature, data + 6 + LINK_SIZE, SIGNATURE_SIZE);
+    return PSA_SUCCESS;
+}
+
+/* Sign the link of the last record with the key of the current checkpoint
+ * and make it the new checkpoint. */
+static psa_status_t sign_head(void)
+{
+    checkpoint_t next = checkpoint;
+    uint8_t digest[PSA_HASH_SIZE(PSA_ALG_SHA_256)];
+    uint8_t data[CHECKPOINT_SIZE];
+    size_t length;
+    uint64_t start = atecc608a_time_us();
+    psa_status_t status;
+
+    next.seq = log_seq;
+    memcpy(next.link, log_link, LINK_SIZE);
+    status = checkpoint_hash(&next, digest);
+    if (status == PSA_SUCCESS) {
+        status = atecc608a_driver()->p_asym->p_sign(
+                     next.sign_slot, PSA_ALG_ECDSA(PSA_ALG_SHA_256), digest,
+                     sizeof(digest), next.signature, sizeof(next.signature),
+                     &length);
+    }
+    if (status != PSA_SUCCESS) {
+        return status;
+    }
+
+    put_u32(data, next.seq);
+    memcpy(data + 4, next.link, LINK_SIZE);
+    put_u16(data + 4 + LINK_SIZE, next.sign_slot);
+    memcpy(data + 6 + LINK_SIZE, next.signature, SIGNATURE_SIZE);
+    status = psa_its_set(ATECC608A_EVENT_LOG_CHECKPOINT_UID, sizeof(data),
+                         data, PSA_STORAGE_FLAG_NONE);
+    if (status != PSA_SUCCESS) {
+        return status;
+    }
+    checkpoint = next;
+    stats.checkpoints++;
+    stats.checkpoint_us += atecc608a_time_us() - start;
+    return PSA_SUCCESS;
+}
+
+static psa_status_t write_tail(uint32_t first_seq)
+{
+    uint8_t tail[TAIL_SIZE];
+    psa_status_t status;
+
+    put_u32(tail, first_seq);
+    status = atecc608a_device_write(ATECC608A_EVENT_LOG_SLOT,
+                                    ATECC608A_EVENT_LOG_OFFSET, tail,
+                                    sizeof(tail));
+    if (status == PSA_SUCCESS) {
+        stats.words_written++;
+    }
+    tail_stale = status != PSA_SUCCESS;
+    return status;
+}
+
+psa_status_t atecc608a_event_log_format(psa_key_slot_number_t sign_slot)
+{
+    uint8_t log[ATECC608A_EVENT_LOG_SIZE];
+    uint8_t *record = log + block_of(1);
+    psa_status_t status;
+
+    memset(log, 0xFF, sizeof(log));
+    put_u32(log, 1);
+    put_u32(record, 1);
+    record[4] = ATECC608A_EVENT_FORMATTED;
+    record[5] = (uint8_t) sign_slot;
+    put_u16(record + 6, 0);
+
+    atecc608a_device_lock();
+    log_open = false;
+    memset(log_link, 0, sizeof(log_link));
+    status = chain(log_link, record, record + LINK_OFFSET);
+    if (status != PSA_SUCCESS) {
+        goto exit;
+    }
+    /* The records first, the tail pointer last. The old checkpoint does
+     * not match anything any more. */
+    psa_its_remove(ATECC608A_EVENT_LOG_CHECKPOINT_UID);
+    status = atecc608a_device_write(ATECC608A_EVENT_LOG_SLOT,
+                                    ATECC608A_EVENT_LOG_OFFSET + BLOCK_SIZE,
+                                    log + BLOCK_SIZE,
+                                    sizeof(log) - BLOCK_SIZE);
+    if (status == PSA_SUCCESS) {
+        status = atecc608a_device_write(ATECC608A_EVENT_LOG_SLOT,
+                                        ATECC608A_EVENT_LOG_OFFSET, log,
+                                        BLOCK_SIZE);
+    }
+    if (status != PSA_SUCCESS) {
+        goto exit;
+    }
+    stats.blocks_written += sizeof(log) / BLOCK_SIZE;
+
+    log_seq = 1;
+    memcpy(log_link, record + LINK_OFFSET, LINK_SIZE);
+    memcpy(current_block, log + block_of(1), BLOCK_SIZE);
+    tail_stale = false;
+    memset(&checkpoint, 0, sizeof(checkpoint));
+    checkpoint.sign_slot = (uint16_t) sign_slot;
+    status = sign_head();
+    log_open = status == PSA_SUCCESS;
+
+exit:
+    atecc608a_device_unlock();
+    return status;
+}
+
+psa_status_t atecc608a_event_log_open(void)
+{
+    uint8_t tail[TAIL_SIZE];
+    uint8_t block[BLOCK_SIZE];
+    uint8_t last_block[BLOCK_SIZE];
+    uint8_t link[LINK_SIZE];
+    uint32_t first_seq;
+    uint32_t seq;
+    uint32_t last = 0;
+    psa_status_t status;
+
+    atecc608a_device_lock();
+    log_open = false;
+    status = load_checkpoint();
+    if (status == PSA_SUCCESS) {
+        status = atecc608a_device_read(ATECC608A_EVENT_LOG_SLOT,
+                                       ATECC608A_EVENT_LOG_OFFSET, tail,
+                                       sizeof(tail));
+    }
+    if (status != PSA_SUCCESS) {
+        goto exit;
+    }
+    first_seq = get_u32(tail);
+    if (first_seq == 0 || first_seq == 0xFFFFFFFF || !starts_block(first_seq)) {
+        status = PSA_ERROR_DOES_NOT_EXIST;
+        goto exit;
+    }
+
+    /* Walk from the block the tail points to for as long as the records
+     * follow each other: the last block may have been written without the
+     * tail pointer. */
+    for (seq = first_seq; seq - first_seq < ATECC608A_EVENT_LOG_RECORDS;
+            seq++) {
+        const uint8_t *record;
+
+        if (starts_block(seq)) {
+            status = atecc608a_device_read(ATECC608A_EVENT_LOG_SLOT,
+                                           ATECC608A_EVENT_LOG_OFFSET +
+                                           block_of(seq), block,
+                                           sizeof(block));
+            if (status != PSA_SUCCESS) {
+                goto exit;
+            }
+        }
+        record = block + record_in_block(seq);
+        if (get_u32(record) != seq) {
+            break;
+        }
+        if (last != 0) {
+            status = chain(log_link, record, link);
+            if (status != PSA_SUCCESS) {
+                goto exit;
+            }
+            if (memcmp(link, record + LINK_OFFSET, LINK_SIZE) != 0) {
+                status = PSA_ERROR_INVALID_SIGNATURE;
+                goto exit;
+            }
+        }
+        if (seq == checkpoint.seq &&
+                memcmp(checkpoint.link, record + LINK_OFFSET, LINK_SIZE) != 0) {
+            status = PSA_ERROR_INVALID_SIGNATURE;
+            goto exit;
+        }
+        memcpy(log_link, record + LINK_OFFSET, LINK_SIZE);
+        memcpy(last_block, block, sizeof(block));
+        last = seq;
+    }
+    /* The tail points at a record that is not there, or the log was cut
+     * back to before its last signed record. */
+    if (last == 0 || last < checkpoint.seq ||
+            last - checkpoint.seq >
+            ATECC608A_EVENT_LOG_RECORDS - RECORDS_PER_BLOCK) {
+        status = PSA_ERROR_INVALID_SIGNATURE;
+        goto exit;
+    }
+
+    log_seq = last;
+    memcpy(current_block, last_block, sizeof(current_block));
+    tail_stale = block_of(last) != block_of(first_seq);
+    log_open = true;
+
+exit:
+    atecc608a_device_unlock();
+    return status;
+}
+
+bool atecc608a_event_log_is_open(void)
+{
+    return log_open;
+}
+
+int atecc608a_event_log_sign_slot(void)
+{
+    return log_open ? checkpoint.sign_slot : -1;
+}
+
+void atecc608a_event_log_suspend(void)
+{
+    atecc608a_device_lock();
+    suspended++;
+    atecc608a_device_unlock();
+}
+
+void atecc608a_event_log_resume(void)
+{
+    atecc608a_device_lock();
+    if (suspended != 0) {
+        suspended--;
+    }
+    atecc608a_device_unlock();
+}
+
+psa_status_t atecc608a_event_log_append(atecc608a_event_type_t type,
+                                        uint16_t slot, uint16_t detail)
+{
+    uint8_t block[BLOCK_SIZE];
+    uint8_t *record;
+    uint32_t seq;
+    psa_status_t status;
+
+    atecc608a_device_lock();
+    if (suspended != 0 && type != ATECC608A_EVENT_APPLICATION) {
+        status = PSA_SUCCESS;
+        goto exit;
+    }
+    if (!log_open) {
+        status = PSA_ERROR_BAD_STATE;
+        goto exit;
+    }
+    seq = log_seq + 1;
+    /* Starting a block erases the other record in it, the older one. */
+    if (seq - checkpoint.seq > ATECC608A_EVENT_LOG_RECORDS - RECORDS_PER_BLOCK) {
+        status = PSA_ERROR_INSUFFICIENT_STORAGE;
+        goto exit;
+    }
+
+    if (starts_block(seq)) {
+        memset(block, 0xFF, sizeof(block));
+    } else {
+        memcpy(block, current_block, sizeof(block));
+    }
+    record = block + record_in_block(seq);
+    put_u32(record, seq);
+    record[4] = (uint8_t) type;
+    record[5] = (uint8_t) slot;
+    put_u16(record + 6, detail);
+    status = chain(log_link, record, record + LINK_OFFSET);
+    if (status != PSA_SUCCESS) {
+        goto exit;
+    }
+    status = atecc608a_device_write(ATECC608A_EVENT_LOG_SLOT,
+                                    ATECC608A_EVENT_LOG_OFFSET + block_of(seq),
+                                    block, sizeof(block));
+    if (status != PSA_SUCCESS) {
+        goto exit;
+    }
+    stats.blocks_written++;
+    stats.appends++;
+    log_seq = seq;
+    memcpy(log_link, record + LINK_OFFSET, LINK_SIZE);
+    memcpy(current_block, block, sizeof(current_block));
+
+    /* The record is in place whether or not the tail pointer follows: the
+     * next open walks past a stale one, and the next append retries. */
+    if (starts_block(seq) || tail_stale) {
+        write_tail(seq - position_of(seq) % RECORDS_PER_BLOCK);
+    }
+
+    if (seq - checkpoint.seq >= ATECC608A_EVENT_LOG_SIGN_INTERVAL ||
+            (slot == checkpoint.sign_slot &&
+             (type == ATECC608A_EVENT_KEY_GENERATED ||
+              type == ATECC608A_EVENT_KEY_IMPORTED ||
+              type == ATECC608A_EVENT_KEY_DESTROYED))) {
+        status = sign_head();
+    }
+
+exit:
+    atecc608a_device_unlock();
+    return status;
+}
+
+psa_status_t atecc608a_event_log_checkpoint(void)
+{
+    psa_status_t status = PSA_ERROR_BAD_STATE;
+
+    atecc608a_device_lock();
+    if (log_open) {
+        status = sign_head();
+    }
+    atecc608a_device_unlock();
+    return status;
+}
+
+/* Copy the whole log and the state needed to check it. */
+static psa_status_t read_log(uint8_t *log, uint32_t *seq,
+                             checkpoint_t *signed_head)
+{
+    psa_status_t status = PSA_ERROR_BAD_STATE;
+
+    atecc608a_device_lock();
+    if (log_open) {
+        status = atecc608a_device_read(ATECC608A_EVENT_LOG_SLOT,
+                                       ATECC608A_EVENT_LOG_OFFSET, log,
+                                       ATECC608A_EVENT_LOG_SIZE);
+        *seq = log_seq;
+        *signed_head = checkpoint;
+    }
+    atecc608a_device_unlock();
+    return status;
+}
+
+static uint32_t oldest_record(const uint8_t *log, uint32_t seq)
+{
+    uint32_t oldest = seq;
+
+    while (oldest > 1 && seq - (oldest - 1) < ATECC608A_EVENT_LOG_RECORDS &&
+            find_record(log, oldest - 1) != NULL) {
+        oldest--;
+    }
+    return oldest;
+}
+
+psa_status_t atecc608a_event_log_verify(void)
+{
+    uint8_t log[ATECC608A_EVENT_LOG_SIZE];
+    uint8_t link[LINK_SIZE];
+    uint8_t digest[PSA_HASH_SIZE(PSA_ALG_SHA_256)];
+    checkpoint_t signed_head;
+    const uint8_t *record;
+    uint32_t seq;
+    uint32_t oldest;
+    uint32_t broken = 0;
+    psa_status_t status;
+    psa_status_t signature_status = PSA_ERROR_INVALID_SIGNATURE;
+
+    status = read_log(log, &seq, &signed_head);
+    if (status != PSA_SUCCESS) {
+        return status;
+    }
+    if (find_record(log, seq) == NULL) {
+        printf("Event log: record %lu is missing.\n", (unsigned long) seq);
+        return PSA_ERROR_INVALID_SIGNATURE;
+    }
+
+    oldest = oldest_record(log, seq);
+    for (uint32_t i = oldest + 1; i <= seq; i++) {
+        record = find_record(log, i);
+        status = chain(find_record(log, i - 1) + LINK_OFFSET, record, link);
+        if (status != PSA_SUCCESS) {
+            return status;
+        }
+        if (memcmp(link, record + LINK_OFFSET, LINK_SIZE) != 0 && broken == 0) {
+            broken = i;
+        }
+    }
+
+    /* Checked on the host, the signature is not secret. */
+    record = find_record(log, signed_head.seq);
+    if (record != NULL &&
+            memcmp(record + LINK_OFFSET, signed_head.link, LINK_SIZE) == 0) {
+        status = checkpoint_hash(&signed_head, digest);
+        if (status != PSA_SUCCESS) {
+            return status;
+        }
+        signature_status = atecc608a_verify_cache_verify(
+                               signed_head.sign_slot, digest, sizeof(digest),
+                               signed_head.signature, SIGNATURE_SIZE);
+    }
+
+    printf("Event log: records %lu to %lu, ", (unsigned long) oldest,
+           (unsigned long) seq);
+    if (broken != 0) {
+        printf("chain broken at record %lu, ", (unsigned long) broken);
+    } else {
+        printf("chain intact, ");
+    }
+    printf("head of record %lu signed by slot %u %s, %lu records not signed "
+           "yet.\n", (unsigned long) signed_head.seq, signed_head.sign_slot,
+           signature_status == PSA_SUCCESS ? "verified" : "NOT verified",
+           (unsigned long)(seq - signed_head.seq));
+
+    if (broken != 0 || signature_status != PSA_SUCCESS) {
+        return PSA_ERROR_INVALID_SIGNATURE;
+    }
+    return PSA_SUCCESS;
+}
+
+static const char *type_name(uint8_t type)
+{
+    switch (type) {
+        case ATECC608A_EVENT_FORMATTED:
+            return "formatted";
+        case ATECC608A_EVENT_KEY_GENERATED:
+            return "key generated";
+        case ATECC608A_EVENT_KEY_IMPORTED:
+            return "key imported";
+        case ATECC608A_EVENT_KEY_DESTROYED:
+            return "key destroyed";
+        case ATECC608A_EVENT_KEY_STATE:
+            return "key state";
+        case ATECC608A_EVENT_VERIFY_FAILED:
+            return "verify failed";
+        case ATECC608A_EVENT_APPLICATION:
+            return "application";
+        default:
+            return "?";
+    }
+}
+
+psa_status_t atecc608a_event_log_print(void)
+{
+    uint8_t log[ATECC608A_EVENT_LOG_SIZE];
+    checkpoint_t signed_head;
+    uint32_t seq;
+    psa_status_t status;
+
+    status = read_log(log, &seq, &signed_head);
+    if (status != PSA_SUCCESS) {
+        return status;
+    }
+    printf("--- Event log (slot %d, last signed record %lu) ---\n",
+           ATECC608A_EVENT_LOG_SLOT, (unsigned long) signed_head.seq);
+    printf("  record  event          slot  detail\n");
+    for (uint32_t i = oldest_record(log, seq); i <= seq; i++) {
+        const uint8_t *record = find_record(log, i);
+
+        if (record == NULL) {
+            continue;
+        }
+        printf("  %6lu  %-13s  %4u  %6u\n", (unsigned long) i,
+               type_name(record[4]), record[5], get_u16(record + 6));
+    }
+    printf("--------------------------------------\n");
+    return PSA_SUCCESS;
+}
+
+void atecc608a_event_log_get_stats(atecc608a_event_log_stats_t *out)
+{
+    atecc608a_device_lock();
+    *out = stats;
+    atecc608a_device_unlock();
+}
+
+void atecc608a_event_log_reset_stats(void)
+{
+    atecc608a_device_lock();
+    memset(&stats, 0, sizeof(stats));
+    atecc608a_device_unlock();
+}
@@ -0,0 +1,143 @@
+/**
+ * \file atecc608a_event_log.h
+ * \brief Append-only, hash-chained log of security events kept in a data
+ *        slot of the device.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_EVENT_LOG_H
+#define ATECC608A_EVENT_LOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "psa/crypto.h"
+#include "atecc608a_key_index.h"
+
+/** The log takes the rest of the key index slot: a block holding the tail
+ *  pointer, then seven blocks of two 16 byte records, used as a ring. */
+#define ATECC608A_EVENT_LOG_SLOT ATECC608A_KEY_INDEX_SLOT
+#define ATECC608A_EVENT_LOG_OFFSET \
+    (ATECC608A_KEY_INDEX_OFFSET + ATECC608A_KEY_INDEX_SIZE)
+#define ATECC608A_EVENT_LOG_SIZE 256
+#define ATECC608A_EVENT_LOG_RECORD_SIZE 16
+#define ATECC608A_EVENT_LOG_RECORDS 14
+
+/** The chain head is signed every that many appends. Must leave the last
+ *  signed record in the ring until the next signature: at most
+ *  ATECC608A_EVENT_LOG_RECORDS - 2. */
+#ifndef ATECC608A_EVENT_LOG_SIGN_INTERVAL
+#define ATECC608A_EVENT_LOG_SIGN_INTERVAL 8
+#endif
+
+/** Private key slot that signs the chain head unless another is given to
+ *  atecc608a_event_log_format(). The tests and benchmarks use the slot set
+ *  with `private_slot`, which cannot be this one while it signs the log. */
+#ifndef ATECC608A_EVENT_LOG_SIGN_SLOT
+#define ATECC608A_EVENT_LOG_SIGN_SLOT 6
+#endif
+
+/** PSA internal trusted storage UID of the last signed chain head. */
+#define ATECC608A_EVENT_LOG_CHECKPOINT_UID 0x45564C31
+
+typedef enum {
+    ATECC608A_EVENT_FORMATTED = 1,
+    /** Through atecc608a_driver(), detail: the number of key changes of the
+     *  slot so far. */
+    ATECC608A_EVENT_KEY_GENERATED,
+    ATECC608A_EVENT_KEY_IMPORTED,
+    ATECC608A_EVENT_KEY_DESTROYED,
+    /** A key index state change, detail: the new atecc608a_key_state_t. */
+    ATECC608A_EVENT_KEY_STATE,
+    /** A signature that did not verify, detail: 0 on the device, 1 on the
+     *  host through the verify key cache. */
+    ATECC608A_EVENT_VERIFY_FAILED,
+    /** Recorded by the application, detail is its own. */
+    ATECC608A_EVENT_APPLICATION,
+} atecc608a_event_type_t;
+
+typedef struct {
+    /** Records appended and 32 byte blocks and 4 byte words written since
+     *  the statistics were reset. */
+    uint32_t appends;
+    uint32_t blocks_written;
+    uint32_t words_written;
+    /** Chain heads signed, and the device time they took. */
+    uint32_t checkpoints;
+    uint64_t checkpoint_us;
+} atecc608a_event_log_stats_t;
+
+/** Start a new log whose chain head is signed with the private key in
+ *  `sign_slot`, and record ATECC608A_EVENT_FORMATTED in it. Events of the
+ *  previous log are lost. */
+psa_status_t atecc608a_event_log_format(psa_key_slot_number_t sign_slot);
+
+/** Find the end of the log on the device: one word read for the tail
+ *  pointer and one or two block reads. Fails with PSA_ERROR_DOES_NOT_EXIST
+ *  if no log was formatted, and with PSA_ERROR_INVALID_SIGNATURE if the
+ *  log ends before its last signed record, e.g. after blocks were written
+ *  back from an older copy. */
+psa_status_t atecc608a_event_log_open(void);
+
+bool atecc608a_event_log_is_open(void);
+
+/** Slot whose key signs the chain head of the open log, or -1 if no log is
+ *  open. */
+int atecc608a_event_log_sign_slot(void);
+
+/** Stop recording the events of the driver wrappers and the key index
+ *  while tests and benchmarks churn through keys, so that they neither
+ *  push real events out of the ring nor wear the slot. Records of
+ *  ATECC608A_EVENT_APPLICATION are still appended. Calls nest, each must be
+ *  matched by atecc608a_event_log_resume(). */
+void atecc608a_event_log_suspend(void);
+
+void atecc608a_event_log_resume(void);
+
+/** Append a record, rewriting only the block it goes into, and the tail
+ *  pointer word when the record starts a block. Every
+ *  ATECC608A_EVENT_LOG_SIGN_INTERVAL appends, and after a key change in the
+ *  signing slot, the chain head is also signed. An error from the signature
+ *  is returned, but the record stays appended.
+ *
+ *  The driver wrappers and the key index append their events themselves
+ *  while the log is open and not suspended, a suspended log drops them and
+ *  returns PSA_SUCCESS. Fails with PSA_ERROR_BAD_STATE if the log is not
+ *  open, and with PSA_ERROR_INSUFFICIENT_STORAGE if the record would push
+ *  the last signed one out of the ring. */
+psa_status_t atecc608a_event_log_append(atecc608a_event_type_t type,
+                                        uint16_t slot, uint16_t detail);
+
+/** Sign the chain head now. */
+psa_status_t atecc608a_event_log_checkpoint(void);
+
+/** Read the whole log back and check that every record in the ring but the
+ *  oldest chains to the one before it, and that the last signed head is
+ *  one of them with a valid signature. Prints the outcome. Fails with
+ *  PSA_ERROR_INVALID_SIGNATURE if either check fails. */
+psa_status_t atecc608a_event_log_verify(void);
+
+/** Print the records in the ring, oldest first. */
+psa_status_t atecc608a_event_log_print(void);
+
+void atecc608a_event_log_get_stats(atecc608a_event_log_stats_t *stats);
+
+void atecc608a_event_log_reset_stats(void);
+
+#endif /* ATECC608A_EVENT_LOG_H */
@@ -0,0 +1,255 @@
+/**
+ * \file atecc608a_event_log_commands.c
+ * \brief Console commands of the security event log.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include "atecc608a_event_log_commands.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "atecc608a_event_log.h"
+#include "atecc608a_stats.h"
+#include "atecc608a_utils.h"
+
+/* Test that an appended event survives reopening the event log, with one
+ * block write and at most a tail word write, and that the log verifies. A
+ * log signed with the key in ATECC608A_EVENT_LOG_SIGN_SLOT is formatted if
+ * there is none. */
+static psa_status_t test_event_log()
+{
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+    atecc608a_event_log_stats_t before;
+    atecc608a_event_log_stats_t after;
+
+    if (!atecc608a_event_log_is_open() &&
+            atecc608a_event_log_open() == PSA_ERROR_DOES_NOT_EXIST) {
+        ASSERT_SUCCESS_PSA(atecc608a_event_log_format(
+                               ATECC608A_EVENT_LOG_SIGN_SLOT));
+    }
+    ASSERT_STATUS(atecc608a_event_log_is_open(), true, PSA_ERROR_BAD_STATE);
+
+    atecc608a_event_log_get_stats(&before);
+    ASSERT_SUCCESS_PSA(atecc608a_event_log_append(ATECC608A_EVENT_APPLICATION,
+                                                  0, 0x7E57));
+    atecc608a_event_log_get_stats(&after);
+    ASSERT_STATUS(after.blocks_written - before.blocks_written, 1,
+                  PSA_ERROR_GENERIC_ERROR);
+    ASSERT_STATUS(after.words_written - before.words_written <= 1, true,
+                  PSA_ERROR_GENERIC_ERROR);
+
+    ASSERT_SUCCESS_PSA(atecc608a_event_log_open());
+    ASSERT_SUCCESS_PSA(atecc608a_event_log_verify());
+    TEST_PASSED("test_event_log");
+exit:
+    return status;
+}
+
+static const atecc608a_cost_step_t cost_event_log[] = {
+    { ATECC608A_COST_WRITE_BLOCK, 1 }, { ATECC608A_COST_READ_WORD, 1 },
+    { ATECC608A_COST_READ_BLOCK, 10 }, { ATECC608A_COST_EXPORT, 1 },
+};
+
+const test_step_t test_step_event_log = {
+    "test_event_log", test_event_log, COST_STEPS(cost_event_log)
+    FIXTURE(LOCKED) PERSISTENT
+};
+
+/* Appends per second and bytes written per event for `count` application
+ * events, against rewriting the whole slot for every event. */
+static psa_status_t event_log_rate(uint32_t count)
+{
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+    atecc608a_event_log_stats_t stats;
+    atecc608a_cost_step_t rewrite = { ATECC608A_COST_WRITE_BLOCK, 13 };
+    uint64_t start;
+    uint64_t us;
+    uint64_t bytes;
+
+    if (!atecc608a_event_log_is_open()) {
+        printf("Please open or format the event log first.\n");
+        return PSA_ERROR_BAD_STATE;
+    }
+    if (count == 0) {
+        return PSA_ERROR_INVALID_ARGUMENT;
+    }
+
+    atecc608a_event_log_reset_stats();
+    start = atecc608a_time_us();
+    for (uint32_t i = 0; i < count; i++) {
+        ASSERT_SUCCESS_PSA(atecc608a_event_log_append(
+                               ATECC608A_EVENT_APPLICATION, 0, (uint16_t) i));
+    }
+    us = atecc608a_time_us() - start;
+    atecc608a_event_log_get_stats(&stats);
+    bytes = 32ULL * stats.blocks_written + 4ULL * stats.words_written;
+
+    printf("  - %lu events in %lu ms, %lu.%02lu appends/s\n",
+           (unsigned long) count, (unsigned long)(us / 1000),
+           (unsigned long)(count * 1000000ULL / us),
+           (unsigned long)(count * 100000000ULL / us % 100));
+    printf("  - %lu.%02lu bytes written per event (%lu blocks, %lu tail words)\n",
+           (unsigned long)(bytes / count),
+           (unsigned long)(bytes * 100 / count % 100),
+           (unsigned long) stats.blocks_written,
+           (unsigned long) stats.words_written);
+    if (stats.checkpoints != 0) {
+        printf("  - %lu signed heads, %lu ms each\n",
+               (unsigned long) stats.checkpoints,
+               (unsigned long)(stats.checkpoint_us / stats.checkpoints / 1000));
+    }
+    printf("  - rewriting slot %d per event instead: 416 bytes, %lu ms each "
+           "(model)\n", ATECC608A_EVENT_LOG_SLOT,
+           (unsigned long)(atecc608a_cost_model_estimate_us(&rewrite, 1) / 1000));
+
+exit:
+    return status;
+}
+
+static bool run_event_log_command(char *command, char *arg)
+{
+    if (strcmp(command, "event_log") == 0) {
+        psa_status_t status = atecc608a_event_log_print();
+
+        if (status != PSA_SUCCESS) {
+            printf("No event log open. Error %ld.\n", (long) status);
+        }
+    } else if (strncmp(command, "event_log_format", strlen("event_log_format")) == 0) {
+        uint16_t slot = arg != NULL ? (uint16_t) atoi(arg + 1)
+                                    : ATECC608A_EVENT_LOG_SIGN_SLOT;
+        psa_status_t status;
+
+        if (slot > 15) {
+            printf("Invalid slot %u provided as a signing slot.\n", slot);
+            return true;
+        }
+        if (slot == atecc608a_private_key_slot) {
+            printf("Slot %u is the private key slot of the tests, which "
+                   "replace its key.\n", slot);
+            return true;
+        }
+        status = atecc608a_event_log_format(slot);
+        if (status != PSA_SUCCESS) {
+            printf("Failed to format the event log. Error %ld.\n",
+                   (long) status);
+            return true;
+        }
+        printf("Event log formatted, signed with the key in slot %u.\n", slot);
+    } else if (strcmp(command, "event_log_verify") == 0) {
+        psa_status_t status = atecc608a_event_log_verify();
+
+        if (status != PSA_SUCCESS) {
+            printf("Event log verification failed. Error %ld.\n",
+                   (long) status);
+        }
+    } else if (strncmp(command, "event=", strlen("event=")) == 0) {
+        psa_status_t status = atecc608a_event_log_append(
+                                  ATECC608A_EVENT_APPLICATION, 0,
+                                  (uint16_t) atoi(arg + 1));
+
+        if (status != PSA_SUCCESS) {
+            printf("Failed to append the event. Error %ld.\n", (long) status);
+        }
+    } else if (strncmp(command, "event_log_rate=", strlen("event_log_rate=")) == 0) {
+        psa_status_t status;
+
+        if (job_busy()) {
+            return true;
+        }
+        printf("Event log appends:\n");
+        status = event_log_rate((uint32_t) atoi(arg + 1));
+        if (status != PSA_SUCCESS) {
+            printf("Event log rate run failed. Error %ld.\n", (long) status);
+        }
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool estimate_event_log_command(const char *command, const char *arg,
+                                       uint64_t *estimate_us)
+{
+    static const atecc608a_cost_step_t cost_event_log_format[] = {
+        { ATECC608A_COST_WRITE_BLOCK, 8 }, { ATECC608A_COST_SIGN, 1 },
+    };
+    static const atecc608a_cost_step_t cost_event_log_read[] = {
+        { ATECC608A_COST_READ_BLOCK, 8 },
+    };
+    static const atecc608a_cost_step_t cost_export_import[] = {
+        { ATECC608A_COST_EXPORT, 1 }, { ATECC608A_COST_IMPORT, 1 },
+    };
+    static const atecc608a_cost_step_t cost_event_append[] = {
+        { ATECC608A_COST_WRITE_BLOCK, 1 },
+    };
+    static const atecc608a_cost_step_t cost_event_tail[] = {
+        { ATECC608A_COST_WRITE_WORD, 1 },
+    };
+    static const atecc608a_cost_step_t cost_event_sign[] = {
+        { ATECC608A_COST_SIGN, 1 },
+    };
+    uint64_t us = 0;
+
+    if (strncmp(command, "event_log_format", strlen("event_log_format")) == 0) {
+        printf("[dry run] %s\n", command);
+        us = print_estimate("event_log_format",
+                            COST_STEPS(cost_event_log_format), 1);
+    } else if (strcmp(command, "event_log") == 0) {
+        printf("[dry run] %s\n", command);
+        us = print_estimate("event_log", COST_STEPS(cost_event_log_read), 1);
+    } else if (strcmp(command, "event_log_verify") == 0) {
+        printf("[dry run] %s\n", command);
+        us = print_estimate("event_log_verify",
+                            COST_STEPS(cost_event_log_read), 1);
+        us += print_estimate("event_log_verify (public key, first time)",
+                             COST_STEPS(cost_export_import), 1);
+    } else if (strncmp(command, "event=", strlen("event=")) == 0) {
+        printf("[dry run] %s\n", command);
+        us = print_estimate("event", COST_STEPS(cost_event_append), 1);
+    } else if (strncmp(command, "event_log_rate=", strlen("event_log_rate=")) == 0) {
+        uint32_t count = (uint32_t) atoi(arg + 1);
+
+        /* A tail word every other event, a signature every few. */
+        printf("[dry run] %s\n", command);
+        us = print_estimate("event_log_rate", COST_STEPS(cost_event_append),
+                            count);
+        us += print_estimate("event_log_rate (tail)",
+                             COST_STEPS(cost_event_tail), count / 2);
+        us += print_estimate("event_log_rate (signed heads)",
+                             COST_STEPS(cost_event_sign),
+                             count / ATECC608A_EVENT_LOG_SIGN_INTERVAL);
+    } else {
+        return false;
+    }
+    *estimate_us = us;
+    return true;
+}
+
+const command_module_t event_log_commands = {
+    " - event_log - print the security event log kept in slot 8;\n"
+    " - event_log_format[=%d] - start a new event log signed with the key in\n"
+    "                          a given slot (0-15) other than the private\n"
+    "                          key slot used in tests, default - 6;\n"
+    " - event_log_verify - check the hash chain and the signed head of the\n"
+    "                      event log;\n"
+    " - event=%d - append an application event with a given detail value;\n"
+    " - event_log_rate=%d - append a number of events, print appends per\n"
+    "                      second and bytes written per event;\n",
+    NULL, run_event_log_command, estimate_event_log_command,
+};
@@ -0,0 +1,36 @@
+/**
+ * \file atecc608a_event_log_commands.h
+ * \brief Console commands of the security event log.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_EVENT_LOG_COMMANDS_H
+#define ATECC608A_EVENT_LOG_COMMANDS_H
+
+#include "atecc608a_app.h"
+
+/** event_log, event_log_format, event_log_verify, event and
+ *  event_log_rate. */
+extern const command_module_t event_log_commands;
+
+/** Test that an appended event survives reopening the event log, and that
+ *  the log verifies. */
+extern const test_step_t test_step_event_log;
+
+#endif /* ATECC608A_EVENT_LOG_COMMANDS_H */
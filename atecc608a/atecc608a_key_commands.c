@@ -0,0 +1,609 @@
+/**
+ * \file atecc608a_key_commands.c
+ * \brief Console commands that generate keys and keep the key index.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include "atecc608a_key_commands.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "atecc608a_event_log.h"
+#include "atecc608a_key_index.h"
+#include "atecc608a_stats.h"
+#include "atecc608a_utils.h"
+
+/* Slots that hold P256 private keys in the hardcoded configuration: KeyConfig
+ * has the Private bit set and KeyType is 0b100. */
+static bool template_slot_is_private_key(uint16_t slot)
+{
+    uint8_t key_config = template_config_508a_dev[96 + 2 * slot];
+    return (key_config & 0x01) && ((key_config >> 2) & 0x07) == 0x04;
+}
+
+/* In paired-slot mode, the public keys of private key slots 0-5 are kept in
+ * the public key slots 9-14 of the hardcoded configuration, so that exporting
+ * them is a read rather than a GenKey. */
+static bool paired_slots;
+
+#define PAIRED_PRIVATE_SLOTS 6
+#define PAIRED_MIRROR_FIRST_SLOT 9
+
+/* Mirror slot of a private key slot, or -1 if its public key is not
+ * mirrored. */
+static int mirror_slot_of(uint16_t slot)
+{
+    if (!paired_slots || slot >= PAIRED_PRIVATE_SLOTS) {
+        return -1;
+    }
+    return PAIRED_MIRROR_FIRST_SLOT + slot;
+}
+
+/* Record a new key in the key index, if there is one. */
+static psa_status_t index_record_key(uint16_t slot, atecc608a_key_role_t role,
+                                     const uint8_t *pubkey, size_t pubkey_length)
+{
+    if (!atecc608a_key_index_loaded()) {
+        return PSA_SUCCESS;
+    }
+    return atecc608a_key_index_record_key(slot, role, pubkey, pubkey_length);
+}
+
+static psa_status_t generate_private_key(uint16_t slot)
+{
+    psa_status_t status;
+    int mirror_slot = mirror_slot_of(slot);
+    static uint8_t pubkey[pubkey_size];
+    size_t pubkey_len = 0;
+
+    if (mirror_slot >= 0) {
+        ASSERT_SUCCESS_PSA(atecc608a_generate_mirrored(
+                               slot, (uint16_t) mirror_slot, pubkey,
+                               sizeof(pubkey), &pubkey_len));
+        ASSERT_SUCCESS_PSA(index_record_key((uint16_t) mirror_slot,
+                                            ATECC608A_KEY_ROLE_PUBLIC_KEY,
+                                            pubkey, pubkey_len));
+    } else {
+        ASSERT_SUCCESS_PSA(atecc608a_driver()->p_key_management->p_generate(
+                               slot, keypair_type,
+                               PSA_KEY_USAGE_SIGN | PSA_KEY_USAGE_VERIFY,
+                               key_bits, NULL, 0, pubkey, sizeof(pubkey),
+                               &pubkey_len));
+    }
+    ASSERT_SUCCESS_PSA(index_record_key(slot, ATECC608A_KEY_ROLE_PRIVATE_KEY,
+                                        pubkey, pubkey_len));
+exit:
+    return status;
+}
+
+static psa_status_t export_public_key(uint16_t slot, uint8_t *pubkey,
+                                      size_t pubkey_size, size_t *pubkey_length)
+{
+    int mirror_slot = mirror_slot_of(slot);
+
+    if (mirror_slot >= 0) {
+        return atecc608a_export_mirrored(slot, (uint16_t) mirror_slot, pubkey,
+                                         pubkey_size, pubkey_length);
+    }
+    return atecc608a_driver()->p_key_management->p_export(
+               slot, pubkey, pubkey_size, pubkey_length);
+}
+
+/* Whether generate_all records its keys in a key index batch. */
+static bool generate_all_batch;
+
+static job_step_result_t generate_all_job_step(uint32_t done)
+{
+    uint16_t slot = (uint16_t) done;
+    psa_status_t status;
+
+    if (done == 0) {
+        generate_all_batch = atecc608a_key_index_loaded() &&
+                             atecc608a_key_index_batch_begin() == PSA_SUCCESS;
+    }
+    if (!template_slot_is_private_key(slot)) {
+        return JOB_STEP_CONTINUE;
+    }
+    printf("Generating a private key in slot %u... ", slot);
+    status = generate_private_key(slot);
+    if (status != PSA_SUCCESS) {
+        printf("Failed! Error %ld.\n", (long) status);
+        return JOB_STEP_FAILED;
+    }
+    printf("Done.\n");
+    return JOB_STEP_CONTINUE;
+}
+
+/* The keys generated so far exist on the device whether or not the job
+ * finished, so they are recorded in any case. */
+static void generate_all_stop()
+{
+    psa_status_t status;
+
+    if (!generate_all_batch) {
+        return;
+    }
+    generate_all_batch = false;
+    status = atecc608a_key_index_batch_commit();
+    if (status != PSA_SUCCESS) {
+        printf("Failed to update the key index. Error %ld.\n", (long) status);
+    }
+}
+
+/* Private key slots that provision_rate regenerates: all but the one that
+ * signs the event log. */
+static bool provision_rate_slot(uint16_t slot)
+{
+    return template_slot_is_private_key(slot) &&
+           slot != atecc608a_event_log_sign_slot();
+}
+
+/* Keys per second, and key index blocks and journal saves written, when
+ * the keys of the private key slots are generated and recorded one by one,
+ * then in one batch. The event log is suspended meanwhile. */
+static psa_status_t provision_rate()
+{
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+    uint32_t keys = 0;
+    uint32_t blocks = 0;
+    uint32_t journal_writes;
+    uint64_t start;
+    uint64_t us;
+    bool batch = false;
+
+    if (!atecc608a_key_index_loaded()) {
+        printf("Please load or format the key index first.\n");
+        return PSA_ERROR_BAD_STATE;
+    }
+
+    atecc608a_event_log_suspend();
+    journal_writes = atecc608a_key_index_journal_writes();
+    start = atecc608a_time_us();
+    for (uint16_t slot = 0; slot < 16; slot++) {
+        if (provision_rate_slot(slot)) {
+            ASSERT_SUCCESS_PSA(generate_private_key(slot));
+            blocks += atecc608a_key_index_last_write_blocks();
+            keys++;
+        }
+    }
+    us = atecc608a_time_us() - start;
+    printf("  - one by one: %lu keys in %lu ms, %lu.%02lu keys/s, "
+           "%lu index blocks written, %lu journaled\n", (unsigned long) keys,
+           (unsigned long)(us / 1000),
+           (unsigned long)(keys * 1000000ULL / us),
+           (unsigned long)(keys * 100000000ULL / us % 100),
+           (unsigned long) blocks,
+           (unsigned long)(atecc608a_key_index_journal_writes() -
+                           journal_writes));
+
+    journal_writes = atecc608a_key_index_journal_writes();
+    start = atecc608a_time_us();
+    ASSERT_SUCCESS_PSA(atecc608a_key_index_batch_begin());
+    batch = true;
+    for (uint16_t slot = 0; slot < 16; slot++) {
+        if (provision_rate_slot(slot)) {
+            ASSERT_SUCCESS_PSA(generate_private_key(slot));
+        }
+    }
+    batch = false;
+    ASSERT_SUCCESS_PSA(atecc608a_key_index_batch_commit());
+    us = atecc608a_time_us() - start;
+    printf("  - batch:      %lu keys in %lu ms, %lu.%02lu keys/s, "
+           "%lu index blocks written, %lu journaled\n", (unsigned long) keys,
+           (unsigned long)(us / 1000),
+           (unsigned long)(keys * 1000000ULL / us),
+           (unsigned long)(keys * 100000000ULL / us % 100),
+           (unsigned long) atecc608a_key_index_last_write_blocks(),
+           (unsigned long)(atecc608a_key_index_journal_writes() -
+                           journal_writes));
+
+exit:
+    if (batch) {
+        /* Record what was generated before the failure. */
+        atecc608a_key_index_batch_commit();
+    }
+    atecc608a_event_log_resume();
+    return status;
+}
+
+/* Test that a mirrored public key reads back as the key the device computes,
+ * and that an overwritten or stale mirror is detected and rewritten. */
+static psa_status_t test_mirrored_export()
+{
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+    static uint8_t generated[pubkey_size];
+    static uint8_t computed[pubkey_size];
+    static uint8_t mirrored[pubkey_size];
+    size_t generated_len = 0;
+    size_t computed_len = 0;
+    size_t mirrored_len = 0;
+
+    ASSERT_SUCCESS_PSA(atecc608a_generate_mirrored(
+                           atecc608a_private_key_slot, atecc608a_public_key_slot,
+                           generated, sizeof(generated), &generated_len));
+    ASSERT_SUCCESS_PSA(atecc608a_export_mirrored(
+                           atecc608a_private_key_slot, atecc608a_public_key_slot,
+                           mirrored, sizeof(mirrored), &mirrored_len));
+    ASSERT_SUCCESS_PSA(atecc608a_driver()->p_key_management->p_export(
+                           atecc608a_private_key_slot, computed,
+                           sizeof(computed), &computed_len));
+    ASSERT_STATUS(mirrored_len == computed_len && generated_len == computed_len,
+                  true, PSA_ERROR_HARDWARE_FAILURE);
+    ASSERT_STATUS(memcmp(mirrored, computed, computed_len), 0,
+                  PSA_ERROR_HARDWARE_FAILURE);
+    ASSERT_STATUS(memcmp(generated, computed, computed_len), 0,
+                  PSA_ERROR_HARDWARE_FAILURE);
+
+    /* A plain import leaves the pad bytes zero, so the tag is gone. */
+    ASSERT_SUCCESS_PSA(atecc608a_driver()->p_key_management->p_import(
+                           atecc608a_public_key_slot,
+                           atecc608a_drv_info.lifetime,
+                           key_type, alg, PSA_KEY_USAGE_VERIFY, computed,
+                           computed_len));
+    memset(mirrored, 0, sizeof(mirrored));
+    ASSERT_SUCCESS_PSA(atecc608a_export_mirrored(
+                           atecc608a_private_key_slot, atecc608a_public_key_slot,
+                           mirrored, sizeof(mirrored), &mirrored_len));
+    ASSERT_STATUS(memcmp(mirrored, computed, computed_len), 0,
+                  PSA_ERROR_HARDWARE_FAILURE);
+
+    /* A key generated behind the back of the mirror is not exported from
+     * it: the mirror still has a valid tag, of the old key. */
+    ASSERT_SUCCESS_PSA(atecc608a_driver()->p_key_management->p_generate(
+                           atecc608a_private_key_slot, keypair_type,
+                           PSA_KEY_USAGE_SIGN | PSA_KEY_USAGE_VERIFY, key_bits,
+                           NULL, 0, computed, sizeof(computed),
+                           &computed_len));
+    ASSERT_SUCCESS_PSA(atecc608a_export_mirrored(
+                           atecc608a_private_key_slot, atecc608a_public_key_slot,
+                           mirrored, sizeof(mirrored), &mirrored_len));
+    ASSERT_STATUS(memcmp(mirrored, computed, computed_len), 0,
+                  PSA_ERROR_HARDWARE_FAILURE);
+
+    TEST_PASSED("test_mirrored_export");
+exit:
+    return status;
+}
+
+static const atecc608a_cost_step_t cost_mirrored_export[] = {
+    { ATECC608A_COST_GENERATE_MIRRORED, 1 },
+    { ATECC608A_COST_EXPORT_MIRRORED, 2 }, { ATECC608A_COST_EXPORT, 2 },
+    { ATECC608A_COST_IMPORT, 2 },
+};
+
+const test_step_t test_step_mirrored_export = {
+    "test_mirrored_export", test_mirrored_export,
+    COST_STEPS(cost_mirrored_export) FIXTURE(LOCKED)
+};
+
+/* Test that a key ID assignment reaches the device index with at most two
+ * block writes and no journal, and is found again after reloading the
+ * index. The index is
+ * formatted if the slot does not hold one yet, and the assignment is undone
+ * at the end. */
+static psa_status_t test_key_index()
+{
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+    uint16_t slot = (uint16_t) atecc608a_private_key_slot;
+    uint16_t original_id;
+    uint16_t test_id = 0x7E57;
+    uint16_t generation;
+    uint32_t journal_writes;
+
+    if (!atecc608a_key_index_loaded() &&
+            atecc608a_key_index_load() == PSA_ERROR_DOES_NOT_EXIST) {
+        ASSERT_SUCCESS_PSA(atecc608a_key_index_format(
+                               template_config_508a_dev,
+                               sizeof(template_config_508a_dev)));
+    }
+    ASSERT_STATUS(atecc608a_key_index_loaded(), true, PSA_ERROR_BAD_STATE);
+    original_id = atecc608a_key_index_entry(slot)->key_id;
+    while (atecc608a_key_index_find(test_id) >= 0) {
+        test_id++;
+    }
+
+    journal_writes = atecc608a_key_index_journal_writes();
+    ASSERT_SUCCESS_PSA(atecc608a_key_index_set_key_id(slot, test_id));
+    ASSERT_STATUS(atecc608a_key_index_last_write_blocks() <= 2, true,
+                  PSA_ERROR_GENERIC_ERROR);
+    ASSERT_STATUS(atecc608a_key_index_journal_writes(), journal_writes,
+                  PSA_ERROR_GENERIC_ERROR);
+    generation = atecc608a_key_index_generation();
+
+    ASSERT_SUCCESS_PSA(atecc608a_key_index_load());
+    ASSERT_STATUS(atecc608a_key_index_generation(), generation,
+                  PSA_ERROR_HARDWARE_FAILURE);
+    ASSERT_STATUS(atecc608a_key_index_find(test_id), slot,
+                  PSA_ERROR_HARDWARE_FAILURE);
+
+    ASSERT_SUCCESS_PSA(atecc608a_key_index_set_key_id(slot, original_id));
+    TEST_PASSED("test_key_index");
+exit:
+    return status;
+}
+
+static const atecc608a_cost_step_t cost_key_index[] = {
+    { ATECC608A_COST_READ_BLOCK, 4 }, { ATECC608A_COST_WRITE_BLOCK, 4 },
+};
+
+const test_step_t test_step_key_index = {
+    "test_key_index", test_key_index, COST_STEPS(cost_key_index)
+    FIXTURE(LOCKED) PERSISTENT
+};
+
+static bool run_key_command(char *command, char *arg)
+{
+    size_t len = strlen(command);
+
+    if (strncmp(command, "paired_slots=", strlen("paired_slots=")) == 0) {
+        paired_slots = atoi(arg + 1) != 0;
+        if (paired_slots) {
+            printf("Public keys of slots 0-%d are mirrored to slots %d-%d.\n",
+                   PAIRED_PRIVATE_SLOTS - 1, PAIRED_MIRROR_FIRST_SLOT,
+                   PAIRED_MIRROR_FIRST_SLOT + PAIRED_PRIVATE_SLOTS - 1);
+        } else {
+            printf("Public keys are computed by the device on export.\n");
+        }
+    } else if (strcmp(command, "key_index") == 0) {
+        atecc608a_key_index_print();
+    } else if (strcmp(command, "key_index_format") == 0) {
+        psa_status_t status = atecc608a_key_index_format(
+                                  template_config_508a_dev,
+                                  sizeof(template_config_508a_dev));
+
+        if (status != PSA_SUCCESS) {
+            printf("Failed to format the key index. Error %ld.\n",
+                   (long) status);
+            return true;
+        }
+        atecc608a_key_index_print();
+    } else if (strncmp(command, "key_id=", strlen("key_id=")) == 0) {
+        const char *key_id = strchr(arg + 1, '_');
+        psa_status_t status;
+
+        if (key_id == NULL) {
+            printf("Please specify a slot and a key ID.\n");
+            return true;
+        }
+        status = atecc608a_key_index_set_key_id((uint16_t) atoi(arg + 1),
+                                                (uint16_t) atoi(key_id + 1));
+        if (status != PSA_SUCCESS) {
+            printf("Failed to assign the key ID. Error %ld.\n", (long) status);
+            return true;
+        }
+        printf("Done, %lu blocks written.\n",
+               (unsigned long) atecc608a_key_index_last_write_blocks());
+    } else if (strncmp(command, "find_key=", strlen("find_key=")) == 0) {
+        int slot = atecc608a_key_index_find((uint16_t) atoi(arg + 1));
+
+        if (slot < 0) {
+            printf("No slot holds key %d.\n", atoi(arg + 1));
+        } else {
+            printf("Key %d is in slot %d.\n", atoi(arg + 1), slot);
+        }
+    } else if (strcmp(command, "provision_rate") == 0) {
+        psa_status_t status;
+
+        if (job_busy()) {
+            return true;
+        }
+        printf("Provisioning rate:\n");
+        status = provision_rate();
+        if (status != PSA_SUCCESS) {
+            printf("Provisioning failed. Error %ld.\n", (long) status);
+        }
+    } else if (strcmp(command, "generate_all") == 0) {
+        start_job("generate_all", generate_all_job_step, generate_all_stop, 16);
+    } else if (strncmp(command, "generate_private", strlen("generate_private") - 1) == 0) {
+        uint16_t slot = 0;
+        psa_status_t status;
+
+        // If there is an argument supplied
+        if (len > strlen("generate_private=0") - 1 && arg != NULL) {
+            slot = (uint16_t) atoi(arg + 1);
+        }
+
+        if (slot > 15) {
+            printf("Invalid slot %u provided for generate_private command.\n", slot);
+            return true;
+        }
+        printf("Generating a private key in slot %u... ", slot);
+        status = generate_private_key(slot);
+        if (status != PSA_SUCCESS) {
+            printf("Failed! Error %ld.\n", (long) status);
+            return true;
+        }
+        printf("Done.\n");
+    } else if (strncmp(command, "generate_public", strlen("generate_public") - 1) == 0) {
+        uint16_t slot_private = 0;
+        uint16_t slot_public = 9;
+        static uint8_t pubkey[pubkey_size];
+        size_t pubkey_len = 0;
+        psa_status_t status;
+
+        // Check if an argument is missing
+        if (len <= strlen("generate_public=0_9") - 1) {
+            printf("Please specify both slots for public key generation.\n");
+            return true;
+        }
+        slot_private = (uint16_t) atoi(arg + 1);
+        slot_public = (uint16_t) atoi(strrchr(command, '_') + 1);
+
+        if (slot_private > 15 || slot_public > 15) {
+            printf("Invalid slots provided for generate_public command: %u, %u\n",
+                   slot_private, slot_public);
+            return true;
+        }
+
+        printf("Exporting a public key from private key in slot %u... ",
+               slot_private);
+        status = export_public_key(slot_private, pubkey, sizeof(pubkey),
+                                   &pubkey_len);
+        if (status != PSA_SUCCESS) {
+            printf("Failed! Error %ld.\n", (long) status);
+            return true;
+        }
+        printf("Done.\n");
+
+        /* An import would drop the mirror tag. */
+        if (mirror_slot_of(slot_private) == slot_public) {
+            printf("Slot %u already mirrors the public key.\n", slot_public);
+            return true;
+        }
+
+        printf("Importing public key to slot %u... ", slot_public);
+        status = atecc608a_driver()->p_key_management->p_import(
+                     slot_public,
+                     atecc608a_drv_info.lifetime,
+                     key_type, alg, PSA_KEY_USAGE_VERIFY, pubkey,
+                     pubkey_len);
+        if (status == PSA_SUCCESS) {
+            status = index_record_key(slot_public,
+                                      ATECC608A_KEY_ROLE_PUBLIC_KEY, pubkey,
+                                      pubkey_len);
+        }
+        if (status != PSA_SUCCESS) {
+            printf("Failed! Error %ld.\n", (long) status);
+            return true;
+        }
+        printf("Done.\n");
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool estimate_key_command(const char *command, const char *arg,
+                                 uint64_t *estimate_us)
+{
+    static const atecc608a_cost_step_t cost_generate[] = {
+        { ATECC608A_COST_GENERATE, 1 },
+    };
+    static const atecc608a_cost_step_t cost_generate_mirrored[] = {
+        { ATECC608A_COST_GENERATE_MIRRORED, 1 },
+    };
+    static const atecc608a_cost_step_t cost_export_import[] = {
+        { ATECC608A_COST_EXPORT, 1 }, { ATECC608A_COST_IMPORT, 1 },
+    };
+    static const atecc608a_cost_step_t cost_export_mirrored_import[] = {
+        { ATECC608A_COST_EXPORT_MIRRORED, 1 }, { ATECC608A_COST_IMPORT, 1 },
+    };
+    static const atecc608a_cost_step_t cost_key_index_format[] = {
+        { ATECC608A_COST_WRITE_BLOCK, 4 },
+    };
+    static const atecc608a_cost_step_t cost_key_id[] = {
+        { ATECC608A_COST_WRITE_BLOCK, 2 },
+    };
+    uint64_t us = 0;
+
+    if (strncmp(command, "generate_private", strlen("generate_private")) == 0) {
+        uint16_t slot = arg != NULL ? (uint16_t) atoi(arg + 1) : 0;
+
+        printf("[dry run] %s\n", command);
+        if (mirror_slot_of(slot) >= 0) {
+            us = print_estimate("generate_private",
+                                COST_STEPS(cost_generate_mirrored), 1);
+        } else {
+            us = print_estimate("generate_private", COST_STEPS(cost_generate), 1);
+        }
+    } else if (strncmp(command, "generate_public", strlen("generate_public")) == 0) {
+        uint16_t slot = arg != NULL ? (uint16_t) atoi(arg + 1) : 0;
+
+        printf("[dry run] %s\n", command);
+        if (mirror_slot_of(slot) >= 0) {
+            us = print_estimate("generate_public",
+                                COST_STEPS(cost_export_mirrored_import), 1);
+        } else {
+            us = print_estimate("generate_public",
+                                COST_STEPS(cost_export_import), 1);
+        }
+    } else if (strcmp(command, "generate_all") == 0) {
+        uint32_t slots = 0;
+        uint32_t mirrored = 0;
+
+        for (uint16_t slot = 0; slot < 16; slot++) {
+            if (template_slot_is_private_key(slot)) {
+                mirrored += mirror_slot_of(slot) >= 0 ? 1 : 0;
+                slots++;
+            }
+        }
+        printf("[dry run] %s\n", command);
+        us = print_estimate("generate_all", COST_STEPS(cost_generate),
+                            slots - mirrored);
+        if (mirrored != 0) {
+            us += print_estimate("generate_all (mirrored)",
+                                 COST_STEPS(cost_generate_mirrored), mirrored);
+        }
+    } else if (strcmp(command, "provision_rate") == 0) {
+        uint32_t slots = 0;
+
+        for (uint16_t slot = 0; slot < 16; slot++) {
+            slots += provision_rate_slot(slot) ? 1 : 0;
+        }
+        /* Mirrors are left out. One by one, each key rewrites its entry
+         * block and the header; the batch writes at most the whole index. */
+        printf("[dry run] %s\n", command);
+        us = print_estimate("provision_rate (keys)", COST_STEPS(cost_generate),
+                            2 * slots);
+        us += print_estimate("provision_rate (index, one by one)",
+                             COST_STEPS(cost_key_id), slots);
+        us += print_estimate("provision_rate (index, batch)",
+                             COST_STEPS(cost_key_id), 2);
+    } else if (strcmp(command, "key_index_format") == 0) {
+        printf("[dry run] %s\n", command);
+        us = print_estimate("key_index_format",
+                            COST_STEPS(cost_key_index_format), 1);
+    } else if (strncmp(command, "key_id=", strlen("key_id=")) == 0) {
+        /* At most the header block and the block of the entry. */
+        printf("[dry run] %s (at most)\n", command);
+        us = print_estimate("key_id", COST_STEPS(cost_key_id), 1);
+    } else {
+        return false;
+    }
+    *estimate_us = us;
+    return true;
+}
+
+static const char *const key_host_commands[] = {
+    "paired_slots=", "key_index", "find_key=", NULL,
+};
+
+const command_module_t key_commands = {
+    " - generate_private[=%d] - generate a private key in a given slot (0-15),\n"
+    "                          default slot - 0.\n"
+    " - provision_rate - generate keys in the private key slots of the\n"
+    "                    hardcoded configuration but the event log's\n"
+    "                    signing slot, recording them in the key index one\n"
+    "                    by one and then in one batch, and print keys per\n"
+    "                    second for both;\n"
+    " - generate_all - generate private keys in all private key slots of\n"
+    "                  the hardcoded configuration, in the background;\n"
+    " - generate_public=%d_%d - generate a public key in a given slot\n"
+    "                           (0-15, first argument) using a private key\n"
+    "                           from a given slot (0-15, second argument);\n"
+    " - paired_slots=%d - 1 - mirror the public keys of keys generated in\n"
+    "                      slots 0-5 to slots 9-14 and export them from\n"
+    "                      there, 0 - compute public keys on export;\n"
+    " - key_index - print the key index kept in slot 8;\n"
+    " - key_index_format - write an empty key index to slot 8;\n"
+    " - key_id=%d_%d - assign a key ID (second argument) to a slot (first\n"
+    "                  argument) in the key index;\n"
+    " - find_key=%d - look up the slot of a key ID in the key index;\n",
+    key_host_commands, run_key_command, estimate_key_command,
+};
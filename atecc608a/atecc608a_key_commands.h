@@ -0,0 +1,40 @@
+/**
+ * \file atecc608a_key_commands.h
+ * \brief Console commands that generate keys and keep the key index.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_KEY_COMMANDS_H
+#define ATECC608A_KEY_COMMANDS_H
+
+#include "atecc608a_app.h"
+
+/** generate_private, generate_public, generate_all, provision_rate,
+ *  paired_slots, key_index, key_index_format, key_id and find_key. */
+extern const command_module_t key_commands;
+
+/** Test that a mirrored public key reads back as the key the device
+ *  computes, and that an overwritten or stale mirror is detected. */
+extern const test_step_t test_step_mirrored_export;
+
+/** Test that a key ID assignment reaches the key index on the device
+ *  without a journal, and is found again after reloading the index. */
+extern const test_step_t test_step_key_index;
+
+#endif /* ATECC608A_KEY_COMMANDS_H */
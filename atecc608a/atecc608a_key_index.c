@@ -0,0 +1,683 @@
+/**
+ * \file atecc608a_key_index.c
+ * \brief Key metadata index kept in a data slot of the device.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include "atecc608a_key_index.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "atecc608a_se.h"
+#include "atecc608a_crc16.h"
+#include "atecc608a_event_log.h"
+#include "atecc608a_lock.h"
+#include "atecc608a_utils.h"
+#include "psa/internal_trusted_storage.h"
+
+/* Index layout, all fields little-endian:
+ *   header: magic (2), version (1), entry count (1), generation (2), CRC (2)
+ *   entry:  key ID (2), role (1), state (1), generation (2), public key
+ *           hash (2)
+ * The CRC covers the whole index with the CRC field zeroed. */
+#define INDEX_MAGIC 0x4B49
+#define HEADER_SIZE 8
+#define ENTRY_SIZE 8
+#define CRC_OFFSET 6
+#define SLOT_COUNT 16
+#define ENTRY_COUNT (SLOT_COUNT - 1)
+#define BLOCK_SIZE 32
+#define BLOCK_COUNT (ATECC608A_KEY_INDEX_SIZE / BLOCK_SIZE)
+
+/* Open addressing table from key ID to entry, twice the number of entries
+ * so that probe sequences stay short. */
+#define BUCKET_COUNT 32
+#define BUCKET_EMPTY 0xFF
+
+static atecc608a_key_index_entry_t entries[ENTRY_COUNT];
+static uint16_t index_generation;
+static uint8_t buckets[BUCKET_COUNT];
+static bool index_loaded;
+/* The index as it is on the device, to find the blocks an update changes. */
+static uint8_t stored[ATECC608A_KEY_INDEX_SIZE];
+static uint32_t last_write_blocks;
+static uint32_t journal_writes;
+/* Guards the RAM copy. Taken before the device lock when both are held. */
+static atecc608a_lock_t index_lock = ATECC608A_LOCK_INIT("key index");
+/* Nesting depth of the open batch, and whether it changed anything. */
+static uint32_t batch_depth;
+static bool batch_dirty;
+
+/* Entry number of a slot, skipping the index slot. */
+static int entry_of(uint16_t slot)
+{
+    if (slot >= SLOT_COUNT || slot == ATECC608A_KEY_INDEX_SLOT) {
+        return -1;
+    }
+    return slot < ATECC608A_KEY_INDEX_SLOT ? slot : slot - 1;
+}
+
+static uint16_t slot_of(int entry)
+{
+    return (uint16_t)(entry < ATECC608A_KEY_INDEX_SLOT ? entry : entry + 1);
+}
+
+static uint32_t bucket_of(uint16_t key_id)
+{
+    /* Fibonacci hashing, the top five bits of the product. */
+    return ((uint32_t) key_id * 40503u & 0xFFFF) >> 11;
+}
+
+static void rebuild_buckets(void)
+{
+    memset(buckets, BUCKET_EMPTY, sizeof(buckets));
+    for (int i = 0; i < ENTRY_COUNT; i++) {
+        uint32_t bucket;
+
+        if (entries[i].key_id == ATECC608A_KEY_ID_NONE) {
+            continue;
+        }
+        bucket = bucket_of(entries[i].key_id);
+        while (buckets[bucket] != BUCKET_EMPTY) {
+            bucket = (bucket + 1) % BUCKET_COUNT;
+        }
+        buckets[bucket] = (uint8_t) i;
+    }
+}
+
+static void put_u16(uint8_t *to, uint16_t value)
+{
+    to[0] = (uint8_t) value;
+    to[1] = (uint8_t)(value >> 8);
+}
+
+static uint16_t get_u16(const uint8_t *from)
+{
+    return (uint16_t)(from[0] | (from[1] << 8));
+}
+
+static void serialize(uint16_t generation, uint8_t *image)
+{
+    uint8_t crc[2];
+
+    put_u16(image, INDEX_MAGIC);
+    image[2] = ATECC608A_KEY_INDEX_VERSION;
+    image[3] = ENTRY_COUNT;
+    put_u16(image + 4, generation);
+    put_u16(image + CRC_OFFSET, 0);
+    for (int i = 0; i < ENTRY_COUNT; i++) {
+        uint8_t *entry = image + HEADER_SIZE + i * ENTRY_SIZE;
+
+        put_u16(entry, entries[i].key_id);
+        entry[2] = entries[i].role;
+        entry[3] = entries[i].state;
+        put_u16(entry + 4, entries[i].generation);
+        put_u16(entry + 6, entries[i].pubkey_hash);
+    }
+    atecc608a_crc16(ATECC608A_KEY_INDEX_SIZE, image, crc);
+    memcpy(image + CRC_OFFSET, crc, sizeof(crc));
+}
+
+/* PSA_ERROR_INVALID_SIGNATURE if only the CRC does not match. */
+static psa_status_t check_image(const uint8_t *image)
+{
+    uint8_t copy[ATECC608A_KEY_INDEX_SIZE];
+    uint8_t crc[2];
+
+    if (get_u16(image) != INDEX_MAGIC || image[3] != ENTRY_COUNT) {
+        return PSA_ERROR_DOES_NOT_EXIST;
+    }
+    if (image[2] != ATECC608A_KEY_INDEX_VERSION) {
+        return PSA_ERROR_NOT_SUPPORTED;
+    }
+    memcpy(copy, image, sizeof(copy));
+    put_u16(copy + CRC_OFFSET, 0);
+    atecc608a_crc16(sizeof(copy), copy, crc);
+    if (memcmp(crc, image + CRC_OFFSET, sizeof(crc)) != 0) {
+        return PSA_ERROR_INVALID_SIGNATURE;
+    }
+    return PSA_SUCCESS;
+}
+
+static void deserialize(const uint8_t *image)
+{
+    index_generation = get_u16(image + 4);
+    for (int i = 0; i < ENTRY_COUNT; i++) {
+        const uint8_t *entry = image + HEADER_SIZE + i * ENTRY_SIZE;
+
+        entries[i].key_id = get_u16(entry);
+        entries[i].role = entry[2];
+        entries[i].state = entry[3];
+        entries[i].generation = get_u16(entry + 4);
+        entries[i].pubkey_hash = get_u16(entry + 6);
+    }
+}
+
+/* Write `image` over the index on the device, the blocks that differ from
+ * `from` only, the header block last: an update cut short leaves a CRC
+ * mismatch rather than a valid mix of old and new entries. */
+static psa_status_t write_blocks(const uint8_t *image, const uint8_t *from,
+                                 uint32_t *blocks)
+{
+    psa_status_t status;
+
+    *blocks = 0;
+    for (int block = BLOCK_COUNT - 1; block >= 0; block--) {
+        size_t offset = block * BLOCK_SIZE;
+
+        if (from != NULL &&
+                memcmp(image + offset, from + offset, BLOCK_SIZE) == 0) {
+            continue;
+        }
+        status = atecc608a_device_write(ATECC608A_KEY_INDEX_SLOT,
+                                        ATECC608A_KEY_INDEX_OFFSET + offset,
+                                        image + offset, BLOCK_SIZE);
+        if (status != PSA_SUCCESS) {
+            return status;
+        }
+        (*blocks)++;
+    }
+    return PSA_SUCCESS;
+}
+
+/* Blocks of `image` other than the header block that differ from the
+ * device. */
+static uint32_t changed_entry_blocks(const uint8_t *image)
+{
+    uint32_t blocks = 0;
+
+    for (int block = 1; block < BLOCK_COUNT; block++) {
+        size_t offset = block * BLOCK_SIZE;
+
+        blocks += memcmp(image + offset, stored + offset, BLOCK_SIZE) != 0;
+    }
+    return blocks;
+}
+
+/* Write the changes to the device. An update of more than one block besides
+ * the header first saves the index as it was in the journal, from which the
+ * next load rolls an interrupted update back. An update of one block is
+ * not journaled: block writes are atomic and the header goes last, so if
+ * it is cut short the next load finds the new block under the old header
+ * and completes the update. An open batch defers everything to its
+ * commit. */
+static psa_status_t commit(bool journal)
+{
+    psa_status_t status;
+    uint8_t image[ATECC608A_KEY_INDEX_SIZE];
+
+    if (batch_depth != 0) {
+        batch_dirty = true;
+        return PSA_SUCCESS;
+    }
+
+    serialize(index_generation + 1, image);
+    journal = journal && changed_entry_blocks(image) > 1;
+    if (journal) {
+        status = psa_its_set(ATECC608A_KEY_INDEX_JOURNAL_UID, sizeof(stored),
+                             stored, PSA_STORAGE_FLAG_NONE);
+        if (status != PSA_SUCCESS) {
+            return status;
+        }
+        journal_writes++;
+    }
+    status = write_blocks(image, stored, &last_write_blocks);
+    if (status != PSA_SUCCESS) {
+        /* The device holds an unknown mix now, make the next user reload
+         * it, which rolls back to the journal. */
+        index_loaded = false;
+        return status;
+    }
+    if (journal) {
+        psa_its_remove(ATECC608A_KEY_INDEX_JOURNAL_UID);
+    }
+    memcpy(stored, image, sizeof(stored));
+    index_generation++;
+    rebuild_buckets();
+    return status;
+}
+
+/* Put back the index saved in the journal by an update that did not finish,
+ * if there is one. */
+static psa_status_t roll_back(void)
+{
+    struct psa_storage_info_t info;
+    uint8_t journal[ATECC608A_KEY_INDEX_SIZE];
+    size_t length = 0;
+    uint32_t blocks;
+    psa_status_t status;
+
+    status = psa_its_get_info(ATECC608A_KEY_INDEX_JOURNAL_UID, &info);
+    if (status == PSA_ERROR_DOES_NOT_EXIST) {
+        return PSA_SUCCESS;
+    }
+    if (status == PSA_SUCCESS) {
+        status = psa_its_get(ATECC608A_KEY_INDEX_JOURNAL_UID, 0,
+                             sizeof(journal), journal, &length);
+    }
+    if (status != PSA_SUCCESS) {
+        return status;
+    }
+    /* A journal that is not a valid index has nothing to restore. */
+    if (length == sizeof(journal) && check_image(journal) == PSA_SUCCESS) {
+        status = write_blocks(journal, NULL, &blocks);
+        if (status != PSA_SUCCESS) {
+            return status;
+        }
+        printf("Key index: rolled back an interrupted update.\n");
+    }
+    return psa_its_remove(ATECC608A_KEY_INDEX_JOURNAL_UID);
+}
+
+/* Finish an update of one block that was cut short before its header was
+ * written: the block on the device is the new one, so the header is written
+ * again over it. A format breaks the header first, so a format cut short
+ * does not end up here. */
+static psa_status_t roll_forward(void)
+{
+    psa_status_t status;
+
+    deserialize(stored);
+    index_loaded = true;
+    /* Only the header differs from the device, it is written alone. */
+    status = commit(false);
+    if (status != PSA_SUCCESS) {
+        index_loaded = false;
+        return status;
+    }
+    printf("Key index: completed an interrupted update.\n");
+    return PSA_SUCCESS;
+}
+
+psa_status_t atecc608a_key_index_load(void)
+{
+    psa_status_t status;
+
+    atecc608a_lock_acquire(&index_lock);
+    if (batch_depth != 0) {
+        atecc608a_lock_release(&index_lock);
+        return PSA_ERROR_BAD_STATE;
+    }
+    index_loaded = false;
+    status = roll_back();
+    if (status == PSA_SUCCESS) {
+        status = atecc608a_device_read(ATECC608A_KEY_INDEX_SLOT,
+                                       ATECC608A_KEY_INDEX_OFFSET, stored,
+                                       sizeof(stored));
+    }
+    if (status == PSA_SUCCESS) {
+        status = check_image(stored);
+        if (status == PSA_SUCCESS) {
+            deserialize(stored);
+            rebuild_buckets();
+            index_loaded = true;
+        } else if (status == PSA_ERROR_INVALID_SIGNATURE) {
+            status = roll_forward();
+        }
+    }
+    atecc608a_lock_release(&index_lock);
+    return status;
+}
+
+psa_status_t atecc608a_key_index_format(const uint8_t *config,
+                                        size_t config_size)
+{
+    psa_status_t status;
+
+    if (config_size != 128) {
+        return PSA_ERROR_INVALID_ARGUMENT;
+    }
+
+    atecc608a_lock_acquire(&index_lock);
+    for (int i = 0; i < ENTRY_COUNT; i++) {
+        uint16_t slot = slot_of(i);
+        /* SlotConfig low byte and KeyConfig low byte of the slot. */
+        uint8_t slot_config = config[20 + 2 * slot];
+        uint8_t key_config = config[96 + 2 * slot];
+        uint8_t key_type = (key_config >> 2) & 0x07;
+
+        memset(&entries[i], 0, sizeof(entries[i]));
+        entries[i].key_id = ATECC608A_KEY_ID_NONE;
+        if (key_type == 0x04) {
+            entries[i].role = (key_config & 0x01) ?
+                              ATECC608A_KEY_ROLE_PRIVATE_KEY :
+                              ATECC608A_KEY_ROLE_PUBLIC_KEY;
+        } else if (slot_config & 0x80) {
+            entries[i].role = ATECC608A_KEY_ROLE_SECRET;
+        } else {
+            entries[i].role = ATECC608A_KEY_ROLE_DATA;
+        }
+    }
+
+    /* Whatever is on the device, all blocks are rewritten. The header is
+     * broken first, so that a format cut short leaves no index rather than
+     * one that the next load would take for an interrupted update. */
+    memset(stored, 0, sizeof(stored));
+    index_generation = 0;
+    status = atecc608a_device_write(ATECC608A_KEY_INDEX_SLOT,
+                                    ATECC608A_KEY_INDEX_OFFSET, stored,
+                                    BLOCK_SIZE);
+    if (status == PSA_SUCCESS) {
+        index_loaded = true;
+        /* There is nothing worth rolling back to. */
+        status = commit(false);
+    }
+    atecc608a_lock_release(&index_lock);
+    return status;
+}
+
+bool atecc608a_key_index_loaded(void)
+{
+    return index_loaded;
+}
+
+uint16_t atecc608a_key_index_generation(void)
+{
+    return index_generation;
+}
+
+const atecc608a_key_index_entry_t *atecc608a_key_index_entry(uint16_t slot)
+{
+    int entry = entry_of(slot);
+
+    if (!index_loaded || entry < 0) {
+        return NULL;
+    }
+    return &entries[entry];
+}
+
+static int find(uint16_t key_id)
+{
+    uint32_t bucket;
+
+    if (!index_loaded || key_id == ATECC608A_KEY_ID_NONE) {
+        return -1;
+    }
+    bucket = bucket_of(key_id);
+    for (uint32_t probes = 0; probes < BUCKET_COUNT; probes++) {
+        uint8_t entry = buckets[bucket];
+
+        if (entry == BUCKET_EMPTY) {
+            return -1;
+        }
+        if (entries[entry].key_id == key_id) {
+            return slot_of(entry);
+        }
+        bucket = (bucket + 1) % BUCKET_COUNT;
+    }
+    return -1;
+}
+
+int atecc608a_key_index_find(uint16_t key_id)
+{
+    int slot;
+
+    atecc608a_lock_acquire(&index_lock);
+    slot = find(key_id);
+    atecc608a_lock_release(&index_lock);
+    return slot;
+}
+
+static psa_status_t pubkey_hash(const uint8_t *pubkey, size_t pubkey_length,
+                                uint16_t *hash)
+{
+    psa_status_t status;
+    psa_hash_operation_t operation = PSA_HASH_OPERATION_INIT;
+    uint8_t digest[PSA_HASH_SIZE(PSA_ALG_SHA_256)];
+    size_t digest_length;
+
+    *hash = 0;
+    if (pubkey == NULL) {
+        return PSA_SUCCESS;
+    }
+    status = psa_hash_setup(&operation, PSA_ALG_SHA_256);
+    if (status == PSA_SUCCESS) {
+        status = psa_hash_update(&operation, pubkey, pubkey_length);
+    }
+    if (status == PSA_SUCCESS) {
+        status = psa_hash_finish(&operation, digest, sizeof(digest),
+                                 &digest_length);
+    }
+    if (status != PSA_SUCCESS) {
+        psa_hash_abort(&operation);
+        return status;
+    }
+    *hash = get_u16(digest);
+    return PSA_SUCCESS;
+}
+
+psa_status_t atecc608a_key_index_record_key(uint16_t slot,
+                                            atecc608a_key_role_t role,
+                                            const uint8_t *pubkey,
+                                            size_t pubkey_length)
+{
+    int entry = entry_of(slot);
+    uint16_t hash;
+    psa_status_t status;
+
+    if (entry < 0) {
+        return PSA_ERROR_INVALID_ARGUMENT;
+    }
+    /* Hashed before the lock is taken. */
+    status = pubkey_hash(pubkey, pubkey_length, &hash);
+    if (status != PSA_SUCCESS) {
+        return status;
+    }
+
+    atecc608a_lock_acquire(&index_lock);
+    if (!index_loaded) {
+        status = PSA_ERROR_BAD_STATE;
+    } else {
+        entries[entry].role = (uint8_t) role;
+        entries[entry].state = ATECC608A_KEY_STATE_ACTIVE;
+        entries[entry].generation++;
+        entries[entry].pubkey_hash = hash;
+        status = commit(true);
+    }
+    atecc608a_lock_release(&index_lock);
+    return status;
+}
+
+psa_status_t atecc608a_key_index_set_key_id(uint16_t slot, uint16_t key_id)
+{
+    int entry = entry_of(slot);
+    int current;
+    psa_status_t status;
+
+    if (entry < 0) {
+        return PSA_ERROR_INVALID_ARGUMENT;
+    }
+
+    atecc608a_lock_acquire(&index_lock);
+    current = find(key_id);
+    if (!index_loaded) {
+        status = PSA_ERROR_BAD_STATE;
+    } else if (current == slot) {
+        status = PSA_SUCCESS;
+    } else if (current >= 0) {
+        status = PSA_ERROR_ALREADY_EXISTS;
+    } else {
+        entries[entry].key_id = key_id;
+        status = commit(true);
+    }
+    atecc608a_lock_release(&index_lock);
+    return status;
+}
+
+psa_status_t atecc608a_key_index_set_state(uint16_t slot,
+                                           atecc608a_key_state_t state)
+{
+    int entry = entry_of(slot);
+    psa_status_t status;
+
+    if (entry < 0) {
+        return PSA_ERROR_INVALID_ARGUMENT;
+    }
+
+    atecc608a_lock_acquire(&index_lock);
+    if (!index_loaded) {
+        status = PSA_ERROR_BAD_STATE;
+    } else if (entries[entry].state == state) {
+        status = PSA_SUCCESS;
+    } else {
+        entries[entry].state = (uint8_t) state;
+        status = commit(true);
+        if (status == PSA_SUCCESS) {
+            /* Ignored if the event log is not open. */
+            atecc608a_event_log_append(ATECC608A_EVENT_KEY_STATE, slot,
+                                       (uint16_t) state);
+        }
+    }
+    atecc608a_lock_release(&index_lock);
+    return status;
+}
+
+psa_status_t atecc608a_key_index_batch_begin(void)
+{
+    /* Held until the batch ends. */
+    atecc608a_lock_acquire(&index_lock);
+    if (!index_loaded || batch_depth != 0) {
+        atecc608a_lock_release(&index_lock);
+        return PSA_ERROR_BAD_STATE;
+    }
+    batch_depth = 1;
+    batch_dirty = false;
+    return PSA_SUCCESS;
+}
+
+psa_status_t atecc608a_key_index_batch_commit(void)
+{
+    psa_status_t status = PSA_SUCCESS;
+
+    /* Another thread waits here until the batch is over. */
+    atecc608a_lock_acquire(&index_lock);
+    if (batch_depth == 0) {
+        atecc608a_lock_release(&index_lock);
+        return PSA_ERROR_BAD_STATE;
+    }
+    batch_depth = 0;
+    last_write_blocks = 0;
+    if (batch_dirty) {
+        status = commit(true);
+    }
+    /* Once for this call and once for the batch. */
+    atecc608a_lock_release(&index_lock);
+    atecc608a_lock_release(&index_lock);
+    return status;
+}
+
+void atecc608a_key_index_batch_abort(void)
+{
+    atecc608a_lock_acquire(&index_lock);
+    if (batch_depth == 0) {
+        atecc608a_lock_release(&index_lock);
+        return;
+    }
+    batch_depth = 0;
+    if (batch_dirty) {
+        /* The device copy is untouched. */
+        deserialize(stored);
+        rebuild_buckets();
+    }
+    atecc608a_lock_release(&index_lock);
+    atecc608a_lock_release(&index_lock);
+}
+
+uint32_t atecc608a_key_index_last_write_blocks(void)
+{
+    return last_write_blocks;
+}
+
+uint32_t atecc608a_key_index_journal_writes(void)
+{
+    return journal_writes;
+}
+
+static const char *role_name(uint8_t role)
+{
+    switch (role) {
+        case ATECC608A_KEY_ROLE_UNUSED:
+            return "unused";
+        case ATECC608A_KEY_ROLE_PRIVATE_KEY:
+            return "private";
+        case ATECC608A_KEY_ROLE_PUBLIC_KEY:
+            return "public";
+        case ATECC608A_KEY_ROLE_SECRET:
+            return "secret";
+        case ATECC608A_KEY_ROLE_DATA:
+            return "data";
+        default:
+            return "?";
+    }
+}
+
+static const char *state_name(uint8_t state)
+{
+    switch (state) {
+        case ATECC608A_KEY_STATE_EMPTY:
+            return "empty";
+        case ATECC608A_KEY_STATE_ACTIVE:
+            return "active";
+        case ATECC608A_KEY_STATE_REVOKED:
+            return "revoked";
+        default:
+            return "?";
+    }
+}
+
+void atecc608a_key_index_print(void)
+{
+    atecc608a_key_index_entry_t copy[ENTRY_COUNT];
+    uint16_t generation;
+    bool loaded;
+
+    /* Printed from a copy, the console is slow. */
+    atecc608a_lock_acquire(&index_lock);
+    loaded = index_loaded;
+    generation = index_generation;
+    memcpy(copy, entries, sizeof(copy));
+    atecc608a_lock_release(&index_lock);
+
+    if (!loaded) {
+        printf("No key index loaded.\n");
+        return;
+    }
+    printf("--- Key index (slot %d, version %d, generation %u) ---\n",
+           ATECC608A_KEY_INDEX_SLOT, ATECC608A_KEY_INDEX_VERSION,
+           generation);
+    printf("  slot  key ID  role     state    gen  pubkey hash\n");
+    for (int i = 0; i < ENTRY_COUNT; i++) {
+        const atecc608a_key_index_entry_t *entry = &copy[i];
+
+        printf("  %4u  ", slot_of(i));
+        if (entry->key_id == ATECC608A_KEY_ID_NONE) {
+            printf("     -");
+        } else {
+            printf("%6u", entry->key_id);
+        }
+        printf("  %-7s  %-7s  %4u  ", role_name(entry->role),
+               state_name(entry->state), entry->generation);
+        if (entry->pubkey_hash != 0) {
+            printf("%04X\n", entry->pubkey_hash);
+        } else {
+            printf("-\n");
+        }
+    }
+    printf("-----------------------------------------------------\n");
+}
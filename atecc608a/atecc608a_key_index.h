@@ -0,0 +1,139 @@
+/**
+ * \file atecc608a_key_index.h
+ * \brief Key metadata index kept in a data slot of the device.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_KEY_INDEX_H
+#define ATECC608A_KEY_INDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "psa/crypto.h"
+
+/** Data slot holding the index, with clear read and write in the dev
+ *  template. Its first block is left to scratch use by tests. */
+#define ATECC608A_KEY_INDEX_SLOT 8
+#define ATECC608A_KEY_INDEX_OFFSET 32
+
+/** An 8 byte header and an 8 byte entry for each slot but the index slot:
+ *  four 32 byte blocks. */
+#define ATECC608A_KEY_INDEX_SIZE 128
+#define ATECC608A_KEY_INDEX_VERSION 1
+
+/** PSA internal trusted storage UID of the journal that makes updates of
+ *  more than one entry block atomic. */
+#define ATECC608A_KEY_INDEX_JOURNAL_UID 0x4B494A31
+
+/** Key ID of a slot that has none assigned. */
+#define ATECC608A_KEY_ID_NONE 0xFFFF
+
+typedef enum {
+    ATECC608A_KEY_ROLE_UNUSED,
+    ATECC608A_KEY_ROLE_PRIVATE_KEY,
+    ATECC608A_KEY_ROLE_PUBLIC_KEY,
+    /** A secret that cannot be read, e.g. an ECDH output. */
+    ATECC608A_KEY_ROLE_SECRET,
+    ATECC608A_KEY_ROLE_DATA,
+} atecc608a_key_role_t;
+
+typedef enum {
+    /** Nothing was recorded in the slot since the index was formatted. */
+    ATECC608A_KEY_STATE_EMPTY,
+    ATECC608A_KEY_STATE_ACTIVE,
+    /** The key is still in the slot but must not be used. */
+    ATECC608A_KEY_STATE_REVOKED,
+} atecc608a_key_state_t;
+
+typedef struct {
+    uint16_t key_id;
+    uint8_t role;
+    uint8_t state;
+    /** Number of keys recorded in the slot so far. */
+    uint16_t generation;
+    /** First two bytes of the SHA-256 of the public key in the export
+     *  format, to tell keys apart, 0 if there is no public key. */
+    uint16_t pubkey_hash;
+} atecc608a_key_index_entry_t;
+
+/** Read the index with one bulk read and check its CRC. Fails with
+ *  PSA_ERROR_DOES_NOT_EXIST if the slot holds no valid index. An update
+ *  that was interrupted, e.g. by a reset, is rolled back first, or
+ *  completed if it changed a single entry block. */
+psa_status_t atecc608a_key_index_load(void);
+
+/** Write a new index with no keys recorded. Slot roles are derived from the
+ *  KeyConfig of every slot in `config`, a 128 byte config zone image. */
+psa_status_t atecc608a_key_index_format(const uint8_t *config,
+                                        size_t config_size);
+
+bool atecc608a_key_index_loaded(void);
+
+/** Number of index updates written since it was formatted. */
+uint16_t atecc608a_key_index_generation(void);
+
+/** Entry of `slot`, or NULL if the index is not loaded or the slot is the
+ *  index slot itself. The entry is updated in place by later changes from
+ *  any thread. */
+const atecc608a_key_index_entry_t *atecc608a_key_index_entry(uint16_t slot);
+
+/** Slot of the key with the given ID, or -1. Constant time on average. */
+int atecc608a_key_index_find(uint16_t key_id);
+
+/** Record that a new key was put in `slot`: it becomes active, its
+ *  generation is bumped, and the hash of `pubkey` (the key itself or the
+ *  public part of a private key, may be NULL) is kept. */
+psa_status_t atecc608a_key_index_record_key(uint16_t slot,
+                                            atecc608a_key_role_t role,
+                                            const uint8_t *pubkey,
+                                            size_t pubkey_length);
+
+/** Assign a logical ID to `slot`, ATECC608A_KEY_ID_NONE to remove it. Fails
+ *  with PSA_ERROR_ALREADY_EXISTS if another slot has the ID. */
+psa_status_t atecc608a_key_index_set_key_id(uint16_t slot, uint16_t key_id);
+
+psa_status_t atecc608a_key_index_set_state(uint16_t slot,
+                                           atecc608a_key_state_t state);
+
+/** Start collecting updates in RAM, to write them with one journaled
+ *  update by atecc608a_key_index_batch_commit(), e.g. while provisioning
+ *  many keys. If the batch is cut short, the index stays as it was before
+ *  it: keys generated meanwhile are not recorded.
+ *
+ *  The batch belongs to the calling thread, which must end it. Index calls
+ *  of other threads wait until it ends. Batches do not nest. */
+psa_status_t atecc608a_key_index_batch_begin(void);
+
+/** Write the updates of the batch, if any, and end it. */
+psa_status_t atecc608a_key_index_batch_commit(void);
+
+/** Drop the updates of the batch and end it. */
+void atecc608a_key_index_batch_abort(void);
+
+/** Number of 32 byte blocks written by the last update. */
+uint32_t atecc608a_key_index_last_write_blocks(void);
+
+/** Number of updates so far that saved the index in the journal first. */
+uint32_t atecc608a_key_index_journal_writes(void);
+
+void atecc608a_key_index_print(void);
+
+#endif /* ATECC608A_KEY_INDEX_H */
@@ -0,0 +1,383 @@
+/**
+ * \file atecc608a_load_commands.c
+ * \brief Console commands that put the device under load from several threads
+ *        and through the service.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include "atecc608a_load_commands.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "atecc608a_contention.h"
+#include "atecc608a_coro_pipeline.h"
+#include "atecc608a_event_log.h"
+#include "atecc608a_loadgen.h"
+#include "atecc608a_lock.h"
+#include "atecc608a_service.h"
+#include "atecc608a_stats.h"
+#include "atecc608a_utils.h"
+
+/* Settings of the load generator. The key slots are taken from the test
+ * settings when a run starts. */
+static atecc608a_loadgen_config_t loadgen_config = {
+    .arrival = ATECC608A_LOADGEN_POISSON,
+    .weights = { 1, 1, 1, 1, 1 },
+    .max_delay_ms = 10000,
+    .data_slot = 8,
+};
+
+/* The load generator runs with the event log suspended, from the key setup
+ * on. */
+static void loadgen_job_stop()
+{
+    atecc608a_loadgen_stop();
+    atecc608a_event_log_resume();
+}
+
+static job_step_result_t loadgen_job_step(uint32_t done)
+{
+    (void) done;
+    return atecc608a_loadgen_step() ? JOB_STEP_CONTINUE : JOB_STEP_FINISHED;
+}
+
+static void start_loadgen(double max_rate, uint32_t levels, uint32_t seconds)
+{
+    psa_status_t status;
+
+    /* The key setup talks to the device, so refuse before doing it. */
+    if (job_busy()) {
+        return;
+    }
+    loadgen_config.duration_s = seconds;
+    loadgen_config.private_slot = atecc608a_private_key_slot;
+    loadgen_config.public_slot = atecc608a_public_key_slot;
+    atecc608a_event_log_suspend();
+    status = atecc608a_loadgen_start(&loadgen_config, max_rate, levels);
+    if (status != PSA_SUCCESS) {
+        atecc608a_event_log_resume();
+        printf("Failed to start the load generator. Error %ld.\n",
+               (long) status);
+        return;
+    }
+    start_job("loadgen", loadgen_job_step, loadgen_job_stop, 0);
+}
+
+#define SERVICE_AGING_HIGH_REQUESTS 4
+#define SERVICE_AGING_FILL_SIZE 64
+
+/* Test that a bulk random fill completes while high priority requests keep
+ * the service busy, each step once it aged to the top, instead of waiting
+ * for the high priority stream to end. */
+static psa_status_t test_service_aging()
+{
+    static atecc608a_request_t high[SERVICE_AGING_HIGH_REQUESTS];
+    static uint8_t random[SERVICE_AGING_HIGH_REQUESTS][32];
+    static atecc608a_request_t bulk;
+    static uint8_t fill[SERVICE_AGING_FILL_SIZE];
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+    /* Each step of the fill needs two aging periods to reach the top, twice
+     * that is plenty. */
+    uint64_t give_up_us = atecc608a_time_us() +
+                          4 * (SERVICE_AGING_FILL_SIZE / 32) *
+                          (uint64_t) ATECC608A_SERVICE_AGING_US;
+    size_t submitted = 0;
+    bool bulk_submitted = false;
+
+    ASSERT_STATUS(atecc608a_service_start(), true,
+                  PSA_ERROR_INSUFFICIENT_MEMORY);
+    for (; submitted < SERVICE_AGING_HIGH_REQUESTS; submitted++) {
+        memset(&high[submitted], 0, sizeof(high[submitted]));
+        high[submitted].op = ATECC608A_REQUEST_RANDOM;
+        high[submitted].priority = ATECC608A_PRIORITY_HIGH;
+        high[submitted].data = random[submitted];
+        high[submitted].data_size = sizeof(random[submitted]);
+        ASSERT_SUCCESS_PSA(atecc608a_service_submit(&high[submitted]));
+    }
+    memset(&bulk, 0, sizeof(bulk));
+    bulk.op = ATECC608A_REQUEST_RANDOM_FILL;
+    bulk.priority = ATECC608A_PRIORITY_BULK;
+    bulk.data = fill;
+    bulk.data_size = sizeof(fill);
+    ASSERT_SUCCESS_PSA(atecc608a_service_submit(&bulk));
+    bulk_submitted = true;
+
+    while (!atecc608a_service_is_done(&bulk)) {
+        ASSERT_STATUS(atecc608a_time_us() < give_up_us, true,
+                      PSA_ERROR_GENERIC_ERROR);
+        osThreadFlagsWait(ATECC608A_SERVICE_DONE_FLAG, osFlagsWaitAny, 10);
+        for (size_t i = 0; i < SERVICE_AGING_HIGH_REQUESTS; i++) {
+            if (atecc608a_service_is_done(&high[i])) {
+                ASSERT_SUCCESS_PSA(high[i].status);
+                ASSERT_SUCCESS_PSA(atecc608a_service_submit(&high[i]));
+            }
+        }
+    }
+    ASSERT_SUCCESS_PSA(bulk.status);
+
+    TEST_PASSED("test_service_aging");
+exit:
+    /* The requests are reused by the next run, and a starved fill finishes
+     * once the stream stops. */
+    for (size_t i = 0; i < submitted; i++) {
+        (void) atecc608a_service_wait(&high[i], 1000);
+    }
+    if (bulk_submitted) {
+        (void) atecc608a_service_wait(&bulk, 1000);
+    }
+    return status;
+}
+
+/* The fill, and the high priority requests served while each of its steps
+ * ages, about 20 ms apiece. */
+static const atecc608a_cost_step_t cost_service_aging[] = {
+    { ATECC608A_COST_RANDOM, SERVICE_AGING_FILL_SIZE / 32 *
+                             (1 + 2 * ATECC608A_SERVICE_AGING_US / 20000) },
+};
+
+const test_step_t test_step_service_aging = {
+    "test_service_aging", test_service_aging, COST_STEPS(cost_service_aging)
+    FIXTURE(LOCKED)
+};
+
+static bool run_load_command(char *command, char *arg)
+{
+    if (strncmp(command, "contention=", strlen("contention=")) == 0) {
+        const char *requests = strchr(arg + 1, '_');
+        psa_status_t status;
+
+        if (requests == NULL) {
+            printf("Please specify the number of threads and of requests.\n");
+            return true;
+        }
+        if (job_busy()) {
+            return true;
+        }
+        status = atecc608a_contention_run((uint32_t) atoi(arg + 1),
+                                          (uint32_t) atoi(requests + 1));
+        if (status != PSA_SUCCESS) {
+            printf("Contention run failed. Error %ld.\n", (long) status);
+        }
+    } else if (strncmp(command, "coro_pipeline=", strlen("coro_pipeline=")) == 0) {
+        const char *concurrency = strchr(arg + 1, '_');
+        psa_status_t status;
+
+        if (concurrency == NULL) {
+            printf("Please specify the number of attestations and of "
+                   "coroutines.\n");
+            return true;
+        }
+        if (job_busy()) {
+            return true;
+        }
+        status = atecc608a_coro_pipeline((uint32_t) atoi(arg + 1),
+                                         (uint32_t) atoi(concurrency + 1));
+        if (status == PSA_ERROR_NOT_SUPPORTED) {
+            printf("Coroutines need a C++20 build.\n");
+        } else if (status != PSA_SUCCESS) {
+            printf("Coroutine pipeline failed. Error %ld.\n", (long) status);
+        }
+    } else if (strncmp(command, "lock_stress=", strlen("lock_stress=")) == 0) {
+        const char *iterations = strchr(arg + 1, '_');
+        psa_status_t status;
+
+        if (iterations == NULL) {
+            printf("Please specify the number of threads and of calls.\n");
+            return true;
+        }
+        if (job_busy()) {
+            return true;
+        }
+        status = atecc608a_contention_stress((uint32_t) atoi(arg + 1),
+                                             (uint32_t) atoi(iterations + 1));
+        if (status != PSA_SUCCESS) {
+            printf("Lock stress failed. Error %ld.\n", (long) status);
+        }
+    } else if (strcmp(command, "locks") == 0) {
+        atecc608a_locks_print();
+    } else if (strncmp(command, "priorities=", strlen("priorities=")) == 0) {
+        psa_status_t status;
+
+        if (job_busy()) {
+            return true;
+        }
+        status = atecc608a_contention_priorities(atecc608a_private_key_slot,
+                                                 (uint32_t) atoi(arg + 1));
+        if (status != PSA_SUCCESS) {
+            printf("Priority run failed. Error %ld.\n", (long) status);
+        }
+    } else if (strncmp(command, "loadgen_mix=", strlen("loadgen_mix=")) == 0) {
+        atecc608a_loadgen_set_mix(&loadgen_config, arg + 1);
+    } else if (strncmp(command, "loadgen_arrival=",
+                       strlen("loadgen_arrival=")) == 0) {
+        if (strcmp(arg + 1, "poisson") == 0) {
+            loadgen_config.arrival = ATECC608A_LOADGEN_POISSON;
+        } else if (strcmp(arg + 1, "constant") == 0) {
+            loadgen_config.arrival = ATECC608A_LOADGEN_CONSTANT;
+        } else {
+            printf("Unknown arrival process \'%s\'.\n", arg + 1);
+        }
+    } else if (strncmp(command, "loadgen_sweep=", strlen("loadgen_sweep=")) == 0) {
+        char *levels = strchr(arg, '_');
+        char *seconds = levels != NULL ? strchr(levels + 1, '_') : NULL;
+
+        if (seconds == NULL) {
+            printf("Please specify the maximum rate, the number of steps and "
+                   "the duration of each step.\n");
+            return true;
+        }
+        start_loadgen(atof(arg + 1), (uint32_t) atoi(levels + 1),
+                      (uint32_t) atoi(seconds + 1));
+    } else if (strncmp(command, "loadgen=", strlen("loadgen=")) == 0) {
+        char *seconds = strchr(arg, '_');
+
+        if (seconds == NULL) {
+            printf("Please specify both the rate and the duration.\n");
+            return true;
+        }
+        start_loadgen(atof(arg + 1), 1, (uint32_t) atoi(seconds + 1));
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool estimate_load_command(const char *command, const char *arg,
+                                  uint64_t *estimate_us)
+{
+    uint64_t us = 0;
+
+    if (strncmp(command, "contention=", strlen("contention=")) == 0 &&
+               strchr(arg + 1, '_') != NULL) {
+        /* Both runs make every request once, one at a time on the device. */
+        atecc608a_cost_step_t step = { ATECC608A_COST_RANDOM, 2 };
+
+        printf("[dry run] %s\n", command);
+        us = print_estimate("contention", &step, 1,
+                            (uint32_t) atoi(arg + 1) *
+                            (uint32_t) atoi(strchr(arg + 1, '_') + 1));
+    } else if (strncmp(command, "coro_pipeline=", strlen("coro_pipeline=")) == 0 &&
+               strchr(arg + 1, '_') != NULL) {
+        /* Every attestation is made once blocking and once from a
+         * coroutine. */
+        static const atecc608a_cost_step_t steps[] = {
+            { ATECC608A_COST_RANDOM, 2 },
+            { ATECC608A_COST_SHA_SHORT, 2 },
+            { ATECC608A_COST_SIGN, 2 },
+        };
+
+        printf("[dry run] %s\n", command);
+        us = print_estimate("coro_pipeline", steps, 3,
+                            (uint32_t) atoi(arg + 1));
+    } else if (strncmp(command, "lock_stress=", strlen("lock_stress=")) == 0 &&
+               strchr(arg + 1, '_') != NULL) {
+        /* A serial number read, a random number and a lock check in every
+         * four calls, the key index lookup needs no device. */
+        static const atecc608a_cost_step_t steps[] = {
+            { ATECC608A_COST_READ_BLOCK, 1 },
+            { ATECC608A_COST_RANDOM, 1 },
+            { ATECC608A_COST_READ_WORD, 1 },
+        };
+
+        printf("[dry run] %s\n", command);
+        us = print_estimate("lock_stress (per 4 calls)", steps, 3,
+                            (uint32_t) atoi(arg + 1) *
+                            (uint32_t) atoi(strchr(arg + 1, '_') + 1) / 4);
+    } else if (strncmp(command, "priorities=", strlen("priorities=")) == 0) {
+        /* Both runs last `seconds`, the periodic requests take their share
+         * of it and the bulk fills the rest, unless the periodic requests
+         * alone take longer. */
+        uint64_t run_ms = 2000ULL * (uint32_t) atoi(arg + 1);
+        atecc608a_cost_step_t sign = { ATECC608A_COST_SIGN, 1 };
+        atecc608a_cost_step_t random = { ATECC608A_COST_RANDOM, 1 };
+        atecc608a_cost_step_t fill = {
+            ATECC608A_COST_RANDOM, ATECC608A_PRIORITIES_FILL_SIZE / 32
+        };
+        uint64_t fill_us = atecc608a_cost_model_estimate_us(&fill, 1);
+
+        printf("[dry run] %s\n", command);
+        us = print_estimate("priorities (high)", &sign, 1, (uint32_t)
+                            (run_ms / ATECC608A_PRIORITIES_SIGN_PERIOD_MS));
+        us += print_estimate("priorities (normal)", &random, 1, (uint32_t)
+                             (run_ms / ATECC608A_PRIORITIES_RANDOM_PERIOD_MS));
+        if (us < run_ms * 1000 && fill_us != 0) {
+            us += print_estimate("priorities (bulk)", &fill, 1,
+                                 (uint32_t)((run_ms * 1000 - us) / fill_us));
+        }
+    } else if (strncmp(command, "loadgen=", strlen("loadgen=")) == 0 &&
+               arg != NULL) {
+        const char *seconds = strchr(arg, '_');
+
+        printf("[dry run] %s\n", command);
+        if (seconds != NULL) {
+            us = atoi(seconds + 1) * 1000000ULL;
+        }
+    } else if (strncmp(command, "loadgen_sweep=", strlen("loadgen_sweep=")) == 0 &&
+               arg != NULL) {
+        const char *levels = strchr(arg, '_');
+        const char *seconds = levels != NULL ? strchr(levels + 1, '_') : NULL;
+
+        /* An upper bound, a sweep stops early once the device saturates. */
+        printf("[dry run] %s (at most)\n", command);
+        if (seconds != NULL) {
+            us = (uint64_t) atoi(levels + 1) * atoi(seconds + 1) * 1000000ULL;
+        }
+    } else {
+        return false;
+    }
+    *estimate_us = us;
+    return true;
+}
+
+static const char *const load_host_commands[] = {
+    "locks", "loadgen_mix=", "loadgen_arrival=", NULL,
+};
+
+const command_module_t load_commands = {
+    " - loadgen=%f_%d - offer a load of a given rate (requests per second)\n"
+    "                   for a given number of seconds, in the background;\n"
+    " - loadgen_sweep=%f_%d_%d - offer loads in steps (second argument)\n"
+    "                             up to a maximum rate (first argument), each\n"
+    "                             for a given number of seconds;\n"
+    " - loadgen_mix=%s:%d,... - relative weights of sign, verify, random,\n"
+    "                           sha and read requests;\n"
+    " - loadgen_arrival=poisson|constant - request arrival process;\n"
+    " - contention=%d_%d - compare the latency of random requests from a\n"
+    "                      number of threads (1-4, first argument) sending\n"
+    "                      a number of requests each (second argument),\n"
+    "                      through the lock-free service ring and through\n"
+    "                      the device lock;\n"
+    " - coro_pipeline=%d_%d - make a number of attestations (random, SHA-256\n"
+    "                         and a signature with slot 0, first argument)\n"
+    "                         one after the other, then from a number of\n"
+    "                         coroutines (1-32, second argument) on one\n"
+    "                         thread, print operations per second and the\n"
+    "                         scheduling overhead of each await (needs a\n"
+    "                         C++20 build);\n"
+    " - lock_stress=%d_%d - call the utilities from a number of threads\n"
+    "                      (1-4, first argument) at once, a number of times\n"
+    "                      each (second argument), check the results and\n"
+    "                      print lock statistics;\n"
+    " - locks - print the wait and hold times of the device and cache locks;\n"
+    " - priorities=%d - for a number of seconds with the scheduler on and\n"
+    "                  then off, send high priority signatures, normal\n"
+    "                  priority random requests and bulk random fills\n"
+    "                  through the service, print per-priority latency;\n",
+    load_host_commands, run_load_command, estimate_load_command,
+};
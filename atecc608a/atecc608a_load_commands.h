@@ -0,0 +1,37 @@
+/**
+ * \file atecc608a_load_commands.h
+ * \brief Console commands that put the device under load from several threads
+ *        and through the service.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_LOAD_COMMANDS_H
+#define ATECC608A_LOAD_COMMANDS_H
+
+#include "atecc608a_app.h"
+
+/** loadgen, loadgen_sweep, loadgen_mix, loadgen_arrival, contention,
+ *  coro_pipeline, lock_stress, locks and priorities. */
+extern const command_module_t load_commands;
+
+/** Test that a bulk random fill completes while high priority requests
+ *  keep the service busy. */
+extern const test_step_t test_step_service_aging;
+
+#endif /* ATECC608A_LOAD_COMMANDS_H */
@@ -0,0 +1,349 @@
+/**
+ * \file atecc608a_loadgen.c
+ * \brief Open-loop load generator for the ATECC608A driver.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include "atecc608a_loadgen.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "atca_basic.h"
+#include "atecc608a_se.h"
+#include "atecc608a_stats.h"
+#include "atecc608a_utils.h"
+
+/* Requests are issued on a schedule that does not depend on when earlier
+ * requests complete (an open loop), and each latency is measured from the
+ * request's intended start time rather than from when the device got to it.
+ * When the device falls behind, the time requests spend waiting is therefore
+ * part of the measurement instead of being silently omitted. */
+
+static const char *const op_names[ATECC608A_LOADGEN_OP_COUNT] = {
+    "sign", "verify", "random", "sha", "read",
+};
+
+static struct {
+    atecc608a_loadgen_config_t config;
+    bool active;
+    double max_rate;
+    uint32_t levels;
+    /* Current load level, from 1 to `levels`. */
+    uint32_t level;
+    double rate;
+    uint32_t rng_state;
+    uint32_t total_weight;
+    uint64_t level_start_us;
+    uint64_t next_arrival_us;
+    uint64_t last_completion_us;
+    uint32_t errors;
+    bool saturated;
+    /* Intended start to completion. */
+    atecc608a_histogram_t response;
+    /* Actual start to completion. */
+    atecc608a_histogram_t service;
+    uint8_t hash[32];
+    uint8_t signature[64];
+    size_t signature_length;
+} loadgen;
+
+const char *atecc608a_loadgen_op_name(atecc608a_loadgen_op_t op)
+{
+    return op < ATECC608A_LOADGEN_OP_COUNT ? op_names[op] : "unknown";
+}
+
+bool atecc608a_loadgen_set_mix(atecc608a_loadgen_config_t *config, char *mix)
+{
+    uint32_t weights[ATECC608A_LOADGEN_OP_COUNT] = {0};
+    uint32_t total = 0;
+    char *entry = mix;
+
+    while (entry != NULL && *entry != '\0') {
+        char *next = strchr(entry, ',');
+        char *colon = strchr(entry, ':');
+        size_t op;
+
+        if (next != NULL) {
+            *next++ = '\0';
+        }
+        if (colon == NULL) {
+            printf("Missing weight for \'%s\' in load mix.\n", entry);
+            return false;
+        }
+        *colon = '\0';
+        for (op = 0; op < ATECC608A_LOADGEN_OP_COUNT; op++) {
+            if (strcmp(op_names[op], entry) == 0) {
+                break;
+            }
+        }
+        if (op == ATECC608A_LOADGEN_OP_COUNT) {
+            printf("Unknown operation \'%s\' in load mix.\n", entry);
+            return false;
+        }
+        weights[op] = (uint32_t) atoi(colon + 1);
+        total += weights[op];
+        entry = next;
+    }
+    if (total == 0) {
+        printf("Load mix has to include at least one operation.\n");
+        return false;
+    }
+    memcpy(config->weights, weights, sizeof(weights));
+    return true;
+}
+
+/* xorshift32 - the schedule and the mix only need to be statistically
+ * reasonable and repeatable, not unpredictable. */
+static uint32_t next_random(void)
+{
+    uint32_t x = loadgen.rng_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    loadgen.rng_state = x;
+    return x;
+}
+
+static uint64_t next_interarrival_us(void)
+{
+    double mean_us = 1000000.0 / loadgen.rate;
+
+    if (loadgen.config.arrival == ATECC608A_LOADGEN_POISSON) {
+        /* Uniform in (0, 1], so that log() is always finite. */
+        double u = ((next_random() >> 8) + 1) / 16777216.0;
+        return (uint64_t)(-log(u) * mean_us + 0.5);
+    }
+    return (uint64_t)(mean_us + 0.5);
+}
+
+static atecc608a_loadgen_op_t next_op(void)
+{
+    uint32_t pick = next_random() % loadgen.total_weight;
+    uint32_t op;
+
+    for (op = 0; op < ATECC608A_LOADGEN_OP_COUNT - 1; op++) {
+        if (pick < loadgen.config.weights[op]) {
+            break;
+        }
+        pick -= loadgen.config.weights[op];
+    }
+    return (atecc608a_loadgen_op_t) op;
+}
+
+static psa_status_t hash_64_bytes(void)
+{
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+    uint8_t message[64];
+    uint8_t digest[ATCA_SHA_DIGEST_SIZE];
+
+    memset(message, 0x5A, sizeof(message));
+    atecc608a_device_lock();
+    ASSERT_SUCCESS_PSA(atecc608a_init());
+    ASSERT_SUCCESS(atcab_hw_sha2_256(message, sizeof(message), digest));
+
+exit:
+    atecc608a_deinit();
+    atecc608a_device_unlock();
+    return status;
+}
+
+static psa_status_t run_op(atecc608a_loadgen_op_t op)
+{
+    const psa_algorithm_t alg = PSA_ALG_ECDSA(PSA_ALG_SHA_256);
+    uint8_t buffer[64];
+    size_t length;
+
+    switch (op) {
+        case ATECC608A_LOADGEN_SIGN:
+            return atecc608a_driver()->p_asym->p_sign(
+                       loadgen.config.private_slot, alg, loadgen.hash,
+                       sizeof(loadgen.hash), buffer, sizeof(buffer), &length);
+        case ATECC608A_LOADGEN_VERIFY:
+            return atecc608a_driver()->p_asym->p_verify(
+                       loadgen.config.public_slot, alg, loadgen.hash,
+                       sizeof(loadgen.hash), loadgen.signature,
+                       loadgen.signature_length);
+        case ATECC608A_LOADGEN_RANDOM:
+            return atecc608a_random_32_bytes(buffer, sizeof(buffer));
+        case ATECC608A_LOADGEN_SHA:
+            return hash_64_bytes();
+        case ATECC608A_LOADGEN_READ:
+            return atecc608a_device_read(loadgen.config.data_slot, 0, buffer, 32);
+        default:
+            return PSA_ERROR_NOT_SUPPORTED;
+    }
+}
+
+/* Print a non-negative value with two decimals. */
+static void print_hundredths(double value)
+{
+    uint32_t hundredths = (uint32_t)(value * 100.0 + 0.5);
+    printf("%lu.%02lu", (unsigned long)(hundredths / 100),
+           (unsigned long)(hundredths % 100));
+}
+
+static void start_level(void)
+{
+    loadgen.rate = loadgen.max_rate * loadgen.level / loadgen.levels;
+    loadgen.errors = 0;
+    loadgen.saturated = false;
+    atecc608a_histogram_reset(&loadgen.response);
+    atecc608a_histogram_reset(&loadgen.service);
+    loadgen.level_start_us = atecc608a_time_us();
+    loadgen.last_completion_us = loadgen.level_start_us;
+    loadgen.next_arrival_us = loadgen.level_start_us + next_interarrival_us();
+}
+
+static void print_level(void)
+{
+    uint64_t elapsed_us = loadgen.last_completion_us - loadgen.level_start_us;
+    double throughput = elapsed_us == 0 ? 0.0 :
+                        loadgen.response.total * 1000000.0 / elapsed_us;
+
+    print_hundredths(loadgen.rate);
+    printf(" | ");
+    print_hundredths(throughput);
+    printf(" | %lu | %lu | %lu | %lu | %lu | %lu | %lu%s\n",
+           (unsigned long) loadgen.response.total,
+           (unsigned long) atecc608a_histogram_percentile(&loadgen.response, 50.0),
+           (unsigned long) atecc608a_histogram_percentile(&loadgen.response, 99.0),
+           (unsigned long) atecc608a_histogram_percentile(&loadgen.response, 99.9),
+           (unsigned long) loadgen.response.max,
+           (unsigned long) atecc608a_histogram_mean(&loadgen.service),
+           (unsigned long) loadgen.errors,
+           loadgen.saturated ? " | saturated" : "");
+}
+
+psa_status_t atecc608a_loadgen_start(const atecc608a_loadgen_config_t *config,
+                                     double max_rate, uint32_t levels)
+{
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+    const psa_algorithm_t alg = PSA_ALG_ECDSA(PSA_ALG_SHA_256);
+    uint8_t pubkey[PSA_KEY_EXPORT_ECC_PUBLIC_KEY_MAX_SIZE(256)];
+    size_t pubkey_length;
+
+    if (max_rate <= 0.0 || levels == 0 || config->duration_s == 0) {
+        return PSA_ERROR_INVALID_ARGUMENT;
+    }
+
+    loadgen.total_weight = 0;
+    for (size_t op = 0; op < ATECC608A_LOADGEN_OP_COUNT; op++) {
+        loadgen.total_weight += config->weights[op];
+    }
+    if (loadgen.total_weight == 0) {
+        return PSA_ERROR_INVALID_ARGUMENT;
+    }
+
+    loadgen.config = *config;
+    loadgen.max_rate = max_rate;
+    loadgen.levels = levels;
+    loadgen.level = 1;
+    loadgen.rng_state = 0x2545F491;
+    memset(loadgen.hash, 0x5A, sizeof(loadgen.hash));
+
+    /* Pair the public key slot with the signing key and make a signature to
+     * verify, so that every operation in the mix is expected to succeed. */
+    ASSERT_SUCCESS_PSA(atecc608a_driver()->p_key_management->p_export(
+                           config->private_slot, pubkey, sizeof(pubkey),
+                           &pubkey_length));
+    ASSERT_SUCCESS_PSA(atecc608a_driver()->p_key_management->p_import(
+                           config->public_slot, atecc608a_drv_info.lifetime,
+                           PSA_KEY_TYPE_ECC_PUBLIC_KEY(PSA_ECC_CURVE_SECP256R1),
+                           alg, PSA_KEY_USAGE_VERIFY, pubkey, pubkey_length));
+    ASSERT_SUCCESS_PSA(atecc608a_driver()->p_asym->p_sign(
+                           config->private_slot, alg, loadgen.hash,
+                           sizeof(loadgen.hash), loadgen.signature,
+                           sizeof(loadgen.signature),
+                           &loadgen.signature_length));
+
+    printf("Load generator: %s arrivals, %lu s per level, mix:",
+           config->arrival == ATECC608A_LOADGEN_POISSON ? "Poisson" : "constant",
+           (unsigned long) config->duration_s);
+    for (size_t op = 0; op < ATECC608A_LOADGEN_OP_COUNT; op++) {
+        if (config->weights[op] != 0) {
+            printf(" %s:%lu", op_names[op], (unsigned long) config->weights[op]);
+        }
+    }
+    printf("\nOffered/s | achieved/s | requests | p50 us | p99 us | "
+           "p99.9 us | max us | mean service us | errors\n");
+
+    loadgen.active = true;
+    start_level();
+
+exit:
+    return status;
+}
+
+bool atecc608a_loadgen_step(void)
+{
+    uint64_t now = atecc608a_time_us();
+    uint64_t end;
+    atecc608a_loadgen_op_t op;
+    psa_status_t status;
+
+    if (!loadgen.active) {
+        return false;
+    }
+
+    /* A level ends when no more requests are scheduled inside it, or once
+     * the device is too far behind the schedule to ever catch up. */
+    if (now > loadgen.next_arrival_us &&
+            now - loadgen.next_arrival_us > loadgen.config.max_delay_ms * 1000ULL) {
+        loadgen.saturated = true;
+    }
+    if (loadgen.saturated || loadgen.next_arrival_us >=
+            loadgen.level_start_us + loadgen.config.duration_s * 1000000ULL) {
+        print_level();
+        if (loadgen.saturated || loadgen.level == loadgen.levels) {
+            loadgen.active = false;
+            return false;
+        }
+        loadgen.level++;
+        start_level();
+        return true;
+    }
+
+    if (now < loadgen.next_arrival_us) {
+        return true;
+    }
+
+    op = next_op();
+    status = run_op(op);
+    end = atecc608a_time_us();
+
+    if (status != PSA_SUCCESS) {
+        loadgen.errors++;
+    }
+    atecc608a_histogram_record(&loadgen.response,
+                               (uint32_t)(end - loadgen.next_arrival_us));
+    atecc608a_histogram_record(&loadgen.service, (uint32_t)(end - now));
+    loadgen.last_completion_us = end;
+    loadgen.next_arrival_us += next_interarrival_us();
+    return true;
+}
+
+void atecc608a_loadgen_stop(void)
+{
+    if (loadgen.active) {
+        print_level();
+        loadgen.active = false;
+    }
+}
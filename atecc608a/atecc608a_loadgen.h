@@ -0,0 +1,84 @@
+/**
+ * \file atecc608a_loadgen.h
+ * \brief Open-loop load generator for the ATECC608A driver.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_LOADGEN_H
+#define ATECC608A_LOADGEN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "psa/crypto.h"
+
+typedef enum {
+    ATECC608A_LOADGEN_SIGN,
+    ATECC608A_LOADGEN_VERIFY,
+    ATECC608A_LOADGEN_RANDOM,
+    ATECC608A_LOADGEN_SHA,
+    ATECC608A_LOADGEN_READ,
+    ATECC608A_LOADGEN_OP_COUNT,
+} atecc608a_loadgen_op_t;
+
+typedef enum {
+    /** Requests arrive exactly 1/rate seconds apart. */
+    ATECC608A_LOADGEN_CONSTANT,
+    /** Exponentially distributed gaps with mean 1/rate seconds. */
+    ATECC608A_LOADGEN_POISSON,
+} atecc608a_loadgen_arrival_t;
+
+typedef struct {
+    atecc608a_loadgen_arrival_t arrival;
+    /** Relative frequency of each operation, 0 excludes it. */
+    uint32_t weights[ATECC608A_LOADGEN_OP_COUNT];
+    /** Duration of each load level, in seconds. */
+    uint32_t duration_s;
+    /** A load level is abandoned as saturated once a request is this far
+     *  behind its intended start, to bound the time spent on overload. */
+    uint32_t max_delay_ms;
+    /** Key used for signing. Its public key is copied to `public_slot`
+     *  before the run for verification. */
+    psa_key_slot_number_t private_slot;
+    psa_key_slot_number_t public_slot;
+    /** Clear read slot used by the read operation. */
+    uint16_t data_slot;
+} atecc608a_loadgen_config_t;
+
+/** Name of an operation, as used by atecc608a_loadgen_set_mix(). */
+const char *atecc608a_loadgen_op_name(atecc608a_loadgen_op_t op);
+
+/** Parse a "name:weight,..." list into `config->weights`. Operations that are
+ *  not listed are excluded. `mix` is modified. */
+bool atecc608a_loadgen_set_mix(atecc608a_loadgen_config_t *config, char *mix);
+
+/** Prepare a sweep over `levels` offered loads, evenly spaced up to
+ *  `max_rate` requests per second. A single load level is a sweep with one
+ *  level. The keys are set up here, so this talks to the device. */
+psa_status_t atecc608a_loadgen_start(const atecc608a_loadgen_config_t *config,
+                                     double max_rate, uint32_t levels);
+
+/** Run at most one request: the next one is only issued once its intended
+ *  start time has passed. Returns false when the sweep is complete. */
+bool atecc608a_loadgen_step(void);
+
+/** Print the results of the level in progress and stop the sweep. */
+void atecc608a_loadgen_stop(void);
+
+#endif /* ATECC608A_LOADGEN_H */
@@ -0,0 +1,154 @@
+/**
+ * \file atecc608a_lock.c
+ * \brief Mutexes that measure how long they are waited for and held.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "atecc608a_lock.h"
+
+#include <stdio.h>
+
+#include "platform/mbed_critical.h"
+
+#define LOCK_NOT_CREATED 0
+#define LOCK_CREATING 1
+#define LOCK_CREATED 2
+
+static atecc608a_lock_t *volatile locks[ATECC608A_LOCK_MAX_COUNT];
+static volatile uint32_t lock_count;
+
+/* Create the mutex of `lock` once. A thread that loses the race yields
+ * until the winner is done, which takes a single kernel call. */
+static void create(atecc608a_lock_t *lock)
+{
+    static const osMutexAttr_t attr = {
+        .name = "atecc608a",
+        .attr_bits = osMutexRecursive | osMutexPrioInherit,
+    };
+    uint32_t expected = LOCK_NOT_CREATED;
+
+    if (core_util_atomic_cas_u32(&lock->created, &expected, LOCK_CREATING)) {
+        uint32_t index = core_util_atomic_incr_u32(&lock_count, 1) - 1;
+
+        lock->mutex = osMutexNew(&attr);
+        atecc608a_histogram_reset(&lock->wait);
+        atecc608a_histogram_reset(&lock->hold);
+        if (index < ATECC608A_LOCK_MAX_COUNT) {
+            locks[index] = lock;
+        }
+        lock->created = LOCK_CREATED;
+        return;
+    }
+    while (lock->created != LOCK_CREATED) {
+        osThreadYield();
+    }
+}
+
+void atecc608a_lock_acquire(atecc608a_lock_t *lock)
+{
+    uint64_t start;
+
+    if (lock->created != LOCK_CREATED) {
+        create(lock);
+    }
+
+    /* The uncontended case costs no clock read. */
+    if (osMutexAcquire(lock->mutex, 0) == osOK) {
+        if (lock->depth++ == 0) {
+            lock->acquisitions++;
+            lock->acquired_us = atecc608a_time_us();
+            atecc608a_histogram_record(&lock->wait, 0);
+        }
+        return;
+    }
+
+    start = atecc608a_time_us();
+    osMutexAcquire(lock->mutex, osWaitForever);
+    lock->depth++;
+    lock->acquisitions++;
+    lock->contended++;
+    lock->acquired_us = atecc608a_time_us();
+    atecc608a_histogram_record(&lock->wait,
+                               (uint32_t)(lock->acquired_us - start));
+}
+
+void atecc608a_lock_release(atecc608a_lock_t *lock)
+{
+    if (--lock->depth == 0) {
+        atecc608a_histogram_record(&lock->hold,
+                                   (uint32_t)(atecc608a_time_us() -
+                                              lock->acquired_us));
+    }
+    osMutexRelease(lock->mutex);
+}
+
+void atecc608a_locks_reset_stats(void)
+{
+    uint32_t count = lock_count;
+
+    for (uint32_t i = 0; i < count && i < ATECC608A_LOCK_MAX_COUNT; i++) {
+        atecc608a_lock_t *lock = locks[i];
+
+        if (lock == NULL) {
+            continue;
+        }
+        atecc608a_lock_acquire(lock);
+        lock->acquisitions = 0;
+        lock->contended = 0;
+        atecc608a_histogram_reset(&lock->wait);
+        atecc608a_histogram_reset(&lock->hold);
+        atecc608a_lock_release(lock);
+    }
+}
+
+void atecc608a_locks_print(void)
+{
+    uint32_t count = lock_count;
+
+    printf("  lock        taken  contended  wait p50/p99/max us  "
+           "hold p50/p99/max us\n");
+    for (uint32_t i = 0; i < count && i < ATECC608A_LOCK_MAX_COUNT; i++) {
+        atecc608a_lock_t *lock = locks[i];
+        atecc608a_histogram_t wait;
+        atecc608a_histogram_t hold;
+        uint32_t acquisitions;
+        uint32_t contended;
+
+        if (lock == NULL) {
+            continue;
+        }
+        /* A consistent copy, printed without holding the lock. */
+        atecc608a_lock_acquire(lock);
+        wait = lock->wait;
+        hold = lock->hold;
+        acquisitions = lock->acquisitions;
+        contended = lock->contended;
+        atecc608a_lock_release(lock);
+
+        printf("  %-10s  %5lu  %9lu  %6lu/%6lu/%6lu  %6lu/%6lu/%6lu\n",
+               lock->name, (unsigned long) acquisitions,
+               (unsigned long) contended,
+               (unsigned long) atecc608a_histogram_percentile(&wait, 50),
+               (unsigned long) atecc608a_histogram_percentile(&wait, 99),
+               (unsigned long) wait.max,
+               (unsigned long) atecc608a_histogram_percentile(&hold, 50),
+               (unsigned long) atecc608a_histogram_percentile(&hold, 99),
+               (unsigned long) hold.max);
+    }
+}
@@ -0,0 +1,68 @@
+/**
+ * \file atecc608a_lock.h
+ * \brief Mutexes that measure how long they are waited for and held.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_LOCK_H
+#define ATECC608A_LOCK_H
+
+#include <stdint.h>
+
+#include "atecc608a_stats.h"
+#include "cmsis_os2.h"
+
+/** Most locks that can be created, for atecc608a_locks_print(). */
+#define ATECC608A_LOCK_MAX_COUNT 8
+
+/** A recursive, priority inheriting mutex with wait and hold time
+ *  histograms. The statistics are only updated by the thread holding the
+ *  lock. */
+typedef struct {
+    const char *name;
+    /** 0 before the mutex exists, 1 while it is being created, 2 after. */
+    volatile uint32_t created;
+    osMutexId_t mutex;
+    /** Nesting depth of the holder. */
+    uint32_t depth;
+    uint64_t acquired_us;
+    uint32_t acquisitions;
+    /** Acquisitions that found the lock held by another thread. */
+    uint32_t contended;
+    atecc608a_histogram_t wait;
+    atecc608a_histogram_t hold;
+} atecc608a_lock_t;
+
+/** Static initializer. The mutex is created on first use, so locks can be
+ *  defined at file scope and used before the kernel runs other threads. */
+#define ATECC608A_LOCK_INIT(lock_name) { .name = (lock_name) }
+
+/** Take the lock, waiting as long as needed. Not for interrupt handlers. */
+void atecc608a_lock_acquire(atecc608a_lock_t *lock);
+
+void atecc608a_lock_release(atecc608a_lock_t *lock);
+
+/** Reset the statistics of every lock created so far. */
+void atecc608a_locks_reset_stats(void);
+
+/** Print the acquisition count and the wait and hold time percentiles of
+ *  every lock created so far. */
+void atecc608a_locks_print(void);
+
+#endif /* ATECC608A_LOCK_H */
@@ -0,0 +1,548 @@
+/**
+ * \file atecc608a_placement.c
+ * \brief Placement of logical keys on the slots of a pool of devices, by
+ *        consistent hashing with bounded loads.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include "atecc608a_placement.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Chip index of a key whose device was removed. */
+#define NO_CHIP 0xFF
+
+#define HEADER_SIZE 6
+#define CHIP_SIZE 6
+#define ENTRY_SIZE 6
+#define MAX_IMAGE_SIZE (HEADER_SIZE + \
+                        ATECC608A_PLACEMENT_MAX_CHIPS * CHIP_SIZE + \
+                        ATECC608A_PLACEMENT_MAX_KEYS * ENTRY_SIZE)
+
+/* The finalizer of MurmurHash3, enough to spread small integers over the
+ * ring. */
+static uint32_t mix32(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x85EBCA6B;
+    x ^= x >> 13;
+    x *= 0xC2B2AE35;
+    x ^= x >> 16;
+    return x;
+}
+
+static uint32_t vnode_point(uint32_t chip_id, uint32_t vnode)
+{
+    return mix32(mix32(chip_id) ^ (vnode * 0x9E3779B9));
+}
+
+static uint32_t key_point(uint16_t key_id)
+{
+    return mix32(0x4B455900u | ((uint32_t) key_id << 16) | key_id);
+}
+
+static void put_u16(uint8_t *to, uint16_t value)
+{
+    to[0] = (uint8_t) value;
+    to[1] = (uint8_t)(value >> 8);
+}
+
+static uint16_t get_u16(const uint8_t *from)
+{
+    return (uint16_t)(from[0] | from[1] << 8);
+}
+
+static int compare_vnodes(const void *a, const void *b)
+{
+    uint32_t left = ((const atecc608a_placement_vnode_t *) a)->point;
+    uint32_t right = ((const atecc608a_placement_vnode_t *) b)->point;
+
+    return left < right ? -1 : left > right ? 1 : 0;
+}
+
+static void build_ring(atecc608a_placement_t *pool)
+{
+    size_t count = 0;
+
+    for (uint8_t chip = 0; chip < pool->chip_count; chip++) {
+        for (uint32_t v = 0; v < ATECC608A_PLACEMENT_VNODES; v++) {
+            pool->ring[count].point = vnode_point(pool->chips[chip].chip_id, v);
+            pool->ring[count].chip = chip;
+            count++;
+        }
+    }
+    qsort(pool->ring, count, sizeof(pool->ring[0]), compare_vnodes);
+}
+
+/* First vnode at or after `point`, wrapping around. */
+static size_t ring_start(const atecc608a_placement_t *pool, uint32_t point)
+{
+    size_t count = (size_t) pool->chip_count * ATECC608A_PLACEMENT_VNODES;
+    size_t low = 0;
+    size_t high = count;
+
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+
+        if (pool->ring[middle].point < point) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low == count ? 0 : low;
+}
+
+static uint16_t free_slots(const atecc608a_placement_chip_t *chip)
+{
+    return chip->private_slots & (uint16_t) ~chip->used_slots;
+}
+
+static bool has_room(const atecc608a_placement_chip_t *chip)
+{
+    uint16_t slots = 0;
+
+    for (uint16_t mask = chip->private_slots; mask != 0; mask &= mask - 1) {
+        slots++;
+    }
+    return chip->keys < slots;
+}
+
+static uint32_t load_bound(const atecc608a_placement_t *pool, uint32_t total,
+                           uint32_t heaviest)
+{
+    uint64_t bound;
+
+    if (pool->load_factor == 0) {
+        return UINT32_MAX;
+    }
+    bound = ((uint64_t) total * pool->load_factor +
+             100ULL * pool->chip_count - 1) / (100ULL * pool->chip_count);
+    return bound < heaviest ? heaviest : (uint32_t) bound;
+}
+
+/* Device for a key of `weight`: the first along the ring from the key with a
+ * free slot and room under `bound`, or else the least loaded one with a free
+ * slot. NO_CHIP if no device has a free slot. */
+static uint8_t choose_chip(const atecc608a_placement_t *pool, uint16_t key_id,
+                           uint16_t weight, uint32_t bound)
+{
+    size_t count = (size_t) pool->chip_count * ATECC608A_PLACEMENT_VNODES;
+    size_t at = ring_start(pool, key_point(key_id));
+    uint16_t seen = 0;
+    uint8_t lightest = NO_CHIP;
+
+    for (size_t i = 0; i < count && seen != (1u << pool->chip_count) - 1; i++) {
+        uint8_t chip = pool->ring[(at + i) % count].chip;
+        const atecc608a_placement_chip_t *candidate = &pool->chips[chip];
+
+        if (seen & (1u << chip)) {
+            continue;
+        }
+        seen |= (uint16_t)(1u << chip);
+        if (has_room(candidate) &&
+                (uint64_t) candidate->load + weight <= bound) {
+            return chip;
+        }
+    }
+    for (uint8_t chip = 0; chip < pool->chip_count; chip++) {
+        if (has_room(&pool->chips[chip]) &&
+                (lightest == NO_CHIP ||
+                 pool->chips[chip].load < pool->chips[lightest].load)) {
+            lightest = chip;
+        }
+    }
+    return lightest;
+}
+
+/* Lowest free slot of `chip`, which has room, now used. */
+static uint8_t take_slot(atecc608a_placement_chip_t *chip)
+{
+    uint16_t available = free_slots(chip);
+    uint8_t slot = 0;
+
+    while ((available & (1u << slot)) == 0) {
+        slot++;
+    }
+    chip->used_slots |= (uint16_t)(1u << slot);
+    return slot;
+}
+
+/* Place every key again, heaviest first. Entries keep the chip index they
+ * had, or NO_CHIP, to count moves. Keys that stay on their device keep
+ * their slot, the others take the lowest free ones. */
+static psa_status_t place_all(atecc608a_placement_t *pool, uint16_t *moved)
+{
+    uint8_t order[ATECC608A_PLACEMENT_MAX_KEYS];
+    uint8_t chosen[ATECC608A_PLACEMENT_MAX_KEYS];
+    uint32_t total = 0;
+    uint32_t heaviest = 0;
+    uint32_t bound;
+    uint16_t moves = 0;
+
+    for (uint8_t chip = 0; chip < pool->chip_count; chip++) {
+        pool->chips[chip].used_slots = 0;
+        pool->chips[chip].keys = 0;
+        pool->chips[chip].load = 0;
+    }
+    /* Insertion sort, by weight and then key ID so that the order does not
+     * depend on the order keys were placed in. */
+    for (uint16_t i = 0; i < pool->key_count; i++) {
+        const atecc608a_placement_entry_t *entry = &pool->entries[i];
+        uint16_t j = i;
+
+        for (; j > 0; j--) {
+            const atecc608a_placement_entry_t *before =
+                &pool->entries[order[j - 1]];
+
+            if (before->weight > entry->weight ||
+                    (before->weight == entry->weight &&
+                     before->key_id < entry->key_id)) {
+                break;
+            }
+            order[j] = order[j - 1];
+        }
+        order[j] = (uint8_t) i;
+        total += entry->weight;
+        heaviest = entry->weight > heaviest ? entry->weight : heaviest;
+    }
+    bound = load_bound(pool, total, heaviest);
+
+    for (uint16_t i = 0; i < pool->key_count; i++) {
+        const atecc608a_placement_entry_t *entry = &pool->entries[order[i]];
+        uint8_t chip = choose_chip(pool, entry->key_id, entry->weight, bound);
+
+        if (chip == NO_CHIP) {
+            return PSA_ERROR_INSUFFICIENT_STORAGE;
+        }
+        chosen[order[i]] = chip;
+        pool->chips[chip].keys++;
+        pool->chips[chip].load += entry->weight;
+    }
+    for (uint16_t i = 0; i < pool->key_count; i++) {
+        if (chosen[i] == pool->entries[i].chip) {
+            pool->chips[chosen[i]].used_slots |=
+                (uint16_t)(1u << pool->entries[i].slot);
+        }
+    }
+    for (uint16_t i = 0; i < pool->key_count; i++) {
+        atecc608a_placement_entry_t *entry = &pool->entries[i];
+
+        if (chosen[i] != entry->chip) {
+            entry->chip = chosen[i];
+            entry->slot = take_slot(&pool->chips[entry->chip]);
+            moves++;
+        }
+    }
+    if (moved != NULL) {
+        *moved = moves;
+    }
+    return PSA_SUCCESS;
+}
+
+static int find_chip(const atecc608a_placement_t *pool, uint32_t chip_id)
+{
+    for (int chip = 0; chip < pool->chip_count; chip++) {
+        if (pool->chips[chip].chip_id == chip_id) {
+            return chip;
+        }
+    }
+    return -1;
+}
+
+static int find_key(const atecc608a_placement_t *pool, uint16_t key_id)
+{
+    for (int i = 0; i < pool->key_count; i++) {
+        if (pool->entries[i].key_id == key_id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+uint16_t atecc608a_placement_private_slots(const uint8_t *config)
+{
+    uint16_t slots = 0;
+
+    for (uint16_t slot = 0; slot < 16; slot++) {
+        uint16_t slot_config = get_u16(config + 20 + 2 * slot);
+        uint16_t key_config = get_u16(config + 96 + 2 * slot);
+
+        /* Private, P-256 and WriteConfig with GenKey allowed. */
+        if ((key_config & 0x01) && ((key_config >> 2) & 0x07) == 0x04 &&
+                (slot_config & 0x2000)) {
+            slots |= (uint16_t)(1u << slot);
+        }
+    }
+    return slots;
+}
+
+void atecc608a_placement_init(atecc608a_placement_t *pool)
+{
+    memset(pool, 0, sizeof(*pool));
+    pool->load_factor = ATECC608A_PLACEMENT_LOAD_FACTOR;
+}
+
+psa_status_t atecc608a_placement_add_chip(atecc608a_placement_t *pool,
+                                          uint32_t chip_id,
+                                          const uint8_t *config,
+                                          uint16_t *moved)
+{
+    atecc608a_placement_chip_t *chip;
+
+    if (pool->chip_count == ATECC608A_PLACEMENT_MAX_CHIPS) {
+        return PSA_ERROR_INSUFFICIENT_MEMORY;
+    }
+    if (find_chip(pool, chip_id) >= 0) {
+        return PSA_ERROR_ALREADY_EXISTS;
+    }
+    chip = &pool->chips[pool->chip_count++];
+    memset(chip, 0, sizeof(*chip));
+    chip->chip_id = chip_id;
+    chip->private_slots = atecc608a_placement_private_slots(config);
+    build_ring(pool);
+    /* One more device can only add room. */
+    return place_all(pool, moved);
+}
+
+psa_status_t atecc608a_placement_remove_chip(atecc608a_placement_t *pool,
+                                             uint32_t chip_id,
+                                             uint16_t *moved)
+{
+    static atecc608a_placement_t backup;
+    int removed = find_chip(pool, chip_id);
+    psa_status_t status;
+
+    if (removed < 0) {
+        return PSA_ERROR_DOES_NOT_EXIST;
+    }
+    memcpy(&backup, pool, sizeof(backup));
+
+    memmove(&pool->chips[removed], &pool->chips[removed + 1],
+            (pool->chip_count - removed - 1) * sizeof(pool->chips[0]));
+    pool->chip_count--;
+    for (uint16_t i = 0; i < pool->key_count; i++) {
+        atecc608a_placement_entry_t *entry = &pool->entries[i];
+
+        if (entry->chip == removed) {
+            entry->chip = NO_CHIP;
+        } else if (entry->chip > removed) {
+            entry->chip--;
+        }
+    }
+    build_ring(pool);
+    status = place_all(pool, moved);
+    if (status != PSA_SUCCESS) {
+        memcpy(pool, &backup, sizeof(*pool));
+    }
+    return status;
+}
+
+psa_status_t atecc608a_placement_place(atecc608a_placement_t *pool,
+                                       uint16_t key_id, uint16_t weight,
+                                       uint32_t *chip_id, uint16_t *slot)
+{
+    atecc608a_placement_entry_t *entry;
+    uint32_t total = weight;
+    uint32_t heaviest = weight;
+    uint8_t chip;
+
+    if (find_key(pool, key_id) >= 0) {
+        return PSA_ERROR_ALREADY_EXISTS;
+    }
+    if (weight == 0) {
+        return PSA_ERROR_INVALID_ARGUMENT;
+    }
+    if (pool->key_count == ATECC608A_PLACEMENT_MAX_KEYS ||
+            pool->chip_count == 0) {
+        return PSA_ERROR_INSUFFICIENT_STORAGE;
+    }
+    for (uint16_t i = 0; i < pool->key_count; i++) {
+        total += pool->entries[i].weight;
+        if (pool->entries[i].weight > heaviest) {
+            heaviest = pool->entries[i].weight;
+        }
+    }
+    chip = choose_chip(pool, key_id, weight,
+                       load_bound(pool, total, heaviest));
+    if (chip == NO_CHIP) {
+        return PSA_ERROR_INSUFFICIENT_STORAGE;
+    }
+
+    entry = &pool->entries[pool->key_count++];
+    entry->key_id = key_id;
+    entry->weight = weight;
+    entry->chip = chip;
+    entry->slot = take_slot(&pool->chips[chip]);
+    pool->chips[chip].keys++;
+    pool->chips[chip].load += weight;
+    *chip_id = pool->chips[chip].chip_id;
+    *slot = entry->slot;
+    return PSA_SUCCESS;
+}
+
+psa_status_t atecc608a_placement_remove(atecc608a_placement_t *pool,
+                                        uint16_t key_id)
+{
+    int i = find_key(pool, key_id);
+    atecc608a_placement_chip_t *chip;
+
+    if (i < 0) {
+        return PSA_ERROR_DOES_NOT_EXIST;
+    }
+    chip = &pool->chips[pool->entries[i].chip];
+    chip->used_slots &= (uint16_t) ~(1u << pool->entries[i].slot);
+    chip->keys--;
+    chip->load -= pool->entries[i].weight;
+    pool->entries[i] = pool->entries[--pool->key_count];
+    return PSA_SUCCESS;
+}
+
+psa_status_t atecc608a_placement_lookup(const atecc608a_placement_t *pool,
+                                        uint16_t key_id, uint32_t *chip_id,
+                                        uint16_t *slot)
+{
+    int i = find_key(pool, key_id);
+
+    if (i < 0) {
+        return PSA_ERROR_DOES_NOT_EXIST;
+    }
+    *chip_id = pool->chips[pool->entries[i].chip].chip_id;
+    *slot = pool->entries[i].slot;
+    return PSA_SUCCESS;
+}
+
+psa_status_t atecc608a_placement_rebalance(atecc608a_placement_t *pool,
+                                           uint16_t *moved)
+{
+    /* Every key had a slot, so there is room for all of them. */
+    return place_all(pool, moved);
+}
+
+psa_status_t atecc608a_placement_save(const atecc608a_placement_t *pool,
+                                      psa_storage_uid_t uid)
+{
+    uint8_t image[MAX_IMAGE_SIZE];
+    uint8_t *at = image + HEADER_SIZE;
+
+    image[0] = ATECC608A_PLACEMENT_VERSION;
+    image[1] = pool->chip_count;
+    put_u16(image + 2, pool->key_count);
+    put_u16(image + 4, pool->load_factor);
+    for (uint8_t chip = 0; chip < pool->chip_count; chip++, at += CHIP_SIZE) {
+        put_u16(at, (uint16_t) pool->chips[chip].chip_id);
+        put_u16(at + 2, (uint16_t)(pool->chips[chip].chip_id >> 16));
+        put_u16(at + 4, pool->chips[chip].private_slots);
+    }
+    for (uint16_t i = 0; i < pool->key_count; i++, at += ENTRY_SIZE) {
+        put_u16(at, pool->entries[i].key_id);
+        at[2] = pool->entries[i].chip;
+        at[3] = pool->entries[i].slot;
+        put_u16(at + 4, pool->entries[i].weight);
+    }
+    return psa_its_set(uid, (uint32_t)(at - image), image,
+                       PSA_STORAGE_FLAG_NONE);
+}
+
+psa_status_t atecc608a_placement_load(atecc608a_placement_t *pool,
+                                      psa_storage_uid_t uid)
+{
+    static atecc608a_placement_t loaded;
+    uint8_t image[MAX_IMAGE_SIZE];
+    const uint8_t *at = image + HEADER_SIZE;
+    size_t length = 0;
+    psa_status_t status;
+
+    status = psa_its_get(uid, 0, sizeof(image), image, &length);
+    if (status != PSA_SUCCESS) {
+        return status;
+    }
+    atecc608a_placement_init(&loaded);
+    if (length < HEADER_SIZE || image[0] != ATECC608A_PLACEMENT_VERSION ||
+            image[1] > ATECC608A_PLACEMENT_MAX_CHIPS ||
+            get_u16(image + 2) > ATECC608A_PLACEMENT_MAX_KEYS ||
+            length != (size_t)(HEADER_SIZE + image[1] * CHIP_SIZE +
+                               get_u16(image + 2) * ENTRY_SIZE)) {
+        return PSA_ERROR_DOES_NOT_EXIST;
+    }
+    loaded.chip_count = image[1];
+    loaded.load_factor = get_u16(image + 4);
+    for (uint8_t chip = 0; chip < loaded.chip_count; chip++, at += CHIP_SIZE) {
+        uint32_t chip_id = get_u16(at) | (uint32_t) get_u16(at + 2) << 16;
+
+        if (find_chip(&loaded, chip_id) >= 0) {
+            return PSA_ERROR_DOES_NOT_EXIST;
+        }
+        loaded.chips[chip].chip_id = chip_id;
+        loaded.chips[chip].private_slots = get_u16(at + 4);
+    }
+    for (uint16_t i = 0; i < get_u16(image + 2); i++, at += ENTRY_SIZE) {
+        atecc608a_placement_entry_t *entry = &loaded.entries[i];
+        atecc608a_placement_chip_t *chip;
+
+        entry->key_id = get_u16(at);
+        entry->chip = at[2];
+        entry->slot = at[3];
+        entry->weight = get_u16(at + 4);
+        if (entry->chip >= loaded.chip_count || entry->slot >= 16 ||
+                entry->weight == 0 || find_key(&loaded, entry->key_id) >= 0) {
+            return PSA_ERROR_DOES_NOT_EXIST;
+        }
+        chip = &loaded.chips[entry->chip];
+        if ((free_slots(chip) & (1u << entry->slot)) == 0) {
+            return PSA_ERROR_DOES_NOT_EXIST;
+        }
+        chip->used_slots |= (uint16_t)(1u << entry->slot);
+        chip->keys++;
+        chip->load += entry->weight;
+        loaded.key_count++;
+    }
+    build_ring(&loaded);
+    memcpy(pool, &loaded, sizeof(*pool));
+    return PSA_SUCCESS;
+}
+
+void atecc608a_placement_print(const atecc608a_placement_t *pool)
+{
+    uint32_t total = 0;
+    uint32_t largest = 0;
+    uint32_t ratio;
+
+    for (uint8_t chip = 0; chip < pool->chip_count; chip++) {
+        total += pool->chips[chip].load;
+        if (pool->chips[chip].load > largest) {
+            largest = pool->chips[chip].load;
+        }
+    }
+    for (uint8_t chip = 0; chip < pool->chip_count; chip++) {
+        const atecc608a_placement_chip_t *entry = &pool->chips[chip];
+        uint32_t permille = total == 0 ? 0 :
+                            (uint32_t)(entry->load * 1000ULL / total);
+
+        printf("  - chip %08lx: %2u keys, load %6lu (%2lu.%01lu%%)\n",
+               (unsigned long) entry->chip_id, entry->keys,
+               (unsigned long) entry->load, (unsigned long)(permille / 10),
+               (unsigned long)(permille % 10));
+    }
+    ratio = total == 0 ? 0 :
+            (uint32_t)(largest * 100ULL * pool->chip_count / total);
+    printf("  - largest load %lu.%02lu x the mean\n", (unsigned long)(ratio / 100),
+           (unsigned long)(ratio % 100));
+}
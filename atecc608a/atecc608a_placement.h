@@ -0,0 +1,150 @@
+/**
+ * \file atecc608a_placement.h
+ * \brief Placement of logical keys on the slots of a pool of devices, by
+ *        consistent hashing with bounded loads.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_PLACEMENT_H
+#define ATECC608A_PLACEMENT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "psa/crypto.h"
+#include "psa/internal_trusted_storage.h"
+
+/** Every device has ATECC608A_PLACEMENT_VNODES points on a hash ring. A key
+ *  goes to the first device after its own point that has a free private
+ *  key slot and stays within the load bound: the load factor times the
+ *  mean load per device, where the load of a device is the sum of the sign
+ *  weights of its keys. Adding or removing a device only moves the keys
+ *  whose ring position or bound changed, about 1/n of them, and keys that
+ *  stay on a device keep their slot.
+ *
+ *  A pool is a plain structure with no locking; its user serializes
+ *  access. */
+
+#define ATECC608A_PLACEMENT_MAX_CHIPS 8
+#define ATECC608A_PLACEMENT_VNODES 40
+#define ATECC608A_PLACEMENT_MAX_KEYS (ATECC608A_PLACEMENT_MAX_CHIPS * 16)
+
+/** Load bound in percent of the mean load, 125 by default. */
+#ifndef ATECC608A_PLACEMENT_LOAD_FACTOR
+#define ATECC608A_PLACEMENT_LOAD_FACTOR 125
+#endif
+
+/** PSA internal trusted storage UID of the saved mapping. */
+#define ATECC608A_PLACEMENT_UID 0x504C4331
+#define ATECC608A_PLACEMENT_VERSION 1
+
+typedef struct {
+    uint32_t chip_id;
+    /** Private key slots that GenKey may write, from the config zone. */
+    uint16_t private_slots;
+    uint16_t used_slots;
+    uint16_t keys;
+    uint32_t load;
+} atecc608a_placement_chip_t;
+
+typedef struct {
+    uint16_t key_id;
+    /** Index in `chips`. */
+    uint8_t chip;
+    uint8_t slot;
+    /** Relative sign load of the key, at least 1. */
+    uint16_t weight;
+} atecc608a_placement_entry_t;
+
+typedef struct {
+    uint32_t point;
+    uint8_t chip;
+} atecc608a_placement_vnode_t;
+
+typedef struct {
+    uint8_t chip_count;
+    uint16_t key_count;
+    /** In percent of the mean load, 0 for no bound. */
+    uint16_t load_factor;
+    atecc608a_placement_chip_t chips[ATECC608A_PLACEMENT_MAX_CHIPS];
+    atecc608a_placement_entry_t entries[ATECC608A_PLACEMENT_MAX_KEYS];
+    /** Sorted by point. */
+    atecc608a_placement_vnode_t ring[ATECC608A_PLACEMENT_MAX_CHIPS *
+                                     ATECC608A_PLACEMENT_VNODES];
+} atecc608a_placement_t;
+
+/** Slots of a 128 byte config zone image that hold P-256 private keys
+ *  GenKey may write, as a mask. */
+uint16_t atecc608a_placement_private_slots(const uint8_t *config);
+
+/** Start an empty pool with the default load factor. */
+void atecc608a_placement_init(atecc608a_placement_t *pool);
+
+/** Add a device with the given config zone image and place every key again.
+ *  `moved`, if not NULL, receives the number of keys now on another device,
+ *  which would have to be provisioned again. Fails with
+ *  PSA_ERROR_INSUFFICIENT_MEMORY if the pool is full, and with
+ *  PSA_ERROR_ALREADY_EXISTS if the device is in it. */
+psa_status_t atecc608a_placement_add_chip(atecc608a_placement_t *pool,
+                                          uint32_t chip_id,
+                                          const uint8_t *config,
+                                          uint16_t *moved);
+
+/** Remove a device and place its keys, and any others the bound requires,
+ *  elsewhere. Fails with PSA_ERROR_INSUFFICIENT_STORAGE, leaving the pool
+ *  as it was, if the other devices lack the slots. */
+psa_status_t atecc608a_placement_remove_chip(atecc608a_placement_t *pool,
+                                             uint32_t chip_id,
+                                             uint16_t *moved);
+
+/** Place a new key. No other key moves, so the bound may be exceeded until
+ *  the next atecc608a_placement_rebalance(). Fails with
+ *  PSA_ERROR_ALREADY_EXISTS if the key is placed, and with
+ *  PSA_ERROR_INSUFFICIENT_STORAGE if no device has a free slot. */
+psa_status_t atecc608a_placement_place(atecc608a_placement_t *pool,
+                                       uint16_t key_id, uint16_t weight,
+                                       uint32_t *chip_id, uint16_t *slot);
+
+psa_status_t atecc608a_placement_remove(atecc608a_placement_t *pool,
+                                        uint16_t key_id);
+
+/** Fails with PSA_ERROR_DOES_NOT_EXIST if the key is not placed. */
+psa_status_t atecc608a_placement_lookup(const atecc608a_placement_t *pool,
+                                        uint16_t key_id, uint32_t *chip_id,
+                                        uint16_t *slot);
+
+/** Place every key again, heaviest first, within the bound. */
+psa_status_t atecc608a_placement_rebalance(atecc608a_placement_t *pool,
+                                           uint16_t *moved);
+
+/** Save the devices and the mapping to, or load them from, PSA internal
+ *  trusted storage. Loading fails with PSA_ERROR_DOES_NOT_EXIST if there
+ *  is no valid mapping: one of another version, or with a key off the
+ *  private key slots of its device or sharing a slot. */
+psa_status_t atecc608a_placement_save(const atecc608a_placement_t *pool,
+                                      psa_storage_uid_t uid);
+psa_status_t atecc608a_placement_load(atecc608a_placement_t *pool,
+                                      psa_storage_uid_t uid);
+
+/** Print the keys and load of every device, and the largest load against
+ *  the mean. */
+void atecc608a_placement_print(const atecc608a_placement_t *pool);
+
+#endif /* ATECC608A_PLACEMENT_H */
@@ -0,0 +1,242 @@
+/**
+ * \file atecc608a_placement_commands.c
+ * \brief Console commands that place keys on several devices.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include "atecc608a_placement_commands.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "atecc608a_placement.h"
+#include "atecc608a_utils.h"
+#include "psa/internal_trusted_storage.h"
+
+/* Scratch ITS entry of the placement test and the placement command. */
+#define PLACEMENT_TEST_UID 0x504C4354
+
+/* Check that every key of `pool` is on a private key slot of its device,
+ * and that no two share one. */
+static psa_status_t check_placement(const atecc608a_placement_t *pool,
+                                    uint16_t keys)
+{
+    uint16_t used[ATECC608A_PLACEMENT_MAX_CHIPS] = { 0 };
+    uint16_t private_slots = atecc608a_placement_private_slots(
+                                 template_config_508a_dev);
+
+    for (uint16_t key_id = 1; key_id <= keys; key_id++) {
+        uint32_t chip_id;
+        uint16_t slot;
+        uint16_t chip;
+
+        if (atecc608a_placement_lookup(pool, key_id, &chip_id, &slot) != PSA_SUCCESS) {
+            return PSA_ERROR_DOES_NOT_EXIST;
+        }
+        for (chip = 0; pool->chips[chip].chip_id != chip_id; chip++) {
+        }
+        if ((private_slots & (1u << slot)) == 0 || (used[chip] & (1u << slot))) {
+            return PSA_ERROR_GENERIC_ERROR;
+        }
+        used[chip] |= (uint16_t)(1u << slot);
+    }
+    return PSA_SUCCESS;
+}
+
+/* Test that keys placed on three devices stay on private key slots, one
+ * each, when a device is added and when one is removed, that adding a
+ * device moves fewer than half of them, and that a saved mapping loads
+ * back the same. */
+static psa_status_t test_placement()
+{
+    static atecc608a_placement_t pool;
+    static atecc608a_placement_t loaded;
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+    const uint16_t keys = 18;
+    uint16_t moved;
+
+    atecc608a_placement_init(&pool);
+    for (uint32_t chip = 0; chip < 3; chip++) {
+        ASSERT_SUCCESS_PSA(atecc608a_placement_add_chip(&pool, 0xC0 + chip,
+                                                        template_config_508a_dev,
+                                                        &moved));
+    }
+    for (uint16_t key_id = 1; key_id <= keys; key_id++) {
+        uint32_t chip_id;
+        uint16_t slot;
+
+        ASSERT_SUCCESS_PSA(atecc608a_placement_place(&pool, key_id,
+                                                     (uint16_t)(100 / key_id + 1),
+                                                     &chip_id, &slot));
+    }
+    ASSERT_SUCCESS_PSA(atecc608a_placement_rebalance(&pool, &moved));
+    ASSERT_SUCCESS_PSA(check_placement(&pool, keys));
+
+    ASSERT_SUCCESS_PSA(atecc608a_placement_add_chip(&pool, 0xC3,
+                                                    template_config_508a_dev,
+                                                    &moved));
+    ASSERT_SUCCESS_PSA(check_placement(&pool, keys));
+    ASSERT_STATUS(moved < keys / 2, true, PSA_ERROR_GENERIC_ERROR);
+    ASSERT_SUCCESS_PSA(atecc608a_placement_remove_chip(&pool, 0xC0, &moved));
+    ASSERT_SUCCESS_PSA(check_placement(&pool, keys));
+
+    ASSERT_SUCCESS_PSA(atecc608a_placement_save(&pool, PLACEMENT_TEST_UID));
+    ASSERT_SUCCESS_PSA(atecc608a_placement_load(&loaded, PLACEMENT_TEST_UID));
+    psa_its_remove(PLACEMENT_TEST_UID);
+    for (uint16_t key_id = 1; key_id <= keys; key_id++) {
+        uint32_t chip_id[2];
+        uint16_t slot[2];
+
+        ASSERT_SUCCESS_PSA(atecc608a_placement_lookup(&pool, key_id,
+                                                      &chip_id[0], &slot[0]));
+        ASSERT_SUCCESS_PSA(atecc608a_placement_lookup(&loaded, key_id,
+                                                      &chip_id[1], &slot[1]));
+        ASSERT_STATUS(chip_id[0] == chip_id[1] && slot[0] == slot[1], true,
+                      PSA_ERROR_GENERIC_ERROR);
+    }
+    TEST_PASSED("test_placement");
+exit:
+    return status;
+}
+
+const test_step_t test_step_placement = {
+    "test_placement", test_placement, NULL, 0 FIXTURE(FACTORY)
+};
+
+/* Share of `keys` keys that hashing modulo the number of devices would move
+ * when going from `chips` to `chips + 1` devices, in percent. */
+static uint32_t modulo_moved_percent(uint16_t keys, uint8_t chips)
+{
+    uint32_t moved = 0;
+
+    for (uint16_t key_id = 1; key_id <= keys; key_id++) {
+        uint32_t hash = key_id * 0x9E3779B9u;
+
+        moved += hash % chips != hash % (chips + 1u) ? 1 : 0;
+    }
+    return moved * 100 / keys;
+}
+
+/* Place `keys` keys with Zipf distributed sign weights on `chips` devices,
+ * without and with the load bound, then add a device and remove the first
+ * one, and save the result as the placement. */
+static psa_status_t placement_sim(uint8_t chips, uint16_t keys, uint32_t skew_percent)
+{
+    static atecc608a_placement_t pool;
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+    uint16_t moved;
+
+    if (chips == 0 || chips >= ATECC608A_PLACEMENT_MAX_CHIPS || keys == 0 ||
+            keys > ATECC608A_PLACEMENT_MAX_KEYS) {
+        return PSA_ERROR_INVALID_ARGUMENT;
+    }
+    atecc608a_placement_init(&pool);
+    for (uint8_t chip = 0; chip < chips; chip++) {
+        ASSERT_SUCCESS_PSA(atecc608a_placement_add_chip(&pool, 0xC0 + chip,
+                                                        template_config_508a_dev,
+                                                        &moved));
+    }
+    /* The heaviest key gets 1000, the weight of key k falls as k^-s. */
+    for (uint16_t key_id = 1; key_id <= keys; key_id++) {
+        double weight = 1000.0 / pow(key_id, skew_percent / 100.0);
+        uint32_t chip_id;
+        uint16_t slot;
+
+        ASSERT_SUCCESS_PSA(atecc608a_placement_place(
+                               &pool, key_id, weight < 1.0 ? 1 : (uint16_t) weight,
+                               &chip_id, &slot));
+    }
+
+    pool.load_factor = 0;
+    ASSERT_SUCCESS_PSA(atecc608a_placement_rebalance(&pool, &moved));
+    printf("Consistent hashing, no load bound:\n");
+    atecc608a_placement_print(&pool);
+    pool.load_factor = ATECC608A_PLACEMENT_LOAD_FACTOR;
+    ASSERT_SUCCESS_PSA(atecc608a_placement_rebalance(&pool, &moved));
+    printf("Load bound of %u%% of the mean:\n", ATECC608A_PLACEMENT_LOAD_FACTOR);
+    atecc608a_placement_print(&pool);
+
+    ASSERT_SUCCESS_PSA(atecc608a_placement_add_chip(&pool, 0xC0 + chips,
+                                                    template_config_508a_dev,
+                                                    &moved));
+    printf("Device %02x added: %u of %u keys moved, hashing modulo the "
+           "number of devices would move %lu%%:\n", 0xC0 + chips, moved, keys,
+           (unsigned long) modulo_moved_percent(keys, chips));
+    atecc608a_placement_print(&pool);
+    ASSERT_SUCCESS_PSA(atecc608a_placement_remove_chip(&pool, 0xC0, &moved));
+    printf("Device c0 removed: %u of %u keys moved:\n", moved, keys);
+    atecc608a_placement_print(&pool);
+
+    ASSERT_SUCCESS_PSA(atecc608a_placement_save(&pool, ATECC608A_PLACEMENT_UID));
+    printf("Placement saved.\n");
+
+exit:
+    return status;
+}
+
+static bool run_placement_command(char *command, char *arg)
+{
+    if (strcmp(command, "placement") == 0) {
+        static atecc608a_placement_t pool;
+        psa_status_t status = atecc608a_placement_load(&pool,
+                                                       ATECC608A_PLACEMENT_UID);
+
+        if (status == PSA_SUCCESS) {
+            printf("%u keys on %u devices:\n", pool.key_count, pool.chip_count);
+            atecc608a_placement_print(&pool);
+        } else {
+            printf("No placement saved (error %ld), see placement_sim.\n",
+                   (long) status);
+        }
+    } else if (strncmp(command, "placement_sim=", strlen("placement_sim=")) == 0) {
+        const char *keys = strchr(arg, '_');
+        const char *skew = keys != NULL ? strchr(keys + 1, '_') : NULL;
+        psa_status_t status = PSA_ERROR_INVALID_ARGUMENT;
+
+        if (skew != NULL) {
+            status = placement_sim((uint8_t) atoi(arg + 1),
+                                   (uint16_t) atoi(keys + 1),
+                                   (uint32_t) atoi(skew + 1));
+        }
+        if (status != PSA_SUCCESS) {
+            printf("Placement simulation failed. Error %ld.\n", (long) status);
+        }
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static const char *const placement_host_commands[] = {
+    "placement", "placement_sim=", NULL,
+};
+
+/* The placement commands only use the host, so there is nothing to
+ * estimate. */
+const command_module_t placement_commands = {
+    " - placement - print the saved placement of keys on devices;\n"
+    " - placement_sim=%d_%d_%d - place a number of keys (second argument)\n"
+    "                             on a number of devices (first argument,\n"
+    "                             1-7) with the hardcoded configuration,\n"
+    "                             sign weights skewed by Zipf's law with an\n"
+    "                             exponent in percent (third argument), add\n"
+    "                             and remove a device, print the loads and\n"
+    "                             the keys moved, save the placement;\n",
+    placement_host_commands, run_placement_command, NULL,
+};
@@ -0,0 +1,36 @@
+/**
+ * \file atecc608a_placement_commands.h
+ * \brief Console commands that place keys on several devices.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_PLACEMENT_COMMANDS_H
+#define ATECC608A_PLACEMENT_COMMANDS_H
+
+#include "atecc608a_app.h"
+
+/** placement and placement_sim. */
+extern const command_module_t placement_commands;
+
+/** Test that placed keys stay on private key slots, one each, when a
+ *  device is added and when one is removed, and that a saved mapping loads
+ *  back the same. */
+extern const test_step_t test_step_placement;
+
+#endif /* ATECC608A_PLACEMENT_COMMANDS_H */
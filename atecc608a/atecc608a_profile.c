@@ -0,0 +1,303 @@
+/**
+ * \file atecc608a_profile.c
+ * \brief Host CPU cost of the layers between an operation and the device,
+ *        from a cycle counter.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include "atecc608a_profile.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "cmsis_os2.h"
+
+#if defined(__MBED__)
+#include "atecc608a_stats.h"
+#else
+#include <time.h>
+#endif
+
+static atecc608a_profile_op_t ops[ATECC608A_PROFILE_MAX_OPS];
+static uint32_t op_count;
+static bool enabled;
+
+/* Written by the profiled thread only, while it is profiled. */
+static volatile bool running;
+static osThreadId_t owner;
+static atecc608a_profile_op_t *current;
+static atecc608a_layer_t stack[ATECC608A_PROFILE_MAX_DEPTH];
+static uint32_t depth;
+static uint64_t last;
+
+static const char *const layer_names[ATECC608A_LAYER_COUNT] = {
+    "app", "utils", "driver", "lib", "hal", "wait",
+};
+
+#if defined(__MBED__)
+
+/* The 32-bit counter wraps within a minute at typical core clocks; it is
+ * read often enough while profiling to extend it. */
+static uint64_t now(void)
+{
+    static uint32_t low;
+    static uint64_t high;
+    uint32_t cycles = atecc608a_cycles();
+
+    if (cycles < low) {
+        high += (uint64_t) 1 << 32;
+    }
+    low = cycles;
+    return high | cycles;
+}
+
+const char *atecc608a_profile_unit(void)
+{
+    return "cycles";
+}
+
+#else
+
+static uint64_t now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+const char *atecc608a_profile_unit(void)
+{
+    return "ns";
+}
+
+#endif
+
+static bool profiled(void)
+{
+    return running && osThreadGetId() == owner;
+}
+
+/* Give the time since the last change to the innermost layer. */
+static void charge(uint64_t time)
+{
+    atecc608a_layer_t layer = ATECC608A_LAYER_APP;
+
+    if (depth > 0) {
+        layer = stack[(depth < ATECC608A_PROFILE_MAX_DEPTH ?
+                       depth : ATECC608A_PROFILE_MAX_DEPTH) - 1];
+    }
+    current->time[layer] += time - last;
+    last = time;
+}
+
+void atecc608a_profile_enable(bool enable)
+{
+    if (enable && !enabled) {
+        atecc608a_profile_reset();
+    }
+    enabled = enable;
+}
+
+bool atecc608a_profile_enabled(void)
+{
+    return enabled;
+}
+
+void atecc608a_profile_reset(void)
+{
+    running = false;
+    op_count = 0;
+    memset(ops, 0, sizeof(ops));
+}
+
+void atecc608a_profile_begin(const char *name)
+{
+    uint32_t i;
+
+    if (!enabled || running) {
+        return;
+    }
+    for (i = 0; i < op_count; i++) {
+        if (strcmp(ops[i].name, name) == 0) {
+            break;
+        }
+    }
+    if (i == op_count) {
+        if (op_count == ATECC608A_PROFILE_MAX_OPS) {
+            return;
+        }
+        ops[op_count++].name = name;
+    }
+    current = &ops[i];
+    current->calls++;
+    owner = osThreadGetId();
+    depth = 0;
+    last = now();
+    running = true;
+}
+
+void atecc608a_profile_end(void)
+{
+    if (!profiled()) {
+        return;
+    }
+    charge(now());
+    running = false;
+}
+
+void atecc608a_profile_enter(atecc608a_layer_t layer)
+{
+    if (!profiled()) {
+        return;
+    }
+    charge(now());
+    if (depth < ATECC608A_PROFILE_MAX_DEPTH) {
+        stack[depth] = layer;
+    }
+    depth++;
+}
+
+void atecc608a_profile_exit(void)
+{
+    /* An exit without its enter, for a layer entered before the operation
+     * began, is ignored. */
+    if (!profiled() || depth == 0) {
+        return;
+    }
+    charge(now());
+    depth--;
+}
+
+const atecc608a_profile_op_t *atecc608a_profile_find(const char *name)
+{
+    for (uint32_t i = 0; i < op_count; i++) {
+        if (strcmp(ops[i].name, name) == 0) {
+            return &ops[i];
+        }
+    }
+    return NULL;
+}
+
+void atecc608a_profile_print(void)
+{
+    printf("Profile, mean %s per call:\n", atecc608a_profile_unit());
+    printf("  %-22s %6s", "operation", "calls");
+    for (int layer = 0; layer < ATECC608A_LAYER_COUNT; layer++) {
+        printf(" %9s", layer_names[layer]);
+    }
+    printf(" | %9s %5s\n", "host cpu", "host%");
+    for (uint32_t i = 0; i < op_count; i++) {
+        const atecc608a_profile_op_t *op = &ops[i];
+        uint64_t total = 0;
+        uint64_t host;
+
+        printf("  %-22s %6lu", op->name, (unsigned long) op->calls);
+        for (int layer = 0; layer < ATECC608A_LAYER_COUNT; layer++) {
+            total += op->time[layer];
+            printf(" %9lu", (unsigned long)(op->time[layer] / op->calls));
+        }
+        host = total - op->time[ATECC608A_LAYER_WAIT];
+        printf(" | %9lu %5lu\n", (unsigned long)(host / op->calls),
+               (unsigned long)(total > 0 ? host * 100 / total : 0));
+    }
+    if (op_count == 0) {
+        printf("  nothing profiled, run tests or benchmarks with profile=1\n");
+    }
+}
+
+#if defined(ATECC608A_PROFILE_WRAP_HAL)
+
+/* The HAL of cryptoauthlib is not ours to tag. The build profile
+ * profile_hal.json, which the documented build adds to the default one,
+ * defines ATECC608A_PROFILE_WRAP_HAL and links with --wrap for each of
+ * these functions, which routes the calls of cryptoauthlib through them.
+ * Without it, transfers and waits count as the layer that made the
+ * command, and the report cannot tell host CPU time from chip wait. */
+#include "atca_hal.h"
+
+ATCA_STATUS __real_hal_i2c_send(ATCAIface iface, uint8_t *txdata,
+                                int txlength);
+ATCA_STATUS __real_hal_i2c_receive(ATCAIface iface, uint8_t *rxdata,
+                                   uint16_t *rxlength);
+ATCA_STATUS __real_hal_i2c_wake(ATCAIface iface);
+ATCA_STATUS __real_hal_i2c_idle(ATCAIface iface);
+ATCA_STATUS __real_hal_i2c_sleep(ATCAIface iface);
+void __real_atca_delay_us(uint32_t delay);
+void __real_atca_delay_10us(uint32_t delay);
+void __real_atca_delay_ms(uint32_t delay);
+
+ATCA_STATUS __wrap_hal_i2c_send(ATCAIface iface, uint8_t *txdata,
+                                int txlength)
+{
+    atecc608a_profile_enter(ATECC608A_LAYER_HAL);
+    return (ATCA_STATUS) atecc608a_profile_exit_status(
+               __real_hal_i2c_send(iface, txdata, txlength));
+}
+
+ATCA_STATUS __wrap_hal_i2c_receive(ATCAIface iface, uint8_t *rxdata,
+                                   uint16_t *rxlength)
+{
+    atecc608a_profile_enter(ATECC608A_LAYER_HAL);
+    return (ATCA_STATUS) atecc608a_profile_exit_status(
+               __real_hal_i2c_receive(iface, rxdata, rxlength));
+}
+
+ATCA_STATUS __wrap_hal_i2c_wake(ATCAIface iface)
+{
+    atecc608a_profile_enter(ATECC608A_LAYER_HAL);
+    return (ATCA_STATUS) atecc608a_profile_exit_status(
+               __real_hal_i2c_wake(iface));
+}
+
+ATCA_STATUS __wrap_hal_i2c_idle(ATCAIface iface)
+{
+    atecc608a_profile_enter(ATECC608A_LAYER_HAL);
+    return (ATCA_STATUS) atecc608a_profile_exit_status(
+               __real_hal_i2c_idle(iface));
+}
+
+ATCA_STATUS __wrap_hal_i2c_sleep(ATCAIface iface)
+{
+    atecc608a_profile_enter(ATECC608A_LAYER_HAL);
+    return (ATCA_STATUS) atecc608a_profile_exit_status(
+               __real_hal_i2c_sleep(iface));
+}
+
+void __wrap_atca_delay_us(uint32_t delay)
+{
+    atecc608a_profile_enter(ATECC608A_LAYER_WAIT);
+    __real_atca_delay_us(delay);
+    atecc608a_profile_exit();
+}
+
+void __wrap_atca_delay_10us(uint32_t delay)
+{
+    atecc608a_profile_enter(ATECC608A_LAYER_WAIT);
+    __real_atca_delay_10us(delay);
+    atecc608a_profile_exit();
+}
+
+void __wrap_atca_delay_ms(uint32_t delay)
+{
+    atecc608a_profile_enter(ATECC608A_LAYER_WAIT);
+    __real_atca_delay_ms(delay);
+    atecc608a_profile_exit();
+}
+
+#endif /* ATECC608A_PROFILE_WRAP_HAL */
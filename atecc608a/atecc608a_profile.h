@@ -0,0 +1,107 @@
+/**
+ * \file atecc608a_profile.h
+ * \brief Host CPU cost of the layers between an operation and the device,
+ *        from a cycle counter.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_PROFILE_H
+#define ATECC608A_PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/** The code between an operation and the device is tagged with the layer
+ *  it belongs to. Layers nest, and the time of an operation goes to the
+ *  innermost layer running, so that each layer gets its own time only.
+ *  Everything but the chip wait is host CPU time. On Mbed OS targets, the
+ *  HAL and wait layers come from the build profile profile_hal.json, see
+ *  setup.md; host builds tag them in their own HAL.
+ *
+ *  Time is read from DWT CYCCNT on Mbed OS targets that have it (see
+ *  atecc608a_cycles()), and from CLOCK_MONOTONIC in nanoseconds on hosts:
+ *  the TSC rate is not known there, and may change with the CPU frequency.
+ *
+ *  Only the thread that began the operation is profiled, so work of other
+ *  threads on the device shows as time outside the device lock. Tagging
+ *  costs a few dozen cycles per layer, which go to the layers. */
+typedef enum {
+    /** Untagged: the caller and the PSA core. */
+    ATECC608A_LAYER_APP,
+    /** Under the device lock: device setup, checks, status conversion. */
+    ATECC608A_LAYER_UTILS,
+    /** Secure element driver entry points, with the cryptoauthlib calls
+     *  they make. */
+    ATECC608A_LAYER_DRIVER,
+    /** cryptoauthlib calls of ASSERT_SUCCESS(): packet building, CRC,
+     *  response parsing. */
+    ATECC608A_LAYER_LIB,
+    /** I2C transfers, and wake, idle and sleep. */
+    ATECC608A_LAYER_HAL,
+    /** Waiting for the device to execute a command. */
+    ATECC608A_LAYER_WAIT,
+    ATECC608A_LAYER_COUNT,
+} atecc608a_layer_t;
+
+/** Operations kept apart, others are dropped. */
+#define ATECC608A_PROFILE_MAX_OPS 48
+
+/** Layers that can nest, deeper ones count as the deepest kept. */
+#define ATECC608A_PROFILE_MAX_DEPTH 8
+
+typedef struct {
+    const char *name;
+    uint32_t calls;
+    /** Total time of each layer over all calls. */
+    uint64_t time[ATECC608A_LAYER_COUNT];
+} atecc608a_profile_op_t;
+
+/** Turn profiling on or off. Turning it on drops earlier results. */
+void atecc608a_profile_enable(bool enabled);
+bool atecc608a_profile_enabled(void);
+void atecc608a_profile_reset(void);
+
+/** Profile the calling thread until atecc608a_profile_end(), adding to the
+ *  operation `name`, which must stay valid. Operations do not nest. Does
+ *  nothing while profiling is off. */
+void atecc608a_profile_begin(const char *name);
+void atecc608a_profile_end(void);
+
+/** Tag the code that runs until the matching atecc608a_profile_exit(). */
+void atecc608a_profile_enter(atecc608a_layer_t layer);
+void atecc608a_profile_exit(void);
+
+/** atecc608a_profile_exit(), passing `status` through, for expressions. */
+static inline int atecc608a_profile_exit_status(int status)
+{
+    atecc608a_profile_exit();
+    return status;
+}
+
+/** Results of the operation `name`, NULL if it was not profiled. */
+const atecc608a_profile_op_t *atecc608a_profile_find(const char *name);
+
+/** "cycles" or "ns". */
+const char *atecc608a_profile_unit(void);
+
+/** Print the mean time of each layer per call of every operation, and
+ *  their split into host CPU and chip wait. */
+void atecc608a_profile_print(void);
+
+#endif /* ATECC608A_PROFILE_H */
@@ -0,0 +1,97 @@
+/**
+ * \file atecc608a_ring.c
+ * \brief Bounded lock-free multi-producer, single-consumer ring of pointers.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include "atecc608a_ring.h"
+
+#include <stddef.h>
+
+#include "cmsis.h"
+#include "platform/mbed_critical.h"
+
+/* Dmitry Vyukov's bounded queue: the sequence number of a cell is its
+ * position while it is free for that position, position + 1 once the item
+ * is published, and position + cell count once it was consumed. Producers
+ * only contend on the claim of a position, with a compare-and-swap that is
+ * LDREX/STREX on Cortex-M3 and above and a short critical section below. */
+
+void atecc608a_ring_init(atecc608a_ring_t *ring, atecc608a_ring_cell_t *cells,
+                         uint32_t cell_count)
+{
+    for (uint32_t i = 0; i < cell_count; i++) {
+        cells[i].sequence = i;
+        cells[i].item = NULL;
+    }
+    ring->cells = cells;
+    ring->mask = cell_count - 1;
+    ring->enqueue_position = 0;
+    ring->dequeue_position = 0;
+}
+
+bool atecc608a_ring_push(atecc608a_ring_t *ring, void *item)
+{
+    uint32_t position = ring->enqueue_position;
+    atecc608a_ring_cell_t *cell;
+
+    for (;;) {
+        int32_t difference;
+
+        cell = &ring->cells[position & ring->mask];
+        difference = (int32_t)(cell->sequence - position);
+        if (difference == 0) {
+            /* On failure, `position` is updated to the current value. */
+            if (core_util_atomic_cas_u32(&ring->enqueue_position, &position,
+                                         position + 1)) {
+                break;
+            }
+        } else if (difference < 0) {
+            /* The cell of this position still holds an unconsumed item. */
+            return false;
+        } else {
+            position = ring->enqueue_position;
+        }
+    }
+
+    cell->item = item;
+    /* The item must be visible before the cell is marked published. */
+    __DMB();
+    cell->sequence = position + 1;
+    return true;
+}
+
+void *atecc608a_ring_pop(atecc608a_ring_t *ring)
+{
+    uint32_t position = ring->dequeue_position;
+    atecc608a_ring_cell_t *cell = &ring->cells[position & ring->mask];
+    void *item;
+
+    if ((int32_t)(cell->sequence - (position + 1)) < 0) {
+        return NULL;
+    }
+    /* The item must not be read before the sequence number that published
+     * it. */
+    __DMB();
+    item = cell->item;
+    /* Nor the cell be handed back to producers before it was read. */
+    __DMB();
+    cell->sequence = position + ring->mask + 1;
+    ring->dequeue_position = position + 1;
+    return item;
+}
@@ -0,0 +1,60 @@
+/**
+ * \file atecc608a_ring.h
+ * \brief Bounded lock-free multi-producer, single-consumer ring of pointers.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_RING_H
+#define ATECC608A_RING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/** A cell holds an item once its sequence number says it was published. */
+typedef struct {
+    volatile uint32_t sequence;
+    void *item;
+} atecc608a_ring_cell_t;
+
+typedef struct {
+    atecc608a_ring_cell_t *cells;
+    uint32_t mask;
+    /** Next position to claim, shared by the producers. */
+    volatile uint32_t enqueue_position;
+    /** Next position to take, owned by the consumer. */
+    uint32_t dequeue_position;
+} atecc608a_ring_t;
+
+/** Set up a ring over `cell_count` cells, a power of two. */
+void atecc608a_ring_init(atecc608a_ring_t *ring, atecc608a_ring_cell_t *cells,
+                         uint32_t cell_count);
+
+/** Add an item. Any number of threads and interrupt handlers may push at
+ *  once: a producer never waits for another one, it only retries when
+ *  another producer claimed the same cell first. Returns false if the ring
+ *  is full. */
+bool atecc608a_ring_push(atecc608a_ring_t *ring, void *item);
+
+/** Take the oldest item, or NULL if there is none yet. Only one thread may
+ *  pop. An item is not returned before all the items claimed ahead of it
+ *  are published, so the consumer may see an empty ring while a preempted
+ *  producer is between claiming and publishing a cell. */
+void *atecc608a_ring_pop(atecc608a_ring_t *ring);
+
+#endif /* ATECC608A_RING_H */
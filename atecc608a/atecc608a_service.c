@@ -0,0 +1,530 @@
+/**
+ * \file atecc608a_service.c
+ * \brief Device-owner thread serving crypto requests from any context.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include "atecc608a_service.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "atecc608a_cost_model.h"
+#include "atecc608a_ring.h"
+#include "atecc608a_se.h"
+#include "atecc608a_stats.h"
+#include "atecc608a_utils.h"
+#include "platform/mbed_critical.h"
+
+/* Thread flag telling the service thread that the ring has new requests. */
+#define SUBMITTED_FLAG 0x1u
+
+#define BLOCK_SIZE 32
+
+/* Requests taken off a ring wait in a queue owned by the service thread,
+ * where their age can be looked at. */
+typedef struct {
+    atecc608a_request_t *head;
+    atecc608a_request_t *tail;
+} queue_t;
+
+static atecc608a_ring_cell_t ring_cells[ATECC608A_PRIORITY_COUNT][ATECC608A_SERVICE_RING_SIZE];
+static atecc608a_ring_t rings[ATECC608A_PRIORITY_COUNT];
+static queue_t queues[ATECC608A_PRIORITY_COUNT];
+static osThreadId_t service_thread_id;
+static volatile uint32_t rejected;
+static bool scheduling = true;
+/* Submission to completion, recorded by the service thread only. */
+static atecc608a_histogram_t latency[ATECC608A_PRIORITY_COUNT];
+/* Requests dropped unrun, and the device time the cost model says they
+ * would have taken. Service thread only. */
+static uint32_t expired;
+static uint32_t cancelled;
+static uint64_t expired_us;
+static uint64_t cancelled_us;
+
+/* cryptoauthlib calls need more stack than the console reader. */
+static const osThreadAttr_t service_thread_attr = {
+    .name = "atecc608a",
+    .stack_size = 2048,
+    .priority = osPriorityAboveNormal,
+};
+
+/* Run one step of a request. `finished` is set once nothing is left. */
+static psa_status_t execute_step(atecc608a_request_t *request, bool *finished)
+{
+    psa_status_t status;
+    uint8_t block[BLOCK_SIZE];
+    uint32_t chunk;
+
+    *finished = true;
+    switch (request->op) {
+        case ATECC608A_REQUEST_SIGN:
+            return atecc608a_driver()->p_asym->p_sign(
+                       request->slot, PSA_ALG_ECDSA(PSA_ALG_SHA_256),
+                       request->hash, request->hash_length, request->data,
+                       request->data_size, &request->data_length);
+        case ATECC608A_REQUEST_VERIFY:
+            return atecc608a_driver()->p_asym->p_verify(
+                       request->slot, PSA_ALG_ECDSA(PSA_ALG_SHA_256),
+                       request->hash, request->hash_length, request->data,
+                       request->data_length);
+        case ATECC608A_REQUEST_RANDOM:
+            request->data_length = 32;
+            return atecc608a_random_32_bytes(request->data, request->data_size);
+        case ATECC608A_REQUEST_RANDOM_FILL:
+            if (request->progress >= request->data_size) {
+                return PSA_SUCCESS;
+            }
+            chunk = request->data_size - request->progress;
+            chunk = chunk < BLOCK_SIZE ? chunk : BLOCK_SIZE;
+            status = atecc608a_random_32_bytes(block, sizeof(block));
+            if (status != PSA_SUCCESS) {
+                return status;
+            }
+            memcpy(request->data + request->progress, block, chunk);
+            request->progress += chunk;
+            request->data_length = request->progress;
+            *finished = request->progress >= request->data_size;
+            return PSA_SUCCESS;
+        case ATECC608A_REQUEST_WRITE_DATA:
+            if (request->progress >= request->data_length) {
+                return PSA_SUCCESS;
+            }
+            /* Chunks end on block boundaries of the slot, so that each is at
+             * most one block write. */
+            chunk = BLOCK_SIZE - (request->offset + request->progress) % BLOCK_SIZE;
+            if (chunk > request->data_length - request->progress) {
+                chunk = request->data_length - request->progress;
+            }
+            status = atecc608a_device_write(request->slot,
+                                     request->offset + request->progress,
+                                     request->data + request->progress, chunk);
+            if (status != PSA_SUCCESS) {
+                return status;
+            }
+            request->progress += chunk;
+            *finished = request->progress >= request->data_length;
+            return PSA_SUCCESS;
+        case ATECC608A_REQUEST_GENERATE_KEYS:
+            while (request->progress < 16 &&
+                    !(request->slot_mask & (1u << request->progress))) {
+                request->progress++;
+            }
+            if (request->progress >= 16) {
+                return PSA_SUCCESS;
+            }
+            status = atecc608a_driver()->p_key_management->p_generate(
+                         request->progress,
+                         PSA_KEY_TYPE_ECC_KEYPAIR(PSA_ECC_CURVE_SECP256R1),
+                         PSA_KEY_USAGE_SIGN | PSA_KEY_USAGE_VERIFY, 256,
+                         NULL, 0, NULL, 0, NULL);
+            request->progress++;
+            *finished = (request->slot_mask >> request->progress) == 0;
+            return status;
+        case ATECC608A_REQUEST_EXPORT:
+            return atecc608a_driver()->p_key_management->p_export(
+                       request->slot, request->data, request->data_size,
+                       &request->data_length);
+        case ATECC608A_REQUEST_SHA256:
+            if (request->data_size < 32) {
+                return PSA_ERROR_BUFFER_TOO_SMALL;
+            }
+            request->data_length = 32;
+            return atecc608a_sha256(request->hash, request->hash_length,
+                                    request->data);
+        case ATECC608A_REQUEST_READ_DATA:
+            if (request->progress >= request->data_size) {
+                return PSA_SUCCESS;
+            }
+            /* Like writes, on block boundaries of the slot. */
+            chunk = BLOCK_SIZE - (request->offset + request->progress) % BLOCK_SIZE;
+            if (chunk > request->data_size - request->progress) {
+                chunk = request->data_size - request->progress;
+            }
+            status = atecc608a_device_read(request->slot,
+                                           request->offset + request->progress,
+                                           request->data + request->progress,
+                                           chunk);
+            if (status != PSA_SUCCESS) {
+                return status;
+            }
+            request->progress += chunk;
+            request->data_length = request->progress;
+            *finished = request->progress >= request->data_size;
+            return PSA_SUCCESS;
+        default:
+            return PSA_ERROR_NOT_SUPPORTED;
+    }
+}
+
+/* Predicted device time left for a request, from the cost model. */
+static uint64_t remaining_us(const atecc608a_request_t *request)
+{
+    uint32_t steps = 0;
+    atecc608a_cost_op_t op;
+
+    switch (request->op) {
+        case ATECC608A_REQUEST_SIGN:
+            op = ATECC608A_COST_SIGN;
+            steps = 1;
+            break;
+        case ATECC608A_REQUEST_VERIFY:
+            op = ATECC608A_COST_VERIFY;
+            steps = 1;
+            break;
+        case ATECC608A_REQUEST_RANDOM:
+            op = ATECC608A_COST_RANDOM;
+            steps = 1;
+            break;
+        case ATECC608A_REQUEST_RANDOM_FILL:
+            op = ATECC608A_COST_RANDOM;
+            if (request->progress < request->data_size) {
+                steps = (request->data_size - request->progress +
+                         BLOCK_SIZE - 1) / BLOCK_SIZE;
+            }
+            break;
+        case ATECC608A_REQUEST_WRITE_DATA:
+            /* Writes are split on block boundaries of the slot. */
+            op = ATECC608A_COST_WRITE_BLOCK;
+            if (request->progress < request->data_length) {
+                uint32_t start = request->offset + request->progress;
+                uint32_t end = request->offset + request->data_length;
+
+                steps = (end + BLOCK_SIZE - 1) / BLOCK_SIZE - start / BLOCK_SIZE;
+            }
+            break;
+        case ATECC608A_REQUEST_GENERATE_KEYS:
+            op = ATECC608A_COST_GENERATE;
+            for (uint32_t slot = request->progress; slot < 16; slot++) {
+                steps += (request->slot_mask >> slot) & 1;
+            }
+            break;
+        case ATECC608A_REQUEST_EXPORT:
+            op = ATECC608A_COST_EXPORT;
+            steps = 1;
+            break;
+        case ATECC608A_REQUEST_SHA256: {
+            /* A start and an end, and an update for each full 64 byte
+             * block. */
+            uint64_t update_us = atecc608a_cost_model_op_us(ATECC608A_COST_SHA_64) -
+                                 atecc608a_cost_model_op_us(ATECC608A_COST_SHA_SHORT);
+
+            return atecc608a_cost_model_op_us(ATECC608A_COST_SHA_SHORT) +
+                   request->hash_length / 64 * update_us;
+        }
+        case ATECC608A_REQUEST_READ_DATA:
+            op = ATECC608A_COST_READ_BLOCK;
+            if (request->progress < request->data_size) {
+                uint32_t start = request->offset + request->progress;
+                uint32_t end = request->offset + request->data_size;
+
+                steps = (end + BLOCK_SIZE - 1) / BLOCK_SIZE - start / BLOCK_SIZE;
+            }
+            break;
+        default:
+            return 0;
+    }
+    return (uint64_t) steps * atecc608a_cost_model_op_us(op);
+}
+
+static void complete(atecc608a_request_t *request, psa_status_t status)
+{
+    /* The waiter is read before `done` is set: once it is, the request may
+     * go out of scope. */
+    osThreadId_t waiter = request->waiter;
+    void (*callback)(atecc608a_request_t *) = request->callback;
+
+    /* Dropped requests are counted apart. */
+    if (request->state == ATECC608A_REQUEST_RUNNING) {
+        atecc608a_histogram_record(&latency[request->priority],
+                                   (uint32_t)(atecc608a_time_us() -
+                                              request->submitted_us));
+        request->state = ATECC608A_REQUEST_COMPLETED;
+    }
+    request->status = status;
+    if (callback != NULL) {
+        callback(request);
+    }
+    request->done = true;
+    if (waiter != NULL) {
+        osThreadFlagsSet(waiter, ATECC608A_SERVICE_DONE_FLAG);
+    }
+}
+
+/* Whether a request is dropped instead of run: it was cancelled, or the
+ * rest of it cannot finish before its deadline. A bulk request that already
+ * ran some steps is checked again before each one, but cannot be cancelled
+ * any more. */
+static bool drop_request(atecc608a_request_t *request)
+{
+    uint64_t cost = remaining_us(request);
+    uint32_t queued = ATECC608A_REQUEST_QUEUED;
+
+    if (request->state == ATECC608A_REQUEST_CANCELLED) {
+        cancelled++;
+        cancelled_us += cost;
+        return true;
+    }
+    if (request->deadline_us != ATECC608A_NO_DEADLINE &&
+            atecc608a_time_us() + cost > request->deadline_us) {
+        /* Lose against a concurrent cancel rather than count it twice. */
+        if (request->state == ATECC608A_REQUEST_RUNNING ||
+                core_util_atomic_cas_u32(&request->state, &queued,
+                                         ATECC608A_REQUEST_EXPIRED)) {
+            request->state = ATECC608A_REQUEST_EXPIRED;
+            expired++;
+            expired_us += cost;
+        } else {
+            cancelled++;
+            cancelled_us += cost;
+        }
+        return true;
+    }
+    if (request->state == ATECC608A_REQUEST_QUEUED &&
+            !core_util_atomic_cas_u32(&request->state, &queued,
+                                      ATECC608A_REQUEST_RUNNING)) {
+        /* Cancelled since it was looked at. */
+        cancelled++;
+        cancelled_us += cost;
+        return true;
+    }
+    return false;
+}
+
+/* Move everything submitted so far to the queues. */
+static void drain_rings(void)
+{
+    for (int priority = 0; priority < ATECC608A_PRIORITY_COUNT; priority++) {
+        atecc608a_request_t *request;
+
+        while ((request = atecc608a_ring_pop(&rings[priority])) != NULL) {
+            queue_t *queue = &queues[priority];
+
+            request->next = NULL;
+            if (queue->tail == NULL) {
+                queue->head = request;
+            } else {
+                queue->tail->next = request;
+            }
+            queue->tail = request;
+        }
+    }
+}
+
+/* The queue to serve next. Strict priority, where a request counts as one
+ * level more urgent per aging period it waited, up to the highest level,
+ * and the longest wait breaks ties, so that an aged request is not held off
+ * by a steady stream of fresh high priority ones. Without scheduling, the
+ * oldest request goes first. */
+static queue_t *pick_queue(void)
+{
+    uint64_t now = atecc608a_time_us();
+    queue_t *best = NULL;
+    int32_t best_rank = INT32_MAX;
+    uint64_t best_waited = 0;
+
+    for (int priority = 0; priority < ATECC608A_PRIORITY_COUNT; priority++) {
+        atecc608a_request_t *head = queues[priority].head;
+        uint64_t waited;
+        int32_t rank;
+
+        if (head == NULL) {
+            continue;
+        }
+        if (scheduling) {
+            waited = now - head->aging_us;
+            rank = priority - (int32_t)(waited / ATECC608A_SERVICE_AGING_US);
+            /* Up to the highest priority, not above it: a request that
+             * waited long would otherwise hold off fresh high priority
+             * ones for all of its steps. */
+            if (rank < 0) {
+                rank = 0;
+            }
+        } else {
+            waited = now - head->submitted_us;
+            rank = 0;
+        }
+        if (rank < best_rank || (rank == best_rank && waited > best_waited)) {
+            best_rank = rank;
+            best_waited = waited;
+            best = &queues[priority];
+        }
+    }
+    return best;
+}
+
+static void service_thread(void *argument)
+{
+    (void) argument;
+
+    for (;;) {
+        queue_t *queue;
+        atecc608a_request_t *request;
+        psa_status_t status;
+        bool finished;
+
+        drain_rings();
+        queue = pick_queue();
+        if (queue == NULL) {
+            osThreadFlagsWait(SUBMITTED_FLAG, osFlagsWaitAny, osWaitForever);
+            continue;
+        }
+
+        /* A bulk request stays at the head of its queue between steps, and
+         * the queues are looked at again after each step. */
+        request = queue->head;
+        do {
+            if (drop_request(request)) {
+                status = PSA_ERROR_BAD_STATE;
+                break;
+            }
+            status = execute_step(request, &finished);
+        } while (!scheduling && !finished && status == PSA_SUCCESS);
+        if (!finished && status == PSA_SUCCESS) {
+            request->aging_us = atecc608a_time_us();
+            continue;
+        }
+
+        queue->head = request->next;
+        if (queue->head == NULL) {
+            queue->tail = NULL;
+        }
+        complete(request, status);
+    }
+}
+
+bool atecc608a_service_start(void)
+{
+    if (service_thread_id != NULL) {
+        return true;
+    }
+    for (int priority = 0; priority < ATECC608A_PRIORITY_COUNT; priority++) {
+        atecc608a_ring_init(&rings[priority], ring_cells[priority],
+                            ATECC608A_SERVICE_RING_SIZE);
+        atecc608a_histogram_reset(&latency[priority]);
+    }
+    service_thread_id = osThreadNew(service_thread, NULL, &service_thread_attr);
+    return service_thread_id != NULL;
+}
+
+psa_status_t atecc608a_service_submit(atecc608a_request_t *request)
+{
+    if (service_thread_id == NULL) {
+        return PSA_ERROR_BAD_STATE;
+    }
+    if ((uint32_t) request->priority >= ATECC608A_PRIORITY_COUNT) {
+        return PSA_ERROR_INVALID_ARGUMENT;
+    }
+
+    request->done = false;
+    request->state = ATECC608A_REQUEST_QUEUED;
+    request->status = PSA_ERROR_GENERIC_ERROR;
+    request->progress = 0;
+    request->submitted_us = atecc608a_time_us();
+    request->aging_us = request->submitted_us;
+    /* Interrupt handlers poll or use the callback instead. */
+    request->waiter = core_util_is_isr_active() ? NULL : osThreadGetId();
+
+    if (!atecc608a_ring_push(&rings[request->priority], request)) {
+        core_util_atomic_incr_u32(&rejected, 1);
+        return PSA_ERROR_INSUFFICIENT_MEMORY;
+    }
+    /* Flags can be set from interrupt handlers. */
+    osThreadFlagsSet(service_thread_id, SUBMITTED_FLAG);
+    return PSA_SUCCESS;
+}
+
+psa_status_t atecc608a_service_wait(atecc608a_request_t *request,
+                                    uint32_t timeout_ms)
+{
+    uint32_t start = osKernelGetTickCount();
+
+    while (!request->done) {
+        uint32_t elapsed = osKernelGetTickCount() - start;
+
+        if (timeout_ms != osWaitForever && elapsed >= timeout_ms) {
+            return PSA_ERROR_BAD_STATE;
+        }
+        /* The flag may be left over from an earlier request of this thread,
+         * hence the loop. */
+        osThreadFlagsWait(ATECC608A_SERVICE_DONE_FLAG, osFlagsWaitAny,
+                          timeout_ms == osWaitForever ? osWaitForever :
+                          timeout_ms - elapsed);
+    }
+    return request->status;
+}
+
+bool atecc608a_service_cancel(atecc608a_request_t *request)
+{
+    uint32_t queued = ATECC608A_REQUEST_QUEUED;
+
+    /* The service thread moves the request out of the queued state with the
+     * same compare and swap before it runs it, so only one of them wins. */
+    return core_util_atomic_cas_u32(&request->state, &queued,
+                                    ATECC608A_REQUEST_CANCELLED);
+}
+
+uint64_t atecc608a_service_deadline_in(uint32_t ms)
+{
+    return atecc608a_time_us() + (uint64_t) ms * 1000;
+}
+
+uint32_t atecc608a_service_rejected(void)
+{
+    return rejected;
+}
+
+void atecc608a_service_set_scheduling(bool enabled)
+{
+    scheduling = enabled;
+}
+
+void atecc608a_service_reset_stats(void)
+{
+    for (int priority = 0; priority < ATECC608A_PRIORITY_COUNT; priority++) {
+        atecc608a_histogram_reset(&latency[priority]);
+    }
+    expired = 0;
+    cancelled = 0;
+    expired_us = 0;
+    cancelled_us = 0;
+}
+
+void atecc608a_service_print_stats(void)
+{
+    static const char *const names[ATECC608A_PRIORITY_COUNT] = {
+        "high", "normal", "bulk"
+    };
+
+    printf("  priority  requests  p50 us  p90 us  p99 us  max us\n");
+    for (int priority = 0; priority < ATECC608A_PRIORITY_COUNT; priority++) {
+        const atecc608a_histogram_t *histogram = &latency[priority];
+
+        printf("  %-8s  %8lu  %6lu  %6lu  %6lu  %6lu\n", names[priority],
+               (unsigned long) histogram->total,
+               (unsigned long) atecc608a_histogram_percentile(histogram, 50),
+               (unsigned long) atecc608a_histogram_percentile(histogram, 90),
+               (unsigned long) atecc608a_histogram_percentile(histogram, 99),
+               (unsigned long) histogram->max);
+    }
+    printf("  expired: %lu, %lu ms of device time saved\n",
+           (unsigned long) expired, (unsigned long)(expired_us / 1000));
+    printf("  cancelled: %lu, %lu ms of device time saved\n",
+           (unsigned long) cancelled, (unsigned long)(cancelled_us / 1000));
+}
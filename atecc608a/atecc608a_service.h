@@ -0,0 +1,184 @@
+/**
+ * \file atecc608a_service.h
+ * \brief Device-owner thread serving crypto requests from any context.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_SERVICE_H
+#define ATECC608A_SERVICE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cmsis_os2.h"
+#include "psa/crypto.h"
+
+/** Requests of each priority that can wait in the submission rings before
+ *  the service thread picks them up, a power of two. */
+#ifndef ATECC608A_SERVICE_RING_SIZE
+#define ATECC608A_SERVICE_RING_SIZE 16
+#endif
+
+/** A waiting request moves up one priority level for each such period it
+ *  waits, up to the highest priority, so that lower priorities are not
+ *  starved. At the same level, the request that waited longest goes first.
+ *  A bulk request starts aging again after each of its steps. */
+#ifndef ATECC608A_SERVICE_AGING_US
+#define ATECC608A_SERVICE_AGING_US 100000
+#endif
+
+/** Thread flag set on the submitting thread when one of its requests
+ *  completes. */
+#define ATECC608A_SERVICE_DONE_FLAG 0x00010000u
+
+typedef enum {
+    /** Latency-critical, e.g. a handshake signature. */
+    ATECC608A_PRIORITY_HIGH,
+    ATECC608A_PRIORITY_NORMAL,
+    /** Background work, e.g. refilling a random pool. */
+    ATECC608A_PRIORITY_BULK,
+    ATECC608A_PRIORITY_COUNT,
+} atecc608a_priority_t;
+
+/** Operations. The bulk ones are run one block or one item at a time, and
+ *  more urgent requests are served between the steps. */
+typedef enum {
+    /** Sign `hash` with the private key in `slot`, into `data`. */
+    ATECC608A_REQUEST_SIGN,
+    /** Verify the signature in `data` over `hash` with the public key in
+     *  `slot`. */
+    ATECC608A_REQUEST_VERIFY,
+    /** Fill `data` with 32 random bytes. */
+    ATECC608A_REQUEST_RANDOM,
+    /** Fill all `data_size` bytes of `data` with random bytes, 32 bytes per
+     *  step. */
+    ATECC608A_REQUEST_RANDOM_FILL,
+    /** Write `data_length` bytes of `data` to `slot` at `offset`, up to a
+     *  32 byte block per step. */
+    ATECC608A_REQUEST_WRITE_DATA,
+    /** Generate a P-256 key in every slot of `slot_mask`, one per step. */
+    ATECC608A_REQUEST_GENERATE_KEYS,
+    /** Export the public key of the key in `slot` into `data`. */
+    ATECC608A_REQUEST_EXPORT,
+    /** Hash the `hash_length` bytes at `hash` with the device SHA-256, into
+     *  the 32 bytes of `data`. */
+    ATECC608A_REQUEST_SHA256,
+    /** Read `data_size` bytes of `slot` at `offset` into `data`, up to a 32
+     *  byte block per step. */
+    ATECC608A_REQUEST_READ_DATA,
+} atecc608a_request_op_t;
+
+typedef enum {
+    ATECC608A_REQUEST_QUEUED,
+    ATECC608A_REQUEST_RUNNING,
+    ATECC608A_REQUEST_COMPLETED,
+    /** Cancelled by the caller before it started. */
+    ATECC608A_REQUEST_CANCELLED,
+    /** Dropped because the cost model said it could not finish before its
+     *  deadline. */
+    ATECC608A_REQUEST_EXPIRED,
+} atecc608a_request_state_t;
+
+/** No deadline. */
+#define ATECC608A_NO_DEADLINE 0
+
+typedef struct atecc608a_request atecc608a_request_t;
+
+struct atecc608a_request {
+    atecc608a_request_op_t op;
+    atecc608a_priority_t priority;
+    psa_key_slot_number_t slot;
+    uint16_t offset;
+    uint16_t slot_mask;
+    const uint8_t *hash;
+    size_t hash_length;
+    uint8_t *data;
+    size_t data_size;
+    /** Length of the signature to verify, or of the output. */
+    size_t data_length;
+    /** atecc608a_time_us() by which the request must be finished, or
+     *  ATECC608A_NO_DEADLINE. */
+    uint64_t deadline_us;
+    /** Called by the service thread on completion, may be NULL. */
+    void (*callback)(atecc608a_request_t *request);
+    void *context;
+
+    /* Set by the service. */
+    psa_status_t status;
+    /** An atecc608a_request_state_t. */
+    volatile uint32_t state;
+    /** The service no longer uses the request. */
+    volatile bool done;
+    osThreadId_t waiter;
+    uint64_t submitted_us;
+    /* When the request started waiting for its next step. */
+    uint64_t aging_us;
+    /* Bytes or slots done so far by a bulk request. */
+    uint32_t progress;
+    atecc608a_request_t *next;
+};
+
+/** Start the thread that serves requests. Other threads may still use the
+ *  device directly, the device lock orders them with the service. */
+bool atecc608a_service_start(void);
+
+/** Queue a request without blocking. This is safe in interrupt handlers.
+ *  The request must stay valid until it is done. Fails with
+ *  PSA_ERROR_INSUFFICIENT_MEMORY if the ring is full. */
+psa_status_t atecc608a_service_submit(atecc608a_request_t *request);
+
+/** Wait until a request submitted from this thread is done and return its
+ *  status, or PSA_ERROR_BAD_STATE if it is still pending after
+ *  `timeout_ms`. Cancelled and expired requests are done with the status
+ *  PSA_ERROR_BAD_STATE too, their `state` tells them apart. */
+psa_status_t atecc608a_service_wait(atecc608a_request_t *request,
+                                    uint32_t timeout_ms);
+
+static inline bool atecc608a_service_is_done(const atecc608a_request_t *request)
+{
+    return request->done;
+}
+
+/** Cancel a request that has not started yet and return true. It is done,
+ *  and may be reused, once the service thread took it off its queue. This
+ *  is safe in interrupt handlers. */
+bool atecc608a_service_cancel(atecc608a_request_t *request);
+
+/** A deadline `ms` milliseconds from now. */
+uint64_t atecc608a_service_deadline_in(uint32_t ms);
+
+/** Number of submissions refused because the ring was full. */
+uint32_t atecc608a_service_rejected(void);
+
+/** With scheduling off, requests are served in submission order whatever
+ *  their priority, and bulk requests run to completion once started - for
+ *  comparison. It is on by default. Only change it while the service is
+ *  idle. */
+void atecc608a_service_set_scheduling(bool enabled);
+
+/** Forget the latency statistics. Only call it while the service is idle. */
+void atecc608a_service_reset_stats(void);
+
+/** Print the submission to completion latency percentiles of each
+ *  priority, and the requests that expired or were cancelled with the
+ *  device time they would have taken. */
+void atecc608a_service_print_stats(void);
+
+#endif /* ATECC608A_SERVICE_H */
@@ -0,0 +1,160 @@
+/**
+ * \file atecc608a_stats.c
+ * \brief Timing and latency statistics helpers for tests and benchmarks.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include "atecc608a_stats.h"
+
+#include <string.h>
+
+#include "cmsis.h"
+#include "hal/us_ticker_api.h"
+
+#if !defined(__MBED__)
+#include <time.h>
+#endif
+
+/* log2 of ATECC608A_HISTOGRAM_SUB_BUCKETS */
+#define SUB_BUCKET_BITS 4
+
+uint64_t atecc608a_time_us(void)
+{
+    return ticker_read_us(get_us_ticker_data());
+}
+
+uint32_t atecc608a_cycles(void)
+{
+#if defined(DWT_CTRL_CYCCNTENA_Msk)
+    if ((DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk) == 0) {
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CYCCNT = 0;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    }
+    return DWT->CYCCNT;
+#elif !defined(__MBED__)
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t) ts.tv_sec * 1000000000u +
+                      (uint64_t) ts.tv_nsec);
+#else
+    return (uint32_t)(atecc608a_time_us() * (SystemCoreClock / 1000000));
+#endif
+}
+
+/* Values below 16 get a bucket each. Above that, a value with its highest set
+ * bit at position `e` lands in group `e - 3`, and its next four bits select
+ * the sub-bucket within the group. */
+static uint32_t bucket_index(uint32_t value)
+{
+    uint32_t shift;
+
+    if (value < ATECC608A_HISTOGRAM_SUB_BUCKETS) {
+        return value;
+    }
+    shift = (31 - __builtin_clz(value)) - SUB_BUCKET_BITS;
+    return (shift + 1) * ATECC608A_HISTOGRAM_SUB_BUCKETS +
+           ((value >> shift) - ATECC608A_HISTOGRAM_SUB_BUCKETS);
+}
+
+/* Largest value that maps to bucket `index`. */
+static uint32_t bucket_highest_value(uint32_t index)
+{
+    uint32_t shift;
+    uint32_t sub;
+
+    if (index < ATECC608A_HISTOGRAM_SUB_BUCKETS) {
+        return index;
+    }
+    shift = index / ATECC608A_HISTOGRAM_SUB_BUCKETS - 1;
+    sub = index % ATECC608A_HISTOGRAM_SUB_BUCKETS;
+    return (((ATECC608A_HISTOGRAM_SUB_BUCKETS + sub) << shift) - 1) +
+           (1u << shift);
+}
+
+void atecc608a_histogram_reset(atecc608a_histogram_t *histogram)
+{
+    memset(histogram, 0, sizeof(*histogram));
+    histogram->min = UINT32_MAX;
+}
+
+void atecc608a_histogram_record(atecc608a_histogram_t *histogram,
+                                uint32_t value)
+{
+    histogram->counts[bucket_index(value)]++;
+    histogram->total++;
+    histogram->sum += value;
+    if (value < histogram->min) {
+        histogram->min = value;
+    }
+    if (value > histogram->max) {
+        histogram->max = value;
+    }
+}
+
+void atecc608a_histogram_merge(atecc608a_histogram_t *to,
+                               const atecc608a_histogram_t *from)
+{
+    for (uint32_t i = 0; i < ATECC608A_HISTOGRAM_BUCKETS; i++) {
+        to->counts[i] += from->counts[i];
+    }
+    to->total += from->total;
+    to->sum += from->sum;
+    if (from->min < to->min) {
+        to->min = from->min;
+    }
+    if (from->max > to->max) {
+        to->max = from->max;
+    }
+}
+
+uint32_t atecc608a_histogram_percentile(const atecc608a_histogram_t *histogram,
+                                        double percentile)
+{
+    uint64_t rank;
+    uint64_t seen = 0;
+
+    if (histogram->total == 0) {
+        return 0;
+    }
+    if (percentile >= 100.0) {
+        return histogram->max;
+    }
+    /* Rank of the value we are looking for, counting from 1. */
+    rank = (uint64_t)(percentile / 100.0 * histogram->total + 0.5);
+    if (rank == 0) {
+        rank = 1;
+    }
+    for (uint32_t i = 0; i < ATECC608A_HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->counts[i];
+        if (seen >= rank) {
+            uint32_t value = bucket_highest_value(i);
+            return value < histogram->max ? value : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+uint32_t atecc608a_histogram_mean(const atecc608a_histogram_t *histogram)
+{
+    if (histogram->total == 0) {
+        return 0;
+    }
+    return (uint32_t)(histogram->sum / histogram->total);
+}
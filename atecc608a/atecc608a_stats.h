@@ -0,0 +1,71 @@
+/**
+ * \file atecc608a_stats.h
+ * \brief Timing and latency statistics helpers for tests and benchmarks.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_STATS_H
+#define ATECC608A_STATS_H
+
+#include <stdint.h>
+
+/** Each power of two range of values is split into this many linear
+ *  sub-buckets, which bounds the relative error of a reported value to
+ *  1/16 (about 6%). */
+#define ATECC608A_HISTOGRAM_SUB_BUCKETS 16
+
+/** Enough buckets to cover the full uint32_t range. */
+#define ATECC608A_HISTOGRAM_BUCKETS (29 * ATECC608A_HISTOGRAM_SUB_BUCKETS)
+
+/** A log-linear (HDR style) histogram of latencies in microseconds, with a
+ *  fixed size and constant time recording. */
+typedef struct {
+    uint32_t counts[ATECC608A_HISTOGRAM_BUCKETS];
+    uint32_t total;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+} atecc608a_histogram_t;
+
+/** Microseconds since boot, from the 64-bit extended microsecond ticker. */
+uint64_t atecc608a_time_us(void);
+
+/** Free-running 32-bit CPU cycle counter. This is DWT CYCCNT where the core
+ *  has one, and is derived from the microsecond ticker on Cortex-M0/M0+.
+ *  Host builds count nanoseconds of CLOCK_MONOTONIC. */
+uint32_t atecc608a_cycles(void);
+
+void atecc608a_histogram_reset(atecc608a_histogram_t *histogram);
+
+void atecc608a_histogram_record(atecc608a_histogram_t *histogram,
+                                uint32_t value);
+
+/** Add all values recorded in `from` to `to`. */
+void atecc608a_histogram_merge(atecc608a_histogram_t *to,
+                               const atecc608a_histogram_t *from);
+
+/** Smallest value such that `percentile` percent of the recorded values are
+ *  less than or equal to it, within the bucket resolution. Returns 0 for an
+ *  empty histogram. */
+uint32_t atecc608a_histogram_percentile(const atecc608a_histogram_t *histogram,
+                                        double percentile);
+
+uint32_t atecc608a_histogram_mean(const atecc608a_histogram_t *histogram);
+
+#endif /* ATECC608A_STATS_H */
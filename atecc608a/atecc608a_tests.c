@@ -0,0 +1,955 @@
+/**
+ * \file atecc608a_tests.c
+ * \brief Tests of the driver and the utilities, run at boot, with `test` and in
+ *        soak runs.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include "atecc608a_tests.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "atecc608a_crc16.h"
+#include "atecc608a_device_commands.h"
+#include "atecc608a_event_log.h"
+#include "atecc608a_event_log_commands.h"
+#include "atecc608a_key_commands.h"
+#include "atecc608a_load_commands.h"
+#include "atecc608a_placement_commands.h"
+#include "atecc608a_stats.h"
+#include "atecc608a_tls_commands.h"
+#include "atecc608a_utils.h"
+#include "atecc608a_verify_cache.h"
+
+static psa_status_t atecc608a_hash_sha256(const uint8_t *input, size_t input_size,
+                                          const uint8_t *expected_hash,
+                                          size_t expected_hash_size)
+{
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+    uint8_t actual_hash[ATCA_SHA_DIGEST_SIZE] = {0};
+
+    atecc608a_device_lock();
+    ASSERT_SUCCESS_PSA(atecc608a_init());
+    ASSERT_SUCCESS(atcab_hw_sha2_256(input, input_size, actual_hash));
+
+    ASSERT_STATUS(memcmp(actual_hash, expected_hash, sizeof(actual_hash)), 0,
+                  PSA_ERROR_HARDWARE_FAILURE);
+
+exit:
+    atecc608a_deinit();
+    atecc608a_device_unlock();
+    return status;
+}
+
+/* Test that a 32 byte clear text write and read can be performed on a slot. */
+static psa_status_t test_write_read_slot(uint16_t slot)
+{
+    const uint8_t test_write_read_size = 32;
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+    uint8_t data_write[test_write_read_size];
+    uint8_t data_read[test_write_read_size];
+
+    ASSERT_SUCCESS_PSA(atecc608a_random_32_bytes(data_write, test_write_read_size));
+    ASSERT_SUCCESS_PSA(atecc608a_device_write(slot, 0, data_write, test_write_read_size));
+    ASSERT_SUCCESS_PSA(atecc608a_device_read(slot, 0, data_read, test_write_read_size));
+    ASSERT_STATUS(memcmp(data_write, data_read, test_write_read_size),
+                  0, PSA_ERROR_HARDWARE_FAILURE);
+
+    TEST_PASSED("test_write_read_slot");
+exit:
+    return status;
+}
+
+/* Test that a signature from hardware can be verified by PSA with a public
+ * key imported to PSA. */
+static psa_status_t test_psa_import_verify()
+{
+    psa_status_t status;
+    psa_key_handle_t verify_handle;
+    psa_key_policy_t policy = PSA_KEY_POLICY_INIT;
+    static uint8_t pubkey[pubkey_size];
+    size_t pubkey_len = 0;
+    uint8_t signature[sig_size];
+    size_t signature_length = 0;
+    const uint8_t hash[hash_size] = {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
+    };
+
+    ASSERT_SUCCESS_PSA(atecc608a_driver()->p_asym->p_sign(
+                           atecc608a_private_key_slot, alg, hash, sizeof(hash),
+                           signature, sizeof(signature), &signature_length));
+
+    ASSERT_SUCCESS_PSA(atecc608a_driver()->p_key_management->p_export(
+                           atecc608a_private_key_slot, pubkey, sizeof(pubkey),
+                           &pubkey_len));
+    /*
+     * Import the secure element's public key into a volatile key slot.
+     */
+    ASSERT_SUCCESS_PSA(psa_allocate_key(&verify_handle));
+
+    psa_key_policy_set_usage(&policy, PSA_KEY_USAGE_VERIFY, alg);
+    ASSERT_SUCCESS_PSA(psa_set_key_policy(verify_handle, &policy));
+
+    ASSERT_SUCCESS_PSA(psa_import_key(verify_handle, key_type, pubkey,
+                                      pubkey_len));
+
+    /* Verify that the signature produced by the secure element is valid. */
+    ASSERT_SUCCESS_PSA(psa_asymmetric_verify(verify_handle, alg, hash,
+                                             sizeof(hash), signature,
+                                             signature_length));
+
+    TEST_PASSED("test_psa_import_verify");
+exit:
+    return status;
+}
+
+/* Test that the verify key cache verifies signatures of the private key
+ * slot, and that it picks up a new key generated in the slot. */
+static psa_status_t test_verify_cache()
+{
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+    uint8_t signature[sig_size];
+    size_t signature_length = 0;
+    const uint8_t hash[hash_size] = {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02,
+    };
+
+    ASSERT_SUCCESS_PSA(atecc608a_driver()->p_asym->p_sign(
+                           atecc608a_private_key_slot, alg, hash, sizeof(hash),
+                           signature, sizeof(signature), &signature_length));
+    /* A miss, then a hit. */
+    ASSERT_SUCCESS_PSA(atecc608a_verify_cache_verify(
+                           atecc608a_private_key_slot, hash, sizeof(hash),
+                           signature, signature_length));
+    ASSERT_SUCCESS_PSA(atecc608a_verify_cache_verify(
+                           atecc608a_private_key_slot, hash, sizeof(hash),
+                           signature, signature_length));
+
+    /* The old signature must not verify with the new key. */
+    ASSERT_SUCCESS_PSA(atecc608a_driver()->p_key_management->p_generate(
+                           atecc608a_private_key_slot, keypair_type,
+                           PSA_KEY_USAGE_SIGN | PSA_KEY_USAGE_VERIFY, key_bits,
+                           NULL, 0, NULL, 0, NULL));
+    ASSERT_STATUS_PSA(atecc608a_verify_cache_verify(
+                          atecc608a_private_key_slot, hash, sizeof(hash),
+                          signature, signature_length),
+                      PSA_ERROR_INVALID_SIGNATURE, PSA_ERROR_GENERIC_ERROR);
+
+    ASSERT_SUCCESS_PSA(atecc608a_driver()->p_asym->p_sign(
+                           atecc608a_private_key_slot, alg, hash, sizeof(hash),
+                           signature, sizeof(signature), &signature_length));
+    ASSERT_SUCCESS_PSA(atecc608a_verify_cache_verify(
+                           atecc608a_private_key_slot, hash, sizeof(hash),
+                           signature, signature_length));
+
+    TEST_PASSED("test_verify_cache");
+exit:
+    return status;
+}
+
+/* Test that a public key generated while generating a private key can
+ * be imported. */
+static psa_status_t test_generate_import()
+{
+    /* Valid values */
+    psa_status_t status;
+    static uint8_t pubkey[pubkey_size];
+    size_t pubkey_len = 0;
+
+    /* Invalid values */
+    const uint16_t bad_key_id = 16;
+    const psa_key_type_t bad_key_type = PSA_KEY_TYPE_RSA_PUBLIC_KEY;
+    const size_t bad_key_bits = 5;
+    const size_t bad_buffer_size = 64;
+
+    /* Passing an invalid key slot should fail. */
+    ASSERT_STATUS_PSA(atecc608a_driver()->p_key_management->p_generate(
+                          bad_key_id, keypair_type,
+                          PSA_KEY_USAGE_SIGN | PSA_KEY_USAGE_VERIFY,
+                          key_bits, NULL, 0, pubkey, pubkey_size, &pubkey_len),
+                      PSA_ERROR_INVALID_ARGUMENT,
+                      PSA_ERROR_HARDWARE_FAILURE);
+
+    /* Passing an invalid key type should fail. */
+    ASSERT_STATUS_PSA(atecc608a_driver()->p_key_management->p_generate(
+                          atecc608a_private_key_slot, bad_key_type,
+                          PSA_KEY_USAGE_SIGN | PSA_KEY_USAGE_VERIFY,
+                          key_bits, NULL, 0, pubkey, pubkey_size,
+                          &pubkey_len),
+                      PSA_ERROR_NOT_SUPPORTED,
+                      PSA_ERROR_HARDWARE_FAILURE);
+
+    /* Passing invalid key bits should fail. */
+    ASSERT_STATUS_PSA(atecc608a_driver()->p_key_management->p_generate(
+                          atecc608a_private_key_slot, keypair_type,
+                          PSA_KEY_USAGE_SIGN | PSA_KEY_USAGE_VERIFY,
+                          bad_key_bits, NULL, 0, pubkey, pubkey_size,
+                          &pubkey_len),
+                      PSA_ERROR_NOT_SUPPORTED,
+                      PSA_ERROR_HARDWARE_FAILURE);
+
+    /* Passing an invalid size should fail. */
+    ASSERT_STATUS_PSA(atecc608a_driver()->p_key_management->p_generate(
+                          atecc608a_private_key_slot, keypair_type,
+                          PSA_KEY_USAGE_SIGN | PSA_KEY_USAGE_VERIFY,
+                          key_bits, NULL, 0, pubkey, bad_buffer_size,
+                          &pubkey_len),
+                      PSA_ERROR_BUFFER_TOO_SMALL,
+                      PSA_ERROR_HARDWARE_FAILURE);
+
+    /* Passing a NULL public key buffer should work, regardless of its size. */
+    ASSERT_SUCCESS_PSA(atecc608a_driver()->p_key_management->p_generate(
+                           atecc608a_private_key_slot, keypair_type,
+                           PSA_KEY_USAGE_SIGN | PSA_KEY_USAGE_VERIFY,
+                           key_bits, NULL, 0, NULL, pubkey_size,
+                           &pubkey_len));
+
+    /* Passing a NULL pubkey_len should work, even when exporting a public key. */
+    ASSERT_SUCCESS_PSA(atecc608a_driver()->p_key_management->p_generate(
+                           atecc608a_private_key_slot, keypair_type,
+                           PSA_KEY_USAGE_SIGN | PSA_KEY_USAGE_VERIFY,
+                           key_bits, NULL, 0, pubkey, pubkey_size, NULL));
+
+    /* Test that a public key received during a private key generation
+     * can be imported. */
+    ASSERT_SUCCESS_PSA(atecc608a_driver()->p_key_management->p_generate(
+                           atecc608a_private_key_slot, keypair_type,
+                           PSA_KEY_USAGE_SIGN | PSA_KEY_USAGE_VERIFY,
+                           key_bits, NULL, 0, pubkey, pubkey_size,
+                           &pubkey_len));
+
+    ASSERT_SUCCESS_PSA(atecc608a_driver()->p_key_management->p_import(
+                           atecc608a_public_key_slot,
+                           atecc608a_drv_info.lifetime,
+                           key_type, alg, PSA_KEY_USAGE_VERIFY, pubkey,
+                           pubkey_len));
+
+    /* Importing with a bad size should fail. */
+    ASSERT_STATUS_PSA(atecc608a_driver()->p_key_management->p_import(
+                          atecc608a_public_key_slot,
+                          atecc608a_drv_info.lifetime,
+                          key_type, alg, PSA_KEY_USAGE_VERIFY, pubkey,
+                          0),
+                      PSA_ERROR_INVALID_ARGUMENT,
+                      PSA_ERROR_HARDWARE_FAILURE);
+
+    TEST_PASSED("test_generate_import");
+exit:
+    return status;
+}
+
+/* Test that a public key that is exported from a private key can be
+ * imported to a public key slot by the driver. */
+static psa_status_t test_export_import()
+{
+    psa_status_t status;
+    static uint8_t pubkey[pubkey_size];
+    size_t pubkey_len = 0;
+
+    ASSERT_SUCCESS_PSA(atecc608a_driver()->p_key_management->p_export(
+                           atecc608a_private_key_slot, pubkey,
+                           sizeof(pubkey), &pubkey_len));
+
+    ASSERT_SUCCESS_PSA(atecc608a_driver()->p_key_management->p_import(
+                           atecc608a_public_key_slot,
+                           atecc608a_drv_info.lifetime,
+                           key_type, alg, PSA_KEY_USAGE_VERIFY, pubkey,
+                           pubkey_len));
+    TEST_PASSED("test_export_import");
+exit:
+    return status;
+}
+
+/* Test that signing using the generated private key and verifying using
+ * the exported public key works. */
+static psa_status_t test_sign_verify()
+{
+    psa_status_t status;
+    const uint8_t hash[hash_size] = {};
+    uint8_t signature[sig_size];
+    size_t signature_length = 0;
+    static uint8_t pubkey[pubkey_size];
+    size_t pubkey_len = 0;
+
+    ASSERT_SUCCESS_PSA(atecc608a_driver()->p_key_management->p_generate(
+                           atecc608a_private_key_slot, keypair_type,
+                           PSA_KEY_USAGE_SIGN | PSA_KEY_USAGE_VERIFY,
+                           key_bits, NULL, 0, pubkey, pubkey_size,
+                           &pubkey_len));
+
+    ASSERT_SUCCESS_PSA(atecc608a_driver()->p_key_management->p_import(
+                           atecc608a_public_key_slot,
+                           atecc608a_drv_info.lifetime,
+                           key_type, alg, PSA_KEY_USAGE_VERIFY, pubkey,
+                           pubkey_len));
+
+    ASSERT_SUCCESS_PSA(atecc608a_driver()->p_asym->p_sign(
+                           atecc608a_private_key_slot, alg, hash,
+                           sizeof(hash), signature, sizeof(signature),
+                           &signature_length));
+
+    ASSERT_SUCCESS_PSA(atecc608a_driver()->p_asym->p_verify(
+                           atecc608a_public_key_slot, alg, hash, sizeof(hash),
+                           signature, signature_length));
+    TEST_PASSED("test_sign_verify");
+exit:
+    return status;
+}
+
+/* Test that the table-driven CRC gives the same results as cryptoauthlib's
+ * bit-by-bit atCRC, for every message of up to two bytes and for every length
+ * and alignment of a config-sized buffer, which covers all the combinations of
+ * 8-byte slices and leftover bytes. */
+static psa_status_t test_crc16()
+{
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+    static uint8_t data[ATCA_ECC_CONFIG_SIZE + 8];
+    uint8_t expected[2];
+    uint8_t actual[2];
+    uint32_t seed = 1;
+
+    for (uint32_t value = 0; value <= 0xFFFF; value++) {
+        data[0] = (uint8_t) value;
+        data[1] = (uint8_t)(value >> 8);
+        atCRC(2, data, expected);
+        atecc608a_crc16(2, data, actual);
+        ASSERT_STATUS(memcmp(expected, actual, sizeof(actual)), 0,
+                      PSA_ERROR_GENERIC_ERROR);
+        if (value <= 0xFF) {
+            atCRC(1, data, expected);
+            atecc608a_crc16(1, data, actual);
+            ASSERT_STATUS(memcmp(expected, actual, sizeof(actual)), 0,
+                          PSA_ERROR_GENERIC_ERROR);
+        }
+    }
+
+    for (size_t i = 0; i < sizeof(data); i++) {
+        seed = seed * 1103515245 + 12345;
+        data[i] = (uint8_t)(seed >> 16);
+    }
+    for (size_t offset = 0; offset < 8; offset++) {
+        for (size_t length = 0; length <= ATCA_ECC_CONFIG_SIZE; length++) {
+            atCRC(length, data + offset, expected);
+            atecc608a_crc16(length, data + offset, actual);
+            ASSERT_STATUS(memcmp(expected, actual, sizeof(actual)), 0,
+                          PSA_ERROR_GENERIC_ERROR);
+        }
+    }
+
+    TEST_PASSED("test_crc16");
+exit:
+    return status;
+}
+
+/* Test that hardware sha256 works. */
+static psa_status_t test_hash_sha256()
+{
+    psa_status_t status;
+    const uint8_t hash_input1[] = "abc";
+    /* SHA-256 hash of ['a','b','c'] */
+    const uint8_t sha256_expected_hash1[] = {
+        0xBA, 0x78, 0x16, 0xBF, 0x8F, 0x01, 0xCF, 0xEA,
+        0x41, 0x41, 0x40, 0xDE, 0x5D, 0xAE, 0x22, 0x23,
+        0xB0, 0x03, 0x61, 0xA3, 0x96, 0x17, 0x7A, 0x9C,
+        0xB4, 0x10, 0xFF, 0x61, 0xF2, 0x00, 0x15, 0xAD
+    };
+
+    const uint8_t hash_input2[] = "";
+    /* SHA-256 hash of an empty string */
+    const uint8_t sha256_expected_hash2[] = {
+        0xe3, 0xb0, 0xc4, 0x42, 0x98, 0xfc, 0x1c, 0x14,
+        0x9a, 0xfb, 0xf4, 0xc8, 0x99, 0x6f, 0xb9, 0x24,
+        0x27, 0xae, 0x41, 0xe4, 0x64, 0x9b, 0x93, 0x4c,
+        0xa4, 0x95, 0x99, 0x1b, 0x78, 0x52, 0xb8, 0x55
+    };
+
+    ASSERT_SUCCESS_PSA(atecc608a_hash_sha256(hash_input1,
+                                             sizeof(hash_input1) - 1,
+                                             sha256_expected_hash1,
+                                             sizeof(sha256_expected_hash1)));
+
+    ASSERT_SUCCESS_PSA(atecc608a_hash_sha256(hash_input2,
+                                             sizeof(hash_input2) - 1,
+                                             sha256_expected_hash2,
+                                             sizeof(sha256_expected_hash2)));
+
+    TEST_PASSED("test_hash_sha256");
+exit:
+    return status;
+}
+
+/* Verify that the device has a locked config zone before running tests
+ * that use slots. */
+static psa_status_t check_config_zone_locked()
+{
+    return atecc608a_check_zone_locked(LOCK_ZONE_CONFIG);
+}
+
+/* Verify that the device has a locked data zone before running tests
+ * that use clear text read. */
+static psa_status_t check_data_zone_locked()
+{
+    return atecc608a_check_zone_locked(LOCK_ZONE_DATA);
+}
+
+/* Slot 8 is usually used as a clear write and read certificate
+ * or signature slot, as it is the biggest one (416 bytes of space). */
+static psa_status_t test_write_read_data_slot()
+{
+    return test_write_read_slot(8);
+}
+
+/* Device operations made by each test, used to estimate a test run without
+ * touching the device. Calls that the driver rejects before reaching the
+ * device are not counted. */
+static const atecc608a_cost_step_t cost_hash_sha256[] = {
+    { ATECC608A_COST_SHA_SHORT, 2 },
+};
+static const atecc608a_cost_step_t cost_zone_locked[] = {
+    { ATECC608A_COST_READ_WORD, 1 },
+};
+static const atecc608a_cost_step_t cost_generate_import[] = {
+    { ATECC608A_COST_GENERATE, 3 }, { ATECC608A_COST_IMPORT, 1 },
+};
+static const atecc608a_cost_step_t cost_export_import[] = {
+    { ATECC608A_COST_EXPORT, 1 }, { ATECC608A_COST_IMPORT, 1 },
+};
+static const atecc608a_cost_step_t cost_sign_verify[] = {
+    { ATECC608A_COST_GENERATE, 1 }, { ATECC608A_COST_IMPORT, 1 },
+    { ATECC608A_COST_SIGN, 1 }, { ATECC608A_COST_VERIFY, 1 },
+};
+static const atecc608a_cost_step_t cost_psa_import_verify[] = {
+    { ATECC608A_COST_SIGN, 1 }, { ATECC608A_COST_EXPORT, 1 },
+};
+static const atecc608a_cost_step_t cost_verify_cache[] = {
+    { ATECC608A_COST_SIGN, 2 }, { ATECC608A_COST_EXPORT, 2 },
+    { ATECC608A_COST_GENERATE, 1 },
+};
+static const atecc608a_cost_step_t cost_write_read_slot[] = {
+    { ATECC608A_COST_RANDOM, 1 }, { ATECC608A_COST_WRITE_BLOCK, 1 },
+    { ATECC608A_COST_READ_BLOCK, 1 },
+};
+
+static const test_step_t test_step_crc16 = {
+    "test_crc16", test_crc16, NULL, 0 FIXTURE(FACTORY)
+};
+static const test_step_t test_step_hash_sha256 = {
+    "test_hash_sha256", test_hash_sha256, COST_STEPS(cost_hash_sha256)
+    FIXTURE(FACTORY)
+};
+static const test_step_t test_step_config_zone_locked = {
+    "check_config_zone_locked", check_config_zone_locked,
+    COST_STEPS(cost_zone_locked) FIXTURE(CONFIG_LOCKED)
+};
+static const test_step_t test_step_generate_import = {
+    "test_generate_import", test_generate_import,
+    COST_STEPS(cost_generate_import) FIXTURE(CONFIG_LOCKED)
+};
+static const test_step_t test_step_export_import = {
+    "test_export_import", test_export_import, COST_STEPS(cost_export_import)
+    FIXTURE(CONFIG_LOCKED)
+};
+static const test_step_t test_step_sign_verify = {
+    "test_sign_verify", test_sign_verify, COST_STEPS(cost_sign_verify)
+    FIXTURE(CONFIG_LOCKED)
+};
+static const test_step_t test_step_psa_import_verify = {
+    "test_psa_import_verify", test_psa_import_verify,
+    COST_STEPS(cost_psa_import_verify) FIXTURE(CONFIG_LOCKED)
+};
+static const test_step_t test_step_verify_cache = {
+    "test_verify_cache", test_verify_cache, COST_STEPS(cost_verify_cache)
+    FIXTURE(CONFIG_LOCKED)
+};
+static const test_step_t test_step_data_zone_locked = {
+    "check_data_zone_locked", check_data_zone_locked,
+    COST_STEPS(cost_zone_locked) FIXTURE(LOCKED)
+};
+static const test_step_t test_step_write_read_slot = {
+    "test_write_read_slot", test_write_read_data_slot,
+    COST_STEPS(cost_write_read_slot) FIXTURE(LOCKED)
+};
+
+/* Tests in the order they are run, the ones of a feature are next to its
+ * commands. Zone lock checks are steps too, so that the tests depending on
+ * them are skipped when they fail. */
+const test_step_t *const test_steps[] = {
+    &test_step_crc16,
+    &test_step_hash_sha256,
+    &test_step_config_zone_locked,
+    &test_step_generate_import,
+    &test_step_export_import,
+    &test_step_sign_verify,
+    &test_step_psa_import_verify,
+    &test_step_verify_cache,
+    &test_step_data_zone_locked,
+    &test_step_csr,
+    &test_step_mirrored_export,
+    &test_step_write_read_slot,
+    &test_step_key_index,
+    &test_step_event_log,
+    &test_step_tls_ticket,
+    &test_step_placement,
+    &test_step_service_aging,
+};
+
+#define TEST_STEP_COUNT (sizeof(test_steps) / sizeof(test_steps[0]))
+
+const size_t test_step_count = TEST_STEP_COUNT;
+
+psa_status_t run_tests()
+{
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+
+    printf("Running tests...\n");
+    for (size_t i = 0; i < TEST_STEP_COUNT; i++) {
+#ifndef ATECC608A_EMULATOR
+        if (test_steps[i]->persistent) {
+            printf("%s skipped, run it with \'test\'.\n", test_steps[i]->name);
+            continue;
+        }
+#endif
+        ASSERT_SUCCESS_PSA(run_test_step(test_steps[i]));
+    }
+
+exit:
+    return status;
+}
+
+static job_step_result_t test_job_step(uint32_t done)
+{
+    if (done == 0) {
+        printf("Running tests...\n");
+    }
+    if (run_test_step(test_steps[done]) != PSA_SUCCESS) {
+        return JOB_STEP_FAILED;
+    }
+    return JOB_STEP_CONTINUE;
+}
+
+/* Soak runs repeat a weighted mix of the tests and report periodically, to
+ * collect error rates and latency drift over hours of operation. */
+#define SOAK_REPORT_INTERVAL_US (10 * 1000000ULL)
+
+typedef struct {
+    /* Relative frequency of the test in the mix, 0 excludes it. */
+    uint32_t weight;
+    /* Smooth weighted round-robin credit. */
+    int32_t credit;
+    uint32_t runs;
+    uint32_t failures;
+} soak_test_t;
+
+static struct {
+    /* Indexed like test_steps. */
+    soak_test_t tests[TEST_STEP_COUNT];
+    uint32_t max_iterations;
+    uint64_t max_duration_us;
+    uint32_t max_failures;
+    uint32_t failures;
+    uint64_t start_us;
+    uint64_t window_start_us;
+    uint32_t window_failures;
+    atecc608a_histogram_t window;
+    atecc608a_histogram_t overall;
+} soak = {
+    .max_failures = 10,
+};
+
+static bool test_step_is_test(size_t index)
+{
+    return strncmp(test_steps[index]->name, "test_", strlen("test_")) == 0;
+}
+
+/* The zone lock check a step depends on: the last check step before it, as
+ * run_tests() skips the steps after a failed check. TEST_STEP_COUNT if
+ * there is none. */
+static size_t test_step_gate(size_t index)
+{
+    size_t gate = TEST_STEP_COUNT;
+
+    for (size_t i = 0; i < index; i++) {
+        if (strncmp(test_steps[i]->name, "check_", strlen("check_")) == 0) {
+            gate = i;
+        }
+    }
+    return gate;
+}
+
+void soak_set_default_mix()
+{
+    for (size_t i = 0; i < TEST_STEP_COUNT; i++) {
+        soak.tests[i].weight =
+            test_step_is_test(i) && !test_steps[i]->persistent ? 1 : 0;
+    }
+}
+
+/* Parse "name:weight,name:weight,...". Tests that are not listed are
+ * excluded from the mix. The mix is left unchanged on error. */
+static bool soak_set_mix(char *mix)
+{
+    uint32_t weights[TEST_STEP_COUNT] = {0};
+    uint32_t total = 0;
+    char *entry = mix;
+
+    while (entry != NULL && *entry != '\0') {
+        char *next = strchr(entry, ',');
+        char *colon = strchr(entry, ':');
+        size_t name_len;
+        size_t i;
+
+        if (next != NULL) {
+            *next++ = '\0';
+        }
+        if (colon == NULL) {
+            printf("Missing weight for \'%s\' in soak mix.\n", entry);
+            return false;
+        }
+        name_len = colon - entry;
+        for (i = 0; i < TEST_STEP_COUNT; i++) {
+            if (test_step_is_test(i) &&
+                    strlen(test_steps[i]->name) == name_len &&
+                    strncmp(test_steps[i]->name, entry, name_len) == 0) {
+                break;
+            }
+        }
+        if (i == TEST_STEP_COUNT) {
+            printf("Unknown test \'%.*s\' in soak mix.\n", (int) name_len,
+                   entry);
+            return false;
+        }
+        weights[i] = (uint32_t) atoi(colon + 1);
+        total += weights[i];
+        entry = next;
+    }
+    if (total == 0) {
+        printf("Soak mix has to include at least one test.\n");
+        return false;
+    }
+    for (size_t i = 0; i < TEST_STEP_COUNT; i++) {
+        soak.tests[i].weight = weights[i];
+    }
+    return true;
+}
+
+static void print_soak_mix()
+{
+    printf("Soak mix:");
+    for (size_t i = 0; i < TEST_STEP_COUNT; i++) {
+        if (soak.tests[i].weight != 0) {
+            printf(" %s:%lu", test_steps[i]->name,
+                   (unsigned long) soak.tests[i].weight);
+        }
+    }
+    printf("\n");
+}
+
+static void print_soak_summary(const char *label,
+                               const atecc608a_histogram_t *histogram,
+                               uint64_t elapsed_us, uint32_t failures)
+{
+    /* Throughput in hundredths of a run per second. */
+    uint32_t rate = elapsed_us == 0 ? 0 :
+                    (uint32_t)(histogram->total * 100000000ULL / elapsed_us);
+
+    printf("[soak %s] %lu s, %lu runs, %lu.%02lu runs/s, failures %lu, "
+           "latency us: p50 %lu, p99 %lu, max %lu\n", label,
+           (unsigned long)(elapsed_us / 1000000),
+           (unsigned long) histogram->total,
+           (unsigned long)(rate / 100), (unsigned long)(rate % 100),
+           (unsigned long) failures,
+           (unsigned long) atecc608a_histogram_percentile(histogram, 50.0),
+           (unsigned long) atecc608a_histogram_percentile(histogram, 99.0),
+           (unsigned long)(histogram->total ? histogram->max : 0));
+}
+
+/* Pick the next test with smooth weighted round-robin, which spreads each
+ * test's runs evenly over the mix instead of running them in bursts. */
+static size_t soak_next_test()
+{
+    int32_t total = 0;
+    size_t best = TEST_STEP_COUNT;
+
+    for (size_t i = 0; i < TEST_STEP_COUNT; i++) {
+        if (soak.tests[i].weight == 0) {
+            continue;
+        }
+        soak.tests[i].credit += soak.tests[i].weight;
+        total += soak.tests[i].weight;
+        if (best == TEST_STEP_COUNT ||
+                soak.tests[i].credit > soak.tests[best].credit) {
+            best = i;
+        }
+    }
+    soak.tests[best].credit -= total;
+    return best;
+}
+
+static job_step_result_t soak_job_step(uint32_t done)
+{
+    size_t test = soak_next_test();
+    uint64_t start = atecc608a_time_us();
+    psa_status_t status = run_test_step(test_steps[test]);
+    uint64_t end = atecc608a_time_us();
+    uint32_t latency = (uint32_t)(end - start);
+
+    atecc608a_histogram_record(&soak.window, latency);
+    soak.tests[test].runs++;
+    if (status != PSA_SUCCESS) {
+        printf("[soak] %s failed with %ld at iteration %lu.\n",
+               test_steps[test]->name, (long) status, (unsigned long) done + 1);
+        soak.tests[test].failures++;
+        soak.window_failures++;
+        soak.failures++;
+    }
+
+    if (end - soak.window_start_us >= SOAK_REPORT_INTERVAL_US) {
+        print_soak_summary("window", &soak.window,
+                           end - soak.window_start_us, soak.window_failures);
+        atecc608a_histogram_merge(&soak.overall, &soak.window);
+        atecc608a_histogram_reset(&soak.window);
+        soak.window_failures = 0;
+        soak.window_start_us = end;
+    }
+
+    if (soak.max_failures != 0 && soak.failures >= soak.max_failures) {
+        printf("[soak] Failure threshold of %lu reached.\n",
+               (unsigned long) soak.max_failures);
+        return JOB_STEP_FAILED;
+    }
+    if ((soak.max_iterations != 0 && done + 1 >= soak.max_iterations) ||
+            (soak.max_duration_us != 0 &&
+             end - soak.start_us >= soak.max_duration_us)) {
+        return JOB_STEP_FINISHED;
+    }
+    return JOB_STEP_CONTINUE;
+}
+
+static void soak_job_stop()
+{
+    tests_verbose = true;
+    atecc608a_histogram_merge(&soak.overall, &soak.window);
+    print_soak_summary("total", &soak.overall,
+                       atecc608a_time_us() - soak.start_us, soak.failures);
+    for (size_t i = 0; i < TEST_STEP_COUNT; i++) {
+        if (soak.tests[i].runs != 0) {
+            printf("  - %s: %lu runs, %lu failures\n", test_steps[i]->name,
+                   (unsigned long) soak.tests[i].runs,
+                   (unsigned long) soak.tests[i].failures);
+        }
+    }
+}
+
+static void start_soak(uint32_t iterations, uint32_t seconds)
+{
+    bool checked[TEST_STEP_COUNT] = { false };
+
+    /* The zone lock checks the tests of the mix depend on are run once up
+     * front instead of being part of the mix. */
+    for (size_t i = 0; i < TEST_STEP_COUNT; i++) {
+        size_t gate = test_step_gate(i);
+
+        if (soak.tests[i].weight == 0 || gate == TEST_STEP_COUNT ||
+                checked[gate]) {
+            continue;
+        }
+        if (run_test_step(test_steps[gate]) != PSA_SUCCESS) {
+            printf("%s failed, %s cannot be part of a soak run.\n",
+                   test_steps[gate]->name, test_steps[i]->name);
+            return;
+        }
+        checked[gate] = true;
+    }
+
+    for (size_t i = 0; i < TEST_STEP_COUNT; i++) {
+        soak.tests[i].credit = 0;
+        soak.tests[i].runs = 0;
+        soak.tests[i].failures = 0;
+    }
+    soak.max_iterations = iterations;
+    soak.max_duration_us = seconds * 1000000ULL;
+    soak.failures = 0;
+    soak.window_failures = 0;
+    atecc608a_histogram_reset(&soak.window);
+    atecc608a_histogram_reset(&soak.overall);
+    if (!start_job("soak", soak_job_step, soak_job_stop, 0)) {
+        return;
+    }
+    print_soak_mix();
+    tests_verbose = false;
+    soak.start_us = atecc608a_time_us();
+    soak.window_start_us = soak.start_us;
+}
+
+static uint64_t estimate_tests()
+{
+    uint64_t total = 0;
+
+    for (size_t i = 0; i < TEST_STEP_COUNT; i++) {
+        total += print_estimate(test_steps[i]->name, test_steps[i]->cost,
+                                test_steps[i]->cost_steps, 1);
+    }
+    return total;
+}
+
+/* Duration of `iterations` soak iterations with the current mix, or of
+ * `seconds` if that limit is reached first. 0 means no limit for both, and
+ * UINT64_MAX is returned if neither is set. */
+static uint64_t estimate_soak(uint32_t iterations, uint32_t seconds)
+{
+    uint64_t mix_us = 0;
+    uint32_t total_weight = 0;
+    uint64_t us = UINT64_MAX;
+
+    for (size_t i = 0; i < TEST_STEP_COUNT; i++) {
+        mix_us += soak.tests[i].weight *
+                  atecc608a_cost_model_estimate_us(test_steps[i]->cost,
+                                                   test_steps[i]->cost_steps);
+        total_weight += soak.tests[i].weight;
+    }
+    if (total_weight == 0) {
+        return 0;
+    }
+    printf("  - ");
+    print_ms(mix_us / total_weight);
+    printf(" per iteration with the current mix\n");
+    if (iterations != 0) {
+        us = mix_us * iterations / total_weight;
+    }
+    if (seconds != 0 && seconds * 1000000ULL < us) {
+        us = seconds * 1000000ULL;
+    }
+    return us;
+}
+
+static bool run_test_command(char *command, char *arg)
+{
+    size_t len = strlen(command);
+
+    if (strcmp(command, "test") == 0) {
+        start_job("test", test_job_step, NULL, TEST_STEP_COUNT);
+    } else if (strncmp(command, "soak_mix=", strlen("soak_mix=")) == 0) {
+        if (soak_set_mix(arg + 1)) {
+            print_soak_mix();
+        }
+    } else if (strncmp(command, "soak_max_failures=",
+                       strlen("soak_max_failures=")) == 0) {
+        soak.max_failures = (uint32_t) atoi(arg + 1);
+        printf("Soak runs now stop after %lu failures (0 - never).\n",
+               (unsigned long) soak.max_failures);
+    } else if (strncmp(command, "soak=", strlen("soak=")) == 0) {
+        uint32_t iterations = (uint32_t) atoi(arg + 1);
+        char *seconds = strchr(arg, '_');
+
+        start_soak(iterations, seconds != NULL ? (uint32_t) atoi(seconds + 1) : 0);
+    } else if (strncmp(command, "private_slot", strlen("private_slot") - 1) == 0) {
+        uint16_t slot = 0;
+
+        // If there is no argument
+        if (len <= strlen("private_slot=0") - 1) {
+            printf("Please specify a slot that will be used as a private key in tests.\n");
+            return true;
+        }
+
+        slot = (uint16_t) atoi(arg + 1);
+        if (slot > 15) {
+            printf("Invalid slot %u provided as a private key slot.\n", slot);
+            return true;
+        }
+        if (slot == atecc608a_event_log_sign_slot()) {
+            printf("Slot %u signs the event log, the tests would replace its "
+                   "key.\n", slot);
+            return true;
+        }
+        atecc608a_private_key_slot = slot;
+
+        printf("The private key slot in use is now %u.\n", slot);
+    } else if (strncmp(command, "public_slot", strlen("public_slot") - 1) == 0) {
+        uint16_t slot = 9;
+
+        // If there is no argument
+        if (len <= strlen("public_slot=9") - 1) {
+            printf("Please specify a slot that will be used as a public key in tests.\n");
+            return true;
+        }
+
+        slot = (uint16_t) atoi(arg + 1);
+        if (slot > 15) {
+            printf("Invalid slot %u provided as a public key slot.\n", slot);
+            return true;
+        }
+        atecc608a_public_key_slot = slot;
+
+        printf("The public key slot in use is now %u.\n", slot);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool estimate_test_command(const char *command, const char *arg,
+                                  uint64_t *estimate_us)
+{
+    uint64_t us = 0;
+
+    if (strcmp(command, "test") == 0) {
+        printf("[dry run] %s\n", command);
+        us = estimate_tests();
+    } else if (strncmp(command, "soak=", strlen("soak=")) == 0 && arg != NULL) {
+        const char *seconds = strchr(arg, '_');
+
+        printf("[dry run] %s\n", command);
+        us = estimate_soak((uint32_t) atoi(arg + 1),
+                           seconds != NULL ? (uint32_t) atoi(seconds + 1) : 0);
+        if (us == UINT64_MAX) {
+            printf("  - no iteration or time limit, runs until cancelled\n");
+            us = 0;
+        }
+    } else {
+        return false;
+    }
+    *estimate_us = us;
+    return true;
+}
+
+static const char *const test_host_commands[] = {
+    "soak_mix=", "soak_max_failures=", "private_slot=", "public_slot=", NULL,
+};
+
+const command_module_t test_commands = {
+    " - test - run all tests on the device in the background, also those\n"
+    "          writing records or using a key for ECDH (key index, event\n"
+    "          log, TLS ticket) skipped at boot;\n"
+    " - soak=%d_%d - repeat tests in the background for a number of\n"
+    "                iterations (first argument) and/or seconds (second\n"
+    "                argument), 0 meaning no limit;\n"
+    " - soak_mix=%s:%d,... - relative weights of tests in a soak run,\n"
+    "                        e.g. soak_mix=test_sign_verify:4,test_hash_sha256:1,\n"
+    "                        the default leaves out those skipped at boot;\n"
+    " - soak_max_failures=%d - stop a soak run after this many failures;\n"
+    " - private_slot=%d - designate a slot to be used as a private key in tests;\n"
+    " - public_slot=%d - designate a slot to be used as a public key in tests;\n",
+    test_host_commands, run_test_command, estimate_test_command,
+};
@@ -0,0 +1,43 @@
+/**
+ * \file atecc608a_tests.h
+ * \brief Tests of the driver and the utilities, run at boot, with `test` and in
+ *        soak runs.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_TESTS_H
+#define ATECC608A_TESTS_H
+
+#include "atecc608a_app.h"
+
+/** test, soak, soak_mix, soak_max_failures, private_slot and public_slot. */
+extern const command_module_t test_commands;
+
+/** All test steps, in the order they are run. */
+extern const test_step_t *const test_steps[];
+extern const size_t test_step_count;
+
+/** Run the tests of the boot sequence. Tests that leave persistent records
+ *  are skipped but on the emulator. */
+psa_status_t run_tests(void);
+
+/** Put the tests that run at boot in the soak mix, with equal weights. */
+void soak_set_default_mix(void);
+
+#endif /* ATECC608A_TESTS_H */
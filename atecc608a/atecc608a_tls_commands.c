@@ -0,0 +1,321 @@
+/**
+ * \file atecc608a_tls_commands.c
+ * \brief Console commands of TLS session resumption.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include "atecc608a_tls_commands.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "atecc608a_stats.h"
+#include "atecc608a_tls_session.h"
+#include "atecc608a_utils.h"
+
+static bool same_tls_session(const atecc608a_tls_session_t *a,
+                             const atecc608a_tls_session_t *b)
+{
+    return a->ciphersuite == b->ciphersuite && a->id_length == b->id_length &&
+           a->start == b->start &&
+           memcmp(a->id, b->id, sizeof(a->id)) == 0 &&
+           memcmp(a->master, b->master, sizeof(a->master)) == 0 &&
+           memcmp(a->peer_hash, b->peer_hash, sizeof(a->peer_hash)) == 0;
+}
+
+/* Test that a session written into a ticket parses back the same, that a
+ * modified ticket is rejected, that a session older than the timeout is
+ * neither resumed from its ticket nor from the cache, and that tickets
+ * written within one epoch take a single key derivation. */
+static psa_status_t test_tls_ticket()
+{
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+    atecc608a_tls_session_t session = { 0 };
+    atecc608a_tls_session_t parsed;
+    atecc608a_tls_stats_t stats;
+    uint8_t ticket[ATECC608A_TLS_TICKET_SIZE];
+    size_t ticket_length;
+    uint32_t lifetime;
+    const uint32_t start = 1000;
+
+    atecc608a_tls_set_timeout(ATECC608A_TLS_SESSION_TIMEOUT);
+    atecc608a_tls_reset_stats();
+    ASSERT_SUCCESS_PSA(atecc608a_tls_ticket_setup(
+                           (uint16_t) atecc608a_private_key_slot, start));
+
+    session.ciphersuite = 0xC02B;
+    session.id_length = ATECC608A_TLS_SESSION_ID_SIZE;
+    session.start = start;
+    ASSERT_SUCCESS_PSA(psa_generate_random(session.id, sizeof(session.id)));
+    ASSERT_SUCCESS_PSA(psa_generate_random(session.master,
+                                           sizeof(session.master)));
+
+    ASSERT_SUCCESS_PSA(atecc608a_tls_ticket_write(&session, start, ticket,
+                                                  sizeof(ticket),
+                                                  &ticket_length, &lifetime));
+    ASSERT_SUCCESS_PSA(atecc608a_tls_ticket_write(&session, start + 1, ticket,
+                                                  sizeof(ticket),
+                                                  &ticket_length, &lifetime));
+    ASSERT_SUCCESS_PSA(atecc608a_tls_ticket_parse(ticket, ticket_length,
+                                                  start + 10, &parsed));
+    ASSERT_STATUS(same_tls_session(&parsed, &session), true,
+                  PSA_ERROR_GENERIC_ERROR);
+    atecc608a_tls_get_stats(&stats);
+    ASSERT_STATUS(stats.key_derivations, 1, PSA_ERROR_GENERIC_ERROR);
+
+    ticket[ticket_length / 2] ^= 0x01;
+    ASSERT_STATUS(atecc608a_tls_ticket_parse(ticket, ticket_length, start + 10,
+                                             &parsed),
+                  PSA_ERROR_INVALID_SIGNATURE, PSA_ERROR_GENERIC_ERROR);
+    ticket[ticket_length / 2] ^= 0x01;
+    ASSERT_STATUS(atecc608a_tls_ticket_parse(ticket, ticket_length,
+                                             start + lifetime + 1, &parsed),
+                  PSA_ERROR_DOES_NOT_EXIST, PSA_ERROR_GENERIC_ERROR);
+
+    ASSERT_SUCCESS_PSA(atecc608a_tls_cache_set(&session, start));
+    ASSERT_SUCCESS_PSA(atecc608a_tls_cache_get(session.id, session.id_length,
+                                               start + 10, &parsed));
+    ASSERT_STATUS(same_tls_session(&parsed, &session), true,
+                  PSA_ERROR_GENERIC_ERROR);
+    ASSERT_STATUS(atecc608a_tls_cache_get(session.id, session.id_length,
+                                          start + lifetime + 1, &parsed),
+                  PSA_ERROR_DOES_NOT_EXIST, PSA_ERROR_GENERIC_ERROR);
+    TEST_PASSED("test_tls_ticket");
+exit:
+    atecc608a_tls_ticket_free();
+    atecc608a_tls_cache_clear();
+    return status;
+}
+
+static const atecc608a_cost_step_t cost_tls_ticket[] = {
+    { ATECC608A_COST_EXPORT, 1 }, { ATECC608A_COST_ECDH_HMAC, 1 },
+};
+
+const test_step_t test_step_tls_ticket = {
+    "test_tls_ticket", test_tls_ticket, COST_STEPS(cost_tls_ticket)
+    FIXTURE(LOCKED) PERSISTENT
+};
+
+/* Clients of the reconnect workload. Even ones resume with a ticket, odd
+ * ones with their session ID from the cache. */
+#define TLS_CLIENTS 4
+
+/* A full handshake authenticated with the private key slot: one device
+ * signature of the transcript hash, with random stand-ins for the hash and
+ * for the secrets the key exchange would produce. */
+static psa_status_t tls_full_handshake(atecc608a_tls_session_t *session,
+                                       uint32_t now)
+{
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+    uint8_t hash[hash_size];
+    uint8_t signature[sig_size];
+    size_t signature_length;
+
+    ASSERT_SUCCESS_PSA(psa_generate_random(hash, sizeof(hash)));
+    ASSERT_SUCCESS_PSA(atecc608a_driver()->p_asym->p_sign(
+                           atecc608a_private_key_slot, alg, hash, sizeof(hash),
+                           signature, sizeof(signature), &signature_length));
+    memset(session, 0, sizeof(*session));
+    session->ciphersuite = 0xC02B;
+    session->id_length = ATECC608A_TLS_SESSION_ID_SIZE;
+    session->start = now;
+    ASSERT_SUCCESS_PSA(psa_generate_random(session->id, sizeof(session->id)));
+    ASSERT_SUCCESS_PSA(psa_generate_random(session->master,
+                                           sizeof(session->master)));
+
+exit:
+    return status;
+}
+
+static void print_tls_latency(const char *label,
+                              const atecc608a_histogram_t *histogram)
+{
+    printf("  - %-8s %5lu handshakes, latency us: mean %lu, p50 %lu, p99 %lu\n",
+           label, (unsigned long) histogram->total,
+           (unsigned long) atecc608a_histogram_mean(histogram),
+           (unsigned long) atecc608a_histogram_percentile(histogram, 50.0),
+           (unsigned long) atecc608a_histogram_percentile(histogram, 99.0));
+}
+
+/* `connections` connections of TLS_CLIENTS clients in turn, each client
+ * coming back every `interval` seconds of a simulated clock: first with a
+ * full handshake every time, then resuming where the session and the
+ * ticket allow it. */
+static psa_status_t tls_reconnect(uint32_t connections, uint32_t interval)
+{
+    static atecc608a_tls_session_t sessions[TLS_CLIENTS];
+    static uint8_t tickets[TLS_CLIENTS][ATECC608A_TLS_TICKET_SIZE];
+    static atecc608a_histogram_t full;
+    static atecc608a_histogram_t resumed;
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+    size_t ticket_lengths[TLS_CLIENTS] = { 0 };
+    atecc608a_tls_session_t session;
+    atecc608a_tls_stats_t stats;
+    psa_status_t found;
+    uint64_t baseline_us;
+    uint64_t start;
+    uint64_t us;
+    uint32_t signatures = 0;
+
+    if (connections == 0) {
+        return PSA_ERROR_INVALID_ARGUMENT;
+    }
+
+    atecc608a_histogram_reset(&full);
+    start = atecc608a_time_us();
+    for (uint32_t i = 0; i < connections; i++) {
+        uint64_t handshake_start = atecc608a_time_us();
+
+        ASSERT_SUCCESS_PSA(tls_full_handshake(&session, i / TLS_CLIENTS * interval));
+        atecc608a_histogram_record(&full, (uint32_t)(atecc608a_time_us() -
+                                                     handshake_start));
+    }
+    baseline_us = atecc608a_time_us() - start;
+    printf("Without resumption: %lu device signatures, %lu ms\n",
+           (unsigned long) connections, (unsigned long)(baseline_us / 1000));
+    print_tls_latency("full", &full);
+
+    atecc608a_histogram_reset(&full);
+    atecc608a_histogram_reset(&resumed);
+    atecc608a_tls_cache_clear();
+    atecc608a_tls_reset_stats();
+    start = atecc608a_time_us();
+    ASSERT_SUCCESS_PSA(atecc608a_tls_ticket_setup(
+                           (uint16_t) atecc608a_private_key_slot, 0));
+    for (uint32_t i = 0; i < connections; i++) {
+        uint32_t client = i % TLS_CLIENTS;
+        uint32_t now = i / TLS_CLIENTS * interval;
+        uint64_t handshake_start = atecc608a_time_us();
+
+        found = PSA_ERROR_DOES_NOT_EXIST;
+        if (i >= TLS_CLIENTS && client % 2 == 0) {
+            found = atecc608a_tls_ticket_parse(tickets[client],
+                                               ticket_lengths[client], now,
+                                               &session);
+        } else if (i >= TLS_CLIENTS) {
+            found = atecc608a_tls_cache_get(sessions[client].id,
+                                            sessions[client].id_length, now,
+                                            &session);
+        }
+        if (found != PSA_SUCCESS) {
+            ASSERT_SUCCESS_PSA(tls_full_handshake(&session, now));
+            signatures++;
+            if (client % 2 != 0) {
+                ASSERT_SUCCESS_PSA(atecc608a_tls_cache_set(&session, now));
+            }
+        }
+        /* Tickets are renewed on every connection. */
+        if (client % 2 == 0) {
+            ASSERT_SUCCESS_PSA(atecc608a_tls_ticket_write(
+                                   &session, now, tickets[client],
+                                   sizeof(tickets[client]),
+                                   &ticket_lengths[client], NULL));
+        }
+        sessions[client] = session;
+        atecc608a_histogram_record(found == PSA_SUCCESS ? &resumed : &full,
+                                   (uint32_t)(atecc608a_time_us() -
+                                              handshake_start));
+    }
+    us = atecc608a_time_us() - start;
+    atecc608a_tls_get_stats(&stats);
+    printf("With resumption: %lu device signatures, %lu ticket key "
+           "derivations, %lu ms\n", (unsigned long) signatures,
+           (unsigned long) stats.key_derivations, (unsigned long)(us / 1000));
+    print_tls_latency("full", &full);
+    print_tls_latency("resumed", &resumed);
+    printf("  - %lu resumed from tickets, %lu from the cache, %lu sessions "
+           "expired\n", (unsigned long) stats.tickets_parsed,
+           (unsigned long) stats.cache_hits,
+           (unsigned long)(stats.tickets_expired + stats.cache_expirations));
+    printf("  - %lu of %lu device signatures saved\n",
+           (unsigned long)(connections - signatures),
+           (unsigned long) connections);
+
+exit:
+    atecc608a_tls_ticket_free();
+    memset(sessions, 0, sizeof(sessions));
+    memset(&session, 0, sizeof(session));
+    return status;
+}
+
+static bool run_tls_command(char *command, char *arg)
+{
+    if (strcmp(command, "tls") == 0) {
+        atecc608a_tls_print();
+    } else if (strncmp(command, "tls_reconnect=", strlen("tls_reconnect=")) == 0) {
+        const char *interval = strchr(arg + 1, '_');
+        psa_status_t status;
+
+        if (interval == NULL) {
+            printf("Please specify the number of connections and the "
+                   "interval.\n");
+            return true;
+        }
+        if (job_busy()) {
+            return true;
+        }
+        status = tls_reconnect((uint32_t) atoi(arg + 1),
+                               (uint32_t) atoi(interval + 1));
+        if (status != PSA_SUCCESS) {
+            printf("TLS reconnect run failed. Error %ld.\n", (long) status);
+        }
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool estimate_tls_command(const char *command, const char *arg,
+                                 uint64_t *estimate_us)
+{
+    uint64_t us = 0;
+
+    if (strncmp(command, "tls_reconnect=", strlen("tls_reconnect=")) == 0 &&
+               strchr(arg + 1, '_') != NULL) {
+        /* A signature per connection without resumption. With it, at least
+         * one per client and the first ticket key. */
+        uint32_t connections = (uint32_t) atoi(arg + 1);
+        atecc608a_cost_step_t step = { ATECC608A_COST_SIGN, 1 };
+
+        printf("[dry run] %s (at least)\n", command);
+        us = print_estimate("tls_reconnect (full)", &step, 1, connections);
+        us += print_estimate("tls_reconnect (resumed)", &step, 1,
+                             connections < TLS_CLIENTS ? connections : TLS_CLIENTS);
+        us += print_estimate("tls_reconnect (ticket key)",
+                             COST_STEPS(cost_tls_ticket), 1);
+    } else {
+        return false;
+    }
+    *estimate_us = us;
+    return true;
+}
+
+static const char *const tls_host_commands[] = {
+    "tls", NULL,
+};
+
+const command_module_t tls_commands = {
+    " - tls - print the TLS session cache and ticket key counters;\n"
+    " - tls_reconnect=%d_%d - make a number of TLS connections (first\n"
+    "                         argument) from 4 clients that come back\n"
+    "                         every given number of simulated seconds\n"
+    "                         (second argument), with full handshakes only\n"
+    "                         and then resuming sessions, print device\n"
+    "                         signatures and handshake latency for both;\n",
+    tls_host_commands, run_tls_command, estimate_tls_command,
+};
@@ -0,0 +1,35 @@
+/**
+ * \file atecc608a_tls_commands.h
+ * \brief Console commands of TLS session resumption.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_TLS_COMMANDS_H
+#define ATECC608A_TLS_COMMANDS_H
+
+#include "atecc608a_app.h"
+
+/** tls and tls_reconnect. */
+extern const command_module_t tls_commands;
+
+/** Test that a session written into a ticket parses back the same, and
+ *  that modified tickets and expired sessions are rejected. */
+extern const test_step_t test_step_tls_ticket;
+
+#endif /* ATECC608A_TLS_COMMANDS_H */
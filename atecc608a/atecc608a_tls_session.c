@@ -0,0 +1,532 @@
+/**
+ * \file atecc608a_tls_session.c
+ * \brief TLS session cache and session ticket keys derived from a device
+ *        key, so that reconnecting peers resume without a device signature.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include "atecc608a_tls_session.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "atecc608a_lock.h"
+#include "atecc608a_utils.h"
+
+#define TICKET_ALG PSA_ALG_GCM
+#define TICKET_KEY_SIZE 16
+#define EPOCH_SIZE 4
+#define NONCE_SIZE 12
+#define SESSION_SIZE (2 + 4 + 1 + ATECC608A_TLS_SESSION_ID_SIZE + \
+                      ATECC608A_TLS_MASTER_SIZE + 32)
+#define PUBKEY_SIZE 65
+
+static const uint8_t ticket_label[3] = { 'T', 'K', 'T' };
+
+typedef struct {
+    bool valid;
+    uint32_t last_used;
+    atecc608a_tls_session_t session;
+} cache_entry_t;
+
+typedef struct {
+    bool valid;
+    uint32_t epoch;
+    psa_key_handle_t handle;
+} ticket_key_t;
+
+static cache_entry_t cache[ATECC608A_TLS_CACHE_ENTRIES];
+static uint32_t use_clock;
+static uint32_t timeout = ATECC608A_TLS_SESSION_TIMEOUT;
+static bool ticket_ready;
+static uint16_t ticket_slot;
+/* The current and the previous epoch. */
+static ticket_key_t ticket_keys[2];
+static atecc608a_tls_stats_t stats;
+/* Guards everything above. PSA and device calls are made without it. */
+static atecc608a_lock_t tls_lock = ATECC608A_LOCK_INIT("tls");
+
+static void put_u32(uint8_t *to, uint32_t value)
+{
+    to[0] = (uint8_t)(value >> 24);
+    to[1] = (uint8_t)(value >> 16);
+    to[2] = (uint8_t)(value >> 8);
+    to[3] = (uint8_t) value;
+}
+
+static uint32_t get_u32(const uint8_t *from)
+{
+    return (uint32_t) from[0] << 24 | (uint32_t) from[1] << 16 |
+           (uint32_t) from[2] << 8 | from[3];
+}
+
+static bool expired(const atecc608a_tls_session_t *session, uint32_t now,
+                    uint32_t lifetime)
+{
+    return now - session->start > lifetime;
+}
+
+void atecc608a_tls_set_timeout(uint32_t seconds)
+{
+    atecc608a_lock_acquire(&tls_lock);
+    timeout = seconds != 0 ? seconds : 1;
+    atecc608a_lock_release(&tls_lock);
+}
+
+/* Called with the lock held. */
+static cache_entry_t *cache_find(const uint8_t *id, size_t id_length)
+{
+    for (int i = 0; i < ATECC608A_TLS_CACHE_ENTRIES; i++) {
+        if (cache[i].valid && cache[i].session.id_length == id_length &&
+                memcmp(cache[i].session.id, id, id_length) == 0) {
+            return &cache[i];
+        }
+    }
+    return NULL;
+}
+
+psa_status_t atecc608a_tls_cache_set(const atecc608a_tls_session_t *session,
+                                     uint32_t now)
+{
+    cache_entry_t *entry;
+
+    if (session->id_length == 0 ||
+            session->id_length > ATECC608A_TLS_SESSION_ID_SIZE) {
+        return PSA_ERROR_INVALID_ARGUMENT;
+    }
+
+    atecc608a_lock_acquire(&tls_lock);
+    entry = cache_find(session->id, session->id_length);
+    for (int i = 0; entry == NULL && i < ATECC608A_TLS_CACHE_ENTRIES; i++) {
+        if (!cache[i].valid) {
+            entry = &cache[i];
+        }
+    }
+    if (entry == NULL) {
+        /* An expired session goes first, else the least recently used. */
+        for (int i = 0; i < ATECC608A_TLS_CACHE_ENTRIES; i++) {
+            if (expired(&cache[i].session, now, timeout)) {
+                entry = &cache[i];
+                stats.cache_expirations++;
+                break;
+            }
+            if (entry == NULL || cache[i].last_used < entry->last_used) {
+                entry = &cache[i];
+            }
+        }
+        if (!expired(&entry->session, now, timeout)) {
+            stats.cache_evictions++;
+        }
+    }
+    entry->valid = true;
+    entry->last_used = ++use_clock;
+    entry->session = *session;
+    atecc608a_lock_release(&tls_lock);
+    return PSA_SUCCESS;
+}
+
+psa_status_t atecc608a_tls_cache_get(const uint8_t *id, size_t id_length,
+                                     uint32_t now,
+                                     atecc608a_tls_session_t *session)
+{
+    psa_status_t status = PSA_ERROR_DOES_NOT_EXIST;
+    cache_entry_t *entry;
+
+    atecc608a_lock_acquire(&tls_lock);
+    entry = cache_find(id, id_length);
+    if (entry != NULL && expired(&entry->session, now, timeout)) {
+        memset(entry, 0, sizeof(*entry));
+        stats.cache_expirations++;
+        entry = NULL;
+    }
+    if (entry != NULL) {
+        entry->last_used = ++use_clock;
+        *session = entry->session;
+        stats.cache_hits++;
+        status = PSA_SUCCESS;
+    } else {
+        stats.cache_misses++;
+    }
+    atecc608a_lock_release(&tls_lock);
+    return status;
+}
+
+void atecc608a_tls_cache_remove(const uint8_t *id, size_t id_length)
+{
+    cache_entry_t *entry;
+
+    atecc608a_lock_acquire(&tls_lock);
+    entry = cache_find(id, id_length);
+    if (entry != NULL) {
+        memset(entry, 0, sizeof(*entry));
+    }
+    atecc608a_lock_release(&tls_lock);
+}
+
+void atecc608a_tls_cache_clear(void)
+{
+    atecc608a_lock_acquire(&tls_lock);
+    memset(cache, 0, sizeof(cache));
+    atecc608a_lock_release(&tls_lock);
+}
+
+/* Import the ticket key of `epoch`: an HMAC of the label and the epoch,
+ * keyed with the ECDH secret of the key in `slot` with its own public key,
+ * all computed on the device. */
+static psa_status_t derive_key(uint16_t slot, uint32_t epoch,
+                               psa_key_handle_t *handle)
+{
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+    psa_key_policy_t policy = PSA_KEY_POLICY_INIT;
+    uint8_t pubkey[PUBKEY_SIZE];
+    uint8_t message[sizeof(ticket_label) + EPOCH_SIZE];
+    uint8_t digest[32];
+    size_t length;
+
+    *handle = 0;
+    ASSERT_SUCCESS_PSA(atecc608a_driver()->p_key_management->p_export(
+                           slot, pubkey, sizeof(pubkey), &length));
+    memcpy(message, ticket_label, sizeof(ticket_label));
+    put_u32(message + sizeof(ticket_label), epoch);
+    ASSERT_SUCCESS_PSA(atecc608a_ecdh_hmac(slot, pubkey + 1, message,
+                                           sizeof(message), digest));
+
+    ASSERT_SUCCESS_PSA(psa_allocate_key(handle));
+    psa_key_policy_set_usage(&policy,
+                             PSA_KEY_USAGE_ENCRYPT | PSA_KEY_USAGE_DECRYPT,
+                             TICKET_ALG);
+    ASSERT_SUCCESS_PSA(psa_set_key_policy(*handle, &policy));
+    ASSERT_SUCCESS_PSA(psa_import_key(*handle, PSA_KEY_TYPE_AES, digest,
+                                      TICKET_KEY_SIZE));
+
+exit:
+    memset(digest, 0, sizeof(digest));
+    if (status != PSA_SUCCESS && *handle != 0) {
+        psa_destroy_key(*handle);
+        *handle = 0;
+    }
+    return status;
+}
+
+/* Find the key of `epoch`, deriving it if `derive` is set. Keys of epochs
+ * before the previous one are dropped on the way. A key dropped while
+ * another thread still uses its handle only makes that thread's ticket
+ * fail authentication, as an expiring ticket would. */
+static psa_status_t ticket_key(uint32_t epoch, uint32_t current, bool derive,
+                               psa_key_handle_t *handle)
+{
+    psa_key_handle_t derived;
+    psa_key_handle_t destroy[2] = { 0, 0 };
+    psa_status_t status;
+    uint16_t slot;
+    int free_key = -1;
+
+    atecc608a_lock_acquire(&tls_lock);
+    if (!ticket_ready) {
+        atecc608a_lock_release(&tls_lock);
+        return PSA_ERROR_BAD_STATE;
+    }
+    slot = ticket_slot;
+    for (int i = 0; i < 2; i++) {
+        if (ticket_keys[i].valid && current - ticket_keys[i].epoch > 1) {
+            destroy[i] = ticket_keys[i].handle;
+            ticket_keys[i].valid = false;
+        }
+        if (ticket_keys[i].valid && ticket_keys[i].epoch == epoch) {
+            *handle = ticket_keys[i].handle;
+            atecc608a_lock_release(&tls_lock);
+            return PSA_SUCCESS;
+        }
+    }
+    atecc608a_lock_release(&tls_lock);
+    for (int i = 0; i < 2; i++) {
+        if (destroy[i] != 0) {
+            psa_destroy_key(destroy[i]);
+        }
+    }
+    if (!derive) {
+        return PSA_ERROR_DOES_NOT_EXIST;
+    }
+
+    /* The device derivation is the slow part, done unlocked. A thread deriving
+     * the same epoch at once loses, its key is destroyed below. */
+    status = derive_key(slot, epoch, &derived);
+    if (status != PSA_SUCCESS) {
+        return status;
+    }
+
+    destroy[0] = 0;
+    atecc608a_lock_acquire(&tls_lock);
+    for (int i = 0; i < 2; i++) {
+        if (ticket_keys[i].valid && ticket_keys[i].epoch == epoch) {
+            *handle = ticket_keys[i].handle;
+            destroy[0] = derived;
+            derived = 0;
+            break;
+        }
+        /* An unused key, else the one of the older epoch. */
+        if (free_key < 0 || (ticket_keys[free_key].valid &&
+                             (!ticket_keys[i].valid ||
+                              ticket_keys[i].epoch < ticket_keys[free_key].epoch))) {
+            free_key = i;
+        }
+    }
+    if (derived != 0) {
+        if (ticket_keys[free_key].valid) {
+            destroy[0] = ticket_keys[free_key].handle;
+        }
+        ticket_keys[free_key].valid = true;
+        ticket_keys[free_key].epoch = epoch;
+        ticket_keys[free_key].handle = derived;
+        *handle = derived;
+        stats.key_derivations++;
+    }
+    atecc608a_lock_release(&tls_lock);
+    if (destroy[0] != 0) {
+        psa_destroy_key(destroy[0]);
+    }
+    return PSA_SUCCESS;
+}
+
+psa_status_t atecc608a_tls_ticket_setup(uint16_t slot, uint32_t now)
+{
+    psa_key_handle_t handle;
+
+    if (slot >= 16) {
+        return PSA_ERROR_INVALID_ARGUMENT;
+    }
+    atecc608a_tls_ticket_free();
+    atecc608a_lock_acquire(&tls_lock);
+    ticket_slot = slot;
+    ticket_ready = true;
+    now /= timeout;
+    atecc608a_lock_release(&tls_lock);
+
+    /* Fail early if the slot cannot do it. */
+    return ticket_key(now, now, true, &handle);
+}
+
+static void serialize(const atecc608a_tls_session_t *session, uint8_t *to)
+{
+    to[0] = (uint8_t)(session->ciphersuite >> 8);
+    to[1] = (uint8_t) session->ciphersuite;
+    put_u32(to + 2, session->start);
+    to[6] = session->id_length;
+    memcpy(to + 7, session->id, ATECC608A_TLS_SESSION_ID_SIZE);
+    memcpy(to + 7 + ATECC608A_TLS_SESSION_ID_SIZE, session->master,
+           ATECC608A_TLS_MASTER_SIZE);
+    memcpy(to + 7 + ATECC608A_TLS_SESSION_ID_SIZE + ATECC608A_TLS_MASTER_SIZE,
+           session->peer_hash, sizeof(session->peer_hash));
+}
+
+static void deserialize(const uint8_t *from, atecc608a_tls_session_t *session)
+{
+    session->ciphersuite = (uint16_t)(from[0] << 8 | from[1]);
+    session->start = get_u32(from + 2);
+    session->id_length = from[6];
+    memcpy(session->id, from + 7, ATECC608A_TLS_SESSION_ID_SIZE);
+    memcpy(session->master, from + 7 + ATECC608A_TLS_SESSION_ID_SIZE,
+           ATECC608A_TLS_MASTER_SIZE);
+    memcpy(session->peer_hash,
+           from + 7 + ATECC608A_TLS_SESSION_ID_SIZE + ATECC608A_TLS_MASTER_SIZE,
+           sizeof(session->peer_hash));
+}
+
+psa_status_t atecc608a_tls_ticket_write(const atecc608a_tls_session_t *session,
+                                        uint32_t now, uint8_t *ticket,
+                                        size_t ticket_size,
+                                        size_t *ticket_length,
+                                        uint32_t *lifetime)
+{
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+    uint8_t plaintext[SESSION_SIZE];
+    psa_key_handle_t handle;
+    uint32_t epoch;
+    uint32_t seconds;
+    size_t length;
+
+    if (ticket_size < ATECC608A_TLS_TICKET_SIZE) {
+        return PSA_ERROR_BUFFER_TOO_SMALL;
+    }
+    atecc608a_lock_acquire(&tls_lock);
+    seconds = timeout;
+    atecc608a_lock_release(&tls_lock);
+    epoch = now / seconds;
+
+    ASSERT_SUCCESS_PSA(ticket_key(epoch, epoch, true, &handle));
+    put_u32(ticket, epoch);
+    ASSERT_SUCCESS_PSA(psa_generate_random(ticket + EPOCH_SIZE, NONCE_SIZE));
+    serialize(session, plaintext);
+    ASSERT_SUCCESS_PSA(psa_aead_encrypt(handle, TICKET_ALG,
+                                        ticket + EPOCH_SIZE, NONCE_SIZE,
+                                        ticket, EPOCH_SIZE,
+                                        plaintext, sizeof(plaintext),
+                                        ticket + EPOCH_SIZE + NONCE_SIZE,
+                                        ticket_size - EPOCH_SIZE - NONCE_SIZE,
+                                        &length));
+    *ticket_length = EPOCH_SIZE + NONCE_SIZE + length;
+    if (lifetime != NULL) {
+        *lifetime = seconds;
+    }
+
+    atecc608a_lock_acquire(&tls_lock);
+    stats.tickets_written++;
+    atecc608a_lock_release(&tls_lock);
+
+exit:
+    memset(plaintext, 0, sizeof(plaintext));
+    return status;
+}
+
+psa_status_t atecc608a_tls_ticket_parse(const uint8_t *ticket,
+                                        size_t ticket_length, uint32_t now,
+                                        atecc608a_tls_session_t *session)
+{
+    psa_status_t status;
+    uint8_t plaintext[SESSION_SIZE];
+    psa_key_handle_t handle;
+    uint32_t seconds;
+    uint32_t current;
+    uint32_t epoch;
+    size_t length;
+
+    atecc608a_lock_acquire(&tls_lock);
+    seconds = timeout;
+    atecc608a_lock_release(&tls_lock);
+    current = now / seconds;
+
+    status = PSA_ERROR_INVALID_SIGNATURE;
+    if (ticket_length == ATECC608A_TLS_TICKET_SIZE) {
+        epoch = get_u32(ticket);
+        /* Only the current and the previous epoch are derived again, after
+         * a restart; a forged epoch costs no device command. */
+        if (epoch == current || epoch + 1 == current) {
+            status = ticket_key(epoch, current, true, &handle);
+        }
+    }
+    if (status == PSA_SUCCESS) {
+        status = psa_aead_decrypt(handle, TICKET_ALG, ticket + EPOCH_SIZE,
+                                  NONCE_SIZE, ticket, EPOCH_SIZE,
+                                  ticket + EPOCH_SIZE + NONCE_SIZE,
+                                  ticket_length - EPOCH_SIZE - NONCE_SIZE,
+                                  plaintext, sizeof(plaintext), &length);
+    }
+    if (status == PSA_SUCCESS) {
+        deserialize(plaintext, session);
+        memset(plaintext, 0, sizeof(plaintext));
+        if (expired(session, now, seconds)) {
+            memset(session, 0, sizeof(*session));
+            status = PSA_ERROR_DOES_NOT_EXIST;
+        }
+    } else if (status != PSA_ERROR_BAD_STATE) {
+        status = PSA_ERROR_INVALID_SIGNATURE;
+    }
+
+    atecc608a_lock_acquire(&tls_lock);
+    if (status == PSA_SUCCESS) {
+        stats.tickets_parsed++;
+    } else if (status == PSA_ERROR_DOES_NOT_EXIST) {
+        stats.tickets_expired++;
+    } else if (status == PSA_ERROR_INVALID_SIGNATURE) {
+        stats.tickets_rejected++;
+    }
+    atecc608a_lock_release(&tls_lock);
+    return status;
+}
+
+void atecc608a_tls_ticket_free(void)
+{
+    ticket_key_t keys[2];
+
+    atecc608a_lock_acquire(&tls_lock);
+    memcpy(keys, ticket_keys, sizeof(keys));
+    memset(ticket_keys, 0, sizeof(ticket_keys));
+    ticket_ready = false;
+    atecc608a_lock_release(&tls_lock);
+
+    for (int i = 0; i < 2; i++) {
+        if (keys[i].valid) {
+            psa_destroy_key(keys[i].handle);
+        }
+    }
+}
+
+void atecc608a_tls_get_stats(atecc608a_tls_stats_t *copy)
+{
+    atecc608a_lock_acquire(&tls_lock);
+    *copy = stats;
+    atecc608a_lock_release(&tls_lock);
+}
+
+void atecc608a_tls_reset_stats(void)
+{
+    atecc608a_lock_acquire(&tls_lock);
+    memset(&stats, 0, sizeof(stats));
+    atecc608a_lock_release(&tls_lock);
+}
+
+void atecc608a_tls_print(void)
+{
+    cache_entry_t copy[ATECC608A_TLS_CACHE_ENTRIES];
+    ticket_key_t keys[2];
+    atecc608a_tls_stats_t counts;
+    bool ready;
+    uint16_t slot;
+
+    atecc608a_lock_acquire(&tls_lock);
+    memcpy(copy, cache, sizeof(copy));
+    memcpy(keys, ticket_keys, sizeof(keys));
+    counts = stats;
+    ready = ticket_ready;
+    slot = ticket_slot;
+    atecc608a_lock_release(&tls_lock);
+
+    printf("TLS session cache: %lu hits, %lu misses, %lu evictions, "
+           "%lu expired\n", (unsigned long) counts.cache_hits,
+           (unsigned long) counts.cache_misses,
+           (unsigned long) counts.cache_evictions,
+           (unsigned long) counts.cache_expirations);
+    for (int i = 0; i < ATECC608A_TLS_CACHE_ENTRIES; i++) {
+        if (copy[i].valid) {
+            printf("  - session %02x%02x%02x%02x..., suite %04x, started %lu\n",
+                   copy[i].session.id[0], copy[i].session.id[1],
+                   copy[i].session.id[2], copy[i].session.id[3],
+                   copy[i].session.ciphersuite,
+                   (unsigned long) copy[i].session.start);
+        }
+    }
+    memset(copy, 0, sizeof(copy));
+
+    printf("TLS tickets: %lu written, %lu parsed, %lu rejected, %lu expired, "
+           "%lu keys derived\n", (unsigned long) counts.tickets_written,
+           (unsigned long) counts.tickets_parsed,
+           (unsigned long) counts.tickets_rejected,
+           (unsigned long) counts.tickets_expired,
+           (unsigned long) counts.key_derivations);
+    if (!ready) {
+        printf("  - no ticket keys set up\n");
+        return;
+    }
+    for (int i = 0; i < 2; i++) {
+        if (keys[i].valid) {
+            printf("  - epoch %lu, from slot %u\n",
+                   (unsigned long) keys[i].epoch, slot);
+        }
+    }
+}
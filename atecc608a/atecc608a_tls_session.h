@@ -0,0 +1,136 @@
+/**
+ * \file atecc608a_tls_session.h
+ * \brief TLS session cache and session ticket keys derived from a device
+ *        key, so that reconnecting peers resume without a device signature.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_TLS_SESSION_H
+#define ATECC608A_TLS_SESSION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "psa/crypto.h"
+
+/** A full handshake authenticated with a device key costs a device
+ *  signature; a resumed one only needs the master secret of an earlier
+ *  session. Sessions are found again either by ID, in the cache, or from a
+ *  ticket the peer keeps, encrypted and authenticated with AES-128-GCM.
+ *
+ *  Ticket keys are never stored: the key of an epoch is HMAC-SHA256 of a
+ *  label and the epoch number, keyed with the ECDH secret of a device key
+ *  with its own public key. The device computes the secret into TempKey and
+ *  the HMAC from there, so the secret never crosses the bus, and the key
+ *  slot does not need to allow ECDH output in the clear. The keys of the
+ *  current and the previous epoch are kept imported in PSA, so that a
+ *  ticket stays valid for at least one ticket lifetime, and at most two. A
+ *  new epoch costs one ECDH and one HMAC on the device.
+ *
+ *  The functions are shaped after the session cache and ticket callbacks of
+ *  TLS stacks, which take the current time from the caller. They may be
+ *  called from any thread. */
+
+#define ATECC608A_TLS_CACHE_ENTRIES 8
+#define ATECC608A_TLS_SESSION_ID_SIZE 32
+#define ATECC608A_TLS_MASTER_SIZE 48
+
+/** Default lifetime of cached sessions and of tickets, in seconds. */
+#define ATECC608A_TLS_SESSION_TIMEOUT 86400
+
+typedef struct {
+    uint16_t ciphersuite;
+    uint8_t id_length;
+    uint8_t id[ATECC608A_TLS_SESSION_ID_SIZE];
+    uint8_t master[ATECC608A_TLS_MASTER_SIZE];
+    /** Time of the full handshake, in seconds. */
+    uint32_t start;
+    /** SHA-256 of the certificate of the peer, zero if it sent none. */
+    uint8_t peer_hash[32];
+} atecc608a_tls_session_t;
+
+/** Epoch, nonce, the encrypted session and the tag. */
+#define ATECC608A_TLS_TICKET_SIZE (4 + 12 + 119 + 16)
+
+typedef struct {
+    uint32_t cache_hits;
+    uint32_t cache_misses;
+    uint32_t cache_evictions;
+    uint32_t cache_expirations;
+    uint32_t tickets_written;
+    uint32_t tickets_parsed;
+    /** Tickets that failed authentication, or of an unknown epoch. */
+    uint32_t tickets_rejected;
+    uint32_t tickets_expired;
+    /** Ticket keys derived, each one device ECDH and HMAC. */
+    uint32_t key_derivations;
+} atecc608a_tls_stats_t;
+
+/** Set the lifetime of cached sessions and tickets, for sessions stored and
+ *  tickets written from now on. */
+void atecc608a_tls_set_timeout(uint32_t seconds);
+
+/** Store a session under its ID, replacing one with the same ID, else the
+ *  least recently used entry. */
+psa_status_t atecc608a_tls_cache_set(const atecc608a_tls_session_t *session,
+                                     uint32_t now);
+
+/** Find the session with ID `id`. Fails with PSA_ERROR_DOES_NOT_EXIST if
+ *  there is none, or if it is older than the timeout, which drops it. */
+psa_status_t atecc608a_tls_cache_get(const uint8_t *id, size_t id_length,
+                                     uint32_t now,
+                                     atecc608a_tls_session_t *session);
+
+void atecc608a_tls_cache_remove(const uint8_t *id, size_t id_length);
+
+/** Forget every cached session. */
+void atecc608a_tls_cache_clear(void);
+
+/** Derive ticket keys from the private key in `slot`, which must allow
+ *  ECDH. Keys of epochs already derived from another slot are destroyed. */
+psa_status_t atecc608a_tls_ticket_setup(uint16_t slot, uint32_t now);
+
+/** Encrypt `session` into a ticket of ATECC608A_TLS_TICKET_SIZE bytes, with
+ *  the key of the epoch of `now`, derived first if needed. `lifetime`, if
+ *  not NULL, receives the lifetime hint to send along. Fails with
+ *  PSA_ERROR_BAD_STATE before atecc608a_tls_ticket_setup(). */
+psa_status_t atecc608a_tls_ticket_write(const atecc608a_tls_session_t *session,
+                                        uint32_t now, uint8_t *ticket,
+                                        size_t ticket_size,
+                                        size_t *ticket_length,
+                                        uint32_t *lifetime);
+
+/** Decrypt a ticket. Fails with PSA_ERROR_INVALID_SIGNATURE if it was not
+ *  written with a key still kept or was modified, and with
+ *  PSA_ERROR_DOES_NOT_EXIST if its session is older than the timeout. */
+psa_status_t atecc608a_tls_ticket_parse(const uint8_t *ticket,
+                                        size_t ticket_length, uint32_t now,
+                                        atecc608a_tls_session_t *session);
+
+/** Destroy the ticket keys. Tickets written so far cannot be parsed again
+ *  until a setup with the same slot. */
+void atecc608a_tls_ticket_free(void);
+
+void atecc608a_tls_get_stats(atecc608a_tls_stats_t *stats);
+void atecc608a_tls_reset_stats(void);
+
+/** Print the counters, the cached sessions and the ticket key epochs. */
+void atecc608a_tls_print(void);
+
+#endif /* ATECC608A_TLS_SESSION_H */
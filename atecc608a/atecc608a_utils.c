@@ -22,6 +22,225 @@
 #include "atecc608a_utils.h"
 
 #include "atca_basic.h"
+#include "atecc608a_crc16.h"
+#include "atecc608a_event_log.h"
+#include "atecc608a_lock.h"
+
+static atecc608a_lock_t device_lock = ATECC608A_LOCK_INIT("device");
+/* Bumped under the device lock, read without it. */
+static volatile uint32_t key_changes[16];
+
+/* What runs under the lock is glue of the utilities, unless a deeper layer
+ * is tagged. */
+void atecc608a_device_lock(void)
+{
+    atecc608a_lock_acquire(&device_lock);
+    atecc608a_profile_enter(ATECC608A_LAYER_UTILS);
+}
+
+void atecc608a_device_unlock(void)
+{
+    atecc608a_profile_exit();
+    atecc608a_lock_release(&device_lock);
+}
+
+uint32_t atecc608a_slot_key_changes(uint16_t slot)
+{
+    return slot < 16 ? key_changes[slot] : 0;
+}
+
+/* Count a key change even if the command failed: the slot may have been
+ * written anyway. */
+static void key_changed(psa_key_slot_number_t slot)
+{
+    if (slot < 16) {
+        key_changes[slot]++;
+    }
+}
+
+/* Record a security event if the event log is open, appends fail with
+ * PSA_ERROR_BAD_STATE otherwise. The operation's own status is what the
+ * caller gets. */
+static void log_event(psa_status_t status, atecc608a_event_type_t type,
+                      psa_key_slot_number_t slot)
+{
+    if (status == PSA_SUCCESS && slot < 16) {
+        atecc608a_event_log_append(type, (uint16_t) slot,
+                                   (uint16_t) key_changes[slot]);
+    }
+}
+
+psa_status_t atecc608a_device_read(uint16_t slot, size_t offset,
+                                   uint8_t *data, size_t length)
+{
+    psa_status_t status;
+
+    atecc608a_device_lock();
+    status = atecc608a_read(slot, offset, data, length);
+    atecc608a_device_unlock();
+    return status;
+}
+
+psa_status_t atecc608a_device_write(uint16_t slot, size_t offset,
+                                    const uint8_t *data, size_t length)
+{
+    psa_status_t status;
+
+    atecc608a_device_lock();
+    status = atecc608a_write(slot, offset, data, length);
+    key_changed(slot);
+    atecc608a_device_unlock();
+    return status;
+}
+
+static psa_status_t locked_import(psa_key_slot_number_t key_slot,
+                                  psa_key_lifetime_t lifetime,
+                                  psa_key_type_t type,
+                                  psa_algorithm_t alg,
+                                  psa_key_usage_t usage,
+                                  const uint8_t *p_data,
+                                  size_t data_length)
+{
+    psa_status_t status;
+
+    atecc608a_device_lock();
+    atecc608a_profile_enter(ATECC608A_LAYER_DRIVER);
+    status = atecc608a_drv_info.p_key_management->p_import(
+                 key_slot, lifetime, type, alg, usage, p_data, data_length);
+    atecc608a_profile_exit();
+    key_changed(key_slot);
+    log_event(status, ATECC608A_EVENT_KEY_IMPORTED, key_slot);
+    atecc608a_device_unlock();
+    return status;
+}
+
+static psa_status_t locked_generate(psa_key_slot_number_t key_slot,
+                                    psa_key_type_t type,
+                                    psa_key_usage_t usage,
+                                    size_t bits,
+                                    const void *extra,
+                                    size_t extra_size,
+                                    uint8_t *p_pubkey_out,
+                                    size_t pubkey_out_size,
+                                    size_t *p_pubkey_length)
+{
+    psa_status_t status;
+
+    atecc608a_device_lock();
+    atecc608a_profile_enter(ATECC608A_LAYER_DRIVER);
+    status = atecc608a_drv_info.p_key_management->p_generate(
+                 key_slot, type, usage, bits, extra, extra_size, p_pubkey_out,
+                 pubkey_out_size, p_pubkey_length);
+    atecc608a_profile_exit();
+    key_changed(key_slot);
+    log_event(status, ATECC608A_EVENT_KEY_GENERATED, key_slot);
+    atecc608a_device_unlock();
+    return status;
+}
+
+static psa_status_t locked_export(psa_key_slot_number_t key_slot,
+                                  uint8_t *p_data,
+                                  size_t data_size,
+                                  size_t *p_data_length)
+{
+    psa_status_t status;
+
+    atecc608a_device_lock();
+    atecc608a_profile_enter(ATECC608A_LAYER_DRIVER);
+    status = atecc608a_drv_info.p_key_management->p_export(
+                 key_slot, p_data, data_size, p_data_length);
+    atecc608a_profile_exit();
+    atecc608a_device_unlock();
+    return status;
+}
+
+static psa_status_t locked_destroy(psa_key_slot_number_t key_slot)
+{
+    psa_status_t status;
+
+    atecc608a_device_lock();
+    atecc608a_profile_enter(ATECC608A_LAYER_DRIVER);
+    status = atecc608a_drv_info.p_key_management->p_destroy(key_slot);
+    atecc608a_profile_exit();
+    key_changed(key_slot);
+    log_event(status, ATECC608A_EVENT_KEY_DESTROYED, key_slot);
+    atecc608a_device_unlock();
+    return status;
+}
+
+static psa_status_t locked_sign(psa_key_slot_number_t key_slot,
+                                psa_algorithm_t alg,
+                                const uint8_t *p_hash,
+                                size_t hash_length,
+                                uint8_t *p_signature,
+                                size_t signature_size,
+                                size_t *p_signature_length)
+{
+    psa_status_t status;
+
+    atecc608a_device_lock();
+    atecc608a_profile_enter(ATECC608A_LAYER_DRIVER);
+    status = atecc608a_drv_info.p_asym->p_sign(
+                 key_slot, alg, p_hash, hash_length, p_signature,
+                 signature_size, p_signature_length);
+    atecc608a_profile_exit();
+    atecc608a_device_unlock();
+    return status;
+}
+
+static psa_status_t locked_verify(psa_key_slot_number_t key_slot,
+                                  psa_algorithm_t alg,
+                                  const uint8_t *p_hash,
+                                  size_t hash_length,
+                                  const uint8_t *p_signature,
+                                  size_t signature_length)
+{
+    psa_status_t status;
+
+    atecc608a_device_lock();
+    atecc608a_profile_enter(ATECC608A_LAYER_DRIVER);
+    status = atecc608a_drv_info.p_asym->p_verify(
+                 key_slot, alg, p_hash, hash_length, p_signature,
+                 signature_length);
+    atecc608a_profile_exit();
+    if (status == PSA_ERROR_INVALID_SIGNATURE) {
+        atecc608a_event_log_append(ATECC608A_EVENT_VERIFY_FAILED,
+                                   (uint16_t) key_slot, 0);
+    }
+    atecc608a_device_unlock();
+    return status;
+}
+
+static psa_drv_se_key_management_t locked_key_management;
+static psa_drv_se_asymmetric_t locked_asym;
+static psa_drv_se_info_t locked_driver;
+static volatile bool locked_driver_ready;
+
+const psa_drv_se_info_t *atecc608a_driver(void)
+{
+    if (!locked_driver_ready) {
+        /* Entry points that are not wrapped are copied as they are. */
+        atecc608a_device_lock();
+        if (!locked_driver_ready) {
+            locked_key_management = *atecc608a_drv_info.p_key_management;
+            locked_key_management.p_import = locked_import;
+            locked_key_management.p_generate = locked_generate;
+            locked_key_management.p_export = locked_export;
+            if (locked_key_management.p_destroy != NULL) {
+                locked_key_management.p_destroy = locked_destroy;
+            }
+            locked_asym = *atecc608a_drv_info.p_asym;
+            locked_asym.p_sign = locked_sign;
+            locked_asym.p_verify = locked_verify;
+            locked_driver = atecc608a_drv_info;
+            locked_driver.p_key_management = &locked_key_management;
+            locked_driver.p_asym = &locked_asym;
+            locked_driver_ready = true;
+        }
+        atecc608a_device_unlock();
+    }
+    return &locked_driver;
+}
 
 psa_status_t atecc608a_get_serial_number(uint8_t *buffer,
                                          size_t buffer_size,
@@ -33,6 +252,7 @@ psa_status_t atecc608a_get_serial_number(uint8_t *buffer,
         return PSA_ERROR_BUFFER_TOO_SMALL;
     }
 
+    atecc608a_device_lock();
     ASSERT_SUCCESS_PSA(atecc608a_init());
 
     ASSERT_SUCCESS(atcab_read_serial_number(buffer));
@@ -40,6 +260,7 @@ psa_status_t atecc608a_get_serial_number(uint8_t *buffer,
 
 exit:
     atecc608a_deinit();
+    atecc608a_device_unlock();
     return status;
 }
 
@@ -48,7 +269,7 @@ psa_status_t atecc608a_write_lock_config(const uint8_t *config_template,
 {
     psa_status_t status = PSA_ERROR_GENERIC_ERROR;
     const uint8_t config_size = 128;
-    uint16_t crc;
+    uint8_t crc[2];
     uint8_t config[config_size];
     bool config_locked = false;
 
@@ -58,24 +279,29 @@ psa_status_t atecc608a_write_lock_config(const uint8_t *config_template,
 
     memcpy(config, config_template, config_size);
 
+    atecc608a_device_lock();
     ASSERT_SUCCESS_PSA(atecc608a_init());
 
     ASSERT_SUCCESS(atcab_is_locked(LOCK_ZONE_CONFIG, &config_locked));
     if (config_locked) {
         printf("Error while locking config - already locked.\n");
-        return PSA_ERROR_HARDWARE_FAILURE;
+        status = PSA_ERROR_HARDWARE_FAILURE;
+        goto exit;
     }
 
     /* Copy 16 bytes of device-specific data to the prepared config buffer */
     ASSERT_SUCCESS(atcab_read_bytes_zone(ATCA_ZONE_CONFIG, 0, 0, config, 16));
 
-    atCRC(length, config, &crc);
+    /* The device stays locked from the check to the lock, which cannot be
+     * undone: the CRC takes far less than another init of the device. */
+    atecc608a_crc16(length, config, crc);
 
     ASSERT_SUCCESS(atcab_write_config_zone(config));
-    ASSERT_SUCCESS(atcab_lock_config_zone_crc(crc));
+    ASSERT_SUCCESS(atcab_lock_config_zone_crc((uint16_t)(crc[0] | (crc[1] << 8))));
 
 exit:
     atecc608a_deinit();
+    atecc608a_device_unlock();
     return status;
 }
 
@@ -84,12 +310,14 @@ psa_status_t atecc608a_check_zone_locked(uint8_t zone)
     bool zone_locked;
     psa_status_t status = PSA_ERROR_GENERIC_ERROR;
 
+    atecc608a_device_lock();
     ASSERT_SUCCESS_PSA(atecc608a_init());
 
     ASSERT_SUCCESS(atcab_is_locked(zone, &zone_locked));
 
 exit:
     atecc608a_deinit();
+    atecc608a_device_unlock();
     if (status == PSA_SUCCESS) {
         status = zone_locked ? PSA_SUCCESS : PSA_ERROR_HARDWARE_FAILURE;
     }
@@ -101,6 +329,7 @@ psa_status_t atecc608a_lock_data_zone()
     psa_status_t status = PSA_ERROR_GENERIC_ERROR;
     bool zone_locked;
 
+    atecc608a_device_lock();
     ASSERT_SUCCESS_PSA(atecc608a_init());
     /* atcab_is_locked used instead of atecc608a_check_zone_locked as an
      * optimization - this way atecc608a_init won't be called again. */
@@ -115,6 +344,218 @@ psa_status_t atecc608a_lock_data_zone()
 
 exit:
     atecc608a_deinit();
+    atecc608a_device_unlock();
+    return status;
+}
+
+/* A mirrored public key carries its tag in the pad bytes before X: a magic
+ * byte, the private key slot and a CRC-16 of the slot number, X and Y. The
+ * pad bytes before Y stay zero. */
+#define MIRROR_MAGIC 0x4D
+#define MIRROR_COORDINATE_SIZE 32
+
+static void mirror_crc(uint16_t private_slot, const uint8_t *stored,
+                       uint8_t *crc)
+{
+    uint8_t data[1 + 2 * MIRROR_COORDINATE_SIZE];
+
+    data[0] = (uint8_t) private_slot;
+    memcpy(data + 1, stored + 4, MIRROR_COORDINATE_SIZE);
+    memcpy(data + 1 + MIRROR_COORDINATE_SIZE, stored + 40,
+           MIRROR_COORDINATE_SIZE);
+    atecc608a_crc16(sizeof(data), data, crc);
+}
+
+/* Keys changed outside of these functions leave a mirror with a valid tag
+ * behind. A mirror is only trusted while the key change counts of both
+ * slots are the ones it was written or checked against the device at. The
+ * counts start over at boot, so the first export of each boot checks. */
+typedef struct {
+    bool checked;
+    uint16_t mirror_slot;
+    uint32_t private_changes;
+    uint32_t mirror_changes;
+} mirror_check_t;
+
+static mirror_check_t mirror_checks[16];
+
+static void mirror_checked(uint16_t private_slot, uint16_t mirror_slot)
+{
+    mirror_check_t *check = &mirror_checks[private_slot];
+
+    check->checked = true;
+    check->mirror_slot = mirror_slot;
+    check->private_changes = atecc608a_slot_key_changes(private_slot);
+    check->mirror_changes = atecc608a_slot_key_changes(mirror_slot);
+}
+
+static bool mirror_current(uint16_t private_slot, uint16_t mirror_slot)
+{
+    const mirror_check_t *check = &mirror_checks[private_slot];
+
+    return check->checked && check->mirror_slot == mirror_slot &&
+           check->private_changes == atecc608a_slot_key_changes(private_slot) &&
+           check->mirror_changes == atecc608a_slot_key_changes(mirror_slot);
+}
+
+/* Store an export format public key (0x04, X, Y) with its tag. */
+static void mirror_encode(uint16_t private_slot, const uint8_t *pubkey,
+                          uint8_t *stored)
+{
+    memset(stored, 0, ATECC608A_STORED_PUBKEY_SIZE);
+    memcpy(stored + 4, pubkey + 1, MIRROR_COORDINATE_SIZE);
+    memcpy(stored + 40, pubkey + 1 + MIRROR_COORDINATE_SIZE,
+           MIRROR_COORDINATE_SIZE);
+    stored[0] = MIRROR_MAGIC;
+    stored[1] = (uint8_t) private_slot;
+    mirror_crc(private_slot, stored, stored + 2);
+}
+
+static psa_status_t write_mirror(uint16_t private_slot, uint16_t mirror_slot,
+                                 const uint8_t *pubkey)
+{
+    uint8_t stored[ATECC608A_STORED_PUBKEY_SIZE];
+    psa_status_t status;
+
+    mirror_encode(private_slot, pubkey, stored);
+    status = atecc608a_device_write(mirror_slot, 0, stored, sizeof(stored));
+    if (status == PSA_SUCCESS) {
+        mirror_checked(private_slot, mirror_slot);
+    }
+    return status;
+}
+
+psa_status_t atecc608a_generate_mirrored(uint16_t private_slot,
+                                         uint16_t mirror_slot,
+                                         uint8_t *pubkey, size_t pubkey_size,
+                                         size_t *pubkey_length)
+{
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+    uint8_t generated[1 + 2 * MIRROR_COORDINATE_SIZE];
+    size_t generated_length = 0;
+
+    if (pubkey != NULL && pubkey_size < sizeof(generated)) {
+        return PSA_ERROR_BUFFER_TOO_SMALL;
+    }
+    if (private_slot == mirror_slot || private_slot >= 16 ||
+            mirror_slot >= 16) {
+        return PSA_ERROR_INVALID_ARGUMENT;
+    }
+
+    /* Nothing comes between the key and its mirror. */
+    atecc608a_device_lock();
+    ASSERT_SUCCESS_PSA(atecc608a_driver()->p_key_management->p_generate(
+                           private_slot,
+                           PSA_KEY_TYPE_ECC_KEYPAIR(PSA_ECC_CURVE_SECP256R1),
+                           PSA_KEY_USAGE_SIGN | PSA_KEY_USAGE_VERIFY, 256,
+                           NULL, 0, generated, sizeof(generated),
+                           &generated_length));
+    ASSERT_SUCCESS_PSA(write_mirror(private_slot, mirror_slot, generated));
+
+    if (pubkey != NULL) {
+        memcpy(pubkey, generated, sizeof(generated));
+        *pubkey_length = sizeof(generated);
+    }
+
+exit:
+    atecc608a_device_unlock();
+    return status;
+}
+
+psa_status_t atecc608a_export_mirrored(uint16_t private_slot,
+                                       uint16_t mirror_slot,
+                                       uint8_t *pubkey, size_t pubkey_size,
+                                       size_t *pubkey_length)
+{
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+    uint8_t stored[ATECC608A_STORED_PUBKEY_SIZE];
+    uint8_t expected[ATECC608A_STORED_PUBKEY_SIZE];
+    uint8_t crc[2];
+
+    if (pubkey_size < 1 + 2 * MIRROR_COORDINATE_SIZE) {
+        return PSA_ERROR_BUFFER_TOO_SMALL;
+    }
+    if (private_slot == mirror_slot || private_slot >= 16 ||
+            mirror_slot >= 16) {
+        return PSA_ERROR_INVALID_ARGUMENT;
+    }
+
+    atecc608a_device_lock();
+    ASSERT_SUCCESS_PSA(atecc608a_device_read(mirror_slot, 0, stored,
+                                             sizeof(stored)));
+    mirror_crc(private_slot, stored, crc);
+
+    if (stored[0] == MIRROR_MAGIC && stored[1] == (uint8_t) private_slot &&
+            stored[2] == crc[0] && stored[3] == crc[1] &&
+            mirror_current(private_slot, mirror_slot)) {
+        pubkey[0] = 0x04;
+        memcpy(pubkey + 1, stored + 4, MIRROR_COORDINATE_SIZE);
+        memcpy(pubkey + 1 + MIRROR_COORDINATE_SIZE, stored + 40,
+               MIRROR_COORDINATE_SIZE);
+        *pubkey_length = 1 + 2 * MIRROR_COORDINATE_SIZE;
+        goto exit;
+    }
+
+    /* The key from the device, and the mirror rewritten only if it differs
+     * from it: a check after boot costs no write. */
+    ASSERT_SUCCESS_PSA(atecc608a_driver()->p_key_management->p_export(
+                           private_slot, pubkey, pubkey_size,
+                           pubkey_length));
+    mirror_encode(private_slot, pubkey, expected);
+    if (memcmp(stored, expected, sizeof(stored)) == 0) {
+        mirror_checked(private_slot, mirror_slot);
+    } else {
+        ASSERT_SUCCESS_PSA(write_mirror(private_slot, mirror_slot, pubkey));
+    }
+
+exit:
+    atecc608a_device_unlock();
+    return status;
+}
+
+psa_status_t atecc608a_sha256(const uint8_t *input, size_t input_length,
+                              uint8_t *digest)
+{
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+
+    if ((input == NULL && input_length != 0) || digest == NULL) {
+        return PSA_ERROR_INVALID_ARGUMENT;
+    }
+
+    atecc608a_device_lock();
+    ASSERT_SUCCESS_PSA(atecc608a_init());
+    ASSERT_SUCCESS(atcab_hw_sha2_256(input, input_length, digest));
+
+exit:
+    atecc608a_deinit();
+    atecc608a_device_unlock();
+    return status;
+}
+
+psa_status_t atecc608a_ecdh_hmac(uint16_t slot, const uint8_t *peer_public_key,
+                                 const uint8_t *message, size_t message_length,
+                                 uint8_t *mac)
+{
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+
+    if (peer_public_key == NULL || (message == NULL && message_length != 0) ||
+            mac == NULL) {
+        return PSA_ERROR_INVALID_ARGUMENT;
+    }
+
+    /* Both commands under one lock and one wake, so that nothing replaces
+     * TempKey in between. */
+    atecc608a_device_lock();
+    ASSERT_SUCCESS_PSA(atecc608a_init());
+    ASSERT_SUCCESS(atcab_ecdh_base(ECDH_MODE_SOURCE_EEPROM_SLOT |
+                                   ECDH_MODE_COPY_TEMP_KEY, slot,
+                                   peer_public_key, NULL, NULL));
+    ASSERT_SUCCESS(atcab_sha_hmac(message, message_length, ATCA_TEMPKEY_KEYID,
+                                  mac, SHA_MODE_TARGET_OUT_ONLY));
+
+exit:
+    atecc608a_deinit();
+    atecc608a_device_unlock();
     return status;
 }
 
@@ -130,10 +571,12 @@ psa_status_t atecc608a_random_32_bytes(uint8_t *rand_out, size_t buffer_size)
         return PSA_ERROR_BUFFER_TOO_SMALL;
     }
 
+    atecc608a_device_lock();
     ASSERT_SUCCESS_PSA(atecc608a_init());
     ASSERT_SUCCESS(atcab_random(rand_out));
 
 exit:
     atecc608a_deinit();
+    atecc608a_device_unlock();
     return status;
 }
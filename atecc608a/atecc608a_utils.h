@@ -25,6 +25,7 @@
 
 #include "psa/crypto.h"
 #include "atecc608a_se.h"
+#include "atecc608a_profile.h"
 
 /** This macro checks if the result of an `expression` is equal to an
  *  `expected` value and sets a `status` variable of type `psa_status_t` to
@@ -47,15 +48,43 @@
         status = PSA_SUCCESS;                                       \
     } while(0)
 
-/** Check if an ATCA operation is successful, translate the error otherwise. */
-#define ASSERT_SUCCESS(expression) ASSERT_STATUS(expression, ATCA_SUCCESS, \
-                                      atecc608a_to_psa_error(ASSERT_result))
+/** Check if an ATCA operation is successful, translate the error otherwise.
+ *  The operation is profiled as a cryptoauthlib call. */
+#define ASSERT_SUCCESS(expression)                                  \
+    ASSERT_STATUS((atecc608a_profile_enter(ATECC608A_LAYER_LIB),    \
+                   atecc608a_profile_exit_status(expression)),      \
+                  ATCA_SUCCESS, atecc608a_to_psa_error(ASSERT_result))
 
 /** Does the same as the macro above, but without the error translation and for
  *  the PSA return code - PSA_SUCCESS.*/
 #define ASSERT_SUCCESS_PSA(expression) ASSERT_STATUS(expression, PSA_SUCCESS, \
                                                      ASSERT_result)
 
+/** Every use of the device goes through the device lock: cryptoauthlib
+ *  keeps a single global device state, which atecc608a_init() and
+ *  atecc608a_deinit() set up and tear down. The lock is recursive. The
+ *  functions of this file take it themselves, around device commands only;
+ *  a caller that needs several commands to run back to back, or that calls
+ *  cryptoauthlib directly, takes it around them. */
+void atecc608a_device_lock(void);
+void atecc608a_device_unlock(void);
+
+/** atecc608a_drv_info with each key management and asymmetric entry point
+ *  run under the device lock. */
+const psa_drv_se_info_t *atecc608a_driver(void);
+
+/** Number of times a key was generated, imported or destroyed in `slot`
+ *  through atecc608a_driver(), or the slot was written with
+ *  atecc608a_device_write(), for telling whether state derived from the key
+ *  is stale. */
+uint32_t atecc608a_slot_key_changes(uint16_t slot);
+
+/** atecc608a_read() and atecc608a_write() under the device lock. */
+psa_status_t atecc608a_device_read(uint16_t slot, size_t offset,
+                                   uint8_t *data, size_t length);
+psa_status_t atecc608a_device_write(uint16_t slot, size_t offset,
+                                    const uint8_t *data, size_t length);
+
 psa_status_t atecc608a_get_serial_number(uint8_t *buffer, size_t buffer_size,
                                          size_t *buffer_length);
 
@@ -66,6 +95,47 @@ psa_status_t atecc608a_lock_data_zone();
 /** Generate a 32 byte random number from the CryptoAuth device. */
 psa_status_t atecc608a_random_32_bytes(uint8_t *rand_out, size_t buffer_size);
 
+/** SHA-256 of `input_length` bytes on the device, into a 32 byte
+ *  `digest`. */
+psa_status_t atecc608a_sha256(const uint8_t *input, size_t input_length,
+                              uint8_t *digest);
+
+/** HMAC-SHA256 of `message` into a 32 byte `mac`, keyed with the ECDH
+ *  secret of the private key in `slot` and a peer public key, X and Y. The
+ *  secret goes into TempKey and never leaves the device, so the slot only
+ *  needs ECDH enabled in its ReadKey bits, not its output in the clear. */
+psa_status_t atecc608a_ecdh_hmac(uint16_t slot, const uint8_t *peer_public_key,
+                                 const uint8_t *message, size_t message_length,
+                                 uint8_t *mac);
+
 psa_status_t atecc608a_write_lock_config(const uint8_t *config_template,
                                          uint8_t length);
+
+/** Size of a public key as stored in a slot: X and Y, each preceded by
+ *  4 pad bytes. */
+#define ATECC608A_STORED_PUBKEY_SIZE 72
+
+/** Generate a P-256 key in `private_slot` and write its public key, tagged
+ *  with `private_slot` and a CRC, to `mirror_slot`, so that it can later be
+ *  read back instead of being recomputed. The public key is also returned in
+ *  the export format if `pubkey` is not NULL.
+ *
+ *  The tag lives in the pad bytes, so the mirror slot stays usable with the
+ *  driver's verify. It must not hold a validated key (PubInfo set), whose
+ *  digest covers the pad bytes. */
+psa_status_t atecc608a_generate_mirrored(uint16_t private_slot,
+                                         uint16_t mirror_slot,
+                                         uint8_t *pubkey, size_t pubkey_size,
+                                         size_t *pubkey_length);
+
+/** Export the public key of `private_slot` from `mirror_slot` - two block
+ *  and two word reads instead of a GenKey. The mirror is used while neither
+ *  slot changed (see atecc608a_slot_key_changes()) since it was written or
+ *  last checked. Otherwise, after a boot or a key generated in
+ *  `private_slot` by other means, the key is computed by the device, and the
+ *  mirror is rewritten if it does not hold it. */
+psa_status_t atecc608a_export_mirrored(uint16_t private_slot,
+                                       uint16_t mirror_slot,
+                                       uint8_t *pubkey, size_t pubkey_size,
+                                       size_t *pubkey_length);
 #endif /* ATECC608A_SE_H */
@@ -0,0 +1,303 @@
+/**
+ * \file atecc608a_verify_cache.c
+ * \brief PSA verification keys kept imported for the public keys of device
+ *        key pairs.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include "atecc608a_verify_cache.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "atecc608a_event_log.h"
+#include "atecc608a_key_index.h"
+#include "atecc608a_lock.h"
+#include "atecc608a_utils.h"
+
+#define VERIFY_ALG PSA_ALG_ECDSA(PSA_ALG_SHA_256)
+#define PUBKEY_SIZE 65
+
+typedef struct {
+    bool valid;
+    /** No new users, destroyed by the last one. */
+    bool stale;
+    uint16_t slot;
+    /** atecc608a_slot_key_changes() when the key was exported. */
+    uint32_t key_changes;
+    psa_key_handle_t handle;
+    uint32_t users;
+    uint32_t last_used;
+} cache_entry_t;
+
+static cache_entry_t cache[ATECC608A_VERIFY_CACHE_SIZE];
+static uint32_t use_clock;
+static uint32_t hits;
+static uint32_t misses;
+/* Guards the entries. PSA and device calls are made without it. */
+static atecc608a_lock_t cache_lock = ATECC608A_LOCK_INIT("verify");
+
+static bool revoked(uint16_t slot)
+{
+    const atecc608a_key_index_entry_t *entry = atecc608a_key_index_entry(slot);
+
+    return entry != NULL && entry->state == ATECC608A_KEY_STATE_REVOKED;
+}
+
+/* Mark an entry stale and return its handle if it can be destroyed now,
+ * else 0. Called with the lock held. */
+static psa_key_handle_t retire(cache_entry_t *entry)
+{
+    entry->stale = true;
+    if (entry->users != 0) {
+        return 0;
+    }
+    entry->valid = false;
+    return entry->handle;
+}
+
+static psa_status_t import(psa_key_slot_number_t slot, psa_key_handle_t *handle)
+{
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+    psa_key_policy_t policy = PSA_KEY_POLICY_INIT;
+    uint8_t pubkey[PUBKEY_SIZE];
+    size_t pubkey_length;
+
+    *handle = 0;
+    ASSERT_SUCCESS_PSA(atecc608a_driver()->p_key_management->p_export(
+                           slot, pubkey, sizeof(pubkey), &pubkey_length));
+    ASSERT_SUCCESS_PSA(psa_allocate_key(handle));
+    psa_key_policy_set_usage(&policy, PSA_KEY_USAGE_VERIFY, VERIFY_ALG);
+    ASSERT_SUCCESS_PSA(psa_set_key_policy(*handle, &policy));
+    ASSERT_SUCCESS_PSA(psa_import_key(
+                           *handle,
+                           PSA_KEY_TYPE_ECC_PUBLIC_KEY(PSA_ECC_CURVE_SECP256R1),
+                           pubkey, pubkey_length));
+
+exit:
+    if (status != PSA_SUCCESS && *handle != 0) {
+        psa_destroy_key(*handle);
+        *handle = 0;
+    }
+    return status;
+}
+
+/* Look `slot` up and take a use of it. Called with the lock held. */
+static cache_entry_t *lookup(uint16_t slot, uint32_t key_changes,
+                             psa_key_handle_t *destroy)
+{
+    for (int i = 0; i < ATECC608A_VERIFY_CACHE_SIZE; i++) {
+        cache_entry_t *entry = &cache[i];
+
+        if (!entry->valid || entry->stale || entry->slot != slot) {
+            continue;
+        }
+        if (entry->key_changes != key_changes) {
+            /* A thread that read the count later may have cached a newer
+             * key already. */
+            if ((int32_t)(entry->key_changes - key_changes) < 0) {
+                *destroy = retire(entry);
+            }
+            continue;
+        }
+        entry->users++;
+        entry->last_used = ++use_clock;
+        return entry;
+    }
+    return NULL;
+}
+
+psa_status_t atecc608a_verify_cache_acquire(psa_key_slot_number_t slot,
+                                            psa_key_handle_t *handle)
+{
+    psa_key_handle_t destroy = 0;
+    psa_key_handle_t evicted = 0;
+    psa_key_handle_t imported;
+    psa_status_t status;
+    uint32_t key_changes;
+    cache_entry_t *entry;
+    cache_entry_t *victim = NULL;
+
+    if (slot >= 16) {
+        return PSA_ERROR_INVALID_ARGUMENT;
+    }
+    if (revoked((uint16_t) slot)) {
+        return PSA_ERROR_NOT_PERMITTED;
+    }
+
+    key_changes = atecc608a_slot_key_changes((uint16_t) slot);
+    atecc608a_lock_acquire(&cache_lock);
+    entry = lookup((uint16_t) slot, key_changes, &destroy);
+    if (entry != NULL) {
+        hits++;
+    } else {
+        misses++;
+    }
+    atecc608a_lock_release(&cache_lock);
+    if (destroy != 0) {
+        psa_destroy_key(destroy);
+    }
+    if (entry != NULL) {
+        *handle = entry->handle;
+        return PSA_SUCCESS;
+    }
+
+    /* The export and the import are the slow part, done unlocked. Two
+     * threads may do them for the same slot at once, the loser's key is
+     * destroyed below. */
+    status = import(slot, &imported);
+    if (status != PSA_SUCCESS) {
+        return status;
+    }
+
+    destroy = 0;
+    atecc608a_lock_acquire(&cache_lock);
+    entry = lookup((uint16_t) slot, key_changes, &destroy);
+    if (entry == NULL) {
+        for (int i = 0; i < ATECC608A_VERIFY_CACHE_SIZE; i++) {
+            cache_entry_t *candidate = &cache[i];
+
+            if (!candidate->valid) {
+                victim = candidate;
+                break;
+            }
+            if (candidate->users == 0 &&
+                    (victim == NULL ||
+                     candidate->last_used < victim->last_used)) {
+                victim = candidate;
+            }
+        }
+        if (victim != NULL) {
+            if (victim->valid) {
+                evicted = victim->handle;
+            }
+            victim->valid = true;
+            victim->stale = false;
+            victim->slot = (uint16_t) slot;
+            victim->key_changes = key_changes;
+            victim->handle = imported;
+            victim->users = 1;
+            victim->last_used = ++use_clock;
+            entry = victim;
+            imported = 0;
+        }
+    }
+    atecc608a_lock_release(&cache_lock);
+
+    if (destroy != 0) {
+        psa_destroy_key(destroy);
+    }
+    if (evicted != 0) {
+        psa_destroy_key(evicted);
+    }
+    if (entry == NULL) {
+        /* Every entry is in use. */
+        psa_destroy_key(imported);
+        return PSA_ERROR_INSUFFICIENT_MEMORY;
+    }
+    if (imported != 0) {
+        psa_destroy_key(imported);
+    }
+    *handle = entry->handle;
+    return PSA_SUCCESS;
+}
+
+void atecc608a_verify_cache_release(psa_key_handle_t handle)
+{
+    psa_key_handle_t destroy = 0;
+
+    atecc608a_lock_acquire(&cache_lock);
+    for (int i = 0; i < ATECC608A_VERIFY_CACHE_SIZE; i++) {
+        cache_entry_t *entry = &cache[i];
+
+        if (entry->valid && entry->handle == handle && entry->users != 0) {
+            entry->users--;
+            if (entry->stale) {
+                destroy = retire(entry);
+            }
+            break;
+        }
+    }
+    atecc608a_lock_release(&cache_lock);
+    if (destroy != 0) {
+        psa_destroy_key(destroy);
+    }
+}
+
+psa_status_t atecc608a_verify_cache_verify(psa_key_slot_number_t slot,
+                                           const uint8_t *hash,
+                                           size_t hash_length,
+                                           const uint8_t *signature,
+                                           size_t signature_length)
+{
+    psa_key_handle_t handle;
+    psa_status_t status = atecc608a_verify_cache_acquire(slot, &handle);
+
+    if (status != PSA_SUCCESS) {
+        return status;
+    }
+    status = psa_asymmetric_verify(handle, VERIFY_ALG, hash, hash_length,
+                                   signature, signature_length);
+    atecc608a_verify_cache_release(handle);
+    if (status == PSA_ERROR_INVALID_SIGNATURE) {
+        atecc608a_event_log_append(ATECC608A_EVENT_VERIFY_FAILED,
+                                   (uint16_t) slot, 1);
+    }
+    return status;
+}
+
+void atecc608a_verify_cache_flush(void)
+{
+    psa_key_handle_t destroy[ATECC608A_VERIFY_CACHE_SIZE];
+
+    atecc608a_lock_acquire(&cache_lock);
+    for (int i = 0; i < ATECC608A_VERIFY_CACHE_SIZE; i++) {
+        destroy[i] = cache[i].valid ? retire(&cache[i]) : 0;
+    }
+    atecc608a_lock_release(&cache_lock);
+
+    for (int i = 0; i < ATECC608A_VERIFY_CACHE_SIZE; i++) {
+        if (destroy[i] != 0) {
+            psa_destroy_key(destroy[i]);
+        }
+    }
+}
+
+void atecc608a_verify_cache_print(void)
+{
+    cache_entry_t copy[ATECC608A_VERIFY_CACHE_SIZE];
+    uint32_t hit_count;
+    uint32_t miss_count;
+
+    atecc608a_lock_acquire(&cache_lock);
+    memcpy(copy, cache, sizeof(copy));
+    hit_count = hits;
+    miss_count = misses;
+    atecc608a_lock_release(&cache_lock);
+
+    printf("Verify key cache: %lu hits, %lu misses\n",
+           (unsigned long) hit_count, (unsigned long) miss_count);
+    for (int i = 0; i < ATECC608A_VERIFY_CACHE_SIZE; i++) {
+        if (copy[i].valid) {
+            printf("  - slot %u, %lu users%s\n", copy[i].slot,
+                   (unsigned long) copy[i].users,
+                   copy[i].stale ? ", stale" : "");
+        }
+    }
+}
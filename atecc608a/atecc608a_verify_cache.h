@@ -0,0 +1,64 @@
+/**
+ * \file atecc608a_verify_cache.h
+ * \brief PSA verification keys kept imported for the public keys of device
+ *        key pairs.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_VERIFY_CACHE_H
+#define ATECC608A_VERIFY_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "psa/crypto.h"
+
+/** Number of keys kept imported. Each holds a PSA key slot. */
+#define ATECC608A_VERIFY_CACHE_SIZE 4
+
+/** Get a PSA key handle for the public key of the P-256 key pair in device
+ *  slot `slot`, exporting and importing it only if it is not cached yet.
+ *  The key is imported with a policy allowing only ECDSA-SHA256
+ *  verification, which the PSA core keeps enforcing on every use.
+ *
+ *  A cached key is used again only if no key was put in the slot since
+ *  (see atecc608a_slot_key_changes()) and, with the key index loaded, the
+ *  slot is not revoked: that fails with PSA_ERROR_NOT_PERMITTED.
+ *
+ *  The handle stays valid until atecc608a_verify_cache_release(). */
+psa_status_t atecc608a_verify_cache_acquire(psa_key_slot_number_t slot,
+                                            psa_key_handle_t *handle);
+
+void atecc608a_verify_cache_release(psa_key_handle_t handle);
+
+/** Verify an ECDSA-SHA256 signature of `hash` with the public key of the
+ *  key pair in `slot`, on the host, through a cached handle. */
+psa_status_t atecc608a_verify_cache_verify(psa_key_slot_number_t slot,
+                                           const uint8_t *hash,
+                                           size_t hash_length,
+                                           const uint8_t *signature,
+                                           size_t signature_length);
+
+/** Destroy every cached key that is not in use. */
+void atecc608a_verify_cache_flush(void);
+
+/** Print the hit and miss counts and the cached slots. */
+void atecc608a_verify_cache_print(void);
+
+#endif /* ATECC608A_VERIFY_CACHE_H */
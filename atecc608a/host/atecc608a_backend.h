@@ -0,0 +1,67 @@
+/**
+ * \file atecc608a_backend.h
+ * \brief Devices the cryptoauthlib I2C HAL of host builds can talk to.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_BACKEND_H
+#define ATECC608A_BACKEND_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "atca_status.h"
+
+/** A host build links one backend, picked with BACKEND= in host/Makefile:
+ *
+ *  - emulator: the emulated device of atecc608a_emulator.h;
+ *  - replay: the responses of a trace, see below;
+ *  - serial: a real device behind a relay board, see atecc608a_bridge.h.
+ *
+ *  Backends take the calls of the HAL as they are. With ATECC608A_RECORD
+ *  set to a file name in the environment, the HAL also writes every call
+ *  and its result to that file, one line each:
+ *
+ *      wake 00
+ *      send 00 <command packet in hex>
+ *      recv 00 <response in hex>
+ *      idle 00
+ *
+ *  The replay backend reads such a trace from ATECC608A_REPLAY. Runs that
+ *  send the same commands replay the device responses, with the timing of
+ *  no device at all. */
+typedef struct {
+    const char *name;
+    /** Set up from the environment, once, before the first call. */
+    ATCA_STATUS (*open)(void);
+    ATCA_STATUS (*wake)(void);
+    ATCA_STATUS (*idle)(void);
+    ATCA_STATUS (*sleep)(void);
+    /** Send the command `packet`, without the word address. */
+    ATCA_STATUS (*send)(const uint8_t *packet, size_t length);
+    /** Receive up to `*length` bytes, setting `*length` to the count. */
+    ATCA_STATUS (*receive)(uint8_t *data, uint16_t *length);
+    /** A delay of the driver, such as the execution time of a command. */
+    void (*delay_us)(uint32_t us);
+} atecc608a_backend_t;
+
+/** The backend of this build. */
+extern const atecc608a_backend_t atecc608a_host_backend;
+
+#endif /* ATECC608A_BACKEND_H */
@@ -0,0 +1,227 @@
+/**
+ * \file atecc608a_bus.c
+ * \brief Timing model of the I2C bus between the host and the emulated
+ *        device.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include "atecc608a_bus.h"
+
+#include <string.h>
+
+/* A start and a stop condition take about a clock each. */
+#define FRAMING_CLOCKS 2
+#define CLOCKS_PER_BYTE 9
+
+static atecc608a_bus_config_t bus_config;
+
+/* In nanoseconds, so that a clock of a few hundred kHz adds up exactly. */
+static uint64_t now_ns;
+static uint64_t busy_until_ns;
+static uint64_t stats_start_ns;
+static uint64_t transfer_ns;
+static uint64_t wake_ns;
+static uint64_t execute_ns;
+static uint64_t poll_ns;
+static uint32_t frames;
+static uint32_t bytes;
+static uint32_t wakes;
+static uint32_t polls;
+
+/* Approximate typical execution times, in microseconds. They are below the
+ * maximums cryptoauthlib waits for, which the device only reaches at the
+ * limits of its operating range. */
+uint32_t atecc608a_bus_execution_us(uint8_t opcode, uint8_t mode)
+{
+    switch (opcode) {
+        case 0x02: /* Read */
+            return 500;
+        case 0x12: /* Write */
+            return 7000;
+        case 0x16: /* Nonce: pass-through loads are a copy */
+            return (mode & 0x03) == 0x03 ? 100 : 6000;
+        case 0x17: /* Lock */
+            return 8000;
+        case 0x1B: /* Random */
+            return 15000;
+        case 0x20: /* UpdateExtra */
+            return 8000;
+        case 0x24: /* Counter */
+            return 5000;
+        case 0x30: /* Info */
+            return 100;
+        case 0x40: /* GenKey */
+            return 85000;
+        case 0x41: /* Sign */
+            return 42000;
+        case 0x43: /* ECDH */
+            return 38000;
+        case 0x45: /* Verify */
+            return 46000;
+        case 0x47: /* SHA */
+            return 1000;
+        default:
+            return 0;
+    }
+}
+
+static uint64_t clocks_ns(uint64_t clocks)
+{
+    return clocks * 1000000000u / bus_config.clock_hz;
+}
+
+/* A start, the address byte, `length` more bytes and a stop. */
+static uint64_t frame_ns(size_t length)
+{
+    return clocks_ns(FRAMING_CLOCKS + CLOCKS_PER_BYTE * (length + 1)) +
+           (uint64_t) bus_config.stretch_ns * (length + 1);
+}
+
+static void transfer(size_t length)
+{
+    uint64_t ns = frame_ns(length);
+
+    now_ns += ns;
+    transfer_ns += ns;
+    frames++;
+    bytes += (uint32_t)(length + 1);
+}
+
+void atecc608a_bus_configure(const atecc608a_bus_config_t *config)
+{
+    bus_config = *config;
+    busy_until_ns = now_ns;
+}
+
+void atecc608a_bus_default_config(atecc608a_bus_config_t *config,
+                                  uint32_t clock_hz)
+{
+    memset(config, 0, sizeof(*config));
+    config->clock_hz = clock_hz;
+    config->wake_low_us = ATECC608A_BUS_WAKE_LOW_US;
+    config->wake_delay_us = ATECC608A_BUS_WAKE_DELAY_US;
+    config->poll_interval_us = 100;
+}
+
+const atecc608a_bus_config_t *atecc608a_bus_config(void)
+{
+    return &bus_config;
+}
+
+uint64_t atecc608a_bus_time_us(void)
+{
+    return now_ns / 1000;
+}
+
+void atecc608a_bus_get_stats(atecc608a_bus_stats_t *stats)
+{
+    stats->transfer_us = transfer_ns / 1000;
+    stats->wake_us = wake_ns / 1000;
+    stats->execute_us = execute_ns / 1000;
+    stats->poll_us = poll_ns / 1000;
+    stats->total_us = (now_ns - stats_start_ns) / 1000;
+    stats->frames = frames;
+    stats->bytes = bytes;
+    stats->wakes = wakes;
+    stats->polls = polls;
+}
+
+void atecc608a_bus_reset_stats(void)
+{
+    stats_start_ns = now_ns;
+    transfer_ns = 0;
+    wake_ns = 0;
+    execute_ns = 0;
+    poll_ns = 0;
+    frames = 0;
+    bytes = 0;
+    wakes = 0;
+    polls = 0;
+}
+
+void atecc608a_bus_send(size_t length)
+{
+    if (bus_config.clock_hz == 0) {
+        return;
+    }
+    transfer(length);
+}
+
+void atecc608a_bus_receive(size_t length)
+{
+    if (bus_config.clock_hz == 0) {
+        return;
+    }
+    /* The device does not acknowledge its address until it is done. */
+    while (now_ns < busy_until_ns) {
+        uint64_t ns = frame_ns(0);
+
+        now_ns += ns;
+        poll_ns += ns;
+        polls++;
+        if (now_ns < busy_until_ns) {
+            now_ns += (uint64_t) bus_config.poll_interval_us * 1000;
+        }
+    }
+    transfer(length);
+}
+
+/* The 0x00 byte that makes the pulse is too short on fast buses, which then
+ * hold SDA low for the whole tWLO. */
+void atecc608a_bus_wake(void)
+{
+    uint64_t pulse_ns;
+    uint64_t ns;
+
+    if (bus_config.clock_hz == 0) {
+        return;
+    }
+    pulse_ns = clocks_ns(CLOCKS_PER_BYTE);
+    if (pulse_ns < (uint64_t) bus_config.wake_low_us * 1000) {
+        pulse_ns = (uint64_t) bus_config.wake_low_us * 1000;
+    }
+    ns = pulse_ns + (uint64_t) bus_config.wake_delay_us * 1000;
+    now_ns += ns;
+    wake_ns += ns;
+    wakes++;
+}
+
+void atecc608a_bus_idle(void)
+{
+    atecc608a_bus_send(1);
+}
+
+void atecc608a_bus_execute(const uint8_t *packet, size_t length)
+{
+    uint64_t ns;
+
+    if (bus_config.clock_hz == 0 || length < 3) {
+        return;
+    }
+    ns = (uint64_t) atecc608a_bus_execution_us(packet[1], packet[2]) * 1000;
+    busy_until_ns = now_ns + ns;
+    execute_ns += ns;
+}
+
+void atecc608a_bus_delay(uint32_t us)
+{
+    if (bus_config.clock_hz == 0) {
+        return;
+    }
+    now_ns += (uint64_t) us * 1000;
+}
@@ -0,0 +1,116 @@
+/**
+ * \file atecc608a_bus.h
+ * \brief Timing model of the I2C bus between the host and the emulated
+ *        device.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_BUS_H
+#define ATECC608A_BUS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** The emulator executes commands at once. With a clock rate set, the HAL
+ *  of host builds charges every frame to a modelled clock instead, bit by
+ *  bit:
+ *
+ *  - a transfer is a start condition, the address byte, the bytes of the
+ *    frame and a stop condition, 9 clocks per byte with the acknowledge,
+ *    plus the clock stretching of the device after each byte;
+ *  - a wake holds SDA low for the wake pulse, at least one 0x00 byte at
+ *    the clock rate, then waits for the device to wake up (tWHI). The wake
+ *    response is read as any other;
+ *  - a command keeps the device busy for its execution time. Delays of the
+ *    driver advance the clock, and a read while the device is still busy
+ *    polls its address, each poll a NACKed address byte, until it is done.
+ *
+ *  The time is only modelled: nothing sleeps, and the modelled clock is
+ *  separate from atecc608a_time_us(). */
+
+/** Datasheet bus timing: the wake low duration (tWLO) and the wake high
+ *  delay to data communication (tWHI), in microseconds. */
+#define ATECC608A_BUS_WAKE_LOW_US 60
+#define ATECC608A_BUS_WAKE_DELAY_US 1500
+
+typedef struct {
+    /** SCL rate in Hz, 0 for no timing. */
+    uint32_t clock_hz;
+    uint32_t wake_low_us;
+    uint32_t wake_delay_us;
+    /** Clock stretching by the device after each byte, in nanoseconds. */
+    uint32_t stretch_ns;
+    /** Time between two address polls of a busy device. */
+    uint32_t poll_interval_us;
+} atecc608a_bus_config_t;
+
+/** Modelled time, split by what it was spent on. The total may exceed the
+ *  sum: the rest is host delays beyond the execution of a command. */
+typedef struct {
+    /** Bytes clocked in frames, with their framing. */
+    uint64_t transfer_us;
+    /** Wake pulses and wake up delays. */
+    uint64_t wake_us;
+    /** Device executing commands. */
+    uint64_t execute_us;
+    /** Address polls while the device was busy. They overlap execution. */
+    uint64_t poll_us;
+    uint64_t total_us;
+    uint32_t frames;
+    uint32_t bytes;
+    uint32_t wakes;
+    uint32_t polls;
+} atecc608a_bus_stats_t;
+
+/** Set the bus timing. A clock rate of 0 turns the model off. */
+void atecc608a_bus_configure(const atecc608a_bus_config_t *config);
+
+/** The datasheet timing at `clock_hz`, without clock stretching. */
+void atecc608a_bus_default_config(atecc608a_bus_config_t *config,
+                                  uint32_t clock_hz);
+
+const atecc608a_bus_config_t *atecc608a_bus_config(void);
+
+/** Modelled time since start, in microseconds. */
+uint64_t atecc608a_bus_time_us(void);
+
+void atecc608a_bus_get_stats(atecc608a_bus_stats_t *stats);
+void atecc608a_bus_reset_stats(void);
+
+/** Charge a transfer of `length` bytes after the address byte. A receive
+ *  from a busy device is charged the polls until it is done first. */
+void atecc608a_bus_send(size_t length);
+void atecc608a_bus_receive(size_t length);
+
+/** Charge a wake, and the idle or sleep word address byte. */
+void atecc608a_bus_wake(void);
+void atecc608a_bus_idle(void);
+
+/** The device starts executing the command `packet` (count, opcode,
+ *  parameters, data and CRC) at the current time. */
+void atecc608a_bus_execute(const uint8_t *packet, size_t length);
+
+/** A host delay of `us` microseconds. */
+void atecc608a_bus_delay(uint32_t us);
+
+/** Typical execution time of `opcode` with parameter 1 `mode`, in
+ *  microseconds, 0 for unknown opcodes. */
+uint32_t atecc608a_bus_execution_us(uint8_t opcode, uint8_t mode);
+
+#endif /* ATECC608A_BUS_H */
@@ -0,0 +1,1112 @@
+/**
+ * \file atecc608a_emulator.c
+ * \brief Emulated ATECC608A for host builds, with state snapshots and
+ *        ready-made fixture states.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include "atecc608a_emulator.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "atecc608a_crc16.h"
+
+/* Opcodes. */
+#define OP_READ         0x02
+#define OP_WRITE        0x12
+#define OP_NONCE        0x16
+#define OP_LOCK         0x17
+#define OP_RANDOM       0x1B
+#define OP_UPDATE_EXTRA 0x20
+#define OP_COUNTER      0x24
+#define OP_INFO         0x30
+#define OP_GENKEY       0x40
+#define OP_SIGN         0x41
+#define OP_ECDH         0x43
+#define OP_VERIFY       0x45
+#define OP_SHA          0x47
+
+/* Response status codes. */
+#define STATUS_SUCCESS    0x00
+#define STATUS_MISCOMPARE 0x01
+#define STATUS_PARSE      0x03
+#define STATUS_ECC_FAULT  0x05
+#define STATUS_EXECUTION  0x0F
+#define STATUS_CRC        0xFF
+
+/* Config zone bytes. */
+#define CONFIG_REVISION     4
+#define CONFIG_I2C_ENABLE   14
+#define CONFIG_I2C_ADDRESS  16
+#define CONFIG_SLOT_CONFIG  20
+#define CONFIG_USER_EXTRA   84
+#define CONFIG_LOCK_VALUE   86
+#define CONFIG_LOCK_CONFIG  87
+#define CONFIG_SLOT_LOCKED  88
+#define CONFIG_KEY_CONFIG   96
+#define UNLOCKED            0x55
+
+#define ZONE_CONFIG 0
+#define ZONE_OTP    1
+#define ZONE_DATA   2
+
+#define KEY_TYPE_P256 4
+
+#define ECC_ALG PSA_ALG_ECDSA(PSA_ALG_SHA_256)
+#define ECC_KEYPAIR PSA_KEY_TYPE_ECC_KEYPAIR(PSA_ECC_CURVE_SECP256R1)
+#define ECC_PUBLIC_KEY PSA_KEY_TYPE_ECC_PUBLIC_KEY(PSA_ECC_CURVE_SECP256R1)
+
+static atecc608a_emu_t *selected;
+
+/* SHA-256, with a context that fits in the device state. */
+static const uint32_t sha_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha_init(uint32_t *h)
+{
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+
+    memcpy(h, initial, sizeof(initial));
+}
+
+static void sha_block(uint32_t *h, const uint8_t *block)
+{
+    uint32_t w[64];
+    uint32_t v[8];
+
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t) block[4 * i] << 24 | (uint32_t) block[4 * i + 1] << 16 |
+               (uint32_t) block[4 * i + 2] << 8 | block[4 * i + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ROR(w[i - 15], 7) ^ ROR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROR(w[i - 2], 17) ^ ROR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    memcpy(v, h, sizeof(v));
+    for (int i = 0; i < 64; i++) {
+        uint32_t s1 = ROR(v[4], 6) ^ ROR(v[4], 11) ^ ROR(v[4], 25);
+        uint32_t ch = (v[4] & v[5]) ^ (~v[4] & v[6]);
+        uint32_t t1 = v[7] + s1 + ch + sha_k[i] + w[i];
+        uint32_t s0 = ROR(v[0], 2) ^ ROR(v[0], 13) ^ ROR(v[0], 22);
+        uint32_t maj = (v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]);
+
+        memmove(v + 1, v, 7 * sizeof(v[0]));
+        v[4] += t1;
+        v[0] = t1 + s0 + maj;
+    }
+    for (int i = 0; i < 8; i++) {
+        h[i] += v[i];
+    }
+}
+
+/* Hash the last `length` (< 64) bytes of a message of `total` bytes. */
+static void sha_final(uint32_t *h, const uint8_t *tail, size_t length,
+                      uint64_t total, uint8_t *digest)
+{
+    uint8_t block[128] = { 0 };
+    size_t blocks = length < 56 ? 1 : 2;
+
+    memcpy(block, tail, length);
+    block[length] = 0x80;
+    for (int i = 0; i < 8; i++) {
+        block[blocks * 64 - 1 - i] = (uint8_t)((total * 8) >> (8 * i));
+    }
+    for (size_t i = 0; i < blocks; i++) {
+        sha_block(h, block + 64 * i);
+    }
+    for (int i = 0; i < 8; i++) {
+        digest[4 * i] = (uint8_t)(h[i] >> 24);
+        digest[4 * i + 1] = (uint8_t)(h[i] >> 16);
+        digest[4 * i + 2] = (uint8_t)(h[i] >> 8);
+        digest[4 * i + 3] = (uint8_t) h[i];
+    }
+}
+
+static void sha256(const uint8_t *data, size_t length, uint8_t *digest)
+{
+    uint32_t h[8];
+    size_t done = 0;
+
+    sha_init(h);
+    for (; length - done >= 64; done += 64) {
+        sha_block(h, data + done);
+    }
+    sha_final(h, data + done, length - done, length, digest);
+}
+
+static void put_u32(uint8_t *to, uint32_t value)
+{
+    for (int i = 0; i < 4; i++) {
+        to[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static uint32_t get_u32(const uint8_t *from)
+{
+    return from[0] | (uint32_t) from[1] << 8 | (uint32_t) from[2] << 16 |
+           (uint32_t) from[3] << 24;
+}
+
+static void put_u64(uint8_t *to, uint64_t value)
+{
+    put_u32(to, (uint32_t) value);
+    put_u32(to + 4, (uint32_t)(value >> 32));
+}
+
+static uint64_t get_u64(const uint8_t *from)
+{
+    return get_u32(from) | (uint64_t) get_u32(from + 4) << 32;
+}
+
+static void random_32(atecc608a_emu_state_t *state, uint8_t *out)
+{
+    uint8_t input[40];
+
+    memcpy(input, state->rng_seed, 32);
+    put_u64(input + 32, state->rng_counter++);
+    sha256(input, sizeof(input), out);
+}
+
+static bool config_locked(const atecc608a_emu_state_t *state)
+{
+    return state->config[CONFIG_LOCK_CONFIG] != UNLOCKED;
+}
+
+static bool data_locked(const atecc608a_emu_state_t *state)
+{
+    return state->config[CONFIG_LOCK_VALUE] != UNLOCKED;
+}
+
+static uint16_t slot_config(const atecc608a_emu_state_t *state, uint16_t slot)
+{
+    const uint8_t *at = state->config + CONFIG_SLOT_CONFIG + 2 * slot;
+
+    return (uint16_t)(at[0] | at[1] << 8);
+}
+
+static uint16_t key_config(const atecc608a_emu_state_t *state, uint16_t slot)
+{
+    const uint8_t *at = state->config + CONFIG_KEY_CONFIG + 2 * slot;
+
+    return (uint16_t)(at[0] | at[1] << 8);
+}
+
+static bool slot_locked(const atecc608a_emu_state_t *state, uint16_t slot)
+{
+    uint16_t bits = (uint16_t)(state->config[CONFIG_SLOT_LOCKED] |
+                               state->config[CONFIG_SLOT_LOCKED + 1] << 8);
+
+    return (bits & (1u << slot)) == 0;
+}
+
+static bool is_p256(const atecc608a_emu_state_t *state, uint16_t slot)
+{
+    return ((key_config(state, slot) >> 2) & 0x07) == KEY_TYPE_P256;
+}
+
+static bool is_private(const atecc608a_emu_state_t *state, uint16_t slot)
+{
+    return (key_config(state, slot) & 0x01) != 0;
+}
+
+static size_t slot_size(uint16_t slot)
+{
+    return slot < 8 ? 36 : slot == 8 ? 416 : 72;
+}
+
+static uint8_t *slot_data(atecc608a_emu_state_t *state, uint16_t slot)
+{
+    if (slot < 8) {
+        return state->data + 36 * slot;
+    }
+    if (slot == 8) {
+        return state->data + 8 * 36;
+    }
+    return state->data + 8 * 36 + 416 + 72 * (slot - 9);
+}
+
+static uint8_t respond(atecc608a_emu_t *emu, uint8_t status,
+                       const uint8_t *data, size_t length)
+{
+    if (data == NULL || status != STATUS_SUCCESS) {
+        data = &status;
+        length = 1;
+    }
+    emu->response[0] = (uint8_t)(length + 3);
+    memcpy(emu->response + 1, data, length);
+    atecc608a_crc16(length + 1, emu->response, emu->response + 1 + length);
+    emu->response_length = length + 3;
+    return status;
+}
+
+/* Private key operations go through the PSA crypto implementation of the
+ * host, with a key imported for the one operation. */
+static psa_status_t import_key(psa_key_type_t type, psa_key_usage_t usage,
+                               psa_algorithm_t alg, const uint8_t *key,
+                               size_t length, psa_key_handle_t *handle)
+{
+    psa_key_policy_t policy = PSA_KEY_POLICY_INIT;
+    psa_status_t status = psa_allocate_key(handle);
+
+    if (status != PSA_SUCCESS) {
+        return status;
+    }
+    psa_key_policy_set_usage(&policy, usage, alg);
+    status = psa_set_key_policy(*handle, &policy);
+    if (status == PSA_SUCCESS) {
+        status = psa_import_key(*handle, type, key, length);
+    }
+    if (status != PSA_SUCCESS) {
+        psa_destroy_key(*handle);
+    }
+    return status;
+}
+
+/* Public key of the private key `d`, X and Y. */
+static psa_status_t public_key(const uint8_t *d, uint8_t *xy)
+{
+    psa_key_handle_t handle;
+    uint8_t exported[65];
+    size_t length;
+    psa_status_t status = import_key(ECC_KEYPAIR, PSA_KEY_USAGE_SIGN, ECC_ALG,
+                                     d, 32, &handle);
+
+    if (status != PSA_SUCCESS) {
+        return status;
+    }
+    status = psa_export_public_key(handle, exported, sizeof(exported),
+                                   &length);
+    psa_destroy_key(handle);
+    if (status == PSA_SUCCESS) {
+        memcpy(xy, exported + 1, 64);
+    }
+    return status;
+}
+
+static uint8_t read_command(atecc608a_emu_t *emu, uint8_t zone,
+                            uint16_t address)
+{
+    atecc608a_emu_state_t *state = emu->state;
+    size_t length = (zone & 0x80) ? 32 : 4;
+    const uint8_t *from;
+    size_t offset;
+
+    switch (zone & 0x03) {
+        case ZONE_CONFIG:
+            offset = 32 * (address >> 3) + 4 * (address & 0x07);
+            if (offset + length > ATECC608A_EMU_CONFIG_SIZE) {
+                return respond(emu, STATUS_PARSE, NULL, 0);
+            }
+            from = state->config + offset;
+            break;
+        case ZONE_OTP:
+            offset = 32 * (address >> 3) + 4 * (address & 0x07);
+            if (offset + length > ATECC608A_EMU_OTP_SIZE) {
+                return respond(emu, STATUS_PARSE, NULL, 0);
+            }
+            from = state->otp + offset;
+            break;
+        case ZONE_DATA: {
+            uint16_t slot = (address >> 3) & 0x0F;
+
+            offset = 32 * (address >> 8) + 4 * (address & 0x07);
+            if (offset + length > slot_size(slot)) {
+                return respond(emu, STATUS_PARSE, NULL, 0);
+            }
+            /* Secret slots could only be read encrypted. */
+            if (!data_locked(state) || (slot_config(state, slot) & 0x80)) {
+                return respond(emu, STATUS_EXECUTION, NULL, 0);
+            }
+            from = slot_data(state, slot) + offset;
+            break;
+        }
+        default:
+            return respond(emu, STATUS_PARSE, NULL, 0);
+    }
+    return respond(emu, STATUS_SUCCESS, from, length);
+}
+
+static uint8_t write_command(atecc608a_emu_t *emu, uint8_t zone,
+                             uint16_t address, const uint8_t *data,
+                             size_t data_length)
+{
+    atecc608a_emu_state_t *state = emu->state;
+    size_t length = (zone & 0x80) ? 32 : 4;
+    size_t offset;
+
+    /* Encrypted writes carry a MAC and are not supported. */
+    if (data_length != length || (zone & 0x40)) {
+        return respond(emu, STATUS_PARSE, NULL, 0);
+    }
+    switch (zone & 0x03) {
+        case ZONE_CONFIG:
+            offset = 32 * (address >> 3) + 4 * (address & 0x07);
+            if (offset + length > ATECC608A_EMU_CONFIG_SIZE) {
+                return respond(emu, STATUS_PARSE, NULL, 0);
+            }
+            if (config_locked(state)) {
+                return respond(emu, STATUS_EXECUTION, NULL, 0);
+            }
+            /* The serial number and revision, UserExtra, Selector and the
+             * lock bytes are left alone. */
+            for (size_t i = 0; i < length; i++) {
+                size_t at = offset + i;
+
+                if (at >= 16 && (at < CONFIG_USER_EXTRA ||
+                                 at > CONFIG_LOCK_CONFIG)) {
+                    state->config[at] = data[i];
+                }
+            }
+            break;
+        case ZONE_OTP:
+            offset = 32 * (address >> 3) + 4 * (address & 0x07);
+            if (offset + length > ATECC608A_EMU_OTP_SIZE) {
+                return respond(emu, STATUS_PARSE, NULL, 0);
+            }
+            if (data_locked(state)) {
+                return respond(emu, STATUS_EXECUTION, NULL, 0);
+            }
+            memcpy(state->otp + offset, data, length);
+            break;
+        case ZONE_DATA: {
+            uint16_t slot = (address >> 3) & 0x0F;
+            uint8_t write_config = (uint8_t)(slot_config(state, slot) >> 12);
+
+            offset = 32 * (address >> 8) + 4 * (address & 0x07);
+            if (offset + length > slot_size(slot)) {
+                return respond(emu, STATUS_PARSE, NULL, 0);
+            }
+            /* Anything goes before the data zone lock. After it, only
+             * Always (0000) and PubInvalid (0001) slots take clear writes. */
+            if (!config_locked(state) ||
+                    (data_locked(state) &&
+                     (write_config > 1 || slot_locked(state, slot)))) {
+                return respond(emu, STATUS_EXECUTION, NULL, 0);
+            }
+            memcpy(slot_data(state, slot) + offset, data, length);
+            break;
+        }
+        default:
+            return respond(emu, STATUS_PARSE, NULL, 0);
+    }
+    return respond(emu, STATUS_SUCCESS, NULL, 0);
+}
+
+static uint8_t lock_command(atecc608a_emu_t *emu, uint8_t mode, uint16_t crc)
+{
+    atecc608a_emu_state_t *state = emu->state;
+    bool check_crc = (mode & 0x80) == 0;
+    uint8_t computed[2];
+
+    switch (mode & 0x03) {
+        case 0:
+            if (config_locked(state)) {
+                return respond(emu, STATUS_EXECUTION, NULL, 0);
+            }
+            atecc608a_crc16(ATECC608A_EMU_CONFIG_SIZE, state->config, computed);
+            if (check_crc && (computed[0] | computed[1] << 8) != crc) {
+                return respond(emu, STATUS_MISCOMPARE, NULL, 0);
+            }
+            state->config[CONFIG_LOCK_CONFIG] = 0x00;
+            break;
+        case 1: {
+            uint8_t zone[ATECC608A_EMU_DATA_SIZE + ATECC608A_EMU_OTP_SIZE];
+
+            if (!config_locked(state) || data_locked(state)) {
+                return respond(emu, STATUS_EXECUTION, NULL, 0);
+            }
+            memcpy(zone, state->data, ATECC608A_EMU_DATA_SIZE);
+            memcpy(zone + ATECC608A_EMU_DATA_SIZE, state->otp,
+                   ATECC608A_EMU_OTP_SIZE);
+            atecc608a_crc16(sizeof(zone), zone, computed);
+            if (check_crc && (computed[0] | computed[1] << 8) != crc) {
+                return respond(emu, STATUS_MISCOMPARE, NULL, 0);
+            }
+            state->config[CONFIG_LOCK_VALUE] = 0x00;
+            break;
+        }
+        case 2: {
+            uint16_t slot = (mode >> 2) & 0x0F;
+
+            /* Only Lockable slots, once the data zone is locked. */
+            if (!data_locked(state) || (key_config(state, slot) & 0x20) == 0 ||
+                    slot_locked(state, slot)) {
+                return respond(emu, STATUS_EXECUTION, NULL, 0);
+            }
+            state->config[CONFIG_SLOT_LOCKED + slot / 8] &=
+                (uint8_t) ~(1u << (slot % 8));
+            break;
+        }
+        default:
+            return respond(emu, STATUS_PARSE, NULL, 0);
+    }
+    return respond(emu, STATUS_SUCCESS, NULL, 0);
+}
+
+static uint8_t random_command(atecc608a_emu_t *emu)
+{
+    uint8_t out[32];
+
+    /* Before the config lock the device returns a fixed test pattern. */
+    if (!config_locked(emu->state)) {
+        for (int i = 0; i < 32; i += 4) {
+            out[i] = 0xFF;
+            out[i + 1] = 0xFF;
+            out[i + 2] = 0x00;
+            out[i + 3] = 0x00;
+        }
+    } else {
+        random_32(emu->state, out);
+    }
+    emu->state->tempkey_flags = 0;
+    return respond(emu, STATUS_SUCCESS, out, sizeof(out));
+}
+
+static uint8_t nonce_command(atecc608a_emu_t *emu, uint8_t mode,
+                             const uint8_t *data, size_t length)
+{
+    atecc608a_emu_state_t *state = emu->state;
+
+    if ((mode & 0x03) == 0x03) {
+        /* Pass-through, 32 bytes or with mode bit 5 64 bytes. */
+        size_t expected = (mode & 0x20) ? 64 : 32;
+
+        if (length != expected || (mode & 0x40)) {
+            return respond(emu, STATUS_PARSE, NULL, 0);
+        }
+        memset(state->tempkey, 0, sizeof(state->tempkey));
+        memcpy(state->tempkey, data, length);
+        state->tempkey_flags = ATECC608A_EMU_TEMPKEY_VALID |
+                               ATECC608A_EMU_TEMPKEY_EXTERNAL;
+        return respond(emu, STATUS_SUCCESS, NULL, 0);
+    }
+    if ((mode & 0x03) <= 1 && length == 20) {
+        /* TempKey = SHA-256(RandOut, NumIn, opcode, mode, 0). */
+        uint8_t message[32 + 20 + 3];
+        uint8_t rand_out[32];
+
+        random_32(state, rand_out);
+        memcpy(message, rand_out, 32);
+        memcpy(message + 32, data, 20);
+        message[52] = OP_NONCE;
+        message[53] = mode;
+        message[54] = 0x00;
+        memset(state->tempkey, 0, sizeof(state->tempkey));
+        sha256(message, sizeof(message), state->tempkey);
+        state->tempkey_flags = ATECC608A_EMU_TEMPKEY_VALID;
+        return respond(emu, STATUS_SUCCESS, rand_out, sizeof(rand_out));
+    }
+    return respond(emu, STATUS_PARSE, NULL, 0);
+}
+
+static uint8_t genkey_command(atecc608a_emu_t *emu, uint8_t mode,
+                              uint16_t slot)
+{
+    atecc608a_emu_state_t *state = emu->state;
+    uint8_t *d = slot_data(state, slot & 0x0F);
+    uint8_t xy[64];
+
+    slot &= 0x0F;
+    if (!is_private(state, slot) || !is_p256(state, slot)) {
+        return respond(emu, STATUS_EXECUTION, NULL, 0);
+    }
+    if (mode & 0x04) {
+        uint8_t candidate[32];
+        psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+
+        /* Once the data zone is locked, WriteConfig must allow GenKey. */
+        if (!config_locked(state) ||
+                (data_locked(state) &&
+                 ((slot_config(state, slot) & 0x2000) == 0 ||
+                  slot_locked(state, slot)))) {
+            return respond(emu, STATUS_EXECUTION, NULL, 0);
+        }
+        /* A draw outside [1, n - 1] is practically impossible, the PSA
+         * import rejects it anyway. */
+        for (int i = 0; i < 4 && status != PSA_SUCCESS; i++) {
+            random_32(state, candidate);
+            status = public_key(candidate, xy);
+        }
+        if (status != PSA_SUCCESS) {
+            return respond(emu, STATUS_ECC_FAULT, NULL, 0);
+        }
+        memcpy(d, candidate, 32);
+    } else if ((mode & 0x1C) == 0) {
+        if (public_key(d, xy) != PSA_SUCCESS) {
+            return respond(emu, STATUS_ECC_FAULT, NULL, 0);
+        }
+    } else {
+        return respond(emu, STATUS_PARSE, NULL, 0);
+    }
+    state->tempkey_flags = 0;
+    return respond(emu, STATUS_SUCCESS, xy, sizeof(xy));
+}
+
+static uint8_t sign_command(atecc608a_emu_t *emu, uint8_t mode, uint16_t slot)
+{
+    atecc608a_emu_state_t *state = emu->state;
+    psa_key_handle_t handle;
+    uint8_t signature[64];
+    size_t length;
+    psa_status_t status;
+
+    slot &= 0x0F;
+    /* External messages only, with external signatures enabled in
+     * ReadKey. */
+    if ((mode & 0x80) == 0) {
+        return respond(emu, STATUS_PARSE, NULL, 0);
+    }
+    if (!is_private(state, slot) || !is_p256(state, slot) ||
+            (slot_config(state, slot) & 0x01) == 0 ||
+            !(state->tempkey_flags & ATECC608A_EMU_TEMPKEY_VALID)) {
+        return respond(emu, STATUS_EXECUTION, NULL, 0);
+    }
+    status = import_key(ECC_KEYPAIR, PSA_KEY_USAGE_SIGN, ECC_ALG,
+                        slot_data(state, slot), 32, &handle);
+    if (status == PSA_SUCCESS) {
+        status = psa_asymmetric_sign(handle, ECC_ALG, state->tempkey, 32,
+                                     signature, sizeof(signature), &length);
+        psa_destroy_key(handle);
+    }
+    state->tempkey_flags = 0;
+    if (status != PSA_SUCCESS) {
+        return respond(emu, STATUS_ECC_FAULT, NULL, 0);
+    }
+    return respond(emu, STATUS_SUCCESS, signature, sizeof(signature));
+}
+
+/* Mode 0, the shared secret in the clear, with its output not bound to the
+ * next slot, or mode 8, the shared secret into TempKey. Both need ECDH
+ * enabled in ReadKey. */
+static uint8_t ecdh_command(atecc608a_emu_t *emu, uint8_t mode, uint16_t slot,
+                            const uint8_t *data, size_t length)
+{
+    atecc608a_emu_state_t *state = emu->state;
+    uint8_t peer[65] = { 0x04 };
+    uint8_t shared[32];
+    psa_key_handle_t handle;
+    size_t shared_length;
+    psa_status_t status;
+
+    slot &= 0x0F;
+    if ((mode != 0 && mode != 0x08) || length != 64) {
+        return respond(emu, STATUS_PARSE, NULL, 0);
+    }
+    if (!is_private(state, slot) || !is_p256(state, slot) ||
+            !(slot_config(state, slot) & 0x04) ||
+            (mode == 0 && (slot_config(state, slot) & 0x08))) {
+        return respond(emu, STATUS_EXECUTION, NULL, 0);
+    }
+    memcpy(peer + 1, data, 64);
+    status = import_key(ECC_KEYPAIR, PSA_KEY_USAGE_DERIVE, PSA_ALG_ECDH,
+                        slot_data(state, slot), 32, &handle);
+    if (status == PSA_SUCCESS) {
+        status = psa_key_agreement_raw_shared_secret(PSA_ALG_ECDH, handle, peer,
+                                                     sizeof(peer), shared,
+                                                     sizeof(shared),
+                                                     &shared_length);
+        psa_destroy_key(handle);
+    }
+    state->tempkey_flags = 0;
+    if (status != PSA_SUCCESS) {
+        return respond(emu, STATUS_ECC_FAULT, NULL, 0);
+    }
+    if (mode == 0x08) {
+        memset(state->tempkey, 0, sizeof(state->tempkey));
+        memcpy(state->tempkey, shared, sizeof(shared));
+        memset(shared, 0, sizeof(shared));
+        state->tempkey_flags = ATECC608A_EMU_TEMPKEY_VALID;
+        return respond(emu, STATUS_SUCCESS, NULL, 0);
+    }
+    return respond(emu, STATUS_SUCCESS, shared, sizeof(shared));
+}
+
+static uint8_t verify_command(atecc608a_emu_t *emu, uint8_t mode,
+                              uint16_t key_id, const uint8_t *data,
+                              size_t length)
+{
+    atecc608a_emu_state_t *state = emu->state;
+    uint8_t pubkey[65] = { 0x04 };
+    psa_key_handle_t handle;
+    psa_status_t status;
+
+    if (!(state->tempkey_flags & ATECC608A_EMU_TEMPKEY_VALID)) {
+        return respond(emu, STATUS_EXECUTION, NULL, 0);
+    }
+    switch (mode & 0x07) {
+        case 0x00: {
+            /* Stored: X and Y in the slot, each after 4 pad bytes. */
+            uint16_t slot = key_id & 0x0F;
+            const uint8_t *stored = slot_data(state, slot);
+
+            if (length != 64 || is_private(state, slot) || !is_p256(state, slot)) {
+                return respond(emu, STATUS_PARSE, NULL, 0);
+            }
+            memcpy(pubkey + 1, stored + 4, 32);
+            memcpy(pubkey + 33, stored + 40, 32);
+            break;
+        }
+        case 0x02:
+            if (length != 128 || key_id != KEY_TYPE_P256) {
+                return respond(emu, STATUS_PARSE, NULL, 0);
+            }
+            memcpy(pubkey + 1, data + 64, 64);
+            break;
+        default:
+            return respond(emu, STATUS_PARSE, NULL, 0);
+    }
+
+    state->tempkey_flags = 0;
+    status = import_key(ECC_PUBLIC_KEY, PSA_KEY_USAGE_VERIFY, ECC_ALG, pubkey,
+                        sizeof(pubkey), &handle);
+    if (status != PSA_SUCCESS) {
+        return respond(emu, STATUS_ECC_FAULT, NULL, 0);
+    }
+    status = psa_asymmetric_verify(handle, ECC_ALG, state->tempkey, 32, data,
+                                   64);
+    psa_destroy_key(handle);
+    if (status == PSA_ERROR_INVALID_SIGNATURE) {
+        return respond(emu, STATUS_MISCOMPARE, NULL, 0);
+    }
+    return respond(emu, status == PSA_SUCCESS ? STATUS_SUCCESS :
+                   STATUS_ECC_FAULT, NULL, 0);
+}
+
+/* Values of sha_active: the SHA command hashes, or computes an HMAC keyed
+ * with TempKey. */
+#define SHA_ACTIVE  1
+#define HMAC_ACTIVE 2
+
+/* The first block of an HMAC with a 32 byte `key`. */
+static void hmac_key_block(const uint8_t *key, uint8_t pad, uint8_t *block)
+{
+    memset(block, pad, 64);
+    for (int i = 0; i < 32; i++) {
+        block[i] ^= key[i];
+    }
+}
+
+/* The output target bits of `mode` are ignored: the digest is always
+ * returned. HMAC keys can only be TempKey, key ID 0xFFFF. */
+static uint8_t sha_command(atecc608a_emu_t *emu, uint8_t mode,
+                           uint16_t key_id, const uint8_t *data,
+                           size_t length)
+{
+    atecc608a_emu_state_t *state = emu->state;
+    uint8_t block[64];
+    uint8_t digest[32];
+
+    switch (mode & 0x07) {
+        case 0x00:
+            sha_init(state->sha_state);
+            state->sha_length = 0;
+            state->sha_active = SHA_ACTIVE;
+            return respond(emu, STATUS_SUCCESS, NULL, 0);
+        case 0x04:
+            if (key_id != 0xFFFF) {
+                return respond(emu, STATUS_PARSE, NULL, 0);
+            }
+            if (!(state->tempkey_flags & ATECC608A_EMU_TEMPKEY_VALID)) {
+                return respond(emu, STATUS_EXECUTION, NULL, 0);
+            }
+            sha_init(state->sha_state);
+            hmac_key_block(state->tempkey, 0x36, block);
+            sha_block(state->sha_state, block);
+            state->sha_length = 64;
+            state->sha_active = HMAC_ACTIVE;
+            return respond(emu, STATUS_SUCCESS, NULL, 0);
+        case 0x01:
+            if (!state->sha_active || length != 64) {
+                return respond(emu, STATUS_EXECUTION, NULL, 0);
+            }
+            sha_block(state->sha_state, data);
+            state->sha_length += 64;
+            return respond(emu, STATUS_SUCCESS, NULL, 0);
+        case 0x02:
+            if (!state->sha_active || length >= 64) {
+                return respond(emu, STATUS_EXECUTION, NULL, 0);
+            }
+            sha_final(state->sha_state, data, length,
+                      state->sha_length + length, digest);
+            if (state->sha_active == HMAC_ACTIVE) {
+                if (!(state->tempkey_flags & ATECC608A_EMU_TEMPKEY_VALID)) {
+                    state->sha_active = 0;
+                    return respond(emu, STATUS_EXECUTION, NULL, 0);
+                }
+                sha_init(state->sha_state);
+                hmac_key_block(state->tempkey, 0x5C, block);
+                sha_block(state->sha_state, block);
+                sha_final(state->sha_state, digest, sizeof(digest),
+                          64 + sizeof(digest), digest);
+            }
+            state->sha_active = 0;
+            return respond(emu, STATUS_SUCCESS, digest, sizeof(digest));
+        default:
+            return respond(emu, STATUS_PARSE, NULL, 0);
+    }
+}
+
+static uint8_t update_extra_command(atecc608a_emu_t *emu, uint8_t mode,
+                                    uint16_t value)
+{
+    uint8_t *byte = &emu->state->config[CONFIG_USER_EXTRA + (mode & 0x01)];
+
+    /* Each byte can be set once. */
+    if ((mode & 0xFE) != 0 || *byte != 0) {
+        return respond(emu, STATUS_EXECUTION, NULL, 0);
+    }
+    *byte = (uint8_t) value;
+    return respond(emu, STATUS_SUCCESS, NULL, 0);
+}
+
+static uint8_t counter_command(atecc608a_emu_t *emu, uint8_t mode,
+                               uint16_t counter)
+{
+    uint8_t value[4];
+
+    if (counter > 1 || mode > 1) {
+        return respond(emu, STATUS_PARSE, NULL, 0);
+    }
+    if (mode == 1) {
+        if (emu->state->counters[counter] >= 2097151) {
+            return respond(emu, STATUS_EXECUTION, NULL, 0);
+        }
+        emu->state->counters[counter]++;
+    }
+    put_u32(value, emu->state->counters[counter]);
+    return respond(emu, STATUS_SUCCESS, value, sizeof(value));
+}
+
+/* Serial number and random seed of device number `id`. */
+void atecc608a_emu_personalize(atecc608a_emu_t *emu, uint32_t id)
+{
+    atecc608a_emu_state_t *state = emu->state;
+    uint8_t serial[9];
+
+    serial[0] = 0x01;
+    serial[1] = 0x23;
+    put_u32(serial + 2, id);
+    serial[6] = 0x5A;
+    serial[7] = 0xA5;
+    serial[8] = 0xEE;
+    memcpy(state->config, serial, 4);
+    memcpy(state->config + 8, serial + 4, 5);
+    sha256(serial, sizeof(serial), state->rng_seed);
+    state->rng_counter = 0;
+}
+
+void atecc608a_emu_attach(atecc608a_emu_t *emu, atecc608a_emu_state_t *state)
+{
+    emu->state = state;
+    emu->awake = false;
+    emu->response_length = 0;
+}
+
+void atecc608a_emu_reset(atecc608a_emu_t *emu, uint32_t id)
+{
+    atecc608a_emu_state_t *state = &emu->storage;
+
+    atecc608a_emu_attach(emu, state);
+    emu->commands = 0;
+    memset(state, 0, sizeof(*state));
+    memset(state->data, 0xFF, sizeof(state->data));
+    memset(state->otp, 0xFF, sizeof(state->otp));
+    state->config[CONFIG_REVISION + 2] = 0x60;
+    state->config[CONFIG_REVISION + 3] = 0x02;
+    state->config[CONFIG_I2C_ENABLE] = 0x01;
+    state->config[CONFIG_I2C_ADDRESS] = 0xC0;
+    state->config[CONFIG_LOCK_VALUE] = UNLOCKED;
+    state->config[CONFIG_LOCK_CONFIG] = UNLOCKED;
+    state->config[CONFIG_SLOT_LOCKED] = 0xFF;
+    state->config[CONFIG_SLOT_LOCKED + 1] = 0xFF;
+    atecc608a_emu_personalize(emu, id);
+}
+
+uint8_t atecc608a_emu_execute(atecc608a_emu_t *emu, const uint8_t *packet,
+                              size_t length)
+{
+    uint8_t crc[2];
+    uint8_t opcode;
+    uint8_t param1;
+    uint16_t param2;
+    const uint8_t *data = packet + 5;
+    size_t data_length;
+
+    if (length < 7 || packet[0] != length) {
+        return respond(emu, STATUS_PARSE, NULL, 0);
+    }
+    atecc608a_crc16(length - 2, packet, crc);
+    if (crc[0] != packet[length - 2] || crc[1] != packet[length - 1]) {
+        return respond(emu, STATUS_CRC, NULL, 0);
+    }
+    opcode = packet[1];
+    param1 = packet[2];
+    param2 = (uint16_t)(packet[3] | packet[4] << 8);
+    data_length = length - 7;
+    emu->commands++;
+
+    switch (opcode) {
+        case OP_READ:
+            return read_command(emu, param1, param2);
+        case OP_WRITE:
+            return write_command(emu, param1, param2, data, data_length);
+        case OP_LOCK:
+            return lock_command(emu, param1, param2);
+        case OP_RANDOM:
+            return random_command(emu);
+        case OP_NONCE:
+            return nonce_command(emu, param1, data, data_length);
+        case OP_GENKEY:
+            return genkey_command(emu, param1, param2);
+        case OP_SIGN:
+            return sign_command(emu, param1, param2);
+        case OP_ECDH:
+            return ecdh_command(emu, param1, param2, data, data_length);
+        case OP_VERIFY:
+            return verify_command(emu, param1, param2, data, data_length);
+        case OP_SHA:
+            return sha_command(emu, param1, param2, data, data_length);
+        case OP_UPDATE_EXTRA:
+            return update_extra_command(emu, param1, param2);
+        case OP_COUNTER:
+            return counter_command(emu, param1, param2);
+        case OP_INFO:
+            /* Revision only. */
+            if (param1 != 0) {
+                return respond(emu, STATUS_PARSE, NULL, 0);
+            }
+            return respond(emu, STATUS_SUCCESS,
+                           emu->state->config + CONFIG_REVISION, 4);
+        default:
+            return respond(emu, STATUS_PARSE, NULL, 0);
+    }
+}
+
+void atecc608a_emu_select(atecc608a_emu_t *emu)
+{
+    selected = emu;
+}
+
+atecc608a_emu_t *atecc608a_emu_selected(void)
+{
+    return selected;
+}
+
+void atecc608a_emu_snapshot(const atecc608a_emu_t *emu,
+                            atecc608a_emu_state_t *snapshot)
+{
+    memcpy(snapshot, emu->state, sizeof(*snapshot));
+}
+
+void atecc608a_emu_restore(atecc608a_emu_t *emu,
+                           const atecc608a_emu_state_t *snapshot)
+{
+    memcpy(emu->state, snapshot, sizeof(*emu->state));
+    emu->awake = false;
+    emu->response_length = 0;
+}
+
+/* Snapshot file: magic (4), version (1), state, CRC of all before it (2). */
+#define SNAPSHOT_MAGIC "AEMU"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_HEADER_SIZE 5
+#define SNAPSHOT_FILE_SIZE (SNAPSHOT_HEADER_SIZE + ATECC608A_EMU_SNAPSHOT_SIZE + 2)
+
+static void serialize(const atecc608a_emu_state_t *state, uint8_t *to)
+{
+    memcpy(to, state->config, sizeof(state->config));
+    to += sizeof(state->config);
+    memcpy(to, state->otp, sizeof(state->otp));
+    to += sizeof(state->otp);
+    memcpy(to, state->data, sizeof(state->data));
+    to += sizeof(state->data);
+    for (int i = 0; i < 2; i++, to += 4) {
+        put_u32(to, state->counters[i]);
+    }
+    memcpy(to, state->tempkey, sizeof(state->tempkey));
+    to += sizeof(state->tempkey);
+    *to++ = state->tempkey_flags;
+    memcpy(to, state->rng_seed, sizeof(state->rng_seed));
+    to += sizeof(state->rng_seed);
+    put_u64(to, state->rng_counter);
+    to += 8;
+    for (int i = 0; i < 8; i++, to += 4) {
+        put_u32(to, state->sha_state[i]);
+    }
+    put_u64(to, state->sha_length);
+    to += 8;
+    *to = state->sha_active;
+}
+
+static void deserialize(const uint8_t *from, atecc608a_emu_state_t *state)
+{
+    memcpy(state->config, from, sizeof(state->config));
+    from += sizeof(state->config);
+    memcpy(state->otp, from, sizeof(state->otp));
+    from += sizeof(state->otp);
+    memcpy(state->data, from, sizeof(state->data));
+    from += sizeof(state->data);
+    for (int i = 0; i < 2; i++, from += 4) {
+        state->counters[i] = get_u32(from);
+    }
+    memcpy(state->tempkey, from, sizeof(state->tempkey));
+    from += sizeof(state->tempkey);
+    state->tempkey_flags = *from++;
+    memcpy(state->rng_seed, from, sizeof(state->rng_seed));
+    from += sizeof(state->rng_seed);
+    state->rng_counter = get_u64(from);
+    from += 8;
+    for (int i = 0; i < 8; i++, from += 4) {
+        state->sha_state[i] = get_u32(from);
+    }
+    state->sha_length = get_u64(from);
+    from += 8;
+    state->sha_active = *from;
+}
+
+psa_status_t atecc608a_emu_save(const atecc608a_emu_t *emu, const char *path)
+{
+    static uint8_t file[SNAPSHOT_FILE_SIZE];
+    FILE *out = fopen(path, "wb");
+    size_t written;
+
+    if (out == NULL) {
+        return PSA_ERROR_STORAGE_FAILURE;
+    }
+    memcpy(file, SNAPSHOT_MAGIC, 4);
+    file[4] = SNAPSHOT_VERSION;
+    serialize(emu->state, file + SNAPSHOT_HEADER_SIZE);
+    atecc608a_crc16(SNAPSHOT_FILE_SIZE - 2, file, file + SNAPSHOT_FILE_SIZE - 2);
+    written = fwrite(file, 1, sizeof(file), out);
+    if (fclose(out) != 0 || written != sizeof(file)) {
+        return PSA_ERROR_STORAGE_FAILURE;
+    }
+    return PSA_SUCCESS;
+}
+
+psa_status_t atecc608a_emu_load(atecc608a_emu_t *emu, const char *path)
+{
+    static uint8_t file[SNAPSHOT_FILE_SIZE + 1];
+    atecc608a_emu_state_t state;
+    uint8_t crc[2];
+    FILE *in = fopen(path, "rb");
+    size_t length;
+
+    if (in == NULL) {
+        return PSA_ERROR_DOES_NOT_EXIST;
+    }
+    length = fread(file, 1, sizeof(file), in);
+    fclose(in);
+
+    if (length != SNAPSHOT_FILE_SIZE || memcmp(file, SNAPSHOT_MAGIC, 4) != 0 ||
+            file[4] != SNAPSHOT_VERSION) {
+        return PSA_ERROR_INVALID_ARGUMENT;
+    }
+    atecc608a_crc16(SNAPSHOT_FILE_SIZE - 2, file, crc);
+    if (memcmp(crc, file + SNAPSHOT_FILE_SIZE - 2, 2) != 0) {
+        return PSA_ERROR_INVALID_ARGUMENT;
+    }
+    deserialize(file + SNAPSHOT_HEADER_SIZE, &state);
+    atecc608a_emu_restore(emu, &state);
+    return PSA_SUCCESS;
+}
+
+static atecc608a_emu_state_t fixtures[ATECC608A_EMU_FIXTURE_COUNT];
+static bool fixtures_built;
+
+psa_status_t atecc608a_emu_build_fixtures(const uint8_t *config,
+                                          size_t config_size)
+{
+    static atecc608a_emu_t emu;
+    atecc608a_emu_state_t *state;
+
+    if (config_size != ATECC608A_EMU_CONFIG_SIZE) {
+        return PSA_ERROR_INVALID_ARGUMENT;
+    }
+
+    atecc608a_emu_reset(&emu, 0);
+    state = emu.state;
+    atecc608a_emu_snapshot(&emu, &fixtures[ATECC608A_EMU_FACTORY]);
+
+    /* What atcab_write_config_zone() and a config lock leave behind. */
+    memcpy(state->config + 16, config + 16, CONFIG_USER_EXTRA - 16);
+    memcpy(state->config + CONFIG_USER_EXTRA, config + CONFIG_USER_EXTRA, 2);
+    memcpy(state->config + CONFIG_SLOT_LOCKED, config + CONFIG_SLOT_LOCKED,
+           ATECC608A_EMU_CONFIG_SIZE - CONFIG_SLOT_LOCKED);
+    state->config[CONFIG_LOCK_CONFIG] = 0x00;
+    atecc608a_emu_snapshot(&emu, &fixtures[ATECC608A_EMU_CONFIG_LOCKED]);
+
+    /* Keys go in before the data zone lock, which WriteConfig no longer
+     * restricts. */
+    for (uint16_t slot = 0; slot < 16; slot++) {
+        if (is_private(state, slot) && is_p256(state, slot) &&
+                genkey_command(&emu, 0x04, slot) != STATUS_SUCCESS) {
+            return PSA_ERROR_HARDWARE_FAILURE;
+        }
+    }
+    state->config[CONFIG_LOCK_VALUE] = 0x00;
+    atecc608a_emu_snapshot(&emu, &fixtures[ATECC608A_EMU_LOCKED]);
+    fixtures_built = true;
+    return PSA_SUCCESS;
+}
+
+psa_status_t atecc608a_emu_load_fixture(atecc608a_emu_t *emu,
+                                        atecc608a_emu_fixture_t fixture)
+{
+    if (!fixtures_built) {
+        return PSA_ERROR_BAD_STATE;
+    }
+    if (fixture >= ATECC608A_EMU_FIXTURE_COUNT) {
+        return PSA_ERROR_INVALID_ARGUMENT;
+    }
+    atecc608a_emu_restore(emu, &fixtures[fixture]);
+    return PSA_SUCCESS;
+}
+
+const char *atecc608a_emu_fixture_name(atecc608a_emu_fixture_t fixture)
+{
+    switch (fixture) {
+        case ATECC608A_EMU_FACTORY:
+            return "factory";
+        case ATECC608A_EMU_CONFIG_LOCKED:
+            return "config_locked";
+        case ATECC608A_EMU_LOCKED:
+            return "locked";
+        default:
+            return "unknown";
+    }
+}
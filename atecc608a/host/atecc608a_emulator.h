@@ -0,0 +1,153 @@
+/**
+ * \file atecc608a_emulator.h
+ * \brief Emulated ATECC608A for host builds, with state snapshots and
+ *        ready-made fixture states.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_EMULATOR_H
+#define ATECC608A_EMULATOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "psa/crypto.h"
+
+/** The emulator executes the commands cryptoauthlib sends over I2C: Read,
+ *  Write, Lock, UpdateExtra, Random, Nonce (random and pass-through),
+ *  GenKey (private and public), Sign (external), Verify (stored and
+ *  external), SHA (start, update, end, and HMAC keyed with TempKey), ECDH
+ *  (clear output or into TempKey), Counter and Info. It enforces the zone
+ *  locks, slot locks, IsSecret, the Write rules of WriteConfig and the key
+ *  type of KeyConfig; encrypted reads and writes, the MAC commands and
+ *  limited use keys are not emulated. Commands take no time, see
+ *  atecc608a_bus.h for the time a device would take. It is built into host
+ *  builds with BACKEND=emulator, see host/Makefile. */
+
+#define ATECC608A_EMU_CONFIG_SIZE 128
+#define ATECC608A_EMU_OTP_SIZE 64
+/** Slots 0-7 hold 36 bytes, slot 8 416 bytes and slots 9-15 72 bytes. */
+#define ATECC608A_EMU_DATA_SIZE (8 * 36 + 416 + 7 * 72)
+#define ATECC608A_EMU_RESPONSE_SIZE 75
+
+/** Everything the device keeps, in EEPROM and in volatile memory: what a
+ *  snapshot holds. */
+typedef struct {
+    uint8_t config[ATECC608A_EMU_CONFIG_SIZE];
+    uint8_t otp[ATECC608A_EMU_OTP_SIZE];
+    /** Private keys are kept in the first 32 bytes of their slot. */
+    uint8_t data[ATECC608A_EMU_DATA_SIZE];
+    uint32_t counters[2];
+    uint8_t tempkey[64];
+    /** ATECC608A_EMU_TEMPKEY_* flags. */
+    uint8_t tempkey_flags;
+    /** Random numbers are SHA-256(seed, counter), so that a restored state
+     *  also replays the same random numbers and generated keys. */
+    uint8_t rng_seed[32];
+    uint64_t rng_counter;
+    /** Context of the SHA command between its start and end. */
+    uint32_t sha_state[8];
+    uint64_t sha_length;
+    uint8_t sha_active;
+} atecc608a_emu_state_t;
+
+#define ATECC608A_EMU_TEMPKEY_VALID 0x01
+/** TempKey was loaded by a pass-through Nonce rather than a random one. */
+#define ATECC608A_EMU_TEMPKEY_EXTERNAL 0x02
+
+/** Size of a serialized state in a snapshot file, without its header. */
+#define ATECC608A_EMU_SNAPSHOT_SIZE \
+    (ATECC608A_EMU_CONFIG_SIZE + ATECC608A_EMU_OTP_SIZE + \
+     ATECC608A_EMU_DATA_SIZE + 2 * 4 + 64 + 1 + 32 + 8 + 8 * 4 + 8 + 1)
+
+typedef struct {
+    /** The state commands work on: `storage`, or state kept elsewhere, e.g.
+     *  a record of a fleet file. */
+    atecc608a_emu_state_t *state;
+    atecc608a_emu_state_t storage;
+    /* Bus state, not part of snapshots. */
+    bool awake;
+    uint8_t response[ATECC608A_EMU_RESPONSE_SIZE];
+    size_t response_length;
+    /** Commands executed since the emulator was reset. */
+    uint32_t commands;
+} atecc608a_emu_t;
+
+typedef enum {
+    /** Nothing locked, a factory default configuration. */
+    ATECC608A_EMU_FACTORY,
+    /** The configuration given to atecc608a_emu_build_fixtures() written
+     *  and locked. */
+    ATECC608A_EMU_CONFIG_LOCKED,
+    /** The data zone locked too, and a key generated in every private P-256
+     *  key slot. */
+    ATECC608A_EMU_LOCKED,
+    ATECC608A_EMU_FIXTURE_COUNT,
+} atecc608a_emu_fixture_t;
+
+/** Put `emu` in the factory state of device number `id`, in its own
+ *  storage. Either this or atecc608a_emu_attach() comes first. */
+void atecc608a_emu_reset(atecc608a_emu_t *emu, uint32_t id);
+
+/** Make `emu` work on `state` from now on, with its bus state reset. */
+void atecc608a_emu_attach(atecc608a_emu_t *emu, atecc608a_emu_state_t *state);
+
+/** Set the serial number and random seed of device number `id`, and restart
+ *  its random numbers. Keys already in the data zone stay. */
+void atecc608a_emu_personalize(atecc608a_emu_t *emu, uint32_t id);
+
+/** Execute one command packet - count, opcode, parameters, data and CRC -
+ *  and leave its response in `emu->response`. Returns the status byte of
+ *  the response, 0 on success. */
+uint8_t atecc608a_emu_execute(atecc608a_emu_t *emu, const uint8_t *packet,
+                              size_t length);
+
+/** Device the cryptoauthlib HAL of host builds talks to, may be NULL. */
+void atecc608a_emu_select(atecc608a_emu_t *emu);
+atecc608a_emu_t *atecc608a_emu_selected(void);
+
+/** Copy the state out of or back into a device: a memcpy of
+ *  sizeof(atecc608a_emu_state_t) bytes. The bus state is reset, as after
+ *  a power cycle. */
+void atecc608a_emu_snapshot(const atecc608a_emu_t *emu,
+                            atecc608a_emu_state_t *snapshot);
+void atecc608a_emu_restore(atecc608a_emu_t *emu,
+                           const atecc608a_emu_state_t *snapshot);
+
+/** Write the state to, or read it from, a snapshot file: a magic, a
+ *  version, ATECC608A_EMU_SNAPSHOT_SIZE bytes in a fixed little-endian
+ *  layout and a CRC-16. Loading a file that is not a valid snapshot fails
+ *  with PSA_ERROR_INVALID_ARGUMENT and leaves the device as it was. */
+psa_status_t atecc608a_emu_save(const atecc608a_emu_t *emu, const char *path);
+psa_status_t atecc608a_emu_load(atecc608a_emu_t *emu, const char *path);
+
+/** Build every fixture once, from a factory state, with `config`, a 128
+ *  byte config zone image of which the first 16 bytes are ignored. */
+psa_status_t atecc608a_emu_build_fixtures(const uint8_t *config,
+                                          size_t config_size);
+
+/** Restore a fixture into `emu`. Fails with PSA_ERROR_BAD_STATE if the
+ *  fixtures were not built. */
+psa_status_t atecc608a_emu_load_fixture(atecc608a_emu_t *emu,
+                                        atecc608a_emu_fixture_t fixture);
+
+const char *atecc608a_emu_fixture_name(atecc608a_emu_fixture_t fixture);
+
+#endif /* ATECC608A_EMULATOR_H */
@@ -0,0 +1,384 @@
+/**
+ * \file atecc608a_emulator_commands.c
+ * \brief Console commands of the emulated device: fixtures, snapshots, fleets
+ *        and the bus timing model.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include "atecc608a_emulator_commands.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "atecc608a_bench_commands.h"
+#include "atecc608a_bus.h"
+#include "atecc608a_fleet.h"
+#include "atecc608a_stats.h"
+#include "atecc608a_tests.h"
+#include "atecc608a_utils.h"
+
+/* The device the tests and commands use. */
+static atecc608a_emu_t emulated_device;
+
+/* Restore the fixture called `name` and print how long the restore took,
+ * the host state reload aside. */
+static void restore_fixture_command(const char *name)
+{
+    for (int i = 0; i < ATECC608A_EMU_FIXTURE_COUNT; i++) {
+        atecc608a_emu_fixture_t fixture = (atecc608a_emu_fixture_t) i;
+        uint64_t start;
+        uint32_t us;
+
+        if (strcmp(name, atecc608a_emu_fixture_name(fixture)) != 0) {
+            continue;
+        }
+        start = atecc608a_time_us();
+        if (atecc608a_emu_load_fixture(atecc608a_emu_selected(),
+                                       fixture) != PSA_SUCCESS) {
+            printf("Fixtures were not built.\n");
+            return;
+        }
+        us = (uint32_t)(atecc608a_time_us() - start);
+        reload_host_state();
+        printf("Fixture \'%s\' restored in %lu us.\n", name,
+               (unsigned long) us);
+        return;
+    }
+    printf("Unknown fixture \'%s\'.\n", name);
+}
+
+#ifndef ATECC608A_FLEET_PATH
+#define ATECC608A_FLEET_PATH "atecc608a_fleet.bin"
+#endif
+
+/* Devices created between two evictions. */
+#define FLEET_CREATE_CHUNK 4096
+
+static void print_fleet_memory(const char *when,
+                               const atecc608a_fleet_t *fleet)
+{
+    printf("  - resident %s: %lu KiB of %lu KiB mapped\n", when,
+           (unsigned long)(atecc608a_fleet_resident_bytes(fleet) / 1024),
+           (unsigned long)(fleet->map_size / 1024));
+}
+
+/* Create `devices` devices in the fleet file, then send `requests` random
+ * requests through cryptoauthlib, each to a device picked among the first
+ * `active`. The device lock is held throughout, the HAL talks to whichever
+ * device is selected. */
+static void fleet_command(uint32_t devices, uint32_t active, uint32_t requests)
+{
+    static atecc608a_emu_t fleet_device;
+    atecc608a_fleet_t fleet;
+    uint8_t random[32];
+    uint32_t rng_state = 0x2545F491;
+    uint32_t created = 0;
+    uint32_t failures = 0;
+    uint64_t start;
+    uint64_t us;
+    psa_status_t status;
+
+    if (devices == 0 || active == 0 || active > devices) {
+        printf("Give at least one device, and at most as many active ones.\n");
+        return;
+    }
+    status = atecc608a_fleet_open(&fleet, ATECC608A_FLEET_PATH, devices);
+    if (status != PSA_SUCCESS) {
+        printf("Failed to open %s. Error %ld.\n", ATECC608A_FLEET_PATH,
+               (long) status);
+        return;
+    }
+    printf("Fleet %s: %lu devices created before, records of %lu bytes.\n",
+           ATECC608A_FLEET_PATH, (unsigned long) atecc608a_fleet_created(&fleet),
+           (unsigned long) ATECC608A_FLEET_RECORD_SIZE);
+
+    /* Created devices are written out and dropped chunk by chunk, so
+     * creating many only takes the memory of one chunk. */
+    start = atecc608a_time_us();
+    for (uint32_t id = 0; id < devices; id++) {
+        if (!atecc608a_fleet_exists(&fleet, id)) {
+            status = atecc608a_fleet_create(&fleet, id, ATECC608A_EMU_LOCKED);
+            if (status != PSA_SUCCESS) {
+                printf("Failed to create device %lu. Error %ld.\n",
+                       (unsigned long) id, (long) status);
+                goto exit;
+            }
+            created++;
+        }
+        if ((id + 1) % FLEET_CREATE_CHUNK == 0 || id + 1 == devices) {
+            atecc608a_fleet_evict(&fleet, id / FLEET_CREATE_CHUNK * FLEET_CREATE_CHUNK,
+                                  FLEET_CREATE_CHUNK);
+        }
+    }
+    us = atecc608a_time_us() - start;
+    if (created == 0) {
+        printf("  - all devices existed, remove %s to measure creation\n",
+               ATECC608A_FLEET_PATH);
+    } else {
+        /* With the evictions, which are part of creating many. */
+        printf("  - created %lu devices in ", (unsigned long) created);
+        print_ms(us);
+        printf(", %lu instances/s\n",
+               (unsigned long)(us == 0 ? 0 : created * 1000000ULL / us));
+    }
+    print_fleet_memory("after creation", &fleet);
+
+    atecc608a_device_lock();
+    start = atecc608a_time_us();
+    for (uint32_t i = 0; i < requests; i++) {
+        uint32_t id;
+
+        rng_state ^= rng_state << 13;
+        rng_state ^= rng_state >> 17;
+        rng_state ^= rng_state << 5;
+        id = rng_state % active;
+
+        atecc608a_fleet_attach(&fleet, id, &fleet_device);
+        atecc608a_emu_select(&fleet_device);
+        if (atecc608a_random_32_bytes(random, sizeof(random)) != PSA_SUCCESS) {
+            failures++;
+        }
+        atecc608a_fleet_detach(&fleet, id, &fleet_device);
+    }
+    us = atecc608a_time_us() - start;
+    atecc608a_emu_select(&emulated_device);
+    atecc608a_device_unlock();
+
+    printf("  - %lu random requests to %lu active devices in ",
+           (unsigned long) requests, (unsigned long) active);
+    print_ms(us);
+    printf(", %lu requests/s, %lu failed\n",
+           (unsigned long)(us == 0 ? 0 : requests * 1000000ULL / us),
+           (unsigned long) failures);
+    print_fleet_memory("after the requests", &fleet);
+    printf("  - %lu bytes resident per active device, records of %lu bytes\n",
+           (unsigned long)(atecc608a_fleet_resident_bytes(&fleet) / active),
+           (unsigned long) ATECC608A_FLEET_RECORD_SIZE);
+
+exit:
+    atecc608a_fleet_close(&fleet);
+}
+
+static const uint32_t bus_sweep_hz[] = { 100000, 400000, 1000000 };
+
+#define BUS_SWEEP_SPEEDS (sizeof(bus_sweep_hz) / sizeof(bus_sweep_hz[0]))
+
+typedef struct {
+    const char *name;
+    bool failed;
+    atecc608a_bus_stats_t stats[BUS_SWEEP_SPEEDS];
+} bus_sweep_row_t;
+
+/* Bus-bound operations spend more time clocking bytes than the device spends
+ * executing and waking up. */
+static void print_bus_sweep_row(const bus_sweep_row_t *row)
+{
+    const atecc608a_bus_stats_t *slowest = &row->stats[0];
+    const atecc608a_bus_stats_t *fastest = &row->stats[BUS_SWEEP_SPEEDS - 1];
+
+    printf("  %-26s", row->name);
+    for (size_t i = 0; i < BUS_SWEEP_SPEEDS; i++) {
+        const atecc608a_bus_stats_t *stats = &row->stats[i];
+
+        printf(" %9lu (%2lu%%)", (unsigned long) stats->total_us,
+               (unsigned long)(stats->total_us == 0 ? 0 :
+                               stats->transfer_us * 100 / stats->total_us));
+    }
+    if (row->failed) {
+        printf(" | failed\n");
+    } else if (slowest->total_us == 0) {
+        printf(" | no device\n");
+    } else {
+        printf(" | %-4s %3lu%%\n",
+               slowest->transfer_us > slowest->execute_us + slowest->wake_us ?
+               "bus" : "chip",
+               (unsigned long)(100 - fastest->total_us * 100 /
+                               slowest->total_us));
+    }
+}
+
+/* Run the tests, then one round of every benchmark of a device operation, at
+ * each bus speed, and print the modelled time of each. */
+static void bus_sweep_command(void)
+{
+    bus_sweep_row_t *rows = calloc(test_step_count + bench_step_count,
+                                   sizeof(*rows));
+    atecc608a_bus_config_t saved = *atecc608a_bus_config();
+    atecc608a_bus_config_t config;
+    size_t row_count = 0;
+
+    if (rows == NULL) {
+        printf("Out of memory.\n");
+        return;
+    }
+    for (size_t speed = 0; speed < BUS_SWEEP_SPEEDS; speed++) {
+        size_t row = 0;
+
+        atecc608a_bus_default_config(&config, bus_sweep_hz[speed]);
+        atecc608a_bus_configure(&config);
+        for (size_t i = 0; i < test_step_count; i++, row++) {
+            atecc608a_bus_reset_stats();
+            rows[row].name = test_steps[i]->name;
+            rows[row].failed = run_test_step(test_steps[i]) != PSA_SUCCESS;
+            atecc608a_bus_get_stats(&rows[row].stats[speed]);
+        }
+        /* The benchmarks run in table order from a locked device. */
+        (void) atecc608a_emu_load_fixture(atecc608a_emu_selected(),
+                                          ATECC608A_EMU_LOCKED);
+        reload_host_state();
+        for (size_t i = 0; i < bench_step_count; i++) {
+            if (bench_steps[i].op == ATECC608A_COST_OP_COUNT) {
+                continue;
+            }
+            atecc608a_bus_reset_stats();
+            rows[row].name = bench_steps[i].name;
+            rows[row].failed = bench_steps[i].run() != PSA_SUCCESS;
+            atecc608a_bus_get_stats(&rows[row].stats[speed]);
+            row++;
+        }
+        row_count = row;
+    }
+    atecc608a_bus_configure(&saved);
+
+    printf("Modelled time in us (share clocking bytes), bound at %lu Hz, "
+           "time saved at %lu Hz:\n", (unsigned long) bus_sweep_hz[0],
+           (unsigned long) bus_sweep_hz[BUS_SWEEP_SPEEDS - 1]);
+    printf("  %-26s", "operation");
+    for (size_t i = 0; i < BUS_SWEEP_SPEEDS; i++) {
+        printf(" %9lu kHz  ", (unsigned long)(bus_sweep_hz[i] / 1000));
+    }
+    printf(" |\n");
+    for (size_t i = 0; i < row_count; i++) {
+        print_bus_sweep_row(&rows[i]);
+    }
+    free(rows);
+}
+
+psa_status_t start_emulated_device()
+{
+    psa_status_t status = PSA_ERROR_GENERIC_ERROR;
+
+    /* The fixture keys are made with PSA crypto. Start from a fully locked
+     * device. */
+    ASSERT_SUCCESS_PSA(psa_crypto_init());
+    ASSERT_SUCCESS_PSA(atecc608a_emu_build_fixtures(template_config_508a_dev,
+                                                    sizeof(template_config_508a_dev)));
+    atecc608a_emu_reset(&emulated_device, 0);
+    atecc608a_emu_select(&emulated_device);
+    ASSERT_SUCCESS_PSA(atecc608a_emu_load_fixture(&emulated_device,
+                                                  ATECC608A_EMU_LOCKED));
+
+exit:
+    return status;
+}
+
+static bool run_emulator_command(char *command, char *arg)
+{
+    if (strncmp(command, "fixture=", strlen("fixture=")) == 0) {
+        restore_fixture_command(arg + 1);
+    } else if (strncmp(command, "bus_clock=", strlen("bus_clock=")) == 0) {
+        atecc608a_bus_config_t config;
+
+        atecc608a_bus_default_config(&config, (uint32_t) atoi(arg + 1));
+        atecc608a_bus_configure(&config);
+        atecc608a_bus_reset_stats();
+        if (config.clock_hz == 0) {
+            printf("Bus timing is off.\n");
+        } else {
+            printf("Bus timing modelled at %lu Hz.\n",
+                   (unsigned long) config.clock_hz);
+        }
+    } else if (strcmp(command, "bus") == 0) {
+        atecc608a_bus_stats_t stats;
+
+        atecc608a_bus_get_stats(&stats);
+        printf("Bus at %lu Hz: %lu us, of which %lu us transfers (%lu frames, "
+               "%lu bytes), %lu us waking up (%lu wakes), %lu us executing, "
+               "%lu address polls\n",
+               (unsigned long) atecc608a_bus_config()->clock_hz,
+               (unsigned long) stats.total_us,
+               (unsigned long) stats.transfer_us, (unsigned long) stats.frames,
+               (unsigned long) stats.bytes, (unsigned long) stats.wake_us,
+               (unsigned long) stats.wakes, (unsigned long) stats.execute_us,
+               (unsigned long) stats.polls);
+    } else if (strcmp(command, "bus_sweep") == 0) {
+        if (!job_busy()) {
+            bus_sweep_command();
+        }
+    } else if (strncmp(command, "fleet=", strlen("fleet=")) == 0) {
+        const char *active = strchr(arg, '_');
+        const char *requests = active != NULL ? strchr(active + 1, '_') : NULL;
+
+        if (requests == NULL) {
+            printf("Please specify devices, active devices and requests.\n");
+        } else if (!job_busy()) {
+            fleet_command((uint32_t) atoi(arg + 1), (uint32_t) atoi(active + 1),
+                          (uint32_t) atoi(requests + 1));
+        }
+    } else if (strncmp(command, "snapshot_save=", strlen("snapshot_save=")) == 0) {
+        psa_status_t status = atecc608a_emu_save(atecc608a_emu_selected(),
+                                                 arg + 1);
+
+        if (status == PSA_SUCCESS) {
+            printf("Saved %lu bytes of device state to %s.\n",
+                   (unsigned long) ATECC608A_EMU_SNAPSHOT_SIZE, arg + 1);
+        } else {
+            printf("Failed to save the device state. Error %ld.\n",
+                   (long) status);
+        }
+    } else if (strncmp(command, "snapshot_load=", strlen("snapshot_load=")) == 0) {
+        psa_status_t status = atecc608a_emu_load(atecc608a_emu_selected(),
+                                                 arg + 1);
+
+        if (status == PSA_SUCCESS) {
+            reload_host_state();
+            printf("Device state restored from %s.\n", arg + 1);
+        } else {
+            printf("Failed to load the device state. Error %ld.\n",
+                   (long) status);
+        }
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static const char *const emulator_host_commands[] = {
+    "bus", "bus_clock=", NULL,
+};
+
+/* The emulator commands are not estimated: they replace the device, or
+ * only use the host. */
+const command_module_t emulator_commands = {
+    " - fixture=factory|config_locked|locked - restore the emulated device\n"
+    "                                          to a fixture state;\n"
+    " - snapshot_save=%s - save the emulated device state to a file;\n"
+    " - snapshot_load=%s - restore the emulated device state from a file;\n"
+    " - fleet=%d_%d_%d - create a number of emulated devices (first\n"
+    "                     argument) in the fleet file, then send a number\n"
+    "                     of random requests (third argument) to devices\n"
+    "                     picked among the first ones (second argument),\n"
+    "                     print instances and requests per second;\n"
+    " - bus_clock=%d - model the I2C bus timing at a given clock rate in\n"
+    "                 Hz, 0 - commands take no time;\n"
+    " - bus - print the modelled bus time since the last bus_clock;\n"
+    " - bus_sweep - run the tests and benchmarks at 100 kHz, 400 kHz and\n"
+    "               1 MHz, print the modelled time of each and whether it\n"
+    "               is bound by the bus or by the device;\n",
+    emulator_host_commands, run_emulator_command, NULL,
+};
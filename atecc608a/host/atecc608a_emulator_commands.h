@@ -0,0 +1,37 @@
+/**
+ * \file atecc608a_emulator_commands.h
+ * \brief Console commands of the emulated device: fixtures, snapshots, fleets
+ *        and the bus timing model.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_EMULATOR_COMMANDS_H
+#define ATECC608A_EMULATOR_COMMANDS_H
+
+#include "atecc608a_app.h"
+
+/** fixture, snapshot_save, snapshot_load, fleet, bus_clock, bus and
+ *  bus_sweep. */
+extern const command_module_t emulator_commands;
+
+/** Build the fixtures and select an emulated device in the fully locked
+ *  fixture state, for the tests and commands to use. */
+psa_status_t start_emulated_device(void);
+
+#endif /* ATECC608A_EMULATOR_COMMANDS_H */
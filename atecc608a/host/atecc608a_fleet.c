@@ -0,0 +1,243 @@
+/**
+ * \file atecc608a_fleet.c
+ * \brief Emulated devices by the thousand, their states kept in one
+ *        memory-mapped file.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#define _GNU_SOURCE
+#include "atecc608a_fleet.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FLEET_MAGIC "AFLT"
+#define FLEET_VERSION 1
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t capacity;
+    uint32_t created;
+} fleet_header_t;
+
+static fleet_header_t *header_of(const atecc608a_fleet_t *fleet)
+{
+    return (fleet_header_t *) fleet->map;
+}
+
+static atecc608a_fleet_record_t *record_of(const atecc608a_fleet_t *fleet,
+                                           uint32_t id)
+{
+    return (atecc608a_fleet_record_t *)(fleet->map + ATECC608A_FLEET_HEADER_SIZE +
+                                        (size_t) id * ATECC608A_FLEET_RECORD_SIZE);
+}
+
+static size_t file_size_of(uint32_t capacity)
+{
+    return ATECC608A_FLEET_HEADER_SIZE +
+           (size_t) capacity * ATECC608A_FLEET_RECORD_SIZE;
+}
+
+psa_status_t atecc608a_fleet_open(atecc608a_fleet_t *fleet, const char *path,
+                                  uint32_t capacity)
+{
+    fleet_header_t header;
+    struct stat info;
+    ssize_t length;
+    bool fresh;
+
+    fleet->map = NULL;
+    fleet->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fleet->fd < 0) {
+        return PSA_ERROR_STORAGE_FAILURE;
+    }
+    if (fstat(fleet->fd, &info) != 0) {
+        goto storage_failure;
+    }
+
+    fresh = info.st_size == 0;
+    if (fresh) {
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, FLEET_MAGIC, sizeof(header.magic));
+        header.version = FLEET_VERSION;
+        header.record_size = ATECC608A_FLEET_RECORD_SIZE;
+    } else {
+        length = pread(fleet->fd, &header, sizeof(header), 0);
+        if (length != (ssize_t) sizeof(header) ||
+                memcmp(header.magic, FLEET_MAGIC, sizeof(header.magic)) != 0 ||
+                header.version != FLEET_VERSION ||
+                header.record_size != ATECC608A_FLEET_RECORD_SIZE ||
+                (size_t) info.st_size < file_size_of(header.capacity)) {
+            close(fleet->fd);
+            return PSA_ERROR_INVALID_ARGUMENT;
+        }
+    }
+
+    /* Growing only extends the hole at the end of the file. */
+    if (fresh || capacity > header.capacity) {
+        header.capacity = capacity;
+        if (ftruncate(fleet->fd, (off_t) file_size_of(capacity)) != 0 ||
+                pwrite(fleet->fd, &header, sizeof(header), 0) !=
+                (ssize_t) sizeof(header)) {
+            goto storage_failure;
+        }
+    }
+
+    fleet->capacity = header.capacity;
+    fleet->map_size = file_size_of(header.capacity);
+    fleet->map = mmap(NULL, fleet->map_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED, fleet->fd, 0);
+    if (fleet->map == MAP_FAILED) {
+        fleet->map = NULL;
+        goto storage_failure;
+    }
+    /* Devices are picked at random, reading ahead would page in devices
+     * nobody uses. */
+    (void) madvise(fleet->map, fleet->map_size, MADV_RANDOM);
+    return PSA_SUCCESS;
+
+storage_failure:
+    close(fleet->fd);
+    return PSA_ERROR_STORAGE_FAILURE;
+}
+
+void atecc608a_fleet_close(atecc608a_fleet_t *fleet)
+{
+    if (fleet->map != NULL) {
+        (void) msync(fleet->map, fleet->map_size, MS_SYNC);
+        (void) munmap(fleet->map, fleet->map_size);
+        fleet->map = NULL;
+    }
+    close(fleet->fd);
+}
+
+uint32_t atecc608a_fleet_created(const atecc608a_fleet_t *fleet)
+{
+    return header_of(fleet)->created;
+}
+
+bool atecc608a_fleet_exists(const atecc608a_fleet_t *fleet, uint32_t id)
+{
+    return id < fleet->capacity &&
+           record_of(fleet, id)->magic == ATECC608A_FLEET_RECORD_MAGIC;
+}
+
+psa_status_t atecc608a_fleet_create(atecc608a_fleet_t *fleet, uint32_t id,
+                                    atecc608a_emu_fixture_t fixture)
+{
+    atecc608a_fleet_record_t *record;
+    atecc608a_emu_t emu;
+    psa_status_t status;
+
+    if (id >= fleet->capacity) {
+        return PSA_ERROR_INVALID_ARGUMENT;
+    }
+    if (atecc608a_fleet_exists(fleet, id)) {
+        return PSA_ERROR_ALREADY_EXISTS;
+    }
+
+    record = record_of(fleet, id);
+    atecc608a_emu_attach(&emu, &record->state);
+    status = atecc608a_emu_load_fixture(&emu, fixture);
+    if (status != PSA_SUCCESS) {
+        return status;
+    }
+    atecc608a_emu_personalize(&emu, id);
+    record->id = id;
+    record->commands = 0;
+    /* Last, so that a record is only ever seen complete. */
+    record->magic = ATECC608A_FLEET_RECORD_MAGIC;
+    header_of(fleet)->created++;
+    return PSA_SUCCESS;
+}
+
+psa_status_t atecc608a_fleet_attach(atecc608a_fleet_t *fleet, uint32_t id,
+                                    atecc608a_emu_t *emu)
+{
+    if (!atecc608a_fleet_exists(fleet, id)) {
+        return PSA_ERROR_DOES_NOT_EXIST;
+    }
+    atecc608a_emu_attach(emu, &record_of(fleet, id)->state);
+    emu->commands = 0;
+    return PSA_SUCCESS;
+}
+
+void atecc608a_fleet_detach(atecc608a_fleet_t *fleet, uint32_t id,
+                            atecc608a_emu_t *emu)
+{
+    record_of(fleet, id)->commands += emu->commands;
+    emu->commands = 0;
+}
+
+void atecc608a_fleet_evict(atecc608a_fleet_t *fleet, uint32_t first,
+                           uint32_t count)
+{
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    size_t start;
+    size_t end;
+
+    if (first >= fleet->capacity || count == 0) {
+        return;
+    }
+    if (count > fleet->capacity - first) {
+        count = fleet->capacity - first;
+    }
+    start = (size_t)((uint8_t *) record_of(fleet, first) - fleet->map);
+    end = start + (size_t) count * ATECC608A_FLEET_RECORD_SIZE;
+    start = start / page * page;
+    end = (end + page - 1) / page * page;
+    if (end > fleet->map_size) {
+        end = fleet->map_size;
+    }
+
+    (void) msync(fleet->map + start, end - start, MS_SYNC);
+    (void) madvise(fleet->map + start, end - start, MADV_DONTNEED);
+    (void) posix_fadvise(fleet->fd, (off_t) start, (off_t)(end - start),
+                         POSIX_FADV_DONTNEED);
+}
+
+size_t atecc608a_fleet_resident_bytes(const atecc608a_fleet_t *fleet)
+{
+    static unsigned char pages[4096];
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    size_t resident = 0;
+
+    /* A chunk of pages at a time, to keep the vector small. */
+    for (size_t offset = 0; offset < fleet->map_size;
+            offset += sizeof(pages) * page) {
+        size_t length = fleet->map_size - offset;
+        size_t count;
+
+        if (length > sizeof(pages) * page) {
+            length = sizeof(pages) * page;
+        }
+        count = (length + page - 1) / page;
+        if (mincore(fleet->map + offset, length, pages) != 0) {
+            return 0;
+        }
+        for (size_t i = 0; i < count; i++) {
+            resident += pages[i] & 1;
+        }
+    }
+    return resident * page;
+}
@@ -0,0 +1,112 @@
+/**
+ * \file atecc608a_fleet.h
+ * \brief Emulated devices by the thousand, their states kept in one
+ *        memory-mapped file.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_FLEET_H
+#define ATECC608A_FLEET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "psa/crypto.h"
+#include "atecc608a_emulator.h"
+
+/** The file is a one page header followed by one fixed size record per
+ *  device, indexed by device number. It is sparse: records of devices never
+ *  created take no disk space. The mapping is only paged in where devices
+ *  are used, so the memory a fleet takes follows the devices that are
+ *  active, not its capacity. Emulators attach to their record and run on
+ *  it in place; the state persists across runs.
+ *
+ *  Records hold atecc608a_emu_state_t as laid out in memory, so a file is
+ *  only opened by builds with the same record size. */
+
+#define ATECC608A_FLEET_HEADER_SIZE 4096
+
+typedef struct {
+    /** ATECC608A_FLEET_RECORD_MAGIC once the device was created. */
+    uint32_t magic;
+    uint32_t id;
+    /** Commands executed on the device, over all runs. */
+    uint64_t commands;
+    atecc608a_emu_state_t state;
+} atecc608a_fleet_record_t;
+
+#define ATECC608A_FLEET_RECORD_MAGIC 0x31564544
+
+/** Records are cache line aligned. */
+#define ATECC608A_FLEET_RECORD_SIZE \
+    ((sizeof(atecc608a_fleet_record_t) + 63) / 64 * 64)
+
+typedef struct {
+    int fd;
+    uint8_t *map;
+    size_t map_size;
+    uint32_t capacity;
+} atecc608a_fleet_t;
+
+/** Open or create the fleet file at `path`, with room for at least
+ *  `capacity` devices. An existing file grows to `capacity` if it is
+ *  smaller. Fails with PSA_ERROR_INVALID_ARGUMENT for a file that is not a
+ *  fleet of this build, and PSA_ERROR_STORAGE_FAILURE if it cannot be
+ *  opened or mapped. */
+psa_status_t atecc608a_fleet_open(atecc608a_fleet_t *fleet, const char *path,
+                                  uint32_t capacity);
+
+/** Write the fleet back to its file and unmap it. */
+void atecc608a_fleet_close(atecc608a_fleet_t *fleet);
+
+/** Devices created so far, over all runs. */
+uint32_t atecc608a_fleet_created(const atecc608a_fleet_t *fleet);
+
+bool atecc608a_fleet_exists(const atecc608a_fleet_t *fleet, uint32_t id);
+
+/** Create device number `id` from a fixture, with its own serial number and
+ *  random seed. Keys that come with the fixture are the same on every
+ *  device; keys generated later are not. Fails with
+ *  PSA_ERROR_ALREADY_EXISTS if the device exists. */
+psa_status_t atecc608a_fleet_create(atecc608a_fleet_t *fleet, uint32_t id,
+                                    atecc608a_emu_fixture_t fixture);
+
+/** Make `emu` run on the record of device `id`, and count its commands
+ *  there from now on. Its record is paged in on first use. Fails with
+ *  PSA_ERROR_DOES_NOT_EXIST if the device was not created. */
+psa_status_t atecc608a_fleet_attach(atecc608a_fleet_t *fleet, uint32_t id,
+                                    atecc608a_emu_t *emu);
+
+/** Write `emu` back from device `id` after atecc608a_fleet_attach(): its
+ *  command count goes to the record. */
+void atecc608a_fleet_detach(atecc608a_fleet_t *fleet, uint32_t id,
+                            atecc608a_emu_t *emu);
+
+/** Write the records of devices `first` to `first + count - 1` to the file
+ *  and drop their pages from memory, and from the page cache. Pages shared
+ *  with the devices next to them are dropped too, and paged in again on
+ *  their next use. */
+void atecc608a_fleet_evict(atecc608a_fleet_t *fleet, uint32_t first,
+                           uint32_t count);
+
+/** Bytes of the mapping in memory right now. */
+size_t atecc608a_fleet_resident_bytes(const atecc608a_fleet_t *fleet);
+
+#endif /* ATECC608A_FLEET_H */
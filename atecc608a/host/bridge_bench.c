@@ -0,0 +1,383 @@
+/**
+ * \file bridge_bench.c
+ * \brief Throughput and latency of the serial bridge, against a relay on a
+ *        pseudo terminal.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include <errno.h>
+#include <pty.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "atecc608a_backend.h"
+#include "atecc608a_bridge.h"
+#include "atecc608a_stats.h"
+#include "cmsis_os2.h"
+
+/* Usage: bridge_bench [commands [latency_us [baud [execution_us]]]]
+ *
+ * The relay runs in a thread on the other end of a pseudo terminal, in
+ * front of a device that takes `execution_us` per command. The link delays
+ * each chunk of bytes by `latency_us` one way, about the 1 ms frames of a
+ * USB serial port, and by their time on the wire at `baud`, if not 0. Each
+ * command is a wake, a send, a receive and an idle, as the driver does,
+ * with the backend of hal_serial.c over several windows. */
+
+#define COMMAND_SIZE 40
+#define RESPONSE_SIZE 35
+#define QUEUE_SIZE 64
+
+static uint32_t latency_us = 1000;
+static uint32_t baud;
+static uint32_t execution_us = 1000;
+
+static void sleep_until(uint64_t due)
+{
+    uint64_t now = atecc608a_time_us();
+    struct timespec ts;
+
+    if (due <= now) {
+        return;
+    }
+    ts.tv_sec = (time_t)((due - now) / 1000000);
+    ts.tv_nsec = (long)((due - now) % 1000000) * 1000;
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+/* Bytes on one direction of the link, with the time they arrive. An empty
+ * chunk closes the link. */
+typedef struct {
+    uint64_t due;
+    uint16_t length;
+    uint8_t data[ATECC608A_BRIDGE_MAX_FRAME];
+} chunk_t;
+
+typedef struct {
+    osMessageQueueId_t queue;
+    /* When the wire is free again. */
+    uint64_t busy_until;
+} wire_t;
+
+static void wire_put(wire_t *wire, const uint8_t *data, size_t length)
+{
+    chunk_t chunk;
+    uint64_t start = atecc608a_time_us();
+
+    if (start < wire->busy_until) {
+        start = wire->busy_until;
+    }
+    if (baud != 0) {
+        wire->busy_until = start + (uint64_t) length * 10 * 1000000 / baud;
+    } else {
+        wire->busy_until = start;
+    }
+    chunk.due = wire->busy_until + latency_us;
+    chunk.length = (uint16_t) length;
+    if (length > 0) {
+        memcpy(chunk.data, data, length);
+    }
+    osMessageQueuePut(wire->queue, &chunk, 0, osWaitForever);
+}
+
+typedef struct {
+    int fd;
+    wire_t to_relay;
+    wire_t to_host;
+    /* The chunk the relay is reading. */
+    chunk_t chunk;
+    size_t offset;
+} bench_link_t;
+
+static int relay_read(void *context, uint8_t *data, size_t length)
+{
+    bench_link_t *link = context;
+    size_t count;
+
+    if (link->offset == link->chunk.length) {
+        osMessageQueueGet(link->to_relay.queue, &link->chunk, NULL,
+                          osWaitForever);
+        if (link->chunk.length == 0) {
+            return -1;
+        }
+        link->offset = 0;
+        sleep_until(link->chunk.due);
+    }
+    count = link->chunk.length - link->offset;
+    if (count > length) {
+        count = length;
+    }
+    memcpy(data, link->chunk.data + link->offset, count);
+    link->offset += count;
+    return (int) count;
+}
+
+static bool relay_write(void *context, const uint8_t *data, size_t length)
+{
+    bench_link_t *link = context;
+
+    wire_put(&link->to_host, data, length);
+    return true;
+}
+
+/* Bytes from the host to the relay. */
+static void host_to_relay(void *argument)
+{
+    bench_link_t *link = argument;
+    uint8_t data[ATECC608A_BRIDGE_MAX_FRAME];
+
+    for (;;) {
+        ssize_t count = read(link->fd, data, sizeof(data));
+
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            break;
+        }
+        wire_put(&link->to_relay, data, (size_t) count);
+    }
+    wire_put(&link->to_relay, data, 0);
+}
+
+/* Bytes from the relay to the host. */
+static void relay_to_host(void *argument)
+{
+    bench_link_t *link = argument;
+    chunk_t chunk;
+
+    for (;;) {
+        osMessageQueueGet(link->to_host.queue, &chunk, NULL, osWaitForever);
+        if (chunk.length == 0) {
+            break;
+        }
+        sleep_until(chunk.due);
+        if (write(link->fd, chunk.data, chunk.length) != chunk.length) {
+            break;
+        }
+    }
+}
+
+/* A device that is busy for `execution_us` after each command, and then
+ * answers RESPONSE_SIZE bytes. */
+static uint64_t busy_until;
+
+static ATCA_STATUS device_call(void *context)
+{
+    (void) context;
+    return ATCA_SUCCESS;
+}
+
+static ATCA_STATUS device_send(void *context, const uint8_t *packet,
+                               size_t length)
+{
+    (void) context;
+    (void) packet;
+    (void) length;
+    busy_until = atecc608a_time_us() + execution_us;
+    return ATCA_SUCCESS;
+}
+
+static ATCA_STATUS device_receive(void *context, uint8_t *data,
+                                  uint16_t *length)
+{
+    (void) context;
+    if (atecc608a_time_us() < busy_until) {
+        return ATCA_RX_NO_RESPONSE;
+    }
+    if (*length < RESPONSE_SIZE) {
+        return ATCA_SMALL_BUFFER;
+    }
+    memset(data, 0x5A, RESPONSE_SIZE);
+    *length = RESPONSE_SIZE;
+    return ATCA_SUCCESS;
+}
+
+static void device_delay_us(void *context, uint32_t us)
+{
+    (void) context;
+    sleep_until(atecc608a_time_us() + us);
+}
+
+static const atecc608a_bridge_device_t device = {
+    device_call, device_call, device_call, device_send, device_receive,
+    device_delay_us, NULL,
+};
+
+static void relay(void *argument)
+{
+    bench_link_t *link = argument;
+    const atecc608a_bridge_link_t relay_link = {
+        relay_read, relay_write, link
+    };
+
+    atecc608a_relay_serve(&relay_link, &device);
+    wire_put(&link->to_host, NULL, 0);
+}
+
+typedef struct {
+    ATCA_STATUS (*wake)(void);
+    ATCA_STATUS (*send)(const uint8_t *packet, size_t length);
+    ATCA_STATUS (*receive)(uint8_t *data, uint16_t *length);
+    ATCA_STATUS (*idle)(void);
+} calls_t;
+
+/* The device in this process, for the latency without the bridge. */
+static ATCA_STATUS direct_wake(void)
+{
+    return device.wake(NULL);
+}
+
+static ATCA_STATUS direct_send(const uint8_t *packet, size_t length)
+{
+    return device.send(NULL, packet, length);
+}
+
+static ATCA_STATUS direct_receive(uint8_t *data, uint16_t *length)
+{
+    ATCA_STATUS status;
+
+    while ((status = device.receive(NULL, data, length)) ==
+            ATCA_RX_NO_RESPONSE) {
+        device.delay_us(NULL, ATECC608A_RELAY_POLL_US);
+    }
+    return status;
+}
+
+static ATCA_STATUS direct_idle(void)
+{
+    return device.idle(NULL);
+}
+
+static const calls_t direct = {
+    direct_wake, direct_send, direct_receive, direct_idle
+};
+
+static uint32_t run(const char *name, const calls_t *calls,
+                    unsigned long commands, uint32_t direct_mean)
+{
+    static atecc608a_histogram_t latency;
+    uint8_t packet[COMMAND_SIZE] = { 0 };
+    unsigned long failures = 0;
+    uint64_t start = atecc608a_time_us();
+    uint64_t elapsed;
+    uint32_t mean;
+
+    atecc608a_histogram_reset(&latency);
+    for (unsigned long i = 0; i < commands; i++) {
+        uint8_t response[RESPONSE_SIZE];
+        uint16_t length = sizeof(response);
+        uint64_t begin = atecc608a_time_us();
+
+        failures += calls->wake() != ATCA_SUCCESS;
+        failures += calls->send(packet, sizeof(packet)) != ATCA_SUCCESS;
+        failures += calls->receive(response, &length) != ATCA_SUCCESS ||
+                    length != RESPONSE_SIZE;
+        failures += calls->idle() != ATCA_SUCCESS;
+        atecc608a_histogram_record(&latency,
+                                   (uint32_t)(atecc608a_time_us() - begin));
+    }
+    elapsed = atecc608a_time_us() - start;
+    mean = atecc608a_histogram_mean(&latency);
+    printf("%-10s %8lu %10lu %10lu %10lu %10ld %8lu\n", name,
+           (unsigned long)(4 * commands * 1000000 / elapsed),
+           (unsigned long) mean,
+           (unsigned long) atecc608a_histogram_percentile(&latency, 99),
+           (unsigned long) atecc608a_histogram_percentile(&latency, 100),
+           calls == &direct ? 0 : (long) mean - (long) direct_mean, failures);
+    return mean;
+}
+
+static int run_bridge(unsigned long window, unsigned long commands,
+                      uint32_t direct_mean)
+{
+    bench_link_t *link = calloc(1, sizeof(*link));
+    struct termios tio;
+    char path[64];
+    char value[16];
+    char name[16];
+    int slave;
+    calls_t calls = {
+        atecc608a_host_backend.wake, atecc608a_host_backend.send,
+        atecc608a_host_backend.receive, atecc608a_host_backend.idle,
+    };
+
+    /* Each run has its own link: the threads of the previous one finish
+     * once the backend closes its terminal. */
+    memset(&tio, 0, sizeof(tio));
+    cfmakeraw(&tio);
+    if (link == NULL || openpty(&link->fd, &slave, path, &tio, NULL) != 0) {
+        printf("Failed to open a pseudo terminal.\n");
+        return 1;
+    }
+    link->to_relay.queue = osMessageQueueNew(QUEUE_SIZE, sizeof(chunk_t), NULL);
+    link->to_host.queue = osMessageQueueNew(QUEUE_SIZE, sizeof(chunk_t), NULL);
+    osThreadNew(host_to_relay, link, NULL);
+    osThreadNew(relay, link, NULL);
+    osThreadNew(relay_to_host, link, NULL);
+
+    setenv("ATECC608A_SERIAL", path, 1);
+    snprintf(value, sizeof(value), "%lu", window);
+    setenv("ATECC608A_SERIAL_WINDOW", value, 1);
+    if (atecc608a_host_backend.open() != ATCA_SUCCESS) {
+        return 1;
+    }
+    /* The backend keeps its own descriptor of the terminal. */
+    close(slave);
+    snprintf(name, sizeof(name), "window %lu", window);
+    run(name, &calls, commands, direct_mean);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    static const unsigned long windows[] = { 1, 2, 4, ATECC608A_BRIDGE_WINDOW };
+    unsigned long commands = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000;
+    uint32_t direct_mean;
+
+    if (argc > 2) {
+        latency_us = (uint32_t) strtoul(argv[2], NULL, 10);
+    }
+    if (argc > 3) {
+        baud = (uint32_t) strtoul(argv[3], NULL, 10);
+    }
+    if (argc > 4) {
+        execution_us = (uint32_t) strtoul(argv[4], NULL, 10);
+    }
+    if (commands == 0) {
+        commands = 1;
+    }
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    printf("%lu commands, %lu us one way, %lu baud, %lu us execution\n",
+           commands, (unsigned long) latency_us, (unsigned long) baud,
+           (unsigned long) execution_us);
+    printf("%-10s %8s %10s %10s %10s %10s %8s\n", "", "frames/s", "mean us",
+           "p99 us", "max us", "added us", "failed");
+    direct_mean = run("direct", &direct, commands, 0);
+    for (size_t i = 0; i < sizeof(windows) / sizeof(windows[0]); i++) {
+        if (run_bridge(windows[i], commands, direct_mean) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
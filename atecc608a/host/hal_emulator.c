@@ -0,0 +1,132 @@
+/**
+ * \file hal_emulator.c
+ * \brief Backend of host builds talking to the selected emulated device.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include <string.h>
+
+#include "atecc608a_backend.h"
+#include "atecc608a_bus.h"
+#include "atecc608a_emulator.h"
+#include "atecc608a_profile.h"
+
+/* main.c selects the device once it has made the fixtures. */
+static ATCA_STATUS emu_open(void)
+{
+    return ATCA_SUCCESS;
+}
+
+/* The emulator runs the command right away, the bus model charges the time
+ * a device would take. The word address byte is charged with the packet. */
+static ATCA_STATUS emu_send(const uint8_t *packet, size_t length)
+{
+    atecc608a_emu_t *emu = atecc608a_emu_selected();
+
+    if (emu == NULL || !emu->awake) {
+        return ATCA_COMM_FAIL;
+    }
+    atecc608a_bus_send(1 + length);
+    atecc608a_bus_execute(packet, length);
+    atecc608a_profile_enter(ATECC608A_LAYER_WAIT);
+    atecc608a_emu_execute(emu, packet, length);
+    atecc608a_profile_exit();
+    return ATCA_SUCCESS;
+}
+
+static ATCA_STATUS emu_receive(uint8_t *data, uint16_t *length)
+{
+    atecc608a_emu_t *emu = atecc608a_emu_selected();
+
+    if (emu == NULL || !emu->awake) {
+        return ATCA_COMM_FAIL;
+    }
+    atecc608a_bus_receive(emu->response_length);
+    if (emu->response_length == 0) {
+        return ATCA_RX_NO_RESPONSE;
+    }
+    if (emu->response_length > *length) {
+        return ATCA_SMALL_BUFFER;
+    }
+    memcpy(data, emu->response, emu->response_length);
+    *length = (uint16_t) emu->response_length;
+    emu->response_length = 0;
+    return ATCA_SUCCESS;
+}
+
+/* The wake response: count, 0x11 and its CRC. */
+static ATCA_STATUS emu_wake(void)
+{
+    static const uint8_t wake_response[4] = { 0x04, 0x11, 0x33, 0x43 };
+    atecc608a_emu_t *emu = atecc608a_emu_selected();
+
+    if (emu == NULL) {
+        return ATCA_COMM_FAIL;
+    }
+    atecc608a_bus_wake();
+    emu->awake = true;
+    memcpy(emu->response, wake_response, sizeof(wake_response));
+    emu->response_length = sizeof(wake_response);
+    return ATCA_SUCCESS;
+}
+
+static ATCA_STATUS emu_idle(void)
+{
+    atecc608a_emu_t *emu = atecc608a_emu_selected();
+
+    if (emu == NULL) {
+        return ATCA_COMM_FAIL;
+    }
+    atecc608a_bus_idle();
+    emu->awake = false;
+    emu->response_length = 0;
+    return ATCA_SUCCESS;
+}
+
+/* Sleep also loses the volatile state. */
+static ATCA_STATUS emu_sleep(void)
+{
+    atecc608a_emu_t *emu = atecc608a_emu_selected();
+
+    if (emu == NULL) {
+        return ATCA_COMM_FAIL;
+    }
+    atecc608a_bus_idle();
+    emu->awake = false;
+    emu->response_length = 0;
+    emu->state->tempkey_flags = 0;
+    emu->state->sha_active = 0;
+    return ATCA_SUCCESS;
+}
+
+/* Delays only advance the modelled bus clock. */
+static void emu_delay_us(uint32_t us)
+{
+    atecc608a_bus_delay(us);
+}
+
+const atecc608a_backend_t atecc608a_host_backend = {
+    .name = "emulator",
+    .open = emu_open,
+    .wake = emu_wake,
+    .idle = emu_idle,
+    .sleep = emu_sleep,
+    .send = emu_send,
+    .receive = emu_receive,
+    .delay_us = emu_delay_us,
+};
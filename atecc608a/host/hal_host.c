@@ -0,0 +1,187 @@
+/**
+ * \file hal_host.c
+ * \brief cryptoauthlib I2C HAL of host builds, over the backend of the
+ *        build, with optional recording of the calls.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "atca_hal.h"
+#include "atecc608a_backend.h"
+#include "atecc608a_profile.h"
+
+/* cryptoauthlib initializes the HAL on each atcab_init(). */
+static bool opened;
+static ATCA_STATUS open_status;
+static FILE *record;
+
+static void record_call(const char *call, ATCA_STATUS status,
+                        const uint8_t *data, size_t length)
+{
+    if (record == NULL) {
+        return;
+    }
+    fprintf(record, "%s %02x", call, (unsigned) status);
+    if (length > 0) {
+        fputc(' ', record);
+    }
+    for (size_t i = 0; i < length; i++) {
+        fprintf(record, "%02x", data[i]);
+    }
+    fputc('\n', record);
+}
+
+ATCA_STATUS hal_i2c_init(void *hal, ATCAIfaceCfg *cfg)
+{
+    const char *path = getenv("ATECC608A_RECORD");
+
+    (void) hal;
+    (void) cfg;
+    if (opened) {
+        return open_status;
+    }
+    opened = true;
+    open_status = atecc608a_host_backend.open();
+    if (open_status != ATCA_SUCCESS) {
+        printf("Failed to open the %s backend.\n", atecc608a_host_backend.name);
+        return open_status;
+    }
+    if (path != NULL) {
+        record = fopen(path, "w");
+        if (record == NULL) {
+            printf("Failed to open %s to record the device calls.\n", path);
+            open_status = ATCA_GEN_FAIL;
+            return open_status;
+        }
+        /* Whole lines, so that a trace of a crashed run can be replayed up
+         * to the crash. */
+        setvbuf(record, NULL, _IOLBF, 0);
+    }
+    return ATCA_SUCCESS;
+}
+
+ATCA_STATUS hal_i2c_post_init(ATCAIface iface)
+{
+    (void) iface;
+    return ATCA_SUCCESS;
+}
+
+/* The first byte of `txdata` is reserved for the word address, the command
+ * packet follows it. */
+ATCA_STATUS hal_i2c_send(ATCAIface iface, uint8_t *txdata, int txlength)
+{
+    ATCA_STATUS status;
+
+    (void) iface;
+    atecc608a_profile_enter(ATECC608A_LAYER_HAL);
+    status = atecc608a_host_backend.send(txdata + 1, (size_t) txlength);
+    record_call("send", status, txdata + 1, (size_t) txlength);
+    atecc608a_profile_exit();
+    return status;
+}
+
+ATCA_STATUS hal_i2c_receive(ATCAIface iface, uint8_t *rxdata,
+                            uint16_t *rxlength)
+{
+    ATCA_STATUS status;
+
+    (void) iface;
+    atecc608a_profile_enter(ATECC608A_LAYER_HAL);
+    status = atecc608a_host_backend.receive(rxdata, rxlength);
+    record_call("recv", status, rxdata,
+                status == ATCA_SUCCESS ? *rxlength : 0);
+    atecc608a_profile_exit();
+    return status;
+}
+
+ATCA_STATUS hal_i2c_wake(ATCAIface iface)
+{
+    ATCA_STATUS status;
+
+    (void) iface;
+    atecc608a_profile_enter(ATECC608A_LAYER_HAL);
+    status = atecc608a_host_backend.wake();
+    record_call("wake", status, NULL, 0);
+    atecc608a_profile_exit();
+    return status;
+}
+
+ATCA_STATUS hal_i2c_idle(ATCAIface iface)
+{
+    ATCA_STATUS status;
+
+    (void) iface;
+    atecc608a_profile_enter(ATECC608A_LAYER_HAL);
+    status = atecc608a_host_backend.idle();
+    record_call("idle", status, NULL, 0);
+    atecc608a_profile_exit();
+    return status;
+}
+
+ATCA_STATUS hal_i2c_sleep(ATCAIface iface)
+{
+    ATCA_STATUS status;
+
+    (void) iface;
+    atecc608a_profile_enter(ATECC608A_LAYER_HAL);
+    status = atecc608a_host_backend.sleep();
+    record_call("sleep", status, NULL, 0);
+    atecc608a_profile_exit();
+    return status;
+}
+
+ATCA_STATUS hal_i2c_release(void *hal_data)
+{
+    (void) hal_data;
+    return ATCA_SUCCESS;
+}
+
+ATCA_STATUS hal_i2c_discover_buses(int i2c_buses[], int max_buses)
+{
+    if (max_buses > 0) {
+        i2c_buses[0] = 0;
+    }
+    return ATCA_SUCCESS;
+}
+
+ATCA_STATUS hal_i2c_discover_devices(int bus_num, ATCAIfaceCfg cfg[],
+                                     int *found)
+{
+    (void) bus_num;
+    (void) cfg;
+    *found = 1;
+    return ATCA_SUCCESS;
+}
+
+void atca_delay_us(uint32_t delay)
+{
+    atecc608a_host_backend.delay_us(delay);
+}
+
+void atca_delay_10us(uint32_t delay)
+{
+    atecc608a_host_backend.delay_us(delay * 10);
+}
+
+void atca_delay_ms(uint32_t delay)
+{
+    atecc608a_host_backend.delay_us(delay * 1000);
+}
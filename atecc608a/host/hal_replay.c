@@ -0,0 +1,189 @@
+/**
+ * \file hal_replay.c
+ * \brief Backend of host builds answering with the responses of a recorded
+ *        trace.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "atecc608a_backend.h"
+
+/* Longer than any command packet or response, in hex. */
+#define LINE_SIZE 640
+#define DATA_SIZE 255
+
+static FILE *trace;
+static unsigned long line_number;
+/* Once the run sent something else than the trace, the device state it
+ * expects is unknown: every later call fails. */
+static bool diverged;
+
+typedef struct {
+    char call[8];
+    ATCA_STATUS status;
+    uint8_t data[DATA_SIZE];
+    size_t length;
+} trace_entry_t;
+
+static bool parse_hex(const char *hex, uint8_t *data, size_t *length)
+{
+    size_t count = 0;
+    unsigned int byte;
+
+    while (hex[0] != '\0' && hex[0] != '\n') {
+        if (count == DATA_SIZE || sscanf(hex, "%2x", &byte) != 1) {
+            return false;
+        }
+        data[count++] = (uint8_t) byte;
+        hex += 2;
+    }
+    *length = count;
+    return true;
+}
+
+/* Read the next entry, which must be of `call`. */
+static bool next_entry(const char *call, trace_entry_t *entry)
+{
+    char line[LINE_SIZE];
+    char hex[LINE_SIZE];
+    unsigned int status;
+    int fields;
+
+    if (diverged) {
+        return false;
+    }
+    do {
+        if (fgets(line, sizeof(line), trace) == NULL) {
+            printf("Replay: the trace ended at line %lu, before a %s.\n",
+                   line_number, call);
+            diverged = true;
+            return false;
+        }
+        line_number++;
+    } while (line[0] == '#' || line[0] == '\n');
+
+    hex[0] = '\0';
+    fields = sscanf(line, "%7s %x %s", entry->call, &status, hex);
+    if (fields < 2 || !parse_hex(hex, entry->data, &entry->length)) {
+        printf("Replay: line %lu of the trace is not a call.\n", line_number);
+        diverged = true;
+        return false;
+    }
+    entry->status = (ATCA_STATUS) status;
+    if (strcmp(entry->call, call) != 0) {
+        printf("Replay: diverged at line %lu, a %s instead of a %s.\n",
+               line_number, call, entry->call);
+        diverged = true;
+        return false;
+    }
+    return true;
+}
+
+static ATCA_STATUS replay_open(void)
+{
+    const char *path = getenv("ATECC608A_REPLAY");
+
+    if (path == NULL) {
+        printf("Replay: set ATECC608A_REPLAY to a trace recorded with "
+               "ATECC608A_RECORD.\n");
+        return ATCA_COMM_FAIL;
+    }
+    trace = fopen(path, "r");
+    if (trace == NULL) {
+        printf("Replay: failed to open %s.\n", path);
+        return ATCA_COMM_FAIL;
+    }
+    return ATCA_SUCCESS;
+}
+
+static ATCA_STATUS replay_call(const char *call)
+{
+    trace_entry_t entry;
+
+    return next_entry(call, &entry) ? entry.status : ATCA_COMM_FAIL;
+}
+
+static ATCA_STATUS replay_wake(void)
+{
+    return replay_call("wake");
+}
+
+static ATCA_STATUS replay_idle(void)
+{
+    return replay_call("idle");
+}
+
+static ATCA_STATUS replay_sleep(void)
+{
+    return replay_call("sleep");
+}
+
+static ATCA_STATUS replay_send(const uint8_t *packet, size_t length)
+{
+    trace_entry_t entry;
+
+    if (!next_entry("send", &entry)) {
+        return ATCA_COMM_FAIL;
+    }
+    if (entry.length != length || memcmp(entry.data, packet, length) != 0) {
+        printf("Replay: diverged at line %lu, another command was sent.\n",
+               line_number);
+        diverged = true;
+        return ATCA_COMM_FAIL;
+    }
+    return entry.status;
+}
+
+static ATCA_STATUS replay_receive(uint8_t *data, uint16_t *length)
+{
+    trace_entry_t entry;
+
+    if (!next_entry("recv", &entry)) {
+        return ATCA_COMM_FAIL;
+    }
+    if (entry.status != ATCA_SUCCESS) {
+        return entry.status;
+    }
+    if (entry.length > *length) {
+        return ATCA_SMALL_BUFFER;
+    }
+    memcpy(data, entry.data, entry.length);
+    *length = (uint16_t) entry.length;
+    return ATCA_SUCCESS;
+}
+
+/* The responses are there already. */
+static void replay_delay_us(uint32_t us)
+{
+    (void) us;
+}
+
+const atecc608a_backend_t atecc608a_host_backend = {
+    .name = "replay",
+    .open = replay_open,
+    .wake = replay_wake,
+    .idle = replay_idle,
+    .sleep = replay_sleep,
+    .send = replay_send,
+    .receive = replay_receive,
+    .delay_us = replay_delay_us,
+};
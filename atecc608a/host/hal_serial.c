@@ -0,0 +1,360 @@
+/**
+ * \file hal_serial.c
+ * \brief Backend of host builds talking to a real device through a relay
+ *        board on a serial port.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "atecc608a_backend.h"
+#include "atecc608a_bridge.h"
+
+/* The relay answers a receive once the device is done with its command,
+ * and acknowledges posted requests within a few frames: far less than
+ * this. */
+#define RESPONSE_TIMEOUT_MS 2000
+
+static int serial_fd = -1;
+static atecc608a_bridge_reader_t reader;
+static uint8_t next_seq;
+/* The last request acknowledged. The requests after it, up to next_seq,
+ * are in flight. */
+static uint8_t acked_seq;
+static uint8_t window;
+/* The wake that began the current wake...idle sequence: a command and its
+ * response are in one. */
+static uint8_t sequence_seq;
+/* The first failure of a posted request of the current sequence, for its
+ * next receive, and of an earlier one, for the next wake. A failure is
+ * never returned for a command of another sequence: the driver would retry
+ * that command, which may have run. */
+static ATCA_STATUS deferred_status;
+static ATCA_STATUS earlier_status;
+
+static uint8_t in_flight(void)
+{
+    return (uint8_t)(next_seq - 1 - acked_seq);
+}
+
+/* Keep the failure of the posted request `seq` for the call it belongs
+ * to. */
+static void defer(uint8_t seq, uint8_t code)
+{
+    ATCA_STATUS *status = (int8_t)(uint8_t)(seq - sequence_seq) < 0 ?
+                          &earlier_status : &deferred_status;
+
+    if (code != ATCA_SUCCESS && *status == ATCA_SUCCESS) {
+        *status = (ATCA_STATUS) code;
+    }
+}
+
+static int tty_read(void *context, uint8_t *data, size_t length)
+{
+    struct pollfd pfd = { .fd = serial_fd, .events = POLLIN };
+    ssize_t count;
+    int ready;
+
+    (void) context;
+    ready = poll(&pfd, 1, RESPONSE_TIMEOUT_MS);
+    if (ready <= 0) {
+        return ready == 0 || errno == EINTR ? 0 : -1;
+    }
+    count = read(serial_fd, data, length);
+    if (count < 0) {
+        return errno == EAGAIN || errno == EINTR ? 0 : -1;
+    }
+    /* The other end hung up. */
+    return count == 0 ? -1 : (int) count;
+}
+
+static bool tty_write(void *context, const uint8_t *data, size_t length)
+{
+    (void) context;
+    while (length > 0) {
+        ssize_t count = write(serial_fd, data, length);
+
+        if (count < 0) {
+            if (errno != EINTR && errno != EAGAIN) {
+                return false;
+            }
+            continue;
+        }
+        data += count;
+        length -= (size_t) count;
+    }
+    return true;
+}
+
+static const atecc608a_bridge_link_t tty_link = { tty_read, tty_write, NULL };
+
+static speed_t baud_speed(unsigned long baud)
+{
+    switch (baud) {
+        case 9600:
+            return B9600;
+        case 19200:
+            return B19200;
+        case 38400:
+            return B38400;
+        case 57600:
+            return B57600;
+        case 115200:
+            return B115200;
+        case 230400:
+            return B230400;
+        case 460800:
+            return B460800;
+        case 921600:
+            return B921600;
+        default:
+            return B0;
+    }
+}
+
+/* The relay is on ATECC608A_SERIAL, at ATECC608A_SERIAL_BAUD. */
+static ATCA_STATUS serial_open(void)
+{
+    const char *path = getenv("ATECC608A_SERIAL");
+    const char *baud = getenv("ATECC608A_SERIAL_BAUD");
+    const char *requests = getenv("ATECC608A_SERIAL_WINDOW");
+    unsigned long most = ATECC608A_BRIDGE_WINDOW;
+    speed_t speed;
+    struct termios tio;
+
+    if (path == NULL) {
+        path = "/dev/ttyACM0";
+    }
+    speed = baud_speed(baud != NULL ? strtoul(baud, NULL, 10) :
+                       ATECC608A_RELAY_BAUD);
+    if (speed == B0) {
+        printf("Serial: unsupported baud rate %s.\n", baud);
+        return ATCA_BAD_PARAM;
+    }
+    if (requests != NULL) {
+        most = strtoul(requests, NULL, 10);
+    }
+    if (most < 1 || most > ATECC608A_BRIDGE_WINDOW_MAX) {
+        printf("Serial: the window must be 1 to %d requests.\n",
+               ATECC608A_BRIDGE_WINDOW_MAX);
+        return ATCA_BAD_PARAM;
+    }
+    if (serial_fd >= 0) {
+        close(serial_fd);
+    }
+    serial_fd = open(path, O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (serial_fd < 0) {
+        printf("Serial: failed to open %s: %s.\n", path, strerror(errno));
+        return ATCA_COMM_FAIL;
+    }
+    /* Raw bytes, with reads returning what is there; the reads poll. A tty
+     * that is not a terminal, such as a socket, is taken as it is. */
+    if (tcgetattr(serial_fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tio.c_cflag |= CLOCAL | CREAD;
+        tio.c_cc[VMIN] = 0;
+        tio.c_cc[VTIME] = 0;
+        cfsetispeed(&tio, speed);
+        cfsetospeed(&tio, speed);
+        tcsetattr(serial_fd, TCSANOW, &tio);
+        tcflush(serial_fd, TCIOFLUSH);
+    }
+    atecc608a_bridge_reader_init(&reader);
+    window = (uint8_t) most;
+    next_seq = 0;
+    acked_seq = 0xFF;
+    sequence_seq = 0;
+    deferred_status = ATCA_SUCCESS;
+    earlier_status = ATCA_SUCCESS;
+    return ATCA_SUCCESS;
+}
+
+/* Read responses until `seq`, which is in flight, is answered or
+ * acknowledged along with a later request. Responses to requests no longer
+ * in flight, after a timeout, are dropped. On a failure the requests in
+ * flight are given up. */
+static ATCA_STATUS await(uint8_t seq, atecc608a_bridge_frame_t *response)
+{
+    for (;;) {
+        ATCA_STATUS status = atecc608a_bridge_read(
+                                 &tty_link, &reader,
+                                 ATECC608A_BRIDGE_RESPONSE_SYNC, response);
+        uint8_t done;
+        uint8_t wanted;
+
+        if (status != ATCA_SUCCESS) {
+            acked_seq = (uint8_t)(next_seq - 1);
+            return status == ATCA_RX_TIMEOUT ? ATCA_TIMEOUT : status;
+        }
+        done = (uint8_t)(response->seq - acked_seq);
+        wanted = (uint8_t)(seq - acked_seq);
+        if (done == 0 || done > in_flight()) {
+            continue;
+        }
+        acked_seq = response->seq;
+        if (response->seq == seq) {
+            return ATCA_SUCCESS;
+        }
+        /* An acknowledgement, or the failure of a posted request. */
+        defer(response->seq, response->code);
+        if (done > wanted) {
+            return ATCA_SUCCESS;
+        }
+    }
+}
+
+/* Send a HAL call to the relay, once there is room in the window. Returns
+ * the sequence number of the request. */
+static ATCA_STATUS post(uint8_t code, const uint8_t *payload, size_t length,
+                        uint8_t *seq)
+{
+    atecc608a_bridge_frame_t request;
+    ATCA_STATUS status;
+
+    if (length > ATECC608A_BRIDGE_MAX_PAYLOAD) {
+        return ATCA_BAD_PARAM;
+    }
+    if (in_flight() >= window) {
+        uint8_t oldest = (uint8_t)(acked_seq + 1);
+
+        status = await(oldest, &request);
+        if (status != ATCA_SUCCESS) {
+            return status;
+        }
+        if (request.seq == oldest) {
+            defer(request.seq, request.code);
+        }
+    }
+    request.seq = next_seq;
+    request.code = code;
+    request.length = (uint8_t) length;
+    if (length > 0) {
+        memcpy(request.payload, payload, length);
+    }
+    status = atecc608a_bridge_write(&tty_link, ATECC608A_BRIDGE_REQUEST_SYNC,
+                                    &request);
+    if (status != ATCA_SUCCESS) {
+        return status;
+    }
+    *seq = next_seq++;
+    return ATCA_SUCCESS;
+}
+
+/* Wakes, idles, sleeps and sends return at once: a failure is returned by
+ * the next receive of the same sequence, or else by the next wake. With a
+ * window of one request, each waits for its response. */
+static ATCA_STATUS serial_call(uint8_t code, const uint8_t *payload,
+                               size_t length)
+{
+    atecc608a_bridge_frame_t response;
+    ATCA_STATUS status;
+    uint8_t seq;
+
+    status = post(code, payload, length, &seq);
+    if (status != ATCA_SUCCESS || window > 1) {
+        return status;
+    }
+    status = await(seq, &response);
+    return status != ATCA_SUCCESS ? status : (ATCA_STATUS) response.code;
+}
+
+/* A failure left over from the sequence before, e.g. of its idle, fails
+ * the wake before anything of the new command is sent. */
+static ATCA_STATUS serial_wake(void)
+{
+    ATCA_STATUS status = earlier_status != ATCA_SUCCESS ? earlier_status :
+                         deferred_status;
+
+    earlier_status = ATCA_SUCCESS;
+    deferred_status = ATCA_SUCCESS;
+    if (status != ATCA_SUCCESS) {
+        return status;
+    }
+    sequence_seq = next_seq;
+    return serial_call(ATECC608A_BRIDGE_WAKE, NULL, 0);
+}
+
+static ATCA_STATUS serial_idle(void)
+{
+    return serial_call(ATECC608A_BRIDGE_IDLE, NULL, 0);
+}
+
+static ATCA_STATUS serial_sleep(void)
+{
+    return serial_call(ATECC608A_BRIDGE_SLEEP, NULL, 0);
+}
+
+static ATCA_STATUS serial_send(const uint8_t *packet, size_t length)
+{
+    return serial_call(ATECC608A_BRIDGE_SEND, packet, length);
+}
+
+static ATCA_STATUS serial_receive(uint8_t *data, uint16_t *length)
+{
+    atecc608a_bridge_frame_t response;
+    uint8_t most = *length < ATECC608A_BRIDGE_MAX_PAYLOAD ?
+                   (uint8_t) *length : ATECC608A_BRIDGE_MAX_PAYLOAD;
+    ATCA_STATUS status;
+    uint8_t seq;
+
+    status = post(ATECC608A_BRIDGE_RECEIVE, &most, 1, &seq);
+    if (status == ATCA_SUCCESS) {
+        status = await(seq, &response);
+    }
+    if (deferred_status != ATCA_SUCCESS) {
+        status = deferred_status;
+        deferred_status = ATCA_SUCCESS;
+    }
+    if (status != ATCA_SUCCESS) {
+        return status;
+    }
+    if (response.code != ATCA_SUCCESS) {
+        return (ATCA_STATUS) response.code;
+    }
+    if (response.length > *length) {
+        return ATCA_SMALL_BUFFER;
+    }
+    memcpy(data, response.payload, response.length);
+    *length = response.length;
+    return ATCA_SUCCESS;
+}
+
+/* The relay polls the device on a receive, so the driver need not wait for
+ * the longest execution time of its commands. */
+static void serial_delay_us(uint32_t us)
+{
+    (void) us;
+}
+
+const atecc608a_backend_t atecc608a_host_backend = {
+    .name = "serial",
+    .open = serial_open,
+    .wake = serial_wake,
+    .idle = serial_idle,
+    .sleep = serial_sleep,
+    .send = serial_send,
+    .receive = serial_receive,
+    .delay_us = serial_delay_us,
+};
@@ -0,0 +1,36 @@
+/**
+ * \file cmsis.h
+ * \brief The parts of the CMSIS core header host builds use.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_HOST_CMSIS_H
+#define ATECC608A_HOST_CMSIS_H
+
+#include <stdint.h>
+
+/** Nominal: atecc608a_cycles() counts nanoseconds on hosts. */
+extern uint32_t SystemCoreClock;
+
+static inline void __DMB(void)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+#endif /* ATECC608A_HOST_CMSIS_H */
@@ -0,0 +1,47 @@
+/**
+ * \file us_ticker_api.h
+ * \brief The microsecond ticker of Mbed OS, over CLOCK_MONOTONIC.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_HOST_US_TICKER_API_H
+#define ATECC608A_HOST_US_TICKER_API_H
+
+#include <stdint.h>
+#include <time.h>
+
+typedef uint64_t us_timestamp_t;
+typedef struct ticker_data ticker_data_t;
+
+static inline const ticker_data_t *get_us_ticker_data(void)
+{
+    return NULL;
+}
+
+static inline us_timestamp_t ticker_read_us(const ticker_data_t *ticker)
+{
+    struct timespec ts;
+
+    (void) ticker;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (us_timestamp_t) ts.tv_sec * 1000000u +
+           (us_timestamp_t) ts.tv_nsec / 1000u;
+}
+
+#endif /* ATECC608A_HOST_US_TICKER_API_H */
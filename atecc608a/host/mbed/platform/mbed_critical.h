@@ -0,0 +1,50 @@
+/**
+ * \file mbed_critical.h
+ * \brief The atomics of Mbed OS host builds use, over the GCC builtins.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_HOST_MBED_CRITICAL_H
+#define ATECC608A_HOST_MBED_CRITICAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+static inline bool core_util_atomic_cas_u32(volatile uint32_t *ptr,
+                                            uint32_t *expectedCurrentValue,
+                                            uint32_t desiredValue)
+{
+    return __atomic_compare_exchange_n(ptr, expectedCurrentValue,
+                                       desiredValue, false, __ATOMIC_SEQ_CST,
+                                       __ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t core_util_atomic_incr_u32(volatile uint32_t *valuePtr,
+                                                 uint32_t delta)
+{
+    return __atomic_add_fetch(valuePtr, delta, __ATOMIC_SEQ_CST);
+}
+
+/** Hosts have no interrupt handlers calling in. */
+static inline bool core_util_is_isr_active(void)
+{
+    return false;
+}
+
+#endif /* ATECC608A_HOST_MBED_CRITICAL_H */
@@ -0,0 +1,29 @@
+/**
+ * \file internal_trusted_storage.h
+ * \brief The PSA internal trusted storage of host builds: the file backed
+ *        one of Mbed Crypto, in the working directory.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef ATECC608A_HOST_INTERNAL_TRUSTED_STORAGE_H
+#define ATECC608A_HOST_INTERNAL_TRUSTED_STORAGE_H
+
+#include "psa_crypto_its.h"
+
+#endif /* ATECC608A_HOST_INTERNAL_TRUSTED_STORAGE_H */
@@ -0,0 +1,438 @@
+/**
+ * \file mbed_posix.c
+ * \brief The Mbed OS and CMSIS-RTOS2 calls host builds use, over POSIX
+ *        threads.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include "cmsis_os2.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cmsis.h"
+
+uint32_t SystemCoreClock = 1000000000u;
+
+struct os_thread {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    uint32_t flags;
+    osThreadFunc_t func;
+    void *argument;
+    osPriority_t priority;
+};
+
+struct os_mutex {
+    pthread_mutex_t mutex;
+};
+
+struct os_semaphore {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    uint32_t count;
+    uint32_t max_count;
+};
+
+struct os_message_queue {
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    uint8_t *messages;
+    uint32_t msg_size;
+    uint32_t msg_count;
+    uint32_t head;
+    uint32_t used;
+};
+
+/* The thread running, made on first use for threads not started by
+ * osThreadNew(), such as the main thread. */
+static __thread struct os_thread *current_thread;
+
+static void timespec_add_ms(struct timespec *ts, uint32_t ms)
+{
+    ts->tv_sec += ms / 1000;
+    ts->tv_nsec += (long)(ms % 1000) * 1000000;
+    if (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+/* Condition variables wait on the monotonic clock, as the kernel ticks. */
+static void cond_init(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static void deadline_after(struct timespec *deadline, uint32_t timeout)
+{
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    timespec_add_ms(deadline, timeout);
+}
+
+/* One wait of a loop waiting for a condition with `timeout`, false once the
+ * deadline passed. */
+static bool cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex,
+                      uint32_t timeout, const struct timespec *deadline)
+{
+    if (timeout == 0) {
+        return false;
+    }
+    if (timeout == osWaitForever) {
+        pthread_cond_wait(cond, mutex);
+        return true;
+    }
+    return pthread_cond_timedwait(cond, mutex, deadline) != ETIMEDOUT;
+}
+
+uint32_t osKernelGetTickCount(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t) ts.tv_sec * 1000u +
+                      (uint64_t) ts.tv_nsec / 1000000u);
+}
+
+osStatus_t osDelay(uint32_t ticks)
+{
+    struct timespec ts = { 0, 0 };
+
+    timespec_add_ms(&ts, ticks);
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+    return osOK;
+}
+
+static struct os_thread *thread_new(osThreadFunc_t func, void *argument,
+                                    osPriority_t priority)
+{
+    struct os_thread *thread = calloc(1, sizeof(*thread));
+
+    if (thread == NULL) {
+        return NULL;
+    }
+    pthread_mutex_init(&thread->mutex, NULL);
+    cond_init(&thread->cond);
+    thread->func = func;
+    thread->argument = argument;
+    thread->priority = priority;
+    return thread;
+}
+
+static void *thread_start(void *argument)
+{
+    struct os_thread *thread = argument;
+
+    current_thread = thread;
+    thread->func(thread->argument);
+    return NULL;
+}
+
+/* Threads are never joined or terminated, as on the target: their state
+ * stays valid for osThreadFlagsSet() from others. */
+osThreadId_t osThreadNew(osThreadFunc_t func, void *argument,
+                         const osThreadAttr_t *attr)
+{
+    struct os_thread *thread;
+    pthread_attr_t thread_attr;
+    pthread_t id;
+    int result;
+
+    thread = thread_new(func, argument,
+                        attr != NULL && attr->priority != osPriorityNone ?
+                        attr->priority : osPriorityNormal);
+    if (thread == NULL) {
+        return NULL;
+    }
+    pthread_attr_init(&thread_attr);
+    pthread_attr_setdetachstate(&thread_attr, PTHREAD_CREATE_DETACHED);
+    result = pthread_create(&id, &thread_attr, thread_start, thread);
+    pthread_attr_destroy(&thread_attr);
+    if (result != 0) {
+        free(thread);
+        return NULL;
+    }
+    return thread;
+}
+
+osThreadId_t osThreadGetId(void)
+{
+    if (current_thread == NULL) {
+        current_thread = thread_new(NULL, NULL, osPriorityNormal);
+    }
+    return current_thread;
+}
+
+osStatus_t osThreadYield(void)
+{
+    sched_yield();
+    return osOK;
+}
+
+uint32_t osThreadFlagsSet(osThreadId_t thread_id, uint32_t flags)
+{
+    uint32_t result;
+
+    if (thread_id == NULL || (flags & osFlagsError) != 0) {
+        return osFlagsErrorParameter;
+    }
+    pthread_mutex_lock(&thread_id->mutex);
+    thread_id->flags |= flags;
+    result = thread_id->flags;
+    pthread_cond_broadcast(&thread_id->cond);
+    pthread_mutex_unlock(&thread_id->mutex);
+    return result;
+}
+
+/* Returns the flags before they were cleared, as RTX does. */
+uint32_t osThreadFlagsWait(uint32_t flags, uint32_t options, uint32_t timeout)
+{
+    struct os_thread *thread = osThreadGetId();
+    struct timespec deadline;
+    uint32_t result = osFlagsErrorTimeout;
+
+    if (thread == NULL) {
+        return osFlagsErrorResource;
+    }
+    deadline_after(&deadline, timeout);
+    pthread_mutex_lock(&thread->mutex);
+    do {
+        uint32_t set = thread->flags & flags;
+
+        if ((options & osFlagsWaitAll) != 0 ? set == flags : set != 0) {
+            result = thread->flags;
+            if ((options & osFlagsNoClear) == 0) {
+                thread->flags &= ~flags;
+            }
+            break;
+        }
+    } while (cond_wait(&thread->cond, &thread->mutex, timeout, &deadline));
+    pthread_mutex_unlock(&thread->mutex);
+    return result;
+}
+
+/* Priority inheritance is left out with the priorities. */
+osMutexId_t osMutexNew(const osMutexAttr_t *attr)
+{
+    struct os_mutex *mutex = calloc(1, sizeof(*mutex));
+    pthread_mutexattr_t mutex_attr;
+
+    if (mutex == NULL) {
+        return NULL;
+    }
+    pthread_mutexattr_init(&mutex_attr);
+    pthread_mutexattr_settype(&mutex_attr,
+                              attr != NULL &&
+                              (attr->attr_bits & osMutexRecursive) != 0 ?
+                              PTHREAD_MUTEX_RECURSIVE :
+                              PTHREAD_MUTEX_ERRORCHECK);
+    pthread_mutex_init(&mutex->mutex, &mutex_attr);
+    pthread_mutexattr_destroy(&mutex_attr);
+    return mutex;
+}
+
+osStatus_t osMutexAcquire(osMutexId_t mutex_id, uint32_t timeout)
+{
+    struct timespec deadline;
+    int result;
+
+    if (mutex_id == NULL) {
+        return osErrorParameter;
+    }
+    if (timeout == 0) {
+        result = pthread_mutex_trylock(&mutex_id->mutex);
+        return result == 0 ? osOK : osErrorResource;
+    }
+    if (timeout == osWaitForever) {
+        result = pthread_mutex_lock(&mutex_id->mutex);
+    } else {
+        /* Mutexes only time out on the real time clock. */
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        timespec_add_ms(&deadline, timeout);
+        result = pthread_mutex_timedlock(&mutex_id->mutex, &deadline);
+    }
+    if (result == ETIMEDOUT) {
+        return osErrorTimeout;
+    }
+    return result == 0 ? osOK : osErrorResource;
+}
+
+osStatus_t osMutexRelease(osMutexId_t mutex_id)
+{
+    if (mutex_id == NULL) {
+        return osErrorParameter;
+    }
+    return pthread_mutex_unlock(&mutex_id->mutex) == 0 ? osOK :
+           osErrorResource;
+}
+
+osSemaphoreId_t osSemaphoreNew(uint32_t max_count, uint32_t initial_count,
+                               const osSemaphoreAttr_t *attr)
+{
+    struct os_semaphore *semaphore;
+
+    (void) attr;
+    if (max_count == 0 || initial_count > max_count) {
+        return NULL;
+    }
+    semaphore = calloc(1, sizeof(*semaphore));
+    if (semaphore == NULL) {
+        return NULL;
+    }
+    pthread_mutex_init(&semaphore->mutex, NULL);
+    cond_init(&semaphore->cond);
+    semaphore->count = initial_count;
+    semaphore->max_count = max_count;
+    return semaphore;
+}
+
+osStatus_t osSemaphoreAcquire(osSemaphoreId_t semaphore_id, uint32_t timeout)
+{
+    struct timespec deadline;
+    osStatus_t status = timeout == 0 ? osErrorResource : osErrorTimeout;
+
+    if (semaphore_id == NULL) {
+        return osErrorParameter;
+    }
+    deadline_after(&deadline, timeout);
+    pthread_mutex_lock(&semaphore_id->mutex);
+    do {
+        if (semaphore_id->count > 0) {
+            semaphore_id->count--;
+            status = osOK;
+            break;
+        }
+    } while (cond_wait(&semaphore_id->cond, &semaphore_id->mutex, timeout,
+                       &deadline));
+    pthread_mutex_unlock(&semaphore_id->mutex);
+    return status;
+}
+
+osStatus_t osSemaphoreRelease(osSemaphoreId_t semaphore_id)
+{
+    osStatus_t status = osErrorResource;
+
+    if (semaphore_id == NULL) {
+        return osErrorParameter;
+    }
+    pthread_mutex_lock(&semaphore_id->mutex);
+    if (semaphore_id->count < semaphore_id->max_count) {
+        semaphore_id->count++;
+        pthread_cond_signal(&semaphore_id->cond);
+        status = osOK;
+    }
+    pthread_mutex_unlock(&semaphore_id->mutex);
+    return status;
+}
+
+osMessageQueueId_t osMessageQueueNew(uint32_t msg_count, uint32_t msg_size,
+                                     const osMessageQueueAttr_t *attr)
+{
+    struct os_message_queue *queue;
+
+    (void) attr;
+    if (msg_count == 0 || msg_size == 0) {
+        return NULL;
+    }
+    queue = calloc(1, sizeof(*queue));
+    if (queue == NULL) {
+        return NULL;
+    }
+    queue->messages = calloc(msg_count, msg_size);
+    if (queue->messages == NULL) {
+        free(queue);
+        return NULL;
+    }
+    pthread_mutex_init(&queue->mutex, NULL);
+    cond_init(&queue->not_empty);
+    cond_init(&queue->not_full);
+    queue->msg_size = msg_size;
+    queue->msg_count = msg_count;
+    return queue;
+}
+
+/* Messages are kept in order of arrival, priorities are ignored. */
+osStatus_t osMessageQueuePut(osMessageQueueId_t mq_id, const void *msg_ptr,
+                             uint8_t msg_prio, uint32_t timeout)
+{
+    struct timespec deadline;
+    osStatus_t status = timeout == 0 ? osErrorResource : osErrorTimeout;
+
+    (void) msg_prio;
+    if (mq_id == NULL || msg_ptr == NULL) {
+        return osErrorParameter;
+    }
+    deadline_after(&deadline, timeout);
+    pthread_mutex_lock(&mq_id->mutex);
+    do {
+        if (mq_id->used < mq_id->msg_count) {
+            uint32_t tail = (mq_id->head + mq_id->used) % mq_id->msg_count;
+
+            memcpy(mq_id->messages + (size_t) tail * mq_id->msg_size, msg_ptr,
+                   mq_id->msg_size);
+            mq_id->used++;
+            pthread_cond_signal(&mq_id->not_empty);
+            status = osOK;
+            break;
+        }
+    } while (cond_wait(&mq_id->not_full, &mq_id->mutex, timeout, &deadline));
+    pthread_mutex_unlock(&mq_id->mutex);
+    return status;
+}
+
+osStatus_t osMessageQueueGet(osMessageQueueId_t mq_id, void *msg_ptr,
+                             uint8_t *msg_prio, uint32_t timeout)
+{
+    struct timespec deadline;
+    osStatus_t status = timeout == 0 ? osErrorResource : osErrorTimeout;
+
+    if (mq_id == NULL || msg_ptr == NULL) {
+        return osErrorParameter;
+    }
+    deadline_after(&deadline, timeout);
+    pthread_mutex_lock(&mq_id->mutex);
+    do {
+        if (mq_id->used > 0) {
+            memcpy(msg_ptr,
+                   mq_id->messages + (size_t) mq_id->head * mq_id->msg_size,
+                   mq_id->msg_size);
+            mq_id->head = (mq_id->head + 1) % mq_id->msg_count;
+            mq_id->used--;
+            if (msg_prio != NULL) {
+                *msg_prio = 0;
+            }
+            pthread_cond_signal(&mq_id->not_full);
+            status = osOK;
+            break;
+        }
+    } while (cond_wait(&mq_id->not_empty, &mq_id->mutex, timeout, &deadline));
+    pthread_mutex_unlock(&mq_id->mutex);
+    return status;
+}
@@ -0,0 +1,66 @@
+/**
+ * \file slot_checks.cpp
+ * \brief Uses of the slot types of atecc608a.hpp that must not compile.
+ */
+
+/*
+ *  Copyright (C) 2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/* Compiled by `make -C host slot_checks` once with SLOT_CHECK=0, the valid
+ * uses, which must compile, and once with each misuse, which must not. The
+ * slots are the ones of the developer's template: 0-7 private keys, 8 data,
+ * 9-14 public keys. */
+#include "atecc608a.hpp"
+
+namespace a = atecc608a;
+
+psa_status_t slot_check()
+{
+    uint8_t hash[32] = { 0 };
+    uint8_t buffer[72];
+    size_t length;
+
+#if SLOT_CHECK == 0
+    psa_status_t status = a::sign(a::DevSlot<0>(), hash, buffer, length);
+
+    if (status == PSA_SUCCESS) {
+        status = a::verify(a::DevSlot<9>(), hash, buffer);
+    }
+    if (status == PSA_SUCCESS) {
+        status = a::read(a::DevSlot<8>(), 0, buffer);
+    }
+    return status;
+#elif SLOT_CHECK == 1
+    /* Signing with a public key slot. */
+    return a::sign(a::DevSlot<9>(), hash, buffer, length);
+#elif SLOT_CHECK == 2
+    /* Verifying with a private key slot. */
+    return a::verify(a::DevSlot<0>(), hash, buffer);
+#elif SLOT_CHECK == 3
+    /* Generating a key in the data slot. */
+    return a::generate(a::DevSlot<8>(), buffer, &length);
+#elif SLOT_CHECK == 4
+    /* Importing a public key to a private key slot. */
+    return a::import_public_key(a::DevSlot<0>(), buffer);
+#elif SLOT_CHECK == 5
+    /* Reading a secret. */
+    return a::read(a::DevSlot<0>(), 0, buffer);
+#elif SLOT_CHECK == 6
+    /* A slot the device does not have. */
+    return a::export_public_key(a::DevSlot<16>(), buffer, length);
+#endif
+}